@@ -0,0 +1,284 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "memorybackend.h"
+
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/TextureAtlas>
+#include <AtlasPack/SizeSearch>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+/*
+ * Random source for the image size distributions. The raw output of std::mt19937 is
+ * defined by the standard, the std distributions are not, so they are avoided to
+ * generate the same images on every platform.
+ */
+class SizeGenerator {
+    public:
+        SizeGenerator (unsigned int seed)
+            : m_rng(seed) {}
+
+        // uniform value in [min, max]
+        size_t uniform (size_t min, size_t max) {
+            return min + static_cast<size_t>(m_rng() % (max - min + 1));
+        }
+
+        // uniform value in (0, 1)
+        double unit () {
+            return (static_cast<double>(m_rng()) + 0.5) / 4294967296.0;
+        }
+
+    private:
+        std::mt19937 m_rng;
+};
+
+struct Distribution {
+    const char *name;
+    std::function<AtlasPack::Size (SizeGenerator &)> generate;
+};
+
+/*
+ * The synthetic size distributions the packer is measured with
+ */
+static std::vector<Distribution> distributions ()
+{
+    return {
+        { "uniform", [](SizeGenerator &gen) {
+            return AtlasPack::Size(gen.uniform(16, 256), gen.uniform(16, 256));
+        }},
+        { "power-law", [](SizeGenerator &gen) {
+            //pareto distribution with a minimum of 8 pixels, alpha 1.5, capped at 1024 pixels
+            size_t w = std::min<size_t>(1024, static_cast<size_t>(8.0 / std::pow(gen.unit(), 1.0 / 1.5)));
+            double aspect = 0.5 + gen.unit() * 1.5;
+            size_t h = std::max<size_t>(1, std::min<size_t>(1024, static_cast<size_t>(w * aspect)));
+            return AtlasPack::Size(w, h);
+        }},
+        { "icon-heavy", [](SizeGenerator &gen) {
+            static const size_t iconSizes[] = { 16, 24, 32, 48, 64 };
+            if (gen.uniform(0, 9) != 0) {
+                size_t s = iconSizes[gen.uniform(0, 4)];
+                return AtlasPack::Size(s, s);
+            }
+            return AtlasPack::Size(gen.uniform(128, 512), gen.uniform(128, 512));
+        }},
+        { "mixed", [](SizeGenerator &gen) {
+            if (gen.uniform(0, 4) != 0)
+                return AtlasPack::Size(gen.uniform(8, 32), gen.uniform(8, 32));
+            return AtlasPack::Size(gen.uniform(128, 512), gen.uniform(128, 512));
+        }}
+    };
+}
+
+static double elapsedMs (Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static double median (std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2.0;
+}
+
+struct Timing {
+    std::vector<double> samples;
+
+    void writeJson (std::ostream &out) const {
+        out << "{ \"min\": " << *std::min_element(samples.begin(), samples.end())
+            << ", \"median\": " << median(samples) << " }";
+    }
+};
+
+/*
+ * Runs the benchmark for \a dist and writes the results as JSON object into \a out
+ */
+static bool runDistribution (const Distribution &dist, size_t count, unsigned int seed,
+                             size_t repeat, const fs::path &workDir, std::ostream &out)
+{
+    MemoryBackend backend;
+    std::vector<AtlasPack::Image> images;
+    images.reserve(count);
+
+    SizeGenerator gen(seed);
+    size_t imageArea = 0;
+    for (size_t i = 0; i < count; i++) {
+        std::stringstream name;
+        name << dist.name << "/" << i << ".png";
+        AtlasPack::Size s = dist.generate(gen);
+        backend.addImage(name.str(), s);
+        images.push_back(backend.readImageInformation(name.str()));
+        imageArea += s.width * s.height;
+    }
+
+    Timing search, pack, compile;
+    std::shared_ptr<AtlasPack::TextureAtlasPacker> atlas;
+
+    for (size_t r = 0; r < repeat; r++) {
+        AtlasPack::SizeSearch sizeSearch;
+        auto start = Clock::now();
+        atlas = sizeSearch.run(images);
+        search.samples.push_back(elapsedMs(start));
+
+        if (!atlas) {
+            std::cerr << "No atlas found for " << dist.name << std::endl;
+            return false;
+        }
+
+        //a single packing trial at the final size, this is what every step of the search does
+        AtlasPack::TextureAtlasPacker trial(atlas->size());
+        start = Clock::now();
+        for (const auto &img : images)
+            trial.insertImage(img);
+        pack.samples.push_back(elapsedMs(start));
+
+        std::string err;
+        start = Clock::now();
+        AtlasPack::TextureAtlas compiled = atlas->compile((workDir / dist.name).string(), &backend, &err);
+        compile.samples.push_back(elapsedMs(start));
+
+        if (!compiled.isValid()) {
+            std::cerr << "Failed to compile " << dist.name << ": " << err << std::endl;
+            return false;
+        }
+    }
+
+    const AtlasPack::Size atlasSize = atlas->size();
+    const double occupancy = static_cast<double>(imageArea) / (atlasSize.width * atlasSize.height);
+    const double packMs = median(pack.samples);
+
+    out << "    {\n"
+        << "      \"distribution\": \"" << dist.name << "\",\n"
+        << "      \"images\": " << count << ",\n"
+        << "      \"atlas_width\": " << atlasSize.width << ",\n"
+        << "      \"atlas_height\": " << atlasSize.height << ",\n"
+        << "      \"occupancy\": " << occupancy << ",\n"
+        << "      \"pack_images_per_second\": " << (packMs > 0 ? count / (packMs / 1000.0) : 0.0) << ",\n"
+        << "      \"pack_ms\": ";
+    pack.writeJson(out);
+    out << ",\n      \"search_ms\": ";
+    search.writeJson(out);
+    out << ",\n      \"compile_ms\": ";
+    compile.writeJson(out);
+    out << "\n    }";
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    po::options_description desc("Usage:\n  atlaspack-bench [options]\n\nOptions");
+    desc.add_options()
+            ("help,h", "Show this help message.")
+            ("count,n", po::value<size_t>()->default_value(1000), "Number of images per distribution")
+            ("seed,s", po::value<unsigned int>()->default_value(42), "Seed of the image size generator")
+            ("repeat,r", po::value<size_t>()->default_value(3), "Number of measurements per distribution")
+            ("distribution,d", po::value<std::vector<std::string> >(), "Only run the given distribution, can be given multiple times")
+            ("output,o", po::value<std::string>(), "Write the JSON results to a file instead of stdout");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (po::error &err) {
+        std::cerr << "Error: " << err.what() << "\n\n" << desc << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help")) {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    const size_t count  = vm["count"].as<size_t>();
+    const unsigned int seed = vm["seed"].as<unsigned int>();
+    const size_t repeat = std::max<size_t>(1, vm["repeat"].as<size_t>());
+
+    std::vector<Distribution> selected;
+    for (const Distribution &dist : distributions()) {
+        if (vm.count("distribution")) {
+            const auto &names = vm["distribution"].as<std::vector<std::string> >();
+            if (std::find(names.begin(), names.end(), dist.name) == names.end())
+                continue;
+        }
+        selected.push_back(dist);
+    }
+
+    if (selected.empty() || count == 0) {
+        std::cerr << "Nothing to benchmark." << std::endl;
+        return 1;
+    }
+
+    //the compile step still writes the small atlas description, keep it out of the way
+    fs::path workDir = fs::temp_directory_path() / fs::unique_path("atlaspack-bench-%%%%-%%%%");
+    fs::create_directories(workDir);
+
+    std::stringstream json;
+    json << "{\n"
+         << "  \"seed\": " << seed << ",\n"
+         << "  \"repeat\": " << repeat << ",\n"
+         << "  \"results\": [\n";
+
+    bool success = true;
+    for (size_t i = 0; i < selected.size() && success; i++) {
+        std::cerr << "Running " << selected[i].name << " with " << count << " images" << std::endl;
+        if (i > 0)
+            json << ",\n";
+        success = runDistribution(selected[i], count, seed, repeat, workDir, json);
+    }
+    json << "\n  ]\n}\n";
+
+    boost::system::error_code err;
+    fs::remove_all(workDir, err);
+
+    if (!success)
+        return 1;
+
+    if (vm.count("output")) {
+        std::ofstream out(vm["output"].as<std::string>(), std::ios::trunc | std::ios::out);
+        if (!out.is_open()) {
+            std::cerr << "Could not open " << vm["output"].as<std::string>() << std::endl;
+            return 1;
+        }
+        out << json.str();
+    } else {
+        std::cout << json.str();
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "memorybackend.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+void MemoryBackend::addImage(const std::string &name, const AtlasPack::Size &size)
+{
+    m_images[name] = size;
+}
+
+bool MemoryBackend::supportsImageType(const std::string &extension) const
+{
+    UNUSED(extension);
+    return true;
+}
+
+std::shared_ptr<AtlasPack::PaintDevice> MemoryBackend::createPaintDevice(const AtlasPack::Size &reserveSize) const
+{
+    return std::make_shared<MemoryPaintDevice>(this, reserveSize);
+}
+
+AtlasPack::Image MemoryBackend::readImageInformation(const std::string &path) const
+{
+    auto it = m_images.find(path);
+    if (it == m_images.end())
+        return AtlasPack::Image();
+    return AtlasPack::Image(path, it->second);
+}
+
+/*
+ * Generates the pixels of the image registered as \a path, the content is a
+ * pattern derived from the name with a transparent border, so decoding costs
+ * are roughly comparable to a real image.
+ */
+bool MemoryBackend::readImagePixels(const std::string &path, AtlasPack::PixelBuffer *target) const
+{
+    auto it = m_images.find(path);
+    if (it == m_images.end()) {
+        std::cerr << "Unknown image " << path << std::endl;
+        return false;
+    }
+
+    const AtlasPack::Size size = it->second;
+    const size_t seed = std::hash<std::string>()(path);
+
+    AtlasPack::PixelBuffer pixels(size);
+    for (size_t y = 0; y < size.height; y++) {
+        unsigned char *row = pixels.scanLine(y);
+        bool borderRow = y == 0 || y + 1 == size.height;
+        for (size_t x = 0; x < size.width; x++) {
+            row[x * 4]     = static_cast<unsigned char>(seed + x);
+            row[x * 4 + 1] = static_cast<unsigned char>((seed >> 8) + y);
+            row[x * 4 + 2] = static_cast<unsigned char>((seed >> 16) + x + y);
+            row[x * 4 + 3] = (borderRow || x == 0 || x + 1 == size.width) ? 0 : 255;
+        }
+    }
+
+    *target = std::move(pixels);
+    return true;
+}
+
+MemoryPaintDevice::MemoryPaintDevice(const MemoryBackend *backend, const AtlasPack::Size &reserveSize)
+    : m_backend(backend)
+    , m_canvas(reserveSize)
+{
+
+}
+
+bool MemoryPaintDevice::exportToFile(std::string filename)
+{
+    //nothing is written, the benchmark is not interested in the encoder
+    UNUSED(filename);
+    return true;
+}
+
+bool MemoryPaintDevice::paintImageFromFile(AtlasPack::Pos topleft, std::string filename)
+{
+    AtlasPack::PixelBuffer pixels;
+    if (!m_backend->readImagePixels(filename, &pixels))
+        return false;
+    return paintImage(topleft, pixels.view());
+}
+
+bool MemoryPaintDevice::paintImageFromFile(AtlasPack::Pos topleft, std::string filename, AtlasPack::Rect sourceRect)
+{
+    AtlasPack::PixelBuffer pixels;
+    if (!m_backend->readImagePixels(filename, &pixels) || !pixels.view().contains(sourceRect))
+        return false;
+
+    return paintImage(topleft, pixels.view().region(sourceRect));
+}
+
+bool MemoryPaintDevice::paintImage(AtlasPack::Pos topleft, const AtlasPack::PixelView &pixels)
+{
+    const AtlasPack::Size canvasSize = m_canvas.size();
+    if (!pixels.isValid() || topleft.x + pixels.size.width > canvasSize.width
+            || topleft.y + pixels.size.height > canvasSize.height)
+        return false;
+
+    for (size_t y = 0; y < pixels.size.height; y++) {
+        const unsigned char *src = pixels.scanLine(y);
+        std::copy(src, src + pixels.size.width * 4, m_canvas.scanLine(topleft.y + y) + topleft.x * 4);
+    }
+    return true;
+}
+
+bool MemoryPaintDevice::readPixels(const AtlasPack::Rect &rect, AtlasPack::PixelBuffer *target) const
+{
+    const AtlasPack::Size canvasSize = m_canvas.size();
+    if (rect.topLeft.x + rect.size.width > canvasSize.width
+            || rect.topLeft.y + rect.size.height > canvasSize.height)
+        return false;
+
+    AtlasPack::PixelBuffer pixels(rect.size);
+    for (size_t y = 0; y < rect.size.height; y++) {
+        const unsigned char *src = m_canvas.scanLine(rect.topLeft.y + y) + rect.topLeft.x * 4;
+        std::copy(src, src + rect.size.width * 4, pixels.scanLine(y));
+    }
+
+    *target = std::move(pixels);
+    return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_BENCH_MEMORYBACKEND_H
+#define ATLASPACK_BENCH_MEMORYBACKEND_H
+
+#include <AtlasPack/Backend>
+#include <AtlasPack/PaintDevice>
+#include <AtlasPack/PixelBuffer>
+
+#include <map>
+#include <string>
+
+/**
+ * Backend that keeps everything in memory, the images are not read from disk
+ * but generated from a registry of image names and geometries. This keeps disk I/O
+ * out of the benchmark results.
+ */
+class MemoryBackend : public AtlasPack::Backend
+{
+    public:
+        void addImage (const std::string &name, const AtlasPack::Size &size);
+
+        // Backend interface
+        bool supportsImageType (const std::string &extension) const override;
+        std::shared_ptr<AtlasPack::PaintDevice> createPaintDevice (const AtlasPack::Size &reserveSize) const override;
+        AtlasPack::Image readImageInformation (const std::string &path) const override;
+        bool readImagePixels (const std::string &path, AtlasPack::PixelBuffer *target) const override;
+
+    private:
+        std::map<std::string, AtlasPack::Size> m_images;
+};
+
+class MemoryPaintDevice : public AtlasPack::PaintDevice
+{
+    public:
+        MemoryPaintDevice (const MemoryBackend *backend, const AtlasPack::Size &reserveSize);
+
+        // PaintDevice interface
+        bool exportToFile (std::string filename) override;
+        bool paintImageFromFile (AtlasPack::Pos topleft, std::string filename) override;
+        bool paintImageFromFile (AtlasPack::Pos topleft, std::string filename, AtlasPack::Rect sourceRect) override;
+        bool paintImage (AtlasPack::Pos topleft, const AtlasPack::PixelView &pixels) override;
+        bool readPixels (const AtlasPack::Rect &rect, AtlasPack::PixelBuffer *target) const override;
+
+    private:
+        const MemoryBackend *m_backend;
+        AtlasPack::PixelBuffer m_canvas;
+};
+
+#endif
@@ -25,6 +25,7 @@
 #include <AtlasPack/atlaspack_global.h>
 #include <AtlasPack/Backend>
 #include <AtlasPack/PaintDevice>
+#include <AtlasPack/ImageCache>
 
 namespace AtlasPack {
 namespace Backends {
@@ -34,10 +35,17 @@ class ATLASPACK_EXPORT MagickBackend : public AtlasPack::Backend
     public:
         MagickBackend();
 
+        void setImageCache (AtlasPack::ImageCache *cache);
+        AtlasPack::ImageCache *imageCache () const;
+
         // Backend interface
         virtual bool supportsImageType (const std::string &extension) const;
         std::shared_ptr<AtlasPack::PaintDevice> createPaintDevice(const AtlasPack::Size &reserveSize) const;
         AtlasPack::Image readImageInformation(const std::string &path) const;
+        bool readImagePixels(const std::string &path, AtlasPack::PixelBuffer *target) const override;
+
+    private:
+        AtlasPack::ImageCache *m_cache = nullptr;
 };
 
 
@@ -45,11 +53,18 @@ class MagickPaintDevicePrivate;
 class ATLASPACK_EXPORT MagickPaintDevice : public AtlasPack::PaintDevice
 {
     public:
-        MagickPaintDevice(const AtlasPack::Size &reserveSize);
+        MagickPaintDevice(const AtlasPack::Size &reserveSize, AtlasPack::ImageCache *cache = nullptr);
         virtual ~MagickPaintDevice();
 
         // PaintDevice interface
         bool paintImageFromFile(AtlasPack::Pos topleft, std::string filename) override;
+        bool paintImageFromFile(AtlasPack::Pos topleft, std::string filename, AtlasPack::Rect sourceRect) override;
+        bool paintImageFromData(AtlasPack::Pos topleft, std::string filename, const std::vector<unsigned char> &data) override;
+        bool paintImageFromData(AtlasPack::Pos topleft, std::string filename, const std::vector<unsigned char> &data,
+                                AtlasPack::Rect sourceRect) override;
+        bool decodesImageData() const override;
+        bool paintImage(AtlasPack::Pos topleft, const AtlasPack::PixelView &pixels) override;
+        bool readPixels(const AtlasPack::Rect &rect, AtlasPack::PixelBuffer *target) const override;
         bool exportToFile (std::string filename) override;
 
     private:
@@ -28,6 +28,7 @@
 #include <AtlasPack/PaintDevice>
 #include <AtlasPack/Image>
 #include <AtlasPack/Dimension>
+#include <AtlasPack/PixelBuffer>
 #include <string>
 #include <memory>
 #include <functional>
@@ -40,6 +41,8 @@ class ATLASPACK_EXPORT Backend {
         virtual bool supportsImageType (const std::string &extension) const = 0;
         virtual std::shared_ptr<PaintDevice> createPaintDevice (const Size &reserveSize) const = 0;
         virtual Image readImageInformation (const std::string &path) const = 0;
+        virtual Image readTrimmedImageInformation (const std::string &path) const;
+        virtual bool readImagePixels (const std::string &path, PixelBuffer *target) const;
 };
 
 }
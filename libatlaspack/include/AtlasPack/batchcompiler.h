@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ATLASPACK_BATCHCOMPILER_H_INCLUDED
+#define ATLASPACK_BATCHCOMPILER_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Backend>
+#include <AtlasPack/Image>
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/Report>
+#include <AtlasPack/CpuAffinity>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace AtlasPack {
+
+/**
+ * One atlas of a batch, the images in \a images are packed
+ * and written to \a basePath.
+ */
+struct ATLASPACK_EXPORT BatchEntry {
+    std::string basePath;
+    std::vector<Image> images;
+
+    size_t alignment = 1;
+    PackPolicy policy;
+    bool mipmaps = false;
+    BlockCompression compression = BlockCompression::None;
+    bool exportPng = true;
+    size_t decodeBudget = 0;    //bytes, \sa TextureAtlasPacker::setDecodeBudget
+    size_t prefetchWindow = 0;  //bytes, \sa TextureAtlasPacker::setPrefetchWindow
+    size_t tileSize = 0;        //\sa TextureAtlasPacker::setTileSize
+};
+
+struct ATLASPACK_EXPORT BatchResult {
+    std::string basePath;
+    bool success = false;
+    std::string error;
+    PackReport report;
+};
+
+class BatchCompilerPrivate;
+class ATLASPACK_EXPORT BatchCompiler
+{
+    public:
+        using FinishedCallback = std::function<void (const BatchResult &result)>;
+
+        BatchCompiler(Backend *backend, size_t threads = 0, WorkerAffinity affinity = WorkerAffinity::None);
+        ~BatchCompiler();
+
+        //disable copying of this type
+        BatchCompiler(const BatchCompiler &other) = delete;
+        BatchCompiler &operator=(const BatchCompiler &other) = delete;
+
+        void   setConcurrentAtlases (size_t count);
+        size_t concurrentAtlases () const;
+
+        unsigned int threadCount () const;
+        JobQueueStats queueStats () const;
+
+        std::vector<BatchResult> run (const std::vector<BatchEntry> &entries, FinishedCallback finished = FinishedCallback());
+
+    private:
+        BatchCompilerPrivate *p = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_BLOCKCOMPRESSION_P_H
+#define ATLASPACK_BLOCKCOMPRESSION_P_H
+
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/PixelBuffer>
+
+#include <string>
+#include <vector>
+
+namespace AtlasPack {
+namespace BlockCompressor {
+
+size_t blockSize (BlockCompression format);
+size_t compressedSize (const Size &size, BlockCompression format);
+void compressBlockRows (const PixelView &source, BlockCompression format, unsigned char *target,
+                        size_t firstBlockRow, size_t lastBlockRow);
+bool writeDDS (const std::string &fileName, BlockCompression format, const Size &baseSize,
+               const std::vector<std::vector<unsigned char> > &levels);
+
+}
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_CPUAFFINITY_INCLUDED
+#define ATLASPACK_CPUAFFINITY_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace AtlasPack {
+
+/**
+ * Where the workers of a \sa AtlasPack::JobQueue are allowed to run
+ */
+enum class WorkerAffinity {
+    None,       //!< the scheduler moves the workers freely
+    Cores,      //!< every worker is pinned to one core, round robin over the cores the process may use
+    NumaNodes   //!< the workers are spread over the NUMA nodes and may run on any core of their node
+};
+
+class ATLASPACK_EXPORT CpuAffinity {
+    public:
+        static bool isSupported ();
+        static std::vector<int> allowedCpus ();
+        static std::vector<std::vector<int> > numaNodes ();
+        static std::vector<std::vector<int> > workerCpus (WorkerAffinity affinity, size_t workers);
+        static bool pinCurrentThread (const std::vector<int> &cpus);
+};
+
+}
+
+#endif
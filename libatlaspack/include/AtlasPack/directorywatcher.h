@@ -0,0 +1,58 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ATLASPACK_DIRECTORYWATCHER_H_INCLUDED
+#define ATLASPACK_DIRECTORYWATCHER_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+
+#include <string>
+#include <vector>
+
+namespace AtlasPack {
+
+class DirectoryWatcherPrivate;
+class ATLASPACK_EXPORT DirectoryWatcher
+{
+    public:
+        DirectoryWatcher(const std::string &directory, bool recursive = false);
+        ~DirectoryWatcher();
+
+        //disable copying of this type
+        DirectoryWatcher(const DirectoryWatcher &other) = delete;
+        DirectoryWatcher &operator=(const DirectoryWatcher &other) = delete;
+
+        bool isValid () const;
+        std::string directory () const;
+
+        std::vector<std::string> waitForChanges (unsigned int debounceMs = 100, std::string *error = nullptr);
+        void stop ();
+
+    private:
+        DirectoryWatcherPrivate *p = nullptr;
+};
+
+}
+
+#endif
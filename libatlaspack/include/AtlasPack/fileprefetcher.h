@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_FILEPREFETCHER_H_INCLUDED
+#define ATLASPACK_FILEPREFETCHER_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Report>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AtlasPack {
+
+using FileData = std::vector<unsigned char>;
+
+class FilePrefetcherPrivate;
+class ATLASPACK_EXPORT FilePrefetcher
+{
+    public:
+        FilePrefetcher(size_t windowBytes = 64 << 20, size_t ioThreads = 4);
+        ~FilePrefetcher();
+
+        //disable copying of this type
+        FilePrefetcher(const FilePrefetcher &other) = delete;
+        FilePrefetcher &operator=(const FilePrefetcher &other) = delete;
+
+        bool usesIoUring () const;
+        size_t window () const;
+
+        void prefetch (const std::string &path);
+        std::shared_ptr<const FileData> take (const std::string &path, std::string *error = nullptr);
+
+        PrefetchStats stats () const;
+
+    private:
+        FilePrefetcherPrivate *p = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ATLASPACK_FILESTAMP_P_H
+#define ATLASPACK_FILESTAMP_P_H
+
+#include <cstdint>
+#include <string>
+
+namespace AtlasPack {
+
+/**
+ * @internal
+ * Identifies the version of a file. The modification and status change times are kept with
+ * nanoseconds where the system provides them, together with the inode, so a file that is
+ * rewritten within the same second or replaced by renaming another file over it gets a new stamp.
+ */
+struct FileStamp {
+    int64_t  modifiedSec = 0;
+    int64_t  modifiedNsec = 0;
+    int64_t  changedSec = 0;
+    int64_t  changedNsec = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+
+    bool operator== (const FileStamp &other) const {
+        return modifiedSec == other.modifiedSec && modifiedNsec == other.modifiedNsec
+                && changedSec == other.changedSec && changedNsec == other.changedNsec
+                && inode == other.inode && size == other.size;
+    }
+    bool operator!= (const FileStamp &other) const { return !(*this == other); }
+};
+
+bool readFileStamp (const std::string &path, FileStamp *stamp);
+
+}
+
+#endif
@@ -26,17 +26,31 @@
 
 #include <AtlasPack/atlaspack_global.h>
 #include <AtlasPack/Dimension>
+#include <AtlasPack/PixelBuffer>
 
+#include <functional>
+#include <memory>
 #include <string>
 
 namespace AtlasPack {
 
 class ImagePrivate;
 
+/**
+ * Decodes or generates the pixels of a in-memory image into \a target,
+ * returns false on failure.
+ */
+using PixelProvider = std::function<bool (PixelBuffer *target)>;
+
 class ATLASPACK_EXPORT Image {
     public:
         Image ();
         Image (const std::string &path, const Size size);
+        Image (const std::string &path, const Size size, const Rect &contentRect);
+        Image (const std::string &name, std::shared_ptr<const PixelBuffer> pixels);
+        Image (const std::string &name, std::shared_ptr<const PixelBuffer> pixels, const Rect &contentRect);
+        Image (const std::string &name, const Size size, PixelProvider provider);
+        Image (const std::string &name, const Size size, const Rect &contentRect, PixelProvider provider);
         Image (const Image &other);
         ~Image ();
 
@@ -47,6 +61,13 @@ class ATLASPACK_EXPORT Image {
         std::string path () const;
         bool isValid () const;
 
+        Size sourceSize () const;
+        Rect contentRect () const;
+        bool isTrimmed () const;
+
+        bool isInMemory () const;
+        std::shared_ptr<const PixelBuffer> pixels () const;
+
     private:
         ImagePrivate *p = nullptr;
 
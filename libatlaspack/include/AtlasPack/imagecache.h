@@ -0,0 +1,64 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_IMAGECACHE_H_INCLUDED
+#define ATLASPACK_IMAGECACHE_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Image>
+#include <AtlasPack/PixelBuffer>
+#include <AtlasPack/Report>
+
+#include <memory>
+#include <string>
+
+namespace AtlasPack {
+
+class ImageCachePrivate;
+class ATLASPACK_EXPORT ImageCache
+{
+    public:
+        ImageCache(size_t budgetBytes = 256 << 20, size_t shards = 16);
+        ~ImageCache();
+
+        //disable copying of this type
+        ImageCache(const ImageCache &other) = delete;
+        ImageCache &operator=(const ImageCache &other) = delete;
+
+        void   setBudget (size_t bytes);
+        size_t budget () const;
+
+        std::shared_ptr<const PixelBuffer> find (const std::string &path) const;
+        std::shared_ptr<const PixelBuffer> load (const std::string &path, const PixelProvider &decode);
+        void remove (const std::string &path);
+        void clear ();
+
+        ImageCacheStats stats () const;
+
+    private:
+        ImageCachePrivate *p = nullptr;
+};
+
+}
+
+#endif
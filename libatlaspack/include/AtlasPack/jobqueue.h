@@ -24,51 +24,193 @@
 #ifndef ATLASPACK_JOBQUEUE_INCLUDED
 #define ATLASPACK_JOBQUEUE_INCLUDED
 
+#include <algorithm>
 #include <thread>
 #include <future>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <deque>
 #include <functional>
 #include <condition_variable>
 #include <iostream>
+#include <string>
+
+#include <AtlasPack/Trace>
+#include <AtlasPack/Report>
+#include <AtlasPack/CpuAffinity>
 
 #include <boost/core/noncopyable.hpp>
 
 namespace AtlasPack {
 
+/**
+ * @internal
+ * Lock free counterpart of \sa AtlasPack::DurationHistogram, recording
+ * durations in microseconds from any number of threads.
+ */
+class JobQueueHistogram {
+    public:
+        JobQueueHistogram () {
+            for (auto &bucket : m_buckets)
+                bucket.store(0, std::memory_order_relaxed);
+        }
+
+        void add (uint64_t us) {
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_totalUs.fetch_add(us, std::memory_order_relaxed);
+
+            uint64_t curr = m_minUs.load(std::memory_order_relaxed);
+            while (us < curr && !m_minUs.compare_exchange_weak(curr, us, std::memory_order_relaxed)) {}
+            curr = m_maxUs.load(std::memory_order_relaxed);
+            while (us > curr && !m_maxUs.compare_exchange_weak(curr, us, std::memory_order_relaxed)) {}
+
+            //bucket i counts all durations below 2^i microseconds
+            size_t bucket = 0;
+            while (us >> bucket && bucket < BucketCount - 1)
+                bucket++;
+            m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        DurationHistogram snapshot () const {
+            DurationHistogram hist;
+            hist.count   = m_count.load(std::memory_order_relaxed);
+            hist.totalMs = m_totalUs.load(std::memory_order_relaxed) / 1000.0;
+            if (hist.count) {
+                hist.minMs = m_minUs.load(std::memory_order_relaxed) / 1000.0;
+                hist.maxMs = m_maxUs.load(std::memory_order_relaxed) / 1000.0;
+            }
+
+            for (size_t i = 0; i < BucketCount; i++) {
+                uint64_t val = m_buckets[i].load(std::memory_order_relaxed);
+                if (val) {
+                    hist.buckets.resize(i + 1, 0);
+                    hist.buckets[i] = val;
+                }
+            }
+            return hist;
+        }
+
+    private:
+        static const size_t BucketCount = 48;
+
+        std::atomic<uint64_t> m_count{0};
+        std::atomic<uint64_t> m_totalUs{0};
+        std::atomic<uint64_t> m_minUs{std::numeric_limits<uint64_t>::max()};
+        std::atomic<uint64_t> m_maxUs{0};
+        std::atomic<uint64_t> m_buckets[BucketCount];
+};
+
+/**
+ * Lanes of a \sa AtlasPack::JobQueue, a worker always takes the oldest
+ * task of the highest lane that has waiting tasks.
+ */
+enum class TaskPriority {
+    High,       //!< work somebody is waiting for, like packing trials
+    Normal,
+    Low         //!< long running work that can wait, like writing the atlas image
+};
+
 template <typename T> class JobQueue : public boost::noncopyable{
     public:
 
-    JobQueue(size_t threadPool = 0);
+    JobQueue(size_t threadPool = 0, WorkerAffinity affinity = WorkerAffinity::None);
     ~JobQueue();
 
-    std::future<T> addTask (std::function<T()> &&fun);
+    std::future<T> addTask (std::function<T()> &&fun, const char *label = nullptr,
+                            TaskPriority priority = TaskPriority::Normal);
+    std::future<T> addTask (std::function<T()> &&fun, const std::string &label,
+                            TaskPriority priority = TaskPriority::Normal);
     void waitForAllRunningTasks ();
     unsigned int maxJobs () const;
+    WorkerAffinity workerAffinity () const { return m_affinity; }
+    JobQueueStats stats () const;
 
 
     private:
-        static void threadMain (JobQueue<T> *queue);
+        static const size_t LaneCount = 3;
+        static const size_t DepthSampleCount = 1024;
+        static const uint64_t DepthSampleIntervalUs = 10000;
+
+        struct Job {
+            std::packaged_task<T()> task;
+            std::string label;      //only set while tracing
+            size_t lane = 0;
+            uint64_t enqueued = 0;  //trace timestamp of addTask
+            uint64_t queuedUs = 0;  //elapsedUs() at addTask
+        };
+
+        //a slot of the depth sample ring, seq is the sample number + 1 once the slot is complete
+        struct DepthSample {
+            std::atomic<uint64_t> seq{0};
+            std::atomic<uint64_t> timeUs{0};
+            std::atomic<uint64_t> depth{0};
+        };
+
+        static void threadMain (JobQueue<T> *queue, size_t workerId, std::vector<int> cpus);
+        static void traceBlocked (const char *name, const char *category, uint64_t start);
+        static unsigned int defaultWorkerCount ();
+        uint64_t elapsedUs () const;
+        void updateDepth (uint64_t now);
+        void addDepthSample (uint64_t now, uint64_t depth);
 
         std::vector<std::shared_ptr<std::thread> > m_threadPool;
-        std::deque<std::packaged_task<T()> > m_waitingTasks;
+        std::deque<Job> m_waitingTasks[LaneCount];  //indexed by TaskPriority
+        std::size_t m_waitingCount = 0;
         std::size_t m_runningThreads = 0;
+        WorkerAffinity m_affinity = WorkerAffinity::None;
 
         std::atomic_bool m_stop{false};
         std::mutex m_mutex;
         std::condition_variable m_wakeup; //always notified when there are changes to the worker
         std::condition_variable m_queue_empty; //notifies if all tasks have been finished
+
+        //metrics, only written while m_mutex is held or by the owning worker,
+        //but read without locking by stats()
+        std::chrono::steady_clock::time_point m_created = std::chrono::steady_clock::now();
+        std::atomic<uint64_t> m_depth{0};
+        std::atomic<uint64_t> m_peakDepth{0};
+        std::atomic<uint64_t> m_depthIntegral{0};   //sum of depth * microseconds
+        std::atomic<uint64_t> m_lastDepthChange{0};
+        std::unique_ptr<DepthSample[]> m_depthSamples{new DepthSample[DepthSampleCount]};
+        std::atomic<uint64_t> m_depthSampleCount{0};
+        uint64_t m_sampleStart = 0;     //start of the current sample interval, only used with m_mutex held
+        uint64_t m_samplePeak = 0;      //highest depth in the current sample interval
+        std::atomic<uint64_t> m_running{0};
+        std::atomic<uint64_t> m_enqueued{0};
+        std::atomic<uint64_t> m_finished{0};
+        std::atomic<uint64_t> m_waitCalls{0};
+        JobQueueHistogram m_waitTimes;
+        JobQueueHistogram m_laneWaitTimes[LaneCount];
+        JobQueueHistogram m_runTimes;
+        std::atomic<uint64_t> m_pinnedWorkers{0};
+        size_t m_workerCount = 0;
+        std::unique_ptr<std::atomic<uint64_t>[]> m_busyUs;
 };
 
+/*!
+ * \brief JobQueue<T>::JobQueue
+ * Starts \a threadPool workers, or one per core if it is 0. With a \a affinity other
+ * than \sa WorkerAffinity::None the workers pin themselves to their cores or NUMA nodes,
+ * see \sa AtlasPack::CpuAffinity.
+ */
 template<typename T>
-JobQueue<T>::JobQueue(size_t threadPool) {
+JobQueue<T>::JobQueue(size_t threadPool, WorkerAffinity affinity) : m_affinity(affinity) {
 
-    size_t reqThreads = threadPool > 0 ? threadPool : maxJobs();
+    size_t reqThreads = threadPool > 0 ? threadPool : defaultWorkerCount();
     m_threadPool.reserve(reqThreads);
+    std::vector<std::vector<int> > cpus = CpuAffinity::workerCpus(affinity, reqThreads);
+
+    m_workerCount = reqThreads;
+    m_busyUs.reset(new std::atomic<uint64_t>[reqThreads]);
+    for (size_t t = 0; t < reqThreads; t++)
+        m_busyUs[t].store(0);
 
     for (size_t t = 0; t < reqThreads; t++ ) {
-        auto newThread = std::make_shared<std::thread>(threadMain, this);
+        auto newThread = std::make_shared<std::thread>(threadMain, this, t, std::move(cpus[t]));
         m_threadPool.push_back(newThread);
     }
 }
@@ -83,31 +225,76 @@ JobQueue<T>::~JobQueue() {
     }
 }
 
+/*!
+ * \brief JobQueue<T>::addTask
+ * Queues \a fun for execution in the lane of \a priority, tasks of a higher lane are
+ * always started first. Tasks of lower lanes only wait while higher ones are queued,
+ * a running task is never interrupted. The \a label is only used to name the
+ * task in the trace and only copied while tracing, see \sa AtlasPack::Trace.
+ */
 template<typename T>
-std::future<T> JobQueue<T>::addTask(std::function<T ()> &&fun) {
-    std::packaged_task<T()> task(fun);
-    std::future<T> fut = task.get_future();
+std::future<T> JobQueue<T>::addTask(std::function<T ()> &&fun, const char *label, TaskPriority priority) {
+    Job job;
+    job.task = std::packaged_task<T()>(fun);
+    job.lane = static_cast<size_t>(priority);
+    std::future<T> fut = job.task.get_future();
+
+    if (Trace::isEnabled()) {
+        job.label = label && *label ? label : "task";
+        job.enqueued = Trace::now();
+    }
 
     {
         std::unique_lock<std::mutex> lk(m_mutex);
-        m_waitingTasks.push_back(std::move(task));
+        const uint64_t now = elapsedUs();
+        job.queuedUs = now;
+        m_waitingTasks[job.lane].push_back(std::move(job));
+        m_waitingCount++;
+        m_enqueued.fetch_add(1, std::memory_order_relaxed);
+        updateDepth(now);
     }
     m_wakeup.notify_one();
     return fut;
 }
 
+/*!
+ * \brief JobQueue<T>::addTask
+ * Overload for labels that are built at runtime, callers should only build
+ * them while \sa AtlasPack::Trace::isEnabled is true.
+ */
+template<typename T>
+std::future<T> JobQueue<T>::addTask(std::function<T ()> &&fun, const std::string &label, TaskPriority priority) {
+    return addTask(std::move(fun), label.c_str(), priority);
+}
+
 template<typename T>
 void JobQueue<T>::waitForAllRunningTasks() {
+    m_waitCalls.fetch_add(1, std::memory_order_relaxed);
+
     std::unique_lock<std::mutex> lk(m_mutex);
 
     //check if there are thread running or tasks pending
-    while (m_waitingTasks.size() != 0 || m_runningThreads > 0 ) {
+    while (m_waitingCount != 0 || m_runningThreads > 0 ) {
         m_queue_empty.wait(lk);
     }
 }
 
+/*!
+ * \brief JobQueue<T>::maxJobs
+ * Returns the number of workers, which is the number of tasks that can run at the same time
+ */
 template<typename T>
 unsigned int JobQueue<T>::maxJobs() const {
+    return static_cast<unsigned int>(m_workerCount);
+}
+
+/**
+ * @internal
+ * @brief JobQueue<T>::defaultWorkerCount
+ * Returns the number of workers started if no pool size is given, one per core
+ */
+template<typename T>
+unsigned int JobQueue<T>::defaultWorkerCount() {
     unsigned int jobs = std::thread::hardware_concurrency();
     //use at least 2 threads
     if (jobs < 2)
@@ -115,34 +302,202 @@ unsigned int JobQueue<T>::maxJobs() const {
     return jobs;
 }
 
+/*!
+ * \brief JobQueue<T>::stats
+ * Returns a snapshot of the queue counters. The snapshot is taken without
+ * locking the queue, so it does not slow down the workers, but the values
+ * may be taken at slightly different points in time. The queue depth is sampled
+ * at most every 10ms while tasks are added or taken, the last 1024 samples are kept.
+ */
+template<typename T>
+JobQueueStats JobQueue<T>::stats() const {
+    JobQueueStats stats;
+
+    const uint64_t now = elapsedUs();
+    stats.uptimeMs       = now / 1000.0;
+    stats.queueDepth     = m_depth.load(std::memory_order_relaxed);
+    stats.peakQueueDepth = m_peakDepth.load(std::memory_order_relaxed);
+    stats.runningTasks   = m_running.load(std::memory_order_relaxed);
+    stats.enqueuedTasks  = m_enqueued.load(std::memory_order_relaxed);
+    stats.finishedTasks  = m_finished.load(std::memory_order_relaxed);
+    stats.waitCalls      = m_waitCalls.load(std::memory_order_relaxed);
+    stats.waitTimes      = m_waitTimes.snapshot();
+    stats.runTimes       = m_runTimes.snapshot();
+    stats.pinnedWorkers  = m_pinnedWorkers.load(std::memory_order_relaxed);
+    for (const JobQueueHistogram &lane : m_laneWaitTimes)
+        stats.laneWaitTimes.push_back(lane.snapshot());
+
+    //add the time since the last change with the current depth
+    const uint64_t last = m_lastDepthChange.load(std::memory_order_relaxed);
+    const uint64_t integral = m_depthIntegral.load(std::memory_order_relaxed)
+            + stats.queueDepth * (now > last ? now - last : 0);
+    stats.averageQueueDepth = now ? static_cast<double>(integral) / now : 0.0;
+
+    //a slot that is overwritten while it is read is skipped
+    const uint64_t samples = m_depthSampleCount.load(std::memory_order_acquire);
+    for (uint64_t i = samples > DepthSampleCount ? samples - DepthSampleCount : 0; i < samples; i++) {
+        const DepthSample &slot = m_depthSamples[i % DepthSampleCount];
+        if (slot.seq.load(std::memory_order_acquire) != i + 1)
+            continue;
+        QueueDepthSample sample;
+        sample.timeMs = slot.timeUs.load(std::memory_order_relaxed) / 1000.0;
+        sample.depth  = slot.depth.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == i + 1)
+            stats.depthSamples.push_back(sample);
+    }
+    //the interval that is still open ends with the current depth
+    QueueDepthSample current;
+    current.timeMs = stats.uptimeMs;
+    current.depth  = stats.queueDepth;
+    stats.depthSamples.push_back(current);
+
+    for (size_t i = 0; i < m_workerCount; i++) {
+        double busy = m_busyUs[i].load(std::memory_order_relaxed) / 1000.0;
+        stats.workerBusyMs.push_back(busy);
+        stats.workerUtilization.push_back(stats.uptimeMs > 0 ? std::min(1.0, busy / stats.uptimeMs) : 0.0);
+    }
+    return stats;
+}
+
+template<typename T>
+uint64_t JobQueue<T>::elapsedUs() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - m_created).count());
+}
+
+/*!
+ * \internal
+ * \brief JobQueue<T>::updateDepth
+ * Accounts the time the queue had its previous depth, must be called
+ * with m_mutex locked after m_waitingTasks was changed.
+ */
+template<typename T>
+void JobQueue<T>::updateDepth(uint64_t now) {
+    const uint64_t last = m_lastDepthChange.load(std::memory_order_relaxed);
+    const uint64_t prev = m_depth.load(std::memory_order_relaxed);
+    if (now > last)
+        m_depthIntegral.fetch_add(prev * (now - last), std::memory_order_relaxed);
+    m_lastDepthChange.store(std::max(now, last), std::memory_order_relaxed);
+
+    const uint64_t depth = m_waitingCount;
+    m_depth.store(depth, std::memory_order_relaxed);
+    if (depth > m_peakDepth.load(std::memory_order_relaxed))
+        m_peakDepth.store(depth, std::memory_order_relaxed);
+
+    //the samples keep the peak of every interval, so short bursts are not lost
+    m_samplePeak = std::max(m_samplePeak, depth);
+    if (now >= m_sampleStart + DepthSampleIntervalUs) {
+        addDepthSample(now, m_samplePeak);
+        m_sampleStart = now;
+        m_samplePeak = depth;
+    }
+}
+
+/*!
+ * \internal
+ * \brief JobQueue<T>::addDepthSample
+ * Writes a sample into the ring read by \sa JobQueue<T>::stats, the oldest
+ * sample is overwritten once it is full. Must be called with m_mutex locked.
+ */
+template<typename T>
+void JobQueue<T>::addDepthSample(uint64_t now, uint64_t depth) {
+    const uint64_t idx = m_depthSampleCount.load(std::memory_order_relaxed);
+    DepthSample &slot = m_depthSamples[idx % DepthSampleCount];
+
+    //readers skip the slot while it is incomplete
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timeUs.store(now, std::memory_order_relaxed);
+    slot.depth.store(depth, std::memory_order_relaxed);
+    slot.seq.store(idx + 1, std::memory_order_release);
+    m_depthSampleCount.store(idx + 1, std::memory_order_release);
+}
+
+/*!
+ * \internal
+ * \brief JobQueue<T>::traceBlocked
+ * Records the time a worker was blocked since \a start in the trace,
+ * if it was blocked at all.
+ */
 template<typename T>
-void JobQueue<T>::threadMain(JobQueue<T> *queue) {
+void JobQueue<T>::traceBlocked(const char *name, const char *category, uint64_t start) {
+    uint64_t waited = Trace::now() - start;
+    if (waited > 0)
+        Trace::complete(name, category, start, waited);
+}
+
+template<typename T>
+void JobQueue<T>::threadMain(JobQueue<T> *queue, size_t workerId, std::vector<int> cpus) {
+
+    Trace::setThreadName("JobQueue worker " + std::to_string(workerId));
+    if (CpuAffinity::pinCurrentThread(cpus))
+        queue->m_pinnedWorkers.fetch_add(1, std::memory_order_relaxed);
 
     while (!queue->m_stop.load()) {
 
-        std::packaged_task<T()> task;
+        Job job;
+        uint64_t dequeued = 0;
         {
+            bool traceWait = Trace::isEnabled();
+            uint64_t lockStart = traceWait ? Trace::now() : 0;
             std::unique_lock<std::mutex> lk(queue->m_mutex);
+            if (traceWait)
+                traceBlocked("m_mutex", "lock", lockStart);
 
-            while (queue->m_waitingTasks.size() == 0) {
+            while (queue->m_waitingCount == 0) {
+                traceWait = Trace::isEnabled();
+                uint64_t idleStart = traceWait ? Trace::now() : 0;
                 queue->m_wakeup.wait(lk);
+                if (traceWait)
+                    traceBlocked("m_wakeup", "wait", idleStart);
 
                 if(queue->m_stop.load()) {
                     return;
                 }
             }
 
-            task = std::move(queue->m_waitingTasks.front());
-            queue->m_waitingTasks.pop_front();
+            std::deque<Job> *lane = queue->m_waitingTasks;
+            while (lane->empty())
+                lane++;
+            job = std::move(lane->front());
+            lane->pop_front();
+            queue->m_waitingCount--;
             queue->m_runningThreads++;
+
+            dequeued = queue->elapsedUs();
+            queue->updateDepth(dequeued);
+            queue->m_running.fetch_add(1, std::memory_order_relaxed);
         }
+        const uint64_t queued = dequeued > job.queuedUs ? dequeued - job.queuedUs : 0;
+        queue->m_waitTimes.add(queued);
+        queue->m_laneWaitTimes[job.lane].add(queued);
+
+        //tasks queued before tracing was enabled carry no enqueue time
+        const bool tracing = job.enqueued != 0 && Trace::isEnabled();
+        uint64_t start = tracing ? Trace::now() : 0;
 
-        task();
+        job.task();
+
+        const uint64_t ran = queue->elapsedUs() - dequeued;
+        queue->m_runTimes.add(ran);
+        queue->m_busyUs[workerId].fetch_add(ran, std::memory_order_relaxed);
+
+        if (tracing) {
+            uint64_t finish = Trace::now();
+            Trace::complete(job.label, "job", start, finish - start, job.enqueued);
+        }
 
         {
+            uint64_t lockStart = tracing ? Trace::now() : 0;
             std::unique_lock<std::mutex> lk(queue->m_mutex);
+            if (tracing)
+                traceBlocked("m_mutex", "lock", lockStart);
+
             queue->m_runningThreads--;
-            if (queue->m_waitingTasks.size() == 0 && queue->m_runningThreads == 0) {
+            queue->m_running.fetch_sub(1, std::memory_order_relaxed);
+            queue->m_finished.fetch_add(1, std::memory_order_relaxed);
+            if (queue->m_waitingCount == 0 && queue->m_runningThreads == 0) {
                 queue->m_queue_empty.notify_all();
             }
         }
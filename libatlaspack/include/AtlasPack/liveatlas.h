@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ATLASPACK_LIVEATLAS_H_INCLUDED
+#define ATLASPACK_LIVEATLAS_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Backend>
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/Dimension>
+
+#include <string>
+#include <vector>
+
+namespace AtlasPack {
+
+class LiveAtlasPrivate;
+class ATLASPACK_EXPORT LiveAtlas
+{
+    public:
+        LiveAtlas(Backend *backend, const std::string &basePath);
+        ~LiveAtlas();
+
+        //disable copying of this type
+        LiveAtlas(const LiveAtlas &other) = delete;
+        LiveAtlas &operator=(const LiveAtlas &other) = delete;
+
+        void setTrimImages (bool enabled);
+        bool trimImages () const;
+
+        void   setPlacementAlignment (size_t alignment);
+        size_t placementAlignment () const;
+
+        void       setPackPolicy (const PackPolicy &policy);
+        PackPolicy packPolicy () const;
+
+        void   setTileSize (size_t tileSize);
+        size_t tileSize () const;
+
+        Size   size () const;
+        size_t count () const;
+
+        bool rebuild (const std::vector<std::string> &files, std::string *error = nullptr);
+        bool update (const std::vector<std::string> &changedPaths, std::vector<Rect> *dirtyRects = nullptr,
+                     bool *repacked = nullptr, std::string *error = nullptr);
+        bool flush (std::string *error = nullptr);
+
+    private:
+        LiveAtlasPrivate *p = nullptr;
+};
+
+}
+
+#endif
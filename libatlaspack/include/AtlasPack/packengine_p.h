@@ -0,0 +1,177 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_PACKENGINE_P_H
+#define ATLASPACK_PACKENGINE_P_H
+
+#include <AtlasPack/Dimension>
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/freerects_p.h>
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace AtlasPack {
+
+/**
+ * @internal
+ * Geometry of a packed atlas, a guillotine tree that splits the free areas
+ * until the requested cells fit. Every implementation is specialised on a
+ * split rule, a fit heuristic and a coordinate type, the concrete type is
+ * selected once by \sa PackLayout::create. Nodes are referred to by their index.
+ *
+ * Every successful insert is recorded in a journal, \sa PackLayout::rollback
+ * takes back the latest inserts so a trial packing can be continued from any
+ * earlier state. Releasing a node clears the journal.
+ *
+ * The children of a node are always stored next to each other, \sa PackLayout::firstChild
+ * returns the first of them, or 0 for a leaf. A complete layout can be grafted onto a used
+ * leaf, \sa PackLayout::graft, which is how separately packed blocks are combined.
+ */
+class PackLayout {
+    public:
+        static const size_t NoNode = std::numeric_limits<size_t>::max();
+
+        virtual ~PackLayout() = default;
+
+        virtual Size size () const = 0;
+        virtual size_t nodeCount () const = 0;
+        virtual Rect rect (size_t node) const = 0;
+
+        virtual size_t insert (const Size &cell) = 0;
+        virtual bool insertAll (const std::vector<Size> &cells, std::vector<size_t> *nodes) = 0;
+        virtual void release (size_t node) = 0;
+        virtual void usedNodes (std::vector<size_t> *nodes) const = 0;
+        virtual size_t firstChild (size_t node) const = 0;
+        virtual bool isUsed (size_t node) const = 0;
+        virtual bool graft (size_t node, const PackLayout &layout, std::vector<size_t> *nodeMap) = 0;
+
+        virtual void reserve (size_t cells) = 0;
+        virtual size_t journalSize () const = 0;
+        virtual void rollback (size_t journalSize) = 0;
+
+        static std::unique_ptr<PackLayout> create (const Size &size, const PackPolicy &policy);
+};
+
+/**
+ * @internal
+ * Split rules decide how the remaining free area of a node is cut after a cell
+ * was placed at its top left corner. A vertical split keeps the full node height
+ * on both sides, a horizontal split the full node width.
+ */
+struct SplitLongerRemainder {
+    //keeps the biggest possible empty rectangle
+    template <typename Coord>
+    static bool splitVertically (Coord remainWidth, Coord remainHeight) { return remainWidth > remainHeight; }
+};
+
+struct SplitShorterRemainder {
+    //keeps the empty rectangles closer to a square, a side without remainder is never split
+    template <typename Coord>
+    static bool splitVertically (Coord remainWidth, Coord remainHeight) {
+        return remainHeight == 0 || (remainWidth != 0 && remainWidth <= remainHeight);
+    }
+};
+
+/**
+ * @internal
+ * Fit heuristics choose the free node a cell is placed into. FitFirst walks the tree
+ * and takes the first leaf the cell fits into, FitBestArea scans the list of all free
+ * leafs for the smallest one, the list is only maintained if UsesFreeList is set.
+ */
+struct FitFirst {
+    static const bool UsesFreeList = false;
+};
+
+struct FitBestArea {
+    static const bool UsesFreeList = true;
+};
+
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+class PackEngine final : public PackLayout {
+    public:
+        explicit PackEngine (const Size &size);
+
+        Size size () const override;
+        size_t nodeCount () const override { return m_nodes.size(); }
+        Rect rect (size_t node) const override;
+
+        size_t insert (const Size &cell) override;
+        bool insertAll (const std::vector<Size> &cells, std::vector<size_t> *nodes) override;
+        void release (size_t node) override;
+        void usedNodes (std::vector<size_t> *nodes) const override;
+        size_t firstChild (size_t node) const override { return m_nodes[node].left; }
+        bool isUsed (size_t node) const override { return m_nodes[node].used; }
+        bool graft (size_t node, const PackLayout &layout, std::vector<size_t> *nodeMap) override;
+
+        void reserve (size_t cells) override;
+        size_t journalSize () const override { return m_journal.size(); }
+        void rollback (size_t journalSize) override;
+
+    private:
+        static const uint32_t NoLeaf = std::numeric_limits<uint32_t>::max();
+
+        //the children of a node are always stored next to each other,
+        //the root can not be a child so left == 0 marks a leaf
+        struct Node {
+            Coord x, y, width, height;
+            uint32_t left;
+            bool used;
+        };
+
+        //everything a insert changed in nodes that existed before
+        struct Step {
+            uint32_t nodeCount;
+            uint32_t leaf;
+            uint32_t freeCount;     //size of the free list after the leaf was removed from it
+            uint32_t slot;
+            Coord slotWidth, slotHeight;
+        };
+
+        using UsesFreeList = std::integral_constant<bool, FitHeuristic::UsesFreeList>;
+
+        size_t place (const Size &cell);
+        uint32_t findNode (Coord width, Coord height, size_t *slot, std::false_type);
+        uint32_t findNode (Coord width, Coord height, size_t *slot, std::true_type);
+
+        std::vector<Node> m_nodes;
+        std::vector<uint32_t> m_stack;
+        std::vector<Step> m_journal;
+        FreeRectList<Coord> m_free;
+};
+
+extern template class PackEngine<SplitLongerRemainder,  FitFirst,    uint16_t>;
+extern template class PackEngine<SplitLongerRemainder,  FitFirst,    uint32_t>;
+extern template class PackEngine<SplitLongerRemainder,  FitBestArea, uint16_t>;
+extern template class PackEngine<SplitLongerRemainder,  FitBestArea, uint32_t>;
+extern template class PackEngine<SplitShorterRemainder, FitFirst,    uint16_t>;
+extern template class PackEngine<SplitShorterRemainder, FitFirst,    uint32_t>;
+extern template class PackEngine<SplitShorterRemainder, FitBestArea, uint16_t>;
+extern template class PackEngine<SplitShorterRemainder, FitBestArea, uint32_t>;
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_PACKOPTIMIZER_H_INCLUDED
+#define ATLASPACK_PACKOPTIMIZER_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Image>
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/Report>
+#include <AtlasPack/JobQueue>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace AtlasPack {
+
+class PackOptimizerPrivate;
+class ATLASPACK_EXPORT PackOptimizer
+{
+    public:
+        PackOptimizer(size_t threads = 0);
+        PackOptimizer(JobQueue<bool> *jobs);
+        ~PackOptimizer();
+
+        //disable copying of this type
+        PackOptimizer(const PackOptimizer &other) = delete;
+        PackOptimizer &operator=(const PackOptimizer &other) = delete;
+
+        void   setTimeBudget (double milliseconds);
+        double timeBudget () const;
+
+        void   setPlacementAlignment (size_t alignment);
+        size_t placementAlignment () const;
+
+        void     setSeed (uint64_t seed);
+        uint64_t seed () const;
+
+        unsigned int threadCount () const;
+
+        std::shared_ptr<TextureAtlasPacker> run (const std::vector<Image> &images, OptimizeReport *report = nullptr);
+
+    private:
+        PackOptimizerPrivate *p = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_PACKSERVER_H_INCLUDED
+#define ATLASPACK_PACKSERVER_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Backend>
+#include <AtlasPack/BatchCompiler>
+
+#include <functional>
+#include <string>
+
+namespace AtlasPack {
+
+/**
+ * A request to pack all images of \a inputDirectory into the atlas \a atlas.basePath,
+ * the images of \a atlas are collected by the server.
+ */
+struct ATLASPACK_EXPORT PackRequest {
+    std::string inputDirectory;
+    bool recursive = false;
+    bool trim = false;
+    double optimizeMs = 0;      //!< time budget of the \sa AtlasPack::PackOptimizer, 0 uses the size search
+    bool sendReport = false;    //!< send the \sa AtlasPack::PackReport back before the result
+    BatchEntry atlas;
+};
+
+class PackServerPrivate;
+class ATLASPACK_EXPORT PackServer
+{
+    public:
+        using LineCallback = std::function<void (const std::string &line)>;
+
+        PackServer(Backend *backend, size_t threads = 0, WorkerAffinity affinity = WorkerAffinity::None);
+        ~PackServer();
+
+        //disable copying of this type
+        PackServer(const PackServer &other) = delete;
+        PackServer &operator=(const PackServer &other) = delete;
+
+        bool listen (const std::string &socketPath, std::string *error = nullptr);
+        bool isListening () const;
+        std::string socketPath () const;
+
+        void run ();
+        void stop ();
+
+        unsigned int threadCount () const;
+        size_t cachedImages () const;
+        size_t servedRequests () const;
+
+        static std::string formatRequest (const PackRequest &request);
+        static bool parseRequest (const std::string &line, PackRequest *request, std::string *error = nullptr);
+        static bool sendRequest (const std::string &socketPath, const PackRequest &request,
+                                 LineCallback response = LineCallback(), std::string *error = nullptr);
+
+    private:
+        PackServerPrivate *p = nullptr;
+};
+
+}
+
+#endif
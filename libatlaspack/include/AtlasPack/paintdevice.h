@@ -26,7 +26,10 @@
 
 #include <AtlasPack/atlaspack_global.h>
 #include <functional>
+#include <string>
+#include <vector>
 #include <AtlasPack/Dimension>
+#include <AtlasPack/PixelBuffer>
 
 #include <boost/noncopyable.hpp>
 
@@ -38,6 +41,13 @@ class ATLASPACK_EXPORT PaintDevice : public boost::noncopyable {
         virtual ~PaintDevice();
         virtual bool exportToFile (std::string filename) = 0;
         virtual bool paintImageFromFile (Pos topleft, std::string filename) = 0;
+        virtual bool paintImageFromFile (Pos topleft, std::string filename, Rect sourceRect);
+        virtual bool paintImageFromData (Pos topleft, std::string filename, const std::vector<unsigned char> &data);
+        virtual bool paintImageFromData (Pos topleft, std::string filename, const std::vector<unsigned char> &data,
+                                         Rect sourceRect);
+        virtual bool decodesImageData () const;
+        virtual bool paintImage (Pos topleft, const PixelView &pixels);
+        virtual bool readPixels (const Rect &rect, PixelBuffer *target) const;
 
 };
 
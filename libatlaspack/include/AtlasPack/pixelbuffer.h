@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_PIXELBUFFER_INCLUDED
+#define ATLASPACK_PIXELBUFFER_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Dimension>
+
+#include <cassert>
+#include <vector>
+
+namespace AtlasPack {
+
+/**
+ * Non owning view on 8 bit RGBA pixel data, \a stride is the distance
+ * in bytes between two scanlines.
+ */
+struct ATLASPACK_EXPORT PixelView {
+    PixelView (const unsigned char *d = nullptr, Size s = Size(), size_t rowStride = 0)
+        : data(d), size(s), stride(rowStride ? rowStride : s.width * 4) {}
+
+    bool isValid () const { return data != nullptr; }
+    const unsigned char *scanLine (size_t y) const { return data + y * stride; }
+
+    //true if \a rect lies completely inside of the view
+    bool contains (const Rect &rect) const {
+        return rect.topLeft.x <= size.width && rect.size.width <= size.width - rect.topLeft.x
+                && rect.topLeft.y <= size.height && rect.size.height <= size.height - rect.topLeft.y;
+    }
+
+    //the area \a rect of the view, a invalid view if \a rect is not inside of it
+    PixelView region (const Rect &rect) const {
+        assert(contains(rect));
+        if (!contains(rect))
+            return PixelView();
+        return PixelView(scanLine(rect.topLeft.y) + rect.topLeft.x * 4, rect.size, stride);
+    }
+
+    const unsigned char *data = nullptr;
+    Size   size;
+    size_t stride = 0;
+};
+
+/**
+ * Owning buffer of tightly packed 8 bit RGBA pixels.
+ */
+class ATLASPACK_EXPORT PixelBuffer {
+    public:
+        PixelBuffer (Size s = Size())
+            : m_size(s), m_data(s.width * s.height * 4, 0) {}
+
+        Size   size   () const { return m_size; }
+        size_t stride () const { return m_size.width * 4; }
+        size_t byteCount () const { return m_data.size(); }
+        bool   isNull () const { return m_data.empty(); }
+
+        unsigned char *data () { return m_data.data(); }
+        const unsigned char *data () const { return m_data.data(); }
+        unsigned char *scanLine (size_t y) { return m_data.data() + y * stride(); }
+        const unsigned char *scanLine (size_t y) const { return m_data.data() + y * stride(); }
+
+        PixelView view () const { return PixelView(m_data.data(), m_size, stride()); }
+
+    private:
+        Size m_size;
+        std::vector<unsigned char> m_data;
+};
+
+}
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_PIXELOPS_P_H
+#define ATLASPACK_PIXELOPS_P_H
+
+#include <AtlasPack/Dimension>
+#include <AtlasPack/PixelBuffer>
+
+namespace AtlasPack {
+namespace PixelOps {
+
+Rect opaqueRect (const PixelView &pixels);
+
+Size mipmapSize (const Size &size);
+void downsample (const PixelView &source, PixelBuffer *target, size_t firstRow, size_t lastRow);
+void resample (const PixelView &source, PixelBuffer *target, size_t scale, size_t layoutScale,
+               size_t firstRow, size_t lastRow);
+void extendEdges (PixelBuffer *pixels, const Rect &content, const Rect &cell);
+
+}
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_PNGSTREAM_P_H
+#define ATLASPACK_PNGSTREAM_P_H
+
+#include <AtlasPack/Dimension>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace AtlasPack {
+
+/**
+ * @internal
+ * Writes a 8 bit RGBA png image one scanline at a time, so images of any size can
+ * be written without holding them in memory. Every scanline is filtered with the
+ * Up filter and handed to zlib, which compresses the stream strip by strip.
+ */
+class PngStreamWriter {
+    public:
+        PngStreamWriter () = default;
+        ~PngStreamWriter ();
+
+        //disable copying of this type
+        PngStreamWriter (const PngStreamWriter &other) = delete;
+        PngStreamWriter &operator= (const PngStreamWriter &other) = delete;
+
+        bool open (const std::string &fileName, const Size &size, std::string *error = nullptr);
+        bool writeScanLine (const unsigned char *pixels);
+        bool finish (std::string *error = nullptr);
+
+    private:
+        bool compress (const unsigned char *data, size_t length, int flush);
+        void flushChunk ();
+        void writeChunk (const char *type, const unsigned char *data, size_t length);
+
+        std::ofstream m_file;
+        std::string m_fileName;
+        Size m_size;
+        size_t m_rowsWritten = 0;
+
+        z_stream m_stream;
+        bool m_streamOpen = false;
+        std::vector<unsigned char> m_previous;  //unfiltered pixels of the last scanline
+        std::vector<unsigned char> m_row;       //filter type and filtered pixels of the current scanline
+        std::vector<unsigned char> m_chunk;     //zlib stream of the next IDAT chunk
+};
+
+}
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_REPORT_INCLUDED
+#define ATLASPACK_REPORT_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Dimension>
+
+#include <ostream>
+#include <vector>
+
+namespace AtlasPack {
+
+/**
+ * Distribution of durations, bucket i counts all durations shorter
+ * than 2^i microseconds that did not fit into a previous bucket.
+ */
+struct ATLASPACK_EXPORT DurationHistogram {
+    void add (double milliseconds);
+
+    size_t count = 0;
+    double totalMs = 0;
+    double minMs = 0;
+    double maxMs = 0;
+    std::vector<size_t> buckets;
+};
+
+/**
+ * Queue depth of a \sa AtlasPack::JobQueue at one point in time
+ */
+struct ATLASPACK_EXPORT QueueDepthSample {
+    double timeMs = 0;      //!< since the queue was created
+    size_t depth = 0;       //!< highest depth since the previous sample
+};
+
+/**
+ * Snapshot of the counters of a \sa AtlasPack::JobQueue, all values cover
+ * the time since the queue was created.
+ */
+struct ATLASPACK_EXPORT JobQueueStats {
+    double uptimeMs = 0;
+    size_t queueDepth = 0;          //!< tasks waiting when the snapshot was taken
+    size_t peakQueueDepth = 0;
+    double averageQueueDepth = 0;   //!< weighted by the time the queue had that depth
+    std::vector<QueueDepthSample> depthSamples; //!< the most recent depth samples, oldest first
+    size_t runningTasks = 0;
+    size_t enqueuedTasks = 0;
+    size_t finishedTasks = 0;
+    size_t waitCalls = 0;           //!< calls of JobQueue::waitForAllRunningTasks
+    DurationHistogram waitTimes;    //!< from addTask until a worker picks up the task
+    std::vector<DurationHistogram> laneWaitTimes;   //!< waitTimes of every lane, indexed by TaskPriority
+    DurationHistogram runTimes;
+    size_t pinnedWorkers = 0;       //!< workers that were pinned to their cores or NUMA node
+    std::vector<double> workerBusyMs;
+    std::vector<double> workerUtilization;  //!< busy time of every worker divided by the uptime
+};
+
+/**
+ * Snapshot of the counters of a \sa AtlasPack::ImageCache
+ */
+struct ATLASPACK_EXPORT ImageCacheStats {
+    size_t entries = 0;
+    size_t usedBytes = 0;
+    size_t budgetBytes = 0;
+    size_t hits = 0;
+    size_t misses = 0;          //!< lookups that had to decode the image, including modified files
+    size_t evictions = 0;
+};
+
+/**
+ * One round of the size search, all sizes of a round are tried in parallel
+ */
+struct ATLASPACK_EXPORT SearchRound {
+    bool   growing = true;
+    Size   firstSize;
+    Size   lastSize;
+    size_t trials = 0;
+    bool   foundFit = false;
+    double milliseconds = 0;
+};
+
+struct ATLASPACK_EXPORT SearchReport {
+    std::vector<SearchRound> rounds;
+    double milliseconds = 0;
+    JobQueueStats queue;
+};
+
+/**
+ * Counters of a \sa AtlasPack::FilePrefetcher
+ */
+struct ATLASPACK_EXPORT PrefetchStats {
+    bool ioUring = false;       //!< false if the files were read by the fallback threads
+    size_t windowBytes = 0;
+    size_t files = 0;           //!< files that were read ahead
+    size_t bytes = 0;
+    size_t ready = 0;           //!< files that were already loaded when they were taken
+    size_t waited = 0;          //!< files that were still being read when they were taken
+    size_t direct = 0;          //!< files that were not started yet and read by the caller itself
+    size_t failed = 0;
+    double waitMs = 0;
+};
+
+/**
+ * Result of writing the atlas image as tiles, see \sa TextureAtlasPacker::setTileSize
+ */
+struct ATLASPACK_EXPORT TileOutputStats {
+    size_t tileSize = 0;        //!< 0 if no tiles were written
+    size_t tiles = 0;
+    size_t changedTiles = 0;    //!< tiles that were written because they differ from the earlier build
+    size_t removedTiles = 0;    //!< tiles of the earlier build outside of the atlas
+    bool   full = false;        //!< no earlier build with the same tile and atlas size was found, all tiles were written
+    size_t bytesWritten = 0;
+    double hashMs = 0;
+    double writeMs = 0;
+};
+
+struct ATLASPACK_EXPORT CompileReport {
+    double collectMs  = 0;  //!< walking the packing tree and queueing the paint tasks
+    double paintMs    = 0;  //!< from the first paint task starting until the last one finished, overlaps with collectMs
+    double mipmapMs   = 0;
+    double compressMs = 0;
+    double exportMs   = 0;  //!< writing the atlas image
+    double manifestMs = 0;  //!< writing the atlas description
+    double totalMs    = 0;
+    DurationHistogram paintTasks;
+    JobQueueStats queue;            //!< the pool running paint, mipmap and compression tasks
+
+    size_t decodeBudget = 0;        //!< bytes the running paint tasks may decode at once, 0 if unlimited
+    size_t peakDecodeBytes = 0;     //!< highest estimated decode memory of the running paint tasks
+    double admissionWaitMs = 0;     //!< time paint tasks were held back to stay within the budget
+    PrefetchStats prefetch;         //!< only filled if the source files were read ahead
+    TileOutputStats tiles;
+    size_t variants = 0;            //!< scaled atlases written from the same layout
+    double variantMs = 0;
+
+    size_t imageCount = 0;
+    Size   atlasSize;
+    size_t usedArea   = 0;
+    size_t wastedArea = 0;
+    double occupancy  = 0;
+};
+
+/**
+ * Result of a \sa AtlasPack::PackOptimizer run, all sizes are edge lengths of quadratic atlases
+ */
+struct ATLASPACK_EXPORT OptimizeReport {
+    double milliseconds = 0;
+    size_t lowerBound = 0;      //!< no atlas smaller than this can take in all images
+    size_t initialSize = 0;     //!< best result of the sorted insertion orders
+    size_t finalSize = 0;
+    size_t epochs = 0;
+    size_t improvements = 0;
+    size_t evaluations = 0;     //!< packing trials, most of them only repeat the end of the insertion order
+    JobQueueStats queue;
+};
+
+/**
+ * Result of a \sa AtlasPack::HierarchicalPacker run
+ */
+struct ATLASPACK_EXPORT HierarchicalReport {
+    double milliseconds = 0;
+    size_t clusters = 0;
+    size_t clusterSize = 0;     //!< most images packed into one block
+    size_t columns = 0;         //!< the blocks are stacked into columns next to each other
+    double clusterMs = 0;       //!< packing all clusters into blocks
+    double combineMs = 0;       //!< stacking the blocks into columns and the columns into the atlas
+    size_t cellArea = 0;        //!< area of all image cells
+    size_t blockArea = 0;       //!< area of all blocks, the difference to cellArea is lost inside of the blocks
+};
+
+struct ATLASPACK_EXPORT PackReport {
+    double scanMs  = 0;     //!< walking the input directories
+    double probeMs = 0;     //!< reading the image information
+    size_t imageCount = 0;
+    SearchReport  search;
+    OptimizeReport optimize;
+    HierarchicalReport hierarchical;
+    CompileReport compile;
+    size_t peakMemory = 0;  //!< peak resident memory of the process in bytes
+
+    void writeJson (std::ostream &out) const;
+};
+
+ATLASPACK_EXPORT size_t peakMemoryUsage ();
+
+}
+
+#endif
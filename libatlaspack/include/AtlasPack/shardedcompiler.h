@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_SHARDEDCOMPILER_H_INCLUDED
+#define ATLASPACK_SHARDEDCOMPILER_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Backend>
+#include <AtlasPack/TextureAtlas>
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/Report>
+
+#include <string>
+
+namespace AtlasPack {
+
+class ShardedCompilerPrivate;
+class ATLASPACK_EXPORT ShardedCompiler
+{
+    public:
+        ShardedCompiler(const std::string &workerExecutable, Backend *backend);
+        ~ShardedCompiler();
+
+        //disable copying of this type
+        ShardedCompiler(const ShardedCompiler &other) = delete;
+        ShardedCompiler &operator=(const ShardedCompiler &other) = delete;
+
+        void     setShardCount (unsigned int shards);
+        unsigned int shardCount () const;
+
+        TextureAtlas compile (const TextureAtlasPacker &packer, const std::string &basePath,
+                              std::string *error = nullptr, CompileReport *report = nullptr) const;
+
+        static bool runWorker (const std::string &planFile, unsigned int shard, const Backend *backend,
+                               std::string *error = nullptr);
+
+    private:
+        ShardedCompilerPrivate *p = nullptr;
+};
+
+}
+
+#endif
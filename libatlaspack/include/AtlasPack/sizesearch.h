@@ -0,0 +1,73 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ATLASPACK_SIZESEARCH_H_INCLUDED
+#define ATLASPACK_SIZESEARCH_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Image>
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/Report>
+#include <AtlasPack/JobQueue>
+
+#include <memory>
+#include <vector>
+
+namespace AtlasPack {
+
+class SizeSearchPrivate;
+class ATLASPACK_EXPORT SizeSearch
+{
+    public:
+        SizeSearch(size_t threads = 0);
+        SizeSearch(JobQueue<bool> *jobs);
+        ~SizeSearch();
+
+        //disable copying of this type
+        SizeSearch(const SizeSearch &other) = delete;
+        SizeSearch &operator=(const SizeSearch &other) = delete;
+
+        void   setStartSize (size_t size);
+        size_t startSize () const;
+
+        void   setIncrement (size_t increment);
+        size_t increment () const;
+
+        void   setPlacementAlignment (size_t alignment);
+        size_t placementAlignment () const;
+
+        void       setPackPolicy (const PackPolicy &policy);
+        PackPolicy packPolicy () const;
+
+        unsigned int threadCount () const;
+
+        std::shared_ptr<TextureAtlasPacker> run (const std::vector<Image> &images, SearchReport *report = nullptr);
+
+    private:
+        SizeSearchPrivate *p = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_SPATIALINDEX_P_H
+#define ATLASPACK_SPATIALINDEX_P_H
+
+#include <AtlasPack/Dimension>
+
+#include <limits>
+#include <vector>
+
+namespace AtlasPack {
+
+/**
+ * @internal
+ * Static packed R-tree over a list of rectangles. All nodes are stored level by level
+ * in flat arrays, leaves first, each node has up to NodeSize children. The leaves are
+ * ordered with the Sort-Tile-Recursive algorithm, so nodes cover compact areas.
+ * Queries return the indices of the rectangles that were passed to build.
+ */
+class SpatialIndex {
+    public:
+        static const size_t NoItem = std::numeric_limits<size_t>::max();
+
+        void build (const std::vector<Rect> &rects);
+        void clear ();
+        bool isEmpty () const { return m_boxes.empty(); }
+
+        size_t itemAt (const Pos &pos) const;
+        void query (const Rect &rect, std::vector<size_t> *result) const;
+
+    private:
+        struct Box {
+            size_t x0, y0, x1, y1;    //the right and bottom edges are exclusive
+
+            bool intersects (const Box &other) const {
+                return x0 < other.x1 && other.x0 < x1 && y0 < other.y1 && other.y0 < y1;
+            }
+        };
+
+        static const size_t NodeSize = 16;
+
+        template <typename Visitor> void visit (const Box &area, Visitor visitor) const;
+
+        std::vector<Box> m_boxes;
+        std::vector<size_t> m_indices;      //item index for leaves, position of the first child otherwise
+        std::vector<size_t> m_levelEnds;    //end position of every level in m_boxes
+};
+
+}
+
+#endif
@@ -29,6 +29,7 @@
 #include <AtlasPack/Backend>
 
 #include <string>
+#include <vector>
 
 namespace AtlasPack {
 
@@ -53,7 +54,11 @@ class ATLASPACK_EXPORT TextureAtlas
 
         size_t count () const;
 
+        std::string textureAt (const Pos &pos) const;
+        std::vector<std::string> texturesIn (const Rect &rect) const;
+
     friend class TextureAtlasPacker;
+    friend class ShardedCompiler;
 
     private:
         TextureAtlas(TextureAtlasPrivate *p);
@@ -25,17 +25,24 @@
 #define ATLASPACK_TEXTUREATLAS_P_H
 
 #include <AtlasPack/TextureAtlas>
+#include <AtlasPack/spatialindex_p.h>
 #include <map>
+#include <vector>
 
 namespace AtlasPack {
 
 struct Texture {
     Texture() = default;
     Texture(Pos p, Image img)
-        : pos(p), image(img) {}
+        : pos(p), image(img)
+        , originalSize(img.sourceSize()), offset(img.contentRect().topLeft) {}
     Texture(const Texture &other) = default;
     Pos pos;
     Image image;
+
+    //geometry of the untrimmed image and position of the packed area inside of it
+    Size originalSize;
+    Pos offset;
 };
 
 class TextureAtlasPrivate {
@@ -44,6 +51,12 @@ class TextureAtlasPrivate {
         std::map<std::string, Texture> m_textures;
         Image m_textureAtlas;
         bool m_valid = true;
+
+        void buildIndex ();
+
+        //position lookup, item i of the index is the texture m_indexNames[i]
+        SpatialIndex m_index;
+        std::vector<std::string> m_indexNames;
 };
 
 }
@@ -30,14 +30,115 @@
 #include <AtlasPack/Backend>
 #include <AtlasPack/Dimension>
 #include <AtlasPack/TextureAtlas>
+#include <AtlasPack/Report>
+#include <AtlasPack/JobQueue>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
 
 namespace AtlasPack {
 
+/**
+ * Block compressed texture formats the atlas image can be written in
+ * additionally to the png image.
+ */
+enum class BlockCompression {
+    None,
+    BC1,    //!< opaque RGB, 4 bits per pixel
+    BC3     //!< RGBA with interpolated alpha, 8 bits per pixel
+};
+
+/**
+ * Decides how the free area next to a placed image is divided,
+ * \sa AtlasPack::PackPolicy
+ */
+enum class SplitRule {
+    LongerRemainder,    //!< keep the biggest possible free rectangle
+    ShorterRemainder    //!< keep the free rectangles close to a square
+};
+
+/**
+ * Decides which free area a image is placed into, \sa AtlasPack::PackPolicy
+ */
+enum class FitHeuristic {
+    FirstFit,           //!< the first area the image fits into
+    BestAreaFit         //!< the area that leaves the least space unused
+};
+
+struct ATLASPACK_EXPORT PackPolicy {
+    SplitRule split = SplitRule::LongerRemainder;
+    FitHeuristic fit = FitHeuristic::FirstFit;
+};
+
+/**
+ * A packed image and the area reserved for it in the atlas,
+ * the image is painted at the top left corner of the cell.
+ */
+struct ATLASPACK_EXPORT Placement {
+    Image image;
+    Rect  cell;
+};
+
+/**
+ * A scaled copy of the atlas that is written from the same layout, \sa TextureAtlasPacker::setVariants
+ */
+struct ATLASPACK_EXPORT AtlasVariant {
+    std::string basePath;
+    size_t scale = 1;   //!< the variant is scale / layout scale times the size of the atlas
+    std::map<std::string, std::string> sources; //!< files painted instead of the downsampled images, by image path
+};
+
+/**
+ * Phases of a compile run, in the order they are executed. Mipmaps and
+ * Compressing are skipped if they are not enabled.
+ */
+enum class CompilePhase {
+    Painting,
+    Mipmaps,
+    Compressing,
+    Exporting,
+    WritingDescription,
+    Finished
+};
+
+struct ATLASPACK_EXPORT CompileProgress {
+    CompilePhase phase = CompilePhase::Painting;
+    size_t paintedImages = 0;
+    size_t totalImages = 0;
+};
+
+using CompileProgressCallback = std::function<void (const CompileProgress &progress)>;
+
+class CompileHandlePrivate;
+class ATLASPACK_EXPORT CompileHandle
+{
+    public:
+        CompileHandle();
+
+        bool isValid () const;
+        void cancel ();
+        bool isCancelled () const;
+        CompileProgress progress () const;
+
+        bool isFinished () const;
+        bool waitFor (unsigned int milliseconds) const;
+        TextureAtlas result (std::string *error = nullptr) const;
+
+    friend class TextureAtlasPacker;
+
+    private:
+        std::shared_ptr<CompileHandlePrivate> p;
+};
+
 class TextureAtlasPackerPrivate;
 class ATLASPACK_EXPORT TextureAtlasPacker
 {
     public:
-        TextureAtlasPacker(Size atlasSize);
+        TextureAtlasPacker(Size atlasSize, const PackPolicy &policy = PackPolicy());
         ~TextureAtlasPacker();
 
         //disable copying of this type
@@ -45,13 +146,57 @@ class ATLASPACK_EXPORT TextureAtlasPacker
         TextureAtlasPacker &operator=(const TextureAtlasPacker &other) = delete;
 
         Size size () const;
+        PackPolicy packPolicy () const;
 
-        bool insertImage (const Image &img);
+        bool insertImage (const Image &img, Rect *cell = nullptr);
+        bool insertImages (const std::vector<Image> &images);
+        bool insertAtlas (const TextureAtlasPacker &block, Rect *cell = nullptr);
+        bool replaceImage (const Image &img, Rect *cell = nullptr);
+        bool removeImage (const std::string &path, Rect *cell = nullptr);
+        std::vector<Placement> placements () const;
 
-        TextureAtlas compile (const std::string &basePath, Backend *backend, std::string *error = nullptr) const;
+        void   setPlacementAlignment (size_t alignment);
+        size_t placementAlignment () const;
+
+        void setGenerateMipmaps (bool enabled);
+        bool generateMipmaps () const;
+
+        void setBlockCompression (BlockCompression format);
+        BlockCompression blockCompression () const;
+
+        void setExportPng (bool enabled);
+        bool exportPng () const;
+
+        void   setDecodeBudget (size_t bytes);
+        size_t decodeBudget () const;
+
+        void   setPrefetchWindow (size_t bytes);
+        size_t prefetchWindow () const;
+
+        void   setTileSize (size_t tileSize);
+        size_t tileSize () const;
+
+        void setVariants (const std::vector<AtlasVariant> &variants, size_t layoutScale);
+        std::vector<AtlasVariant> variants () const;
+        size_t layoutScale () const;
+        static size_t variantAlignment (const std::vector<AtlasVariant> &variants, size_t layoutScale);
+
+        void setJobQueue (JobQueue<bool> *jobs);
+        JobQueue<bool> *jobQueue () const;
+
+        TextureAtlas compile (const std::string &basePath, Backend *backend, std::string *error = nullptr,
+                              CompileReport *report = nullptr) const;
+        CompileHandle compileAsync (const std::string &basePath, Backend *backend,
+                                    CompileProgressCallback progress = CompileProgressCallback(),
+                                    CompileReport *report = nullptr) const;
+        bool writeDescription (const std::string &fileName, std::string *error = nullptr) const;
+        void writeDescription (std::ostream &out) const;
 
 
     private:
+        TextureAtlas compile (const std::string &basePath, Backend *backend, std::string *error,
+                              CompileReport *report, CompileHandlePrivate *control) const;
+
         TextureAtlasPackerPrivate *p = nullptr;
 };
 
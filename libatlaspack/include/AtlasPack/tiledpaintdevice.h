@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_TILEDPAINTDEVICE_H_INCLUDED
+#define ATLASPACK_TILEDPAINTDEVICE_H_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+#include <AtlasPack/Backend>
+#include <AtlasPack/PaintDevice>
+
+#include <memory>
+#include <string>
+
+namespace AtlasPack {
+
+class TiledPaintDevicePrivate;
+class ATLASPACK_EXPORT TiledPaintDevice : public PaintDevice
+{
+    public:
+        static const size_t TileSize = 256;
+
+        TiledPaintDevice(const Size &size, const Backend *decoder, const std::string &swapDirectory = std::string(),
+                         size_t residentBytes = 256 << 20);
+        virtual ~TiledPaintDevice();
+
+        static std::shared_ptr<TiledPaintDevice> openFile (const std::string &fileName, const Size &size, const Backend *decoder,
+                                                           size_t residentBytes = 256 << 20);
+
+        bool isValid () const;
+        Size size () const;
+        size_t residentBytes () const;
+
+        // PaintDevice interface
+        bool paintImageFromFile (Pos topleft, std::string filename) override;
+        bool paintImageFromFile (Pos topleft, std::string filename, Rect sourceRect) override;
+        bool paintImage (Pos topleft, const PixelView &pixels) override;
+        bool readPixels (const Rect &rect, PixelBuffer *target) const override;
+        bool exportToFile (std::string filename) override;
+
+    private:
+        TiledPaintDevice(TiledPaintDevicePrivate *priv);
+        TiledPaintDevicePrivate *p = nullptr;
+};
+
+class ATLASPACK_EXPORT TiledBackend : public Backend
+{
+    public:
+        TiledBackend(const Backend *decoder, const std::string &swapDirectory = std::string(),
+                     size_t residentBytes = 256 << 20);
+
+        // Backend interface
+        bool supportsImageType (const std::string &extension) const override;
+        std::shared_ptr<PaintDevice> createPaintDevice (const Size &reserveSize) const override;
+        Image readImageInformation (const std::string &path) const override;
+        Image readTrimmedImageInformation (const std::string &path) const override;
+        bool readImagePixels (const std::string &path, PixelBuffer *target) const override;
+
+    private:
+        const Backend *m_decoder = nullptr;
+        std::string m_swapDirectory;
+        size_t m_residentBytes = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ATLASPACK_TRACE_INCLUDED
+#define ATLASPACK_TRACE_INCLUDED
+
+#include <AtlasPack/atlaspack_global.h>
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace AtlasPack {
+
+class ATLASPACK_EXPORT Trace {
+    public:
+        static void setEnabled (bool enabled);
+        static bool isEnabled () { return s_enabled.load(std::memory_order_relaxed); }
+
+        static void   setBufferSize (size_t eventsPerThread);
+        static size_t bufferSize ();
+
+        static uint64_t now ();
+        static void setThreadName (const std::string &name);
+        static void complete (const std::string &name, const char *category, uint64_t start,
+                              uint64_t duration, uint64_t enqueued = 0);
+
+        static bool writeChromeTrace (std::ostream &out);
+        static void clear ();
+
+    private:
+        static std::atomic_bool s_enabled;
+};
+
+}
+
+#endif
@@ -23,6 +23,9 @@
  */
 
 #include <AtlasPack/Backend>
+#include <AtlasPack/pixelops_p.h>
+
+#include <iostream>
 
 namespace AtlasPack {
 
@@ -62,4 +65,41 @@ Backend::~Backend()
 
 }
 
+/**
+  * \fn AtlasPack::Backend::readTrimmedImageInformation
+  * Like \sa AtlasPack::Backend::readImageInformation, but additionally calculates the
+  * area of the image that is not fully transparent. Only that area is packed into the atlas,
+  * the trimmed borders are recorded in the returned \sa AtlasPack::Image.
+  *
+  * The default implementation decodes the image using \sa AtlasPack::Backend::readImagePixels,
+  * if that fails the untrimmed image information is returned.
+  */
+Image Backend::readTrimmedImageInformation(const std::string &path) const
+{
+    PixelBuffer pixels;
+    if (!readImagePixels(path, &pixels))
+        return readImageInformation(path);
+
+    Rect content = PixelOps::opaqueRect(pixels.view());
+
+    //a fully transparent image still needs a place in the atlas
+    if (content.size.width == 0 || content.size.height == 0)
+        content = Rect(Pos(0, 0), Size(1, 1));
+
+    return Image(path, pixels.size(), content);
+}
+
+/**
+  * \fn AtlasPack::Backend::readImagePixels
+  * Decodes the image specified by \a path into 8 bit RGBA pixels and stores them in \a target.
+  * Returns false if the image could not be decoded, the default implementation does not
+  * support decoding images at all.
+  */
+bool Backend::readImagePixels(const std::string &path, PixelBuffer *target) const
+{
+    UNUSED(target);
+    std::cerr << "The backend does not support decoding " << path << std::endl;
+    return false;
+}
+
 }
@@ -29,6 +29,7 @@
 #include <Magick++.h>
 
 #include <iostream>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 
 namespace AtlasPack {
@@ -50,6 +51,76 @@ MagickBackend::MagickBackend()
     Magick::InitializeMagick(NULL);
 }
 
+/*!
+ * \brief MagickBackend::setImageCache
+ * Keeps the decoded images in \a cache, painting and \sa MagickBackend::readImagePixels look
+ * there first. The cache can be shared by several backends and has to outlive all paint devices
+ * created afterwards. Set to nullptr (the default) to decode every image again.
+ */
+void MagickBackend::setImageCache(AtlasPack::ImageCache *cache)
+{
+    m_cache = cache;
+}
+
+AtlasPack::ImageCache *MagickBackend::imageCache() const
+{
+    return m_cache;
+}
+
+/*
+ * Reads the image \a path into \a img, from \a data if the file content was already read
+ */
+static void readImage (Magick::Image *img, const std::string &path, const std::vector<unsigned char> *data)
+{
+    if (data)
+        img->read(Magick::Blob(data->data(), data->size()));
+    else
+        img->read(path);
+}
+
+/*
+ * Decodes the file \a path, or its content \a data, into tightly packed RGBA pixels
+ */
+static bool decodePixels (const std::string &path, AtlasPack::PixelBuffer *target,
+                          const std::vector<unsigned char> *data = nullptr)
+{
+    try {
+        Magick::Image img;
+        readImage(&img, path, data);
+
+        AtlasPack::PixelBuffer pixels(AtlasPack::Size(img.columns(), img.rows()));
+        img.write(0, 0, img.columns(), img.rows(), "RGBA", Magick::CharPixel, pixels.data());
+
+        *target = std::move(pixels);
+        return true;
+    }
+    catch( Magick::Exception &error )
+    {
+        std::cerr << "Unable to decode file: " << path << " " <<error.what() << std::endl;
+    }
+    return false;
+}
+
+/*
+ * Composites \a pixels onto \a painter at \a topleft with the \a op operator
+ */
+static void compositePixels (Magick::Image *painter, const AtlasPack::Pos &topleft, const AtlasPack::PixelView &pixels,
+                             Magick::CompositeOperator op)
+{
+    //Magick++ expects tightly packed scanlines
+    AtlasPack::PixelBuffer packed;
+    const unsigned char *data = pixels.data;
+    if (pixels.stride != pixels.size.width * 4) {
+        packed = AtlasPack::PixelBuffer(pixels.size);
+        for (size_t y = 0; y < pixels.size.height; y++)
+            std::copy(pixels.scanLine(y), pixels.scanLine(y) + packed.stride(), packed.scanLine(y));
+        data = packed.data();
+    }
+
+    Magick::Image input(pixels.size.width, pixels.size.height, "RGBA", Magick::CharPixel, data);
+    painter->composite(input, topleft.x, topleft.y, op);
+}
+
 /*!
  * \brief MagickBackend::supportsImageType
  * Currenty does check statically if images are supported without
@@ -71,7 +142,7 @@ bool MagickBackend::supportsImageType(const std::string &extension) const
  */
 std::shared_ptr<AtlasPack::PaintDevice> MagickBackend::createPaintDevice(const AtlasPack::Size &reserveSize) const
 {
-    return std::make_shared<MagickPaintDevice>(reserveSize);
+    return std::make_shared<MagickPaintDevice>(reserveSize, m_cache);
 }
 
 /*!
@@ -97,14 +168,113 @@ AtlasPack::Image MagickBackend::readImageInformation(const std::string &path) co
     return AtlasPack::Image();
 }
 
+/*!
+ * \brief MagickBackend::readImagePixels
+ * Reimplements the readImagePixels function from \sa AtlasBackend::Backend
+ * \sa AtlasBackend::Backend::readImagePixels
+ */
+bool MagickBackend::readImagePixels(const std::string &path, AtlasPack::PixelBuffer *target) const
+{
+    if (!m_cache)
+        return decodePixels(path, target);
+
+    std::shared_ptr<const AtlasPack::PixelBuffer> pixels = m_cache->load(path, [&path](AtlasPack::PixelBuffer *decoded) {
+        return decodePixels(path, decoded);
+    });
+    if (!pixels)
+        return false;
+
+    *target = *pixels;
+    return true;
+}
+
 
 class MagickPaintDevicePrivate {
     public:
-        MagickPaintDevicePrivate(const Magick::Geometry &size)
-            :m_painter(new Magick::Image(size, "White")) { }
+        MagickPaintDevicePrivate(const Magick::Geometry &size, AtlasPack::ImageCache *cache)
+            :m_painter(new Magick::Image(size, "White")), m_cache(cache) { }
+
+        std::shared_ptr<const AtlasPack::PixelBuffer> cachedPixels (const std::string &filename,
+                                                                   const std::vector<unsigned char> *data) const;
+        bool paint (AtlasPack::Pos topleft, const std::string &filename, const std::vector<unsigned char> *data);
+        bool paint (AtlasPack::Pos topleft, const std::string &filename, const std::vector<unsigned char> *data,
+                    AtlasPack::Rect sourceRect);
+
         std::shared_ptr<Magick::Image> m_painter;
+        AtlasPack::ImageCache *m_cache = nullptr;
 };
 
+/*
+ * Returns the decoded pixels of \a filename from the image cache, decoding
+ * them from \a data or the file if they are not cached yet
+ */
+std::shared_ptr<const AtlasPack::PixelBuffer> MagickPaintDevicePrivate::cachedPixels(const std::string &filename,
+                                                                                     const std::vector<unsigned char> *data) const
+{
+    return m_cache->load(filename, [&filename, data](AtlasPack::PixelBuffer *decoded) {
+        return decodePixels(filename, decoded, data);
+    });
+}
+
+/*
+ * Paints the image \a filename at \a topleft, decoded from \a data if it is set
+ */
+bool MagickPaintDevicePrivate::paint(AtlasPack::Pos topleft, const std::string &filename, const std::vector<unsigned char> *data)
+{
+    try {
+        if (m_cache) {
+            std::shared_ptr<const AtlasPack::PixelBuffer> pixels = cachedPixels(filename, data);
+            if (!pixels)
+                return false;
+            compositePixels(m_painter.get(), topleft, pixels->view(), Magick::OverCompositeOp);
+            return true;
+        }
+
+        Magick::Image input;
+        readImage(&input, filename, data);
+
+        m_painter->composite(input, topleft.x, topleft.y);
+        return true;
+
+    } catch( Magick::Exception &error_ ) {
+        std::cerr << "Caught exception: " << error_.what() << std::endl;
+        std::cerr << "Unable to compose file: " << filename << std::endl;
+    }
+    return false;
+}
+
+/*
+ * Paints the area \a sourceRect of the image \a filename at \a topleft, decoded from \a data if it is set
+ */
+bool MagickPaintDevicePrivate::paint(AtlasPack::Pos topleft, const std::string &filename, const std::vector<unsigned char> *data,
+                                     AtlasPack::Rect sourceRect)
+{
+    try {
+        if (m_cache) {
+            std::shared_ptr<const AtlasPack::PixelBuffer> pixels = cachedPixels(filename, data);
+            if (!pixels || !pixels->view().contains(sourceRect))
+                return false;
+            compositePixels(m_painter.get(), topleft, pixels->view().region(sourceRect), Magick::OverCompositeOp);
+            return true;
+        }
+
+        Magick::Image input;
+        readImage(&input, filename, data);
+
+        input.crop(Magick::Geometry(sourceRect.size.width, sourceRect.size.height,
+                                    sourceRect.topLeft.x, sourceRect.topLeft.y));
+        input.repage();
+
+        m_painter->composite(input, topleft.x, topleft.y);
+        return true;
+
+    } catch( Magick::Exception &error_ ) {
+        std::cerr << "Caught exception: " << error_.what() << std::endl;
+        std::cerr << "Unable to compose file: " << filename << std::endl;
+    }
+    return false;
+}
+
 /*!
  * \class AtlasPack::Backends::MagickPaintDevice
  *
@@ -112,8 +282,8 @@ class MagickPaintDevicePrivate {
  * the Magick++ library.
  *
  */
-MagickPaintDevice::MagickPaintDevice(const AtlasPack::Size &reserveSize)
-    : p(new MagickPaintDevicePrivate(Magick::Geometry(reserveSize.width, reserveSize.height)))
+MagickPaintDevice::MagickPaintDevice(const AtlasPack::Size &reserveSize, AtlasPack::ImageCache *cache)
+    : p(new MagickPaintDevicePrivate(Magick::Geometry(reserveSize.width, reserveSize.height), cache))
 {
 
 }
@@ -130,16 +300,87 @@ MagickPaintDevice::~MagickPaintDevice()
  */
 bool MagickPaintDevice::paintImageFromFile(AtlasPack::Pos topleft, std::string filename)
 {
+    return p->paint(topleft, filename, nullptr);
+}
+
+/*!
+ * \brief MagickPaintDevice::paintImageFromFile
+ * Reimplements the paintImageFromFile function from \sa AtlasBackend::MagickPaintDevice
+ * \sa AtlasBackend::MagickPaintDevice::paintImageFromFile
+ */
+bool MagickPaintDevice::paintImageFromFile(AtlasPack::Pos topleft, std::string filename, AtlasPack::Rect sourceRect)
+{
+    return p->paint(topleft, filename, nullptr, sourceRect);
+}
+
+/*!
+ * \brief MagickPaintDevice::paintImageFromData
+ * Reimplements the paintImageFromData function from \sa AtlasPack::PaintDevice,
+ * decodes the image from the file content \a data instead of reading \a filename.
+ */
+bool MagickPaintDevice::paintImageFromData(AtlasPack::Pos topleft, std::string filename, const std::vector<unsigned char> &data)
+{
+    return p->paint(topleft, filename, &data);
+}
+
+/*!
+ * \brief MagickPaintDevice::paintImageFromData
+ * Reimplements the paintImageFromData function from \sa AtlasPack::PaintDevice,
+ * decodes the image from the file content \a data instead of reading \a filename.
+ */
+bool MagickPaintDevice::paintImageFromData(AtlasPack::Pos topleft, std::string filename, const std::vector<unsigned char> &data,
+                                           AtlasPack::Rect sourceRect)
+{
+    return p->paint(topleft, filename, &data, sourceRect);
+}
+
+/*!
+ * \brief MagickPaintDevice::decodesImageData
+ * Reimplements the decodesImageData function from \sa AtlasPack::PaintDevice
+ */
+bool MagickPaintDevice::decodesImageData() const
+{
+    return true;
+}
+
+/*!
+ * \brief MagickPaintDevice::paintImage
+ * Reimplements the paintImage function from \sa AtlasBackend::MagickPaintDevice
+ * \sa AtlasBackend::MagickPaintDevice::paintImage
+ */
+bool MagickPaintDevice::paintImage(AtlasPack::Pos topleft, const AtlasPack::PixelView &pixels)
+{
+    if (!pixels.isValid())
+        return false;
+
     try {
-        Magick::Image input;
-        input.read(filename);
+        compositePixels(p->m_painter.get(), topleft, pixels, Magick::CopyCompositeOp);
+        return true;
 
-        p->m_painter->composite(input, topleft.x, topleft.y);
+    } catch( Magick::Exception &error_ ) {
+        std::cerr << "Caught exception: " << error_.what() << std::endl;
+        std::cerr << "Unable to paint pixel buffer" << std::endl;
+    }
+    return false;
+}
+
+/*!
+ * \brief MagickPaintDevice::readPixels
+ * Reimplements the readPixels function from \sa AtlasBackend::MagickPaintDevice
+ * \sa AtlasBackend::MagickPaintDevice::readPixels
+ */
+bool MagickPaintDevice::readPixels(const AtlasPack::Rect &rect, AtlasPack::PixelBuffer *target) const
+{
+    try {
+        AtlasPack::PixelBuffer pixels(rect.size);
+        p->m_painter->write(rect.topLeft.x, rect.topLeft.y, rect.size.width, rect.size.height,
+                            "RGBA", Magick::CharPixel, pixels.data());
+        *target = std::move(pixels);
         return true;
 
     } catch( Magick::Exception &error_ ) {
         std::cerr << "Caught exception: " << error_.what() << std::endl;
-        std::cerr << "Unable to compose file: " << filename << std::endl;
+        std::cerr << "Unable to read pixels from the paint device" << std::endl;
     }
     return false;
 }
@@ -0,0 +1,197 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/BatchCompiler>
+#include <AtlasPack/SizeSearch>
+#include <AtlasPack/JobQueue>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+namespace AtlasPack {
+
+class BatchCompilerPrivate {
+    public:
+        BatchCompilerPrivate (Backend *backend, size_t threads, WorkerAffinity affinity)
+            : m_backend(backend), m_jobs(threads, affinity) {}
+
+        void build (const BatchEntry &entry, BatchResult *result);
+
+        Backend *m_backend = nullptr;
+        JobQueue<bool> m_jobs;
+        size_t m_concurrent = 0;
+};
+
+/**
+ * @internal
+ * @brief BatchCompilerPrivate::build
+ * Searches the atlas size for \a entry and compiles it, all parallel work is done on the shared queue
+ */
+void BatchCompilerPrivate::build(const BatchEntry &entry, BatchResult *result)
+{
+    result->basePath = entry.basePath;
+    result->report.imageCount = entry.images.size();
+
+    if (entry.images.empty()) {
+        result->error = "No images to pack";
+        return;
+    }
+
+    SizeSearch search(&m_jobs);
+    search.setPlacementAlignment(entry.alignment);
+    search.setPackPolicy(entry.policy);
+
+    std::shared_ptr<TextureAtlasPacker> packer = search.run(entry.images, &result->report.search);
+    if (!packer) {
+        result->error = "Could not find a atlas size that fits all images";
+        return;
+    }
+
+    packer->setGenerateMipmaps(entry.mipmaps);
+    packer->setBlockCompression(entry.compression);
+    packer->setExportPng(entry.exportPng);
+    packer->setDecodeBudget(entry.decodeBudget);
+    packer->setPrefetchWindow(entry.prefetchWindow);
+    packer->setTileSize(entry.tileSize);
+    packer->setJobQueue(&m_jobs);
+
+    TextureAtlas atlas = packer->compile(entry.basePath, m_backend, &result->error, &result->report.compile);
+    result->success = atlas.isValid();
+    if (!result->success && result->error.empty())
+        result->error = "Failed to compile the atlas";
+
+    result->report.peakMemory = peakMemoryUsage();
+}
+
+/**
+ * \class AtlasPack::BatchCompiler
+ * Builds many atlases at once, sharing a single pool of worker threads between all of them.
+ * Several atlases are in flight at the same time, while one of them is in a mostly sequential
+ * phase, like encoding the png image, the others keep the workers busy with size search trials
+ * and paint tasks. The biggest atlases are started first, so the batch does not end waiting for
+ * a single big atlas.
+ *
+ * \a threads specifies the number of worker threads, 0 uses one thread per core,
+ * \a affinity where they are pinned to, see \sa AtlasPack::JobQueue.
+ */
+BatchCompiler::BatchCompiler(Backend *backend, size_t threads, WorkerAffinity affinity)
+    : p(new BatchCompilerPrivate(backend, threads, affinity))
+{
+
+}
+
+BatchCompiler::~BatchCompiler()
+{
+    if (p) delete p;
+}
+
+/*!
+ * \brief BatchCompiler::setConcurrentAtlases
+ * Sets how many atlases are built at the same time, 0 (the default) uses
+ * a quarter of the worker threads but at least 2.
+ */
+void BatchCompiler::setConcurrentAtlases(size_t count)
+{
+    p->m_concurrent = count;
+}
+
+size_t BatchCompiler::concurrentAtlases() const
+{
+    if (p->m_concurrent)
+        return p->m_concurrent;
+    return std::max<size_t>(2, p->m_jobs.maxJobs() / 4);
+}
+
+/*!
+ * \brief BatchCompiler::threadCount
+ * Returns the number of worker threads shared by all atlases
+ */
+unsigned int BatchCompiler::threadCount() const
+{
+    return p->m_jobs.maxJobs();
+}
+
+/*!
+ * \brief BatchCompiler::queueStats
+ * Returns the counters of the shared worker queue, \sa AtlasPack::JobQueue::stats
+ */
+JobQueueStats BatchCompiler::queueStats() const
+{
+    return p->m_jobs.stats();
+}
+
+/*!
+ * \brief BatchCompiler::run
+ * Builds all atlases in \a entries and returns their results in the same order.
+ * If \a finished is set, it is called for every atlas as soon as it is done, from
+ * one of the threads driving the batch, but never from two threads at the same time.
+ */
+std::vector<BatchResult> BatchCompiler::run(const std::vector<BatchEntry> &entries, FinishedCallback finished)
+{
+    std::vector<BatchResult> results(entries.size());
+
+    //start with the atlases that have the biggest image area
+    std::vector<size_t> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<size_t> area(entries.size(), 0);
+    for (size_t i = 0; i < entries.size(); i++) {
+        for (const Image &img : entries[i].images)
+            area[i] += img.width() * img.height();
+    }
+    std::stable_sort(order.begin(), order.end(), [&area](size_t a, size_t b) {
+        return area[a] > area[b];
+    });
+
+    std::atomic<size_t> next{0};
+    std::mutex callbackMutex;
+
+    //every driver thread builds one atlas at a time, the heavy lifting happens on the shared queue
+    auto driver = [&]() {
+        for (size_t idx = next++; idx < order.size(); idx = next++) {
+            const size_t entry = order[idx];
+            p->build(entries[entry], &results[entry]);
+
+            if (finished) {
+                std::lock_guard<std::mutex> lk(callbackMutex);
+                finished(results[entry]);
+            }
+        }
+    };
+
+    size_t drivers = std::min(concurrentAtlases(), entries.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < drivers; i++)
+        threads.emplace_back(driver);
+
+    driver();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    return results;
+}
+
+}
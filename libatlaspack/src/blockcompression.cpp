@@ -0,0 +1,319 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/blockcompression_p.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ATLASPACK_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace AtlasPack {
+namespace BlockCompressor {
+
+/**
+ * @internal
+ * Copies the 4x4 block at block coordinates \a bx, \a by of \a source into \a block,
+ * pixels outside of the image are replaced by the nearest border pixel.
+ */
+static void fetchBlock (const PixelView &source, size_t bx, size_t by, unsigned char *block)
+{
+    for (size_t y = 0; y < 4; y++) {
+        const unsigned char *row = source.scanLine(std::min(by * 4 + y, source.size.height - 1));
+        for (size_t x = 0; x < 4; x++) {
+            const unsigned char *px = row + std::min(bx * 4 + x, source.size.width - 1) * 4;
+            std::copy(px, px + 4, block + (y * 4 + x) * 4);
+        }
+    }
+}
+
+/**
+ * @internal
+ * Calculates the per channel minimum and maximum of the 16 pixels in \a block
+ */
+static void blockBounds (const unsigned char *block, unsigned char *minColor, unsigned char *maxColor)
+{
+#ifdef ATLASPACK_HAVE_SSE2
+    const __m128i *rows = reinterpret_cast<const __m128i *>(block);
+    __m128i r0 = _mm_loadu_si128(rows);
+    __m128i r1 = _mm_loadu_si128(rows + 1);
+    __m128i r2 = _mm_loadu_si128(rows + 2);
+    __m128i r3 = _mm_loadu_si128(rows + 3);
+
+    __m128i mn = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+    __m128i mx = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+
+    //fold the 4 pixels of the register into one
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+
+    uint32_t mnPx = static_cast<uint32_t>(_mm_cvtsi128_si32(mn));
+    uint32_t mxPx = static_cast<uint32_t>(_mm_cvtsi128_si32(mx));
+    for (size_t c = 0; c < 4; c++) {
+        minColor[c] = static_cast<unsigned char>(mnPx >> (c * 8));
+        maxColor[c] = static_cast<unsigned char>(mxPx >> (c * 8));
+    }
+#else
+    std::fill(minColor, minColor + 4, 255);
+    std::fill(maxColor, maxColor + 4, 0);
+    for (size_t i = 0; i < 16; i++) {
+        for (size_t c = 0; c < 4; c++) {
+            minColor[c] = std::min(minColor[c], block[i * 4 + c]);
+            maxColor[c] = std::max(maxColor[c], block[i * 4 + c]);
+        }
+    }
+#endif
+}
+
+static uint16_t toRgb565 (const int *color)
+{
+    return static_cast<uint16_t>(((color[0] * 31 + 127) / 255) << 11
+                                 | ((color[1] * 63 + 127) / 255) << 5
+                                 | ((color[2] * 31 + 127) / 255));
+}
+
+static void fromRgb565 (uint16_t value, int *color)
+{
+    int r = (value >> 11) & 31;
+    int g = (value >> 5) & 63;
+    int b = value & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+static void writeLE16 (unsigned char *target, uint16_t value)
+{
+    target[0] = static_cast<unsigned char>(value);
+    target[1] = static_cast<unsigned char>(value >> 8);
+}
+
+/**
+ * @internal
+ * Encodes the color part of \a block as BC1 block into the 8 bytes at \a target.
+ * The endpoints are taken from the inset bounding box of the block colors, every pixel
+ * is then projected onto the line between the endpoints to select its palette entry.
+ */
+static void encodeColorBlock (const unsigned char *block, const unsigned char *minColor,
+                              const unsigned char *maxColor, unsigned char *target)
+{
+    //inset the bounding box by 1/16 of its size to reduce the error of the outer colors
+    int lo[3], hi[3];
+    for (size_t c = 0; c < 3; c++) {
+        int inset = (maxColor[c] - minColor[c]) >> 4;
+        lo[c] = minColor[c] + inset;
+        hi[c] = maxColor[c] - inset;
+    }
+
+    uint16_t c0 = toRgb565(hi);
+    uint16_t c1 = toRgb565(lo);
+
+    uint32_t indices = 0;
+    if (c0 == c1) {
+        //all pixels map to the first endpoint
+    } else {
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        int e0[3], e1[3];
+        fromRgb565(c0, e0);
+        fromRgb565(c1, e1);
+
+        int dir[3] = { e0[0] - e1[0], e0[1] - e1[1], e0[2] - e1[2] };
+        int len = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+
+        //palette order for a projection in thirds from c1 to c0
+        static const uint32_t paletteIndex[4] = { 1, 3, 2, 0 };
+
+        for (size_t i = 0; i < 16; i++) {
+            const unsigned char *px = block + i * 4;
+            int dot = (px[0] - e1[0]) * dir[0] + (px[1] - e1[1]) * dir[1] + (px[2] - e1[2]) * dir[2];
+            int step = len > 0 ? (dot * 3 + len / 2) / len : 0;
+            step = std::max(0, std::min(3, step));
+            indices |= paletteIndex[step] << (i * 2);
+        }
+    }
+
+    writeLE16(target, c0);
+    writeLE16(target + 2, c1);
+    for (size_t i = 0; i < 4; i++)
+        target[4 + i] = static_cast<unsigned char>(indices >> (i * 8));
+}
+
+/**
+ * @internal
+ * Encodes the alpha channel of \a block as BC3 alpha block into the 8 bytes at \a target,
+ * using the 8 value interpolation mode between the minimum and maximum alpha.
+ */
+static void encodeAlphaBlock (const unsigned char *block, unsigned char minAlpha,
+                              unsigned char maxAlpha, unsigned char *target)
+{
+    target[0] = maxAlpha;
+    target[1] = minAlpha;
+
+    uint64_t indices = 0;
+    if (maxAlpha > minAlpha) {
+        const int range = maxAlpha - minAlpha;
+        for (size_t i = 0; i < 16; i++) {
+            int step = ((block[i * 4 + 3] - minAlpha) * 7 + range / 2) / range;
+            //step 7 is the first endpoint, step 0 the second, the rest is interpolated in reverse order
+            uint64_t index = step == 7 ? 0 : (step == 0 ? 1 : static_cast<uint64_t>(8 - step));
+            indices |= index << (i * 3);
+        }
+    }
+
+    for (size_t i = 0; i < 6; i++)
+        target[2 + i] = static_cast<unsigned char>(indices >> (i * 8));
+}
+
+/**
+ * @internal
+ * Returns the number of bytes a single 4x4 block of \a format occupies
+ */
+size_t blockSize (BlockCompression format)
+{
+    switch (format) {
+        case BlockCompression::BC1:
+            return 8;
+        case BlockCompression::BC3:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @internal
+ * Returns the number of bytes a image of \a size needs when compressed to \a format
+ */
+size_t compressedSize (const Size &size, BlockCompression format)
+{
+    return ((size.width + 3) / 4) * ((size.height + 3) / 4) * blockSize(format);
+}
+
+/**
+ * @internal
+ * Compresses the block rows \a firstBlockRow up to but not including \a lastBlockRow of
+ * \a source into \a target, which has to hold \sa compressedSize bytes. Block rows are
+ * independent of each other, so the work can be split up between multiple threads.
+ */
+void compressBlockRows (const PixelView &source, BlockCompression format, unsigned char *target,
+                        size_t firstBlockRow, size_t lastBlockRow)
+{
+    const size_t blocksPerRow = (source.size.width + 3) / 4;
+    const size_t bytes = blockSize(format);
+
+    unsigned char block[64];
+    unsigned char minColor[4], maxColor[4];
+
+    for (size_t by = firstBlockRow; by < lastBlockRow; by++) {
+        unsigned char *out = target + by * blocksPerRow * bytes;
+        for (size_t bx = 0; bx < blocksPerRow; bx++, out += bytes) {
+            fetchBlock(source, bx, by, block);
+            blockBounds(block, minColor, maxColor);
+
+            if (format == BlockCompression::BC3) {
+                encodeAlphaBlock(block, minColor[3], maxColor[3], out);
+                encodeColorBlock(block, minColor, maxColor, out + 8);
+            } else {
+                encodeColorBlock(block, minColor, maxColor, out);
+            }
+        }
+    }
+}
+
+static void writeLE32 (std::ostream &out, uint32_t value)
+{
+    const char bytes[4] = { static_cast<char>(value), static_cast<char>(value >> 8),
+                            static_cast<char>(value >> 16), static_cast<char>(value >> 24) };
+    out.write(bytes, 4);
+}
+
+/**
+ * @internal
+ * Writes the compressed \a levels of a image with the geometry \a baseSize into
+ * a DDS file named \a fileName. The first level is the base level, the following
+ * ones are treated as its mipmap chain.
+ */
+bool writeDDS (const std::string &fileName, BlockCompression format, const Size &baseSize,
+               const std::vector<std::vector<unsigned char> > &levels)
+{
+    //flags as defined by the DDS file format
+    const uint32_t DDSD_CAPS        = 0x1;
+    const uint32_t DDSD_HEIGHT      = 0x2;
+    const uint32_t DDSD_WIDTH       = 0x4;
+    const uint32_t DDSD_PIXELFORMAT = 0x1000;
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDSD_LINEARSIZE  = 0x80000;
+    const uint32_t DDPF_FOURCC      = 0x4;
+    const uint32_t DDSCAPS_COMPLEX  = 0x8;
+    const uint32_t DDSCAPS_TEXTURE  = 0x1000;
+    const uint32_t DDSCAPS_MIPMAP   = 0x400000;
+
+    if (levels.empty())
+        return false;
+
+    std::ofstream out(fileName, std::ios::trunc | std::ios::out | std::ios::binary);
+    if (!out.is_open())
+        return false;
+
+    const bool hasMipmaps = levels.size() > 1;
+
+    out.write("DDS ", 4);
+    writeLE32(out, 124);
+    writeLE32(out, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE
+                   | (hasMipmaps ? DDSD_MIPMAPCOUNT : 0));
+    writeLE32(out, static_cast<uint32_t>(baseSize.height));
+    writeLE32(out, static_cast<uint32_t>(baseSize.width));
+    writeLE32(out, static_cast<uint32_t>(levels.front().size()));
+    writeLE32(out, 0); //depth
+    writeLE32(out, static_cast<uint32_t>(levels.size()));
+    for (size_t i = 0; i < 11; i++)
+        writeLE32(out, 0);
+
+    //pixel format
+    writeLE32(out, 32);
+    writeLE32(out, DDPF_FOURCC);
+    out.write(format == BlockCompression::BC3 ? "DXT5" : "DXT1", 4);
+    for (size_t i = 0; i < 5; i++)
+        writeLE32(out, 0);
+
+    writeLE32(out, DDSCAPS_TEXTURE | (hasMipmaps ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+    for (size_t i = 0; i < 4; i++)
+        writeLE32(out, 0);
+
+    for (const std::vector<unsigned char> &level : levels)
+        out.write(reinterpret_cast<const char *>(level.data()), static_cast<std::streamsize>(level.size()));
+
+    return out.good();
+}
+
+}
+}
@@ -0,0 +1,205 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <AtlasPack/CpuAffinity>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#define ATLASPACK_HAVE_AFFINITY
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace AtlasPack {
+
+/**
+ * @internal
+ * Parses a kernel cpu list like "0-3,8-11" into the single cpu numbers
+ */
+static std::vector<int> parseCpuList (const std::string &list)
+{
+    std::vector<int> cpus;
+    std::istringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        int first = 0, last = 0;
+        char dash = 0;
+        std::istringstream rangeIn(range);
+        if (!(rangeIn >> first))
+            continue;
+        if (!(rangeIn >> dash >> last) || dash != '-')
+            last = first;
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+/**
+ * \class AtlasPack::CpuAffinity
+ * Reads the processor topology and pins threads to processors, used by \sa AtlasPack::JobQueue
+ * to keep its workers on the cores or NUMA nodes they were started on, so the memory they
+ * allocate stays close to them. Only supported on Linux, on other systems nothing is pinned.
+ */
+
+/*!
+ * \brief CpuAffinity::isSupported
+ * Returns true if threads can be pinned on this system.
+ */
+bool CpuAffinity::isSupported()
+{
+#ifdef ATLASPACK_HAVE_AFFINITY
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*!
+ * \brief CpuAffinity::allowedCpus
+ * Returns the processors the calling thread is allowed to run on, which respects
+ * restrictions like taskset or cgroups. Returns a empty list if pinning is not supported.
+ */
+std::vector<int> CpuAffinity::allowedCpus()
+{
+    std::vector<int> cpus;
+#ifdef ATLASPACK_HAVE_AFFINITY
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set))
+            cpus.push_back(cpu);
+    }
+#endif
+    return cpus;
+}
+
+/*!
+ * \brief CpuAffinity::numaNodes
+ * Returns the processors of every NUMA node, ordered by the node number. Only processors the calling
+ * thread is allowed to use are included, nodes without such processors are left out. Systems without
+ * NUMA information are reported as one node.
+ */
+std::vector<std::vector<int> > CpuAffinity::numaNodes()
+{
+    std::vector<std::vector<int> > nodes;
+    const std::vector<int> allowed = allowedCpus();
+    if (allowed.empty())
+        return nodes;
+
+    std::vector<std::pair<int, std::vector<int> > > found;
+    boost::system::error_code err;
+    for (fs::directory_iterator it("/sys/devices/system/node", err), end; !err && it != end; it.increment(err)) {
+        const std::string name = it->path().filename().string();
+        if (name.compare(0, 4, "node") != 0 || name.size() == 4
+                || !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+            continue;
+
+        std::ifstream in((it->path() / "cpulist").string());
+        std::string list;
+        if (!std::getline(in, list))
+            continue;
+
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(list)) {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu))
+                cpus.push_back(cpu);
+        }
+        if (!cpus.empty())
+            found.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+    }
+
+    std::sort(found.begin(), found.end());
+    for (auto &node : found)
+        nodes.push_back(std::move(node.second));
+
+    if (nodes.empty())
+        nodes.push_back(allowed);
+    return nodes;
+}
+
+/*!
+ * \brief CpuAffinity::workerCpus
+ * Returns the processors each of \a workers threads should be pinned to for \a affinity.
+ * Workers are assigned round robin, so consecutive workers end up on different nodes.
+ * A empty list means the worker is not pinned, which is always the case for \sa WorkerAffinity::None
+ * and on systems that do not support pinning.
+ */
+std::vector<std::vector<int> > CpuAffinity::workerCpus(WorkerAffinity affinity, size_t workers)
+{
+    std::vector<std::vector<int> > result(workers);
+    if (affinity == WorkerAffinity::None)
+        return result;
+
+    std::vector<std::vector<int> > groups;
+    if (affinity == WorkerAffinity::NumaNodes) {
+        groups = numaNodes();
+    } else {
+        for (int cpu : allowedCpus())
+            groups.push_back(std::vector<int>{cpu});
+    }
+
+    if (groups.empty())
+        return result;
+    for (size_t i = 0; i < workers; i++)
+        result[i] = groups[i % groups.size()];
+    return result;
+}
+
+/*!
+ * \brief CpuAffinity::pinCurrentThread
+ * Restricts the calling thread to the processors in \a cpus.
+ * Returns false if \a cpus is empty, pinning is not supported or the system refused it.
+ */
+bool CpuAffinity::pinCurrentThread(const std::vector<int> &cpus)
+{
+#ifdef ATLASPACK_HAVE_AFFINITY
+    if (cpus.empty())
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    UNUSED(cpus);
+    return false;
+#endif
+}
+
+}
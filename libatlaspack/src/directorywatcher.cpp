@@ -0,0 +1,352 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/DirectoryWatcher>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <set>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace AtlasPack {
+
+class DirectoryWatcherPrivate {
+    public:
+        std::string m_directory;
+        bool m_recursive = false;
+        bool m_valid = false;
+        std::atomic_bool m_stop{false};
+
+#ifdef __linux__
+        bool addWatch (const fs::path &dir, std::set<std::string> *changes = nullptr);
+        bool readEvents (std::set<std::string> &changes, std::string *error);
+
+        int m_inotify = -1;
+        int m_stopPipe[2] = {-1, -1};
+        std::map<int, fs::path> m_watches;
+#else
+        using Snapshot = std::map<std::string, std::pair<std::time_t, uintmax_t> >;
+        Snapshot scan () const;
+        Snapshot m_snapshot;
+#endif
+};
+
+#ifdef __linux__
+
+static const uint32_t WatchEvents = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF;
+
+/**
+ * @internal
+ * @brief DirectoryWatcherPrivate::addWatch
+ * Watches \a dir and, if the watcher is recursive, all its subdirectories.
+ * If \a changes is set, all files found in the subdirectories are added to it,
+ * which is required for directories that are created or moved into the tree.
+ */
+bool DirectoryWatcherPrivate::addWatch(const fs::path &dir, std::set<std::string> *changes)
+{
+    int wd = inotify_add_watch(m_inotify, dir.string().c_str(), WatchEvents);
+    if (wd < 0) {
+        std::cerr << "Could not watch "<<dir.string()<<" "<<strerror(errno)<<std::endl;
+        return false;
+    }
+    m_watches[wd] = dir;
+
+    if (!m_recursive && !changes)
+        return true;
+
+    boost::system::error_code err;
+    for (fs::directory_iterator it(dir, err), end; !err && it != end; it.increment(err)) {
+        if (fs::is_directory(it->path(), err)) {
+            if (m_recursive)
+                addWatch(it->path(), changes);
+        } else if (changes) {
+            changes->insert(it->path().string());
+        }
+    }
+    return true;
+}
+
+/**
+ * @internal
+ * @brief DirectoryWatcherPrivate::readEvents
+ * Reads all pending inotify events and adds the affected files to \a changes
+ */
+bool DirectoryWatcherPrivate::readEvents(std::set<std::string> &changes, std::string *error)
+{
+    alignas(struct inotify_event) char buffer[16 * 1024];
+
+    while (true) {
+        ssize_t len = read(m_inotify, buffer, sizeof(buffer));
+        if (len < 0) {
+            if (errno == EAGAIN)
+                return true;
+            if (errno == EINTR)
+                continue;
+            if (error) *error = std::string("Failed to read file system events: ") + strerror(errno);
+            return false;
+        }
+
+        for (char *ptr = buffer; ptr < buffer + len; ) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                //events were lost, report every known directory so the caller rescans them
+                std::cerr << "File system event queue overflowed, rescanning the input directory"<<std::endl;
+                for (const auto &watch : m_watches)
+                    changes.insert(watch.second.string());
+                continue;
+            }
+
+            auto watch = m_watches.find(event->wd);
+            if (watch == m_watches.end())
+                continue;
+
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF)) {
+                m_watches.erase(watch);
+                continue;
+            }
+
+            if (!event->len)
+                continue;
+
+            fs::path path = watch->second / event->name;
+            if (event->mask & IN_ISDIR) {
+                //new directories are watched as well, files inside them count as changed
+                if (m_recursive && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                    addWatch(path, &changes);
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                    changes.insert(path.string());
+                continue;
+            }
+
+            //a created file is reported once it was closed after writing
+            if (event->mask & IN_CREATE)
+                continue;
+
+            changes.insert(path.string());
+        }
+    }
+}
+
+#else
+
+/**
+ * @internal
+ * @brief DirectoryWatcherPrivate::scan
+ * Collects modification time and size of all files in the watched tree,
+ * used on platforms without inotify.
+ */
+DirectoryWatcherPrivate::Snapshot DirectoryWatcherPrivate::scan() const
+{
+    Snapshot result;
+    boost::system::error_code err;
+
+    auto addEntry = [&result](const fs::path &path) {
+        boost::system::error_code err;
+        if (!fs::is_regular_file(path, err))
+            return;
+        result[path.string()] = std::make_pair(fs::last_write_time(path, err), fs::file_size(path, err));
+    };
+
+    if (m_recursive) {
+        for (fs::recursive_directory_iterator it(m_directory, err), end; !err && it != end; it.increment(err))
+            addEntry(it->path());
+    } else {
+        for (fs::directory_iterator it(m_directory, err), end; !err && it != end; it.increment(err))
+            addEntry(it->path());
+    }
+    return result;
+}
+
+#endif
+
+/**
+ * \class AtlasPack::DirectoryWatcher
+ * Watches \a directory for files that are written, created, moved or deleted. If \a recursive
+ * is true, all subdirectories are watched as well, including the ones created later on.
+ * On Linux inotify is used, on other platforms the directory tree is scanned periodically.
+ */
+DirectoryWatcher::DirectoryWatcher(const std::string &directory, bool recursive)
+    : p(new DirectoryWatcherPrivate)
+{
+    p->m_directory = directory;
+    p->m_recursive = recursive;
+
+#ifdef __linux__
+    p->m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (p->m_inotify < 0) {
+        std::cerr << "Could not initialize inotify "<<strerror(errno)<<std::endl;
+        return;
+    }
+    if (pipe2(p->m_stopPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        std::cerr << "Could not create the wakeup pipe "<<strerror(errno)<<std::endl;
+        return;
+    }
+    p->m_valid = p->addWatch(directory);
+#else
+    boost::system::error_code err;
+    p->m_valid = fs::is_directory(directory, err);
+    if (p->m_valid)
+        p->m_snapshot = p->scan();
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+#ifdef __linux__
+    if (p->m_inotify >= 0)
+        close(p->m_inotify);
+    for (int fd : p->m_stopPipe) {
+        if (fd >= 0)
+            close(fd);
+    }
+#endif
+    if (p) delete p;
+}
+
+/*!
+ * \brief DirectoryWatcher::isValid
+ * Returns \a true if the directory could be watched
+ */
+bool DirectoryWatcher::isValid() const
+{
+    return p->m_valid;
+}
+
+std::string DirectoryWatcher::directory() const
+{
+    return p->m_directory;
+}
+
+/*!
+ * \brief DirectoryWatcher::waitForChanges
+ * Blocks until files in the watched tree change and returns their paths, sorted and without
+ * duplicates. After the first change the function waits until no further changes happened for
+ * \a debounceMs milliseconds, so saving a file or copying many files results in a single call.
+ * Returned paths can refer to files that do not exist anymore, or to directories that were removed.
+ * Returns a empty list if \sa DirectoryWatcher::stop was called or an error occurred, in which case
+ * \a error is set.
+ */
+std::vector<std::string> DirectoryWatcher::waitForChanges(unsigned int debounceMs, std::string *error)
+{
+    std::set<std::string> changes;
+    if (!p->m_valid) {
+        if (error) *error = "Directory " + p->m_directory + " is not watched";
+        return std::vector<std::string>();
+    }
+
+#ifdef __linux__
+    int timeout = -1;
+    while (!p->m_stop.load()) {
+        struct pollfd fds[2] = {
+            { p->m_inotify, POLLIN, 0 },
+            { p->m_stopPipe[0], POLLIN, 0 }
+        };
+
+        int ready = poll(fds, 2, timeout);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            if (error) *error = std::string("Failed to wait for file system events: ") + strerror(errno);
+            return std::vector<std::string>();
+        }
+
+        //nothing happened during the debounce interval
+        if (ready == 0)
+            break;
+
+        if (fds[1].revents & POLLIN)
+            break;
+
+        if (!p->readEvents(changes, error))
+            return std::vector<std::string>();
+
+        if (!changes.empty())
+            timeout = static_cast<int>(debounceMs);
+    }
+#else
+    bool changed = false;
+    while (!p->m_stop.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::max(debounceMs, 10u)));
+
+        DirectoryWatcherPrivate::Snapshot current = p->scan();
+        size_t known = changes.size();
+        for (const auto &entry : current) {
+            auto old = p->m_snapshot.find(entry.first);
+            if (old == p->m_snapshot.end() || old->second != entry.second)
+                changes.insert(entry.first);
+        }
+        for (const auto &entry : p->m_snapshot) {
+            if (!current.count(entry.first))
+                changes.insert(entry.first);
+        }
+        p->m_snapshot = std::move(current);
+
+        //stop once a scan does not find anything new
+        if (changed && changes.size() == known)
+            break;
+        changed = !changes.empty();
+    }
+#endif
+
+    if (p->m_stop.load())
+        return std::vector<std::string>();
+    return std::vector<std::string>(changes.begin(), changes.end());
+}
+
+/*!
+ * \brief DirectoryWatcher::stop
+ * Wakes up \sa DirectoryWatcher::waitForChanges, can be called from any thread.
+ * The watcher can not be used anymore afterwards.
+ */
+void DirectoryWatcher::stop()
+{
+    p->m_stop.store(true);
+#ifdef __linux__
+    if (p->m_stopPipe[1] >= 0) {
+        char c = 0;
+        ssize_t written = write(p->m_stopPipe[1], &c, 1);
+        UNUSED(written);
+    }
+#endif
+}
+
+}
@@ -0,0 +1,687 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <AtlasPack/FilePrefetcher>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#include <linux/io_uring.h>
+#define ATLASPACK_HAVE_IO_URING
+#endif
+#endif
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace AtlasPack {
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs (Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/**
+ * @internal
+ * Reads the whole file \a path into \a data with a blocking call
+ */
+static bool readFile (const std::string &path, FileData *data, std::string *error)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        if (error) *error = "Could not open " + path;
+        return false;
+    }
+
+    const std::streamoff size = in.tellg();
+    data->resize(size > 0 ? static_cast<size_t>(size) : 0);
+    in.seekg(0);
+    if (!data->empty() && !in.read(reinterpret_cast<char *>(data->data()), data->size())) {
+        if (error) *error = "Could not read " + path;
+        return false;
+    }
+    return true;
+}
+
+enum class EntryState {
+    Pending,    //!< queued, no reader started it yet
+    Reading,
+    Done,
+    Failed
+};
+
+/**
+ * @internal
+ * One file that is read ahead
+ */
+struct PrefetchEntry {
+    std::string path;
+    EntryState state = EntryState::Pending;
+    bool wanted = false;        //somebody waits for the file, it may exceed the window
+    size_t reserved = 0;        //bytes of the window taken by the file
+    std::shared_ptr<FileData> data;
+    std::string error;
+
+#ifdef ATLASPACK_HAVE_IO_URING
+    int fd = -1;
+    size_t offset = 0;
+    iovec iov;
+#endif
+};
+
+using EntryPtr = std::shared_ptr<PrefetchEntry>;
+
+#ifdef ATLASPACK_HAVE_IO_URING
+/**
+ * @internal
+ * Minimal io_uring submission and completion rings, set up with the raw
+ * system calls so no liburing is needed.
+ */
+class IoRing {
+    public:
+        ~IoRing ();
+
+        bool setup (unsigned entries);
+        bool isValid () const { return m_fd >= 0; }
+        unsigned entries () const { return m_entries; }
+
+        void queueRead (int fd, iovec *iov, size_t offset, void *userData);
+        bool submitAndWait (unsigned minComplete);
+
+        template <typename Fun> void reap (Fun fun);
+        template <typename Fun> size_t dropUnsubmitted (Fun fun);
+
+    private:
+        int m_fd = -1;
+        unsigned m_entries = 0;
+        unsigned m_toSubmit = 0;
+
+        void  *m_sqRing = nullptr;
+        void  *m_cqRing = nullptr;
+        size_t m_sqRingSize = 0;
+        size_t m_cqRingSize = 0;
+        io_uring_sqe *m_sqes = nullptr;
+        size_t m_sqesSize = 0;
+
+        unsigned *m_sqTail = nullptr;
+        unsigned *m_sqMask = nullptr;
+        unsigned *m_sqArray = nullptr;
+        unsigned *m_cqHead = nullptr;
+        unsigned *m_cqTail = nullptr;
+        unsigned *m_cqMask = nullptr;
+        io_uring_cqe *m_cqes = nullptr;
+};
+
+IoRing::~IoRing()
+{
+    if (m_sqes)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRing && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing)
+        munmap(m_sqRing, m_sqRingSize);
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+bool IoRing::setup(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    //fails with ENOSYS on old kernels and EPERM where io_uring is disabled
+    m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (m_fd < 0)
+        return false;
+
+    m_entries = params.sq_entries;
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+    auto mapRing = [this](size_t size, off_t offset) -> void * {
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    };
+
+    m_sqRing = mapRing(m_sqRingSize, IORING_OFF_SQ_RING);
+    m_cqRing = singleMmap ? m_sqRing : mapRing(m_cqRingSize, IORING_OFF_CQ_RING);
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = static_cast<io_uring_sqe *>(mapRing(m_sqesSize, IORING_OFF_SQES));
+    if (!m_sqRing || !m_cqRing || !m_sqes)
+        return false;
+
+    char *sq = static_cast<char *>(m_sqRing);
+    m_sqTail  = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_sqMask  = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    char *cq = static_cast<char *>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_cqes   = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+/*
+ * Puts a read of \a iov from \a fd at \a offset into the submission ring,
+ * it is handed to the kernel by the next \sa IoRing::submitAndWait call.
+ * The caller has to make sure the ring has a free slot.
+ */
+void IoRing::queueRead(int fd, iovec *iov, size_t offset, void *userData)
+{
+    const unsigned tail = *m_sqTail;
+    const unsigned index = tail & *m_sqMask;
+
+    io_uring_sqe *sqe = &m_sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = reinterpret_cast<uint64_t>(userData);
+
+    m_sqArray[index] = index;
+    //the kernel may only see the new tail after the entry is written
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+    m_toSubmit++;
+}
+
+bool IoRing::submitAndWait(unsigned minComplete)
+{
+    for (;;) {
+        long res = syscall(__NR_io_uring_enter, m_fd, m_toSubmit, minComplete,
+                           minComplete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (res >= 0) {
+            m_toSubmit -= std::min<unsigned>(m_toSubmit, static_cast<unsigned>(res));
+            if (m_toSubmit == 0)
+                return true;
+            continue;
+        }
+        if (errno != EINTR)
+            return false;
+    }
+}
+
+/*
+ * Calls \a fun with the user data and result of every finished request
+ */
+template <typename Fun>
+void IoRing::reap(Fun fun)
+{
+    unsigned head = *m_cqHead;
+    const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const io_uring_cqe &cqe = m_cqes[head & *m_cqMask];
+        fun(reinterpret_cast<void *>(cqe.user_data), cqe.res);
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Takes the reads the kernel did not accept yet back out of the submission ring, calls \a fun
+ * with the user data of each one and returns their number. The kernel only reads the ring in
+ * io_uring_enter, so it never sees them.
+ */
+template <typename Fun>
+size_t IoRing::dropUnsubmitted(Fun fun)
+{
+    const size_t dropped = m_toSubmit;
+    unsigned tail = *m_sqTail;
+    for (; m_toSubmit > 0; m_toSubmit--) {
+        tail--;
+        fun(reinterpret_cast<void *>(m_sqes[m_sqArray[tail & *m_sqMask]].user_data));
+    }
+    __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+    return dropped;
+}
+#endif
+
+class FilePrefetcherPrivate {
+    public:
+        FilePrefetcherPrivate (size_t window) : m_window(window) {}
+
+        bool waitForWindow (std::unique_lock<std::mutex> &lk, const EntryPtr &entry, size_t bytes);
+        bool canReserve (const PrefetchEntry &entry, size_t bytes) const;
+        void reserve (PrefetchEntry &entry, size_t bytes);
+        void finish (const EntryPtr &entry, bool success);
+
+        void readerMain ();
+#ifdef ATLASPACK_HAVE_IO_URING
+        bool startRead (const EntryPtr &entry, size_t *size);
+        void ringMain ();
+
+        //buffers of reads the kernel may still write to, they have to outlive the ring
+        std::vector<std::shared_ptr<FileData> > m_abandoned;
+        IoRing m_ring;
+#endif
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_changed;  //notified whenever a entry changes its state or the window gets free
+        std::deque<EntryPtr> m_pending;
+        std::unordered_map<std::string, EntryPtr> m_entries;    //all files that were not taken yet
+        size_t m_window = 0;
+        size_t m_used = 0;
+        bool m_stop = false;
+        std::vector<std::thread> m_threads;
+        PrefetchStats m_stats;
+};
+
+/*
+ * A file may be read if it fits into the free window. If the window is empty or somebody waits
+ * for the file it is read anyway, files bigger than the window would never be read otherwise.
+ */
+bool FilePrefetcherPrivate::canReserve(const PrefetchEntry &entry, size_t bytes) const
+{
+    return entry.wanted || m_used == 0 || m_used + bytes <= m_window;
+}
+
+void FilePrefetcherPrivate::reserve(PrefetchEntry &entry, size_t bytes)
+{
+    entry.reserved = bytes;
+    m_used += bytes;
+}
+
+/*
+ * Blocks until \a bytes of the window can be taken for \a entry, must be called with m_mutex locked.
+ * Returns false if the prefetcher is shutting down.
+ */
+bool FilePrefetcherPrivate::waitForWindow(std::unique_lock<std::mutex> &lk, const EntryPtr &entry, size_t bytes)
+{
+    m_changed.wait(lk, [this, &entry, bytes]() { return m_stop || canReserve(*entry, bytes); });
+    if (m_stop)
+        return false;
+    reserve(*entry, bytes);
+    return true;
+}
+
+void FilePrefetcherPrivate::finish(const EntryPtr &entry, bool success)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        entry->state = success ? EntryState::Done : EntryState::Failed;
+        m_stats.files++;
+        if (success)
+            m_stats.bytes += entry->data->size();
+        else
+            m_stats.failed++;
+    }
+    m_changed.notify_all();
+}
+
+/*
+ * Worker of the fallback thread pool, reads one file after the other with blocking calls
+ */
+void FilePrefetcherPrivate::readerMain()
+{
+    for (;;) {
+        EntryPtr entry;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_changed.wait(lk, [this]() { return m_stop || !m_pending.empty(); });
+            if (m_stop)
+                return;
+            entry = m_pending.front();
+            m_pending.pop_front();
+            entry->state = EntryState::Reading;
+        }
+
+        boost::system::error_code err;
+        const uintmax_t size = fs::file_size(entry->path, err);
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            if (!waitForWindow(lk, entry, err ? 0 : static_cast<size_t>(size)))
+                return;
+        }
+
+        entry->data = std::make_shared<FileData>();
+        finish(entry, readFile(entry->path, entry->data.get(), &entry->error));
+    }
+}
+
+#ifdef ATLASPACK_HAVE_IO_URING
+/*
+ * Opens the file of \a entry and prepares its buffer, returns the file size in \a size.
+ * Returns false and sets the error of \a entry if the file can not be opened.
+ */
+bool FilePrefetcherPrivate::startRead(const EntryPtr &entry, size_t *size)
+{
+    entry->data = std::make_shared<FileData>();
+    entry->fd = open(entry->path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    struct stat info;
+    if (entry->fd < 0 || fstat(entry->fd, &info) != 0) {
+        entry->error = "Could not open " + entry->path;
+        return false;
+    }
+
+    *size = static_cast<size_t>(info.st_size);
+    entry->data->resize(*size);
+    return true;
+}
+
+/*
+ * Drives the io_uring, keeps as many reads in flight as the ring has entries
+ * and the window allows
+ */
+void FilePrefetcherPrivate::ringMain()
+{
+    std::unordered_map<PrefetchEntry *, EntryPtr> inFlight;
+    EntryPtr parked;        //opened, but waiting for room in the window
+    size_t parkedSize = 0;
+
+    auto submit = [this, &inFlight](const EntryPtr &entry) {
+        entry->iov.iov_base = entry->data->data() + entry->offset;
+        entry->iov.iov_len  = entry->data->size() - entry->offset;
+        m_ring.queueRead(entry->fd, &entry->iov, entry->offset, entry.get());
+        inFlight[entry.get()] = entry;
+    };
+
+    auto complete = [this](const EntryPtr &entry, bool success) {
+        if (entry->fd >= 0)
+            close(entry->fd);
+        entry->fd = -1;
+        finish(entry, success);
+    };
+
+    for (;;) {
+        //start new reads while the ring has room
+        while (inFlight.size() < m_ring.entries()) {
+            EntryPtr entry;
+            size_t size = 0;
+            {
+                std::unique_lock<std::mutex> lk(m_mutex);
+                if (inFlight.empty()) {
+                    m_changed.wait(lk, [this, &parked, parkedSize]() {
+                        if (m_stop)
+                            return true;
+                        return parked ? canReserve(*parked, parkedSize) : !m_pending.empty();
+                    });
+                }
+                if (m_stop)
+                    break;
+
+                if (parked) {
+                    if (!canReserve(*parked, parkedSize))
+                        break;
+                    reserve(*parked, parkedSize);
+                    entry = std::move(parked);
+                    size = parkedSize;
+                } else if (!m_pending.empty()) {
+                    entry = m_pending.front();
+                    m_pending.pop_front();
+                    entry->state = EntryState::Reading;
+                } else {
+                    break;
+                }
+            }
+
+            if (!entry->reserved && entry->fd < 0) {
+                if (!startRead(entry, &size)) {
+                    complete(entry, false);
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lk(m_mutex);
+                if (!canReserve(*entry, size)) {
+                    parked = entry;
+                    parkedSize = size;
+                    break;
+                }
+                reserve(*entry, size);
+            }
+
+            if (size == 0)
+                complete(entry, true);
+            else
+                submit(entry);
+        }
+
+        bool stopping = false;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            stopping = m_stop;
+        }
+        if (inFlight.empty()) {
+            if (stopping)
+                break;
+            continue;
+        }
+
+        //a failing io_uring_enter leaves the new reads unsubmitted, read them with blocking calls instead.
+        //Reads the kernel accepted earlier are still waited for with the next call.
+        if (!m_ring.submitAndWait(1)) {
+            auto fallback = [&](void *userData) {
+                auto it = inFlight.find(static_cast<PrefetchEntry *>(userData));
+                if (it == inFlight.end())
+                    return;
+                EntryPtr entry = it->second;
+                inFlight.erase(it);
+                complete(entry, readFile(entry->path, entry->data.get(), &entry->error));
+            };
+            if (m_ring.dropUnsubmitted(fallback))
+                continue;
+
+            //not even waiting works, the kernel might still write into the buffers of the accepted
+            //reads, so they are kept alive and the files are read into new ones
+            for (auto &running : inFlight) {
+                EntryPtr entry = running.second;
+                m_abandoned.push_back(entry->data);
+                entry->data = std::make_shared<FileData>();
+                complete(entry, readFile(entry->path, entry->data.get(), &entry->error));
+            }
+            inFlight.clear();
+            continue;
+        }
+
+        m_ring.reap([&](void *userData, int res) {
+            auto it = inFlight.find(static_cast<PrefetchEntry *>(userData));
+            if (it == inFlight.end())
+                return;
+            EntryPtr entry = it->second;
+            inFlight.erase(it);
+
+            if (res == -EAGAIN || res == -EINTR) {
+                submit(entry);
+            } else if (res < 0) {
+                //the kernel might not support the read operation, the blocking read reports real errors
+                complete(entry, readFile(entry->path, entry->data.get(), &entry->error));
+            } else if (res == 0) {
+                //the file was truncated while reading
+                entry->data->resize(entry->offset);
+                complete(entry, true);
+            } else {
+                entry->offset += static_cast<size_t>(res);
+                if (entry->offset < entry->data->size())
+                    submit(entry);
+                else
+                    complete(entry, true);
+            }
+        });
+    }
+
+    if (parked)
+        complete(parked, false);
+}
+#endif
+
+/*!
+ * \class AtlasPack::FilePrefetcher
+ * Reads files into memory ahead of the tasks that decode them, so the decoding workers do not
+ * wait for storage. This helps most with cold caches and network filesystems.
+ *
+ * Files are read in the order they are passed to \sa FilePrefetcher::prefetch. On Linux the reads
+ * are queued to the kernel with io_uring from a single thread, where io_uring is not available
+ * \a ioThreads threads read the files with blocking calls. At most \a windowBytes are held for
+ * files that were not taken yet, a file that does not fit waits until earlier files are taken.
+ */
+FilePrefetcher::FilePrefetcher(size_t windowBytes, size_t ioThreads)
+    : p(new FilePrefetcherPrivate(windowBytes))
+{
+    p->m_stats.windowBytes = windowBytes;
+
+#ifdef ATLASPACK_HAVE_IO_URING
+    if (p->m_ring.setup(32)) {
+        p->m_stats.ioUring = true;
+        p->m_threads.emplace_back(&FilePrefetcherPrivate::ringMain, p);
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < std::max<size_t>(1, ioThreads); i++)
+        p->m_threads.emplace_back(&FilePrefetcherPrivate::readerMain, p);
+}
+
+/*!
+ * \brief FilePrefetcher::~FilePrefetcher
+ * Waits for the reads that are in flight, files that were not started are dropped.
+ */
+FilePrefetcher::~FilePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lk(p->m_mutex);
+        p->m_stop = true;
+    }
+    p->m_changed.notify_all();
+    for (std::thread &thread : p->m_threads)
+        thread.join();
+
+    if (p) delete p;
+}
+
+/*!
+ * \brief FilePrefetcher::usesIoUring
+ * Returns true if the files are read with io_uring, false if the fallback threads read them.
+ */
+bool FilePrefetcher::usesIoUring() const
+{
+    return p->m_stats.ioUring;
+}
+
+size_t FilePrefetcher::window() const
+{
+    return p->m_window;
+}
+
+/*!
+ * \brief FilePrefetcher::prefetch
+ * Queues the file \a path to be read, files that are already queued are ignored.
+ */
+void FilePrefetcher::prefetch(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lk(p->m_mutex);
+        if (p->m_entries.count(path))
+            return;
+
+        EntryPtr entry = std::make_shared<PrefetchEntry>();
+        entry->path = path;
+        p->m_entries[path] = entry;
+        p->m_pending.push_back(entry);
+    }
+    p->m_changed.notify_all();
+}
+
+/*!
+ * \brief FilePrefetcher::take
+ * Returns the content of the file \a path and frees its part of the window. Waits if the file is
+ * still being read, files that were not queued or not started yet are read by the calling thread.
+ * Every queued file can only be taken once. Returns nullptr and sets \a error if the file can not be read.
+ */
+std::shared_ptr<const FileData> FilePrefetcher::take(const std::string &path, std::string *error)
+{
+    std::unique_lock<std::mutex> lk(p->m_mutex);
+
+    auto it = p->m_entries.find(path);
+    if (it == p->m_entries.end() || it->second->state == EntryState::Pending) {
+        if (it != p->m_entries.end()) {
+            p->m_pending.erase(std::find(p->m_pending.begin(), p->m_pending.end(), it->second));
+            p->m_entries.erase(it);
+        }
+        p->m_stats.direct++;
+        lk.unlock();
+
+        std::shared_ptr<FileData> data = std::make_shared<FileData>();
+        if (!readFile(path, data.get(), error))
+            return nullptr;
+        return data;
+    }
+
+    EntryPtr entry = it->second;
+    p->m_entries.erase(it);
+
+    if (entry->state == EntryState::Reading) {
+        auto waitStart = Clock::now();
+        entry->wanted = true;
+        p->m_changed.notify_all();
+        p->m_changed.wait(lk, [&entry]() { return entry->state != EntryState::Reading; });
+
+        p->m_stats.waited++;
+        p->m_stats.waitMs += elapsedMs(waitStart);
+    } else {
+        p->m_stats.ready++;
+    }
+
+    p->m_used -= entry->reserved;
+    entry->reserved = 0;
+    lk.unlock();
+    p->m_changed.notify_all();
+
+    if (entry->state == EntryState::Failed) {
+        if (error) *error = entry->error;
+        return nullptr;
+    }
+    return entry->data;
+}
+
+PrefetchStats FilePrefetcher::stats() const
+{
+    std::lock_guard<std::mutex> lk(p->m_mutex);
+    return p->m_stats;
+}
+
+}
@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <AtlasPack/filestamp_p.h>
+
+#if defined(__linux__)
+#define ATLASPACK_HAVE_NSEC_STAT
+#include <sys/stat.h>
+#else
+#include <boost/filesystem.hpp>
+#endif
+
+namespace AtlasPack {
+
+/**
+ * @internal
+ * Reads the stamp of the file \a path into \a stamp, returns false if the file
+ * does not exist or can not be accessed. Systems without nanosecond file times
+ * fall back to the modification time in seconds and the file size.
+ */
+bool readFileStamp (const std::string &path, FileStamp *stamp)
+{
+    *stamp = FileStamp();
+
+#ifdef ATLASPACK_HAVE_NSEC_STAT
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0)
+        return false;
+
+    stamp->modifiedSec  = info.st_mtim.tv_sec;
+    stamp->modifiedNsec = info.st_mtim.tv_nsec;
+    stamp->changedSec   = info.st_ctim.tv_sec;
+    stamp->changedNsec  = info.st_ctim.tv_nsec;
+    stamp->inode = info.st_ino;
+    stamp->size  = static_cast<uint64_t>(info.st_size);
+    return true;
+#else
+    boost::system::error_code err;
+    stamp->modifiedSec = boost::filesystem::last_write_time(path, err);
+    if (err)
+        return false;
+    stamp->size = boost::filesystem::file_size(path, err);
+    return !err;
+#endif
+}
+
+}
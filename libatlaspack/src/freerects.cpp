@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/freerects_p.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ATLASPACK_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace AtlasPack {
+
+/**
+ * @internal
+ * Scalar version of the fit scan, starting at \a first. \a best and \a bestArea
+ * contain the best result found before.
+ */
+template <typename Coord>
+static size_t scanSmallestFit (const Coord *widths, const Coord *heights, size_t first, size_t count,
+                               Coord width, Coord height, size_t best, uint64_t bestArea)
+{
+    for (size_t i = first; i < count; i++) {
+        if (widths[i] < width || heights[i] < height)
+            continue;
+
+        const uint64_t area = static_cast<uint64_t>(widths[i]) * heights[i];
+        if (area < bestArea) {
+            best = i;
+            bestArea = area;
+        }
+    }
+    return best;
+}
+
+size_t findSmallestFit(const uint16_t *widths, const uint16_t *heights, size_t count, uint16_t width, uint16_t height)
+{
+    size_t i = 0;
+    size_t best = count;
+    uint64_t bestArea = std::numeric_limits<uint64_t>::max();
+
+#ifdef ATLASPACK_HAVE_SSE2
+    //the areas are unsigned 32 bit values, SSE2 only compares signed ones,
+    //so the sign bit is flipped before comparing
+    const __m128i bias  = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const __m128i cellW = _mm_set1_epi16(static_cast<short>(width));
+    const __m128i cellH = _mm_set1_epi16(static_cast<short>(height));
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i step  = _mm_set1_epi32(8);
+
+    //every lane keeps the smallest area it has seen and the first index it was found at
+    __m128i laneArea = _mm_set1_epi32(0x7FFFFFFF);
+    __m128i laneIdx  = _mm_set1_epi32(-1);
+    __m128i idxLo    = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i idxHi    = _mm_setr_epi32(4, 5, 6, 7);
+
+    //test 8 rectangles at once
+    for (; i + 8 <= count; i += 8) {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i *>(widths + i));
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(heights + i));
+
+        //the saturated difference is 0 where the rectangle is big enough
+        __m128i tooSmall = _mm_or_si128(_mm_subs_epu16(cellW, w), _mm_subs_epu16(cellH, h));
+        __m128i misfit   = _mm_xor_si128(_mm_cmpeq_epi16(tooSmall, zero), _mm_set1_epi16(-1));
+
+        if (_mm_movemask_epi8(misfit) != 0xFFFF) {
+            //full 32 bit areas from the low and high halfs of the 16 bit products,
+            //rectangles that are too small get the biggest possible area
+            __m128i lo = _mm_mullo_epi16(w, h);
+            __m128i hi = _mm_mulhi_epu16(w, h);
+            __m128i areaLo = _mm_or_si128(_mm_unpacklo_epi16(lo, hi), _mm_unpacklo_epi16(misfit, misfit));
+            __m128i areaHi = _mm_or_si128(_mm_unpackhi_epi16(lo, hi), _mm_unpackhi_epi16(misfit, misfit));
+            areaLo = _mm_xor_si128(areaLo, bias);
+            areaHi = _mm_xor_si128(areaHi, bias);
+
+            __m128i better = _mm_cmplt_epi32(areaLo, laneArea);
+            laneArea = _mm_or_si128(_mm_and_si128(better, areaLo), _mm_andnot_si128(better, laneArea));
+            laneIdx  = _mm_or_si128(_mm_and_si128(better, idxLo), _mm_andnot_si128(better, laneIdx));
+
+            better   = _mm_cmplt_epi32(areaHi, laneArea);
+            laneArea = _mm_or_si128(_mm_and_si128(better, areaHi), _mm_andnot_si128(better, laneArea));
+            laneIdx  = _mm_or_si128(_mm_and_si128(better, idxHi), _mm_andnot_si128(better, laneIdx));
+        }
+
+        idxLo = _mm_add_epi32(idxLo, step);
+        idxHi = _mm_add_epi32(idxHi, step);
+    }
+
+    //pick the smallest area of all lanes, the lowest index on ties
+    int32_t areas[4], indices[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(areas), laneArea);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(indices), laneIdx);
+    for (int lane = 0; lane < 4; lane++) {
+        if (indices[lane] < 0)
+            continue;
+
+        const uint64_t area = static_cast<uint32_t>(areas[lane]) ^ 0x80000000u;
+        if (area < bestArea || (area == bestArea && static_cast<size_t>(indices[lane]) < best)) {
+            best = static_cast<size_t>(indices[lane]);
+            bestArea = area;
+        }
+    }
+#endif
+
+    return scanSmallestFit(widths, heights, i, count, width, height, best, bestArea);
+}
+
+size_t findSmallestFit(const uint32_t *widths, const uint32_t *heights, size_t count, uint32_t width, uint32_t height)
+{
+    //32 bit areas do not fit into SSE2 lanes, these lists are only used for huge atlases
+    return scanSmallestFit(widths, heights, 0, count, width, height, count, std::numeric_limits<uint64_t>::max());
+}
+
+}
@@ -0,0 +1,388 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/HierarchicalPacker>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace AtlasPack {
+
+using PackerPtr = std::shared_ptr<TextureAtlasPacker>;
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs (Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+class HierarchicalPackerPrivate {
+    public:
+        HierarchicalPackerPrivate (size_t threads)
+            : m_ownJobs(new JobQueue<bool>(threads)), m_jobs(m_ownJobs.get()) {}
+        HierarchicalPackerPrivate (JobQueue<bool> *jobs)
+            : m_jobs(jobs) {}
+
+        size_t align (size_t value) const;
+        PackerPtr tryPack (const Size &size, const std::vector<Image> &images) const;
+        PackerPtr packCluster (const std::vector<Image> &images, size_t width) const;
+        PackerPtr combine (const std::vector<PackerPtr> &blocks, Size size, bool square) const;
+
+        std::unique_ptr<JobQueue<bool> > m_ownJobs;
+        JobQueue<bool> *m_jobs = nullptr;
+        size_t m_clusterSize = 1024;
+        size_t m_alignment = 1;
+        PackPolicy m_policy;
+};
+
+/**
+ * @internal
+ * Rounds \a value up to the next multiple of the placement alignment
+ */
+size_t HierarchicalPackerPrivate::align(size_t value) const
+{
+    return (value + m_alignment - 1) / m_alignment * m_alignment;
+}
+
+/**
+ * @internal
+ * @brief HierarchicalPackerPrivate::tryPack
+ * Packs all \a images into a new atlas of \a size, returns a empty pointer if they do not fit.
+ */
+PackerPtr HierarchicalPackerPrivate::tryPack(const Size &size, const std::vector<Image> &images) const
+{
+    PackerPtr result = std::make_shared<TextureAtlasPacker>(size, m_policy);
+    result->setPlacementAlignment(m_alignment);
+    if (!result->insertImages(images))
+        return PackerPtr();
+    return result;
+}
+
+/**
+ * @internal
+ * @brief HierarchicalPackerPrivate::packCluster
+ * Packs the \a images of one cluster into a block of \a width, or of the widest image if that is wider.
+ * The height starts at the area of all cells divided by the width and grows until all images fit,
+ * then the block is cut down to the height the images were placed in, if they still fit into it.
+ * Runs on a single thread, many clusters are packed at the same time.
+ */
+PackerPtr HierarchicalPackerPrivate::packCluster(const std::vector<Image> &images, size_t width) const
+{
+    size_t area = 0;
+    for (const Image &img : images) {
+        const size_t cellWidth = align(img.width());
+        area += cellWidth * align(img.height());
+        width = std::max(width, cellWidth);
+    }
+    width = align(width);
+
+    size_t height = align((area + width - 1) / width);
+    const size_t step = align(std::max<size_t>(1, height / 64));
+
+    PackerPtr block;
+    while (!(block = tryPack(Size(width, height), images)))
+        height += step;
+
+    //images are placed from the top left corner, the unused area at the bottom is cut off
+    //if the images fit into the rest with the same insertion order, the width is kept so
+    //all blocks stack into the same columns
+    size_t used = 0;
+    for (const Placement &placement : block->placements())
+        used = std::max(used, placement.cell.topLeft.y + placement.cell.size.height);
+    if (used != height) {
+        PackerPtr tight = tryPack(Size(width, used), images);
+        if (tight)
+            block = tight;
+    }
+    return block;
+}
+
+/**
+ * @internal
+ * @brief HierarchicalPackerPrivate::combine
+ * Inserts all \a blocks in order into a atlas of \a size and returns it. The height grows until all
+ * blocks fit, if \a square is set the width grows with it. A size is first tried with placeholder
+ * images of the block sizes, which is cheap, and then confirmed by inserting the blocks with
+ * \sa TextureAtlasPacker::insertAtlas, which copies their layouts. If that fails the size keeps growing.
+ * Returns a empty pointer if the blocks do not fit even when stacked on top of each other.
+ */
+PackerPtr HierarchicalPackerPrivate::combine(const std::vector<PackerPtr> &blocks, Size size, bool square) const
+{
+    std::vector<Image> placeholders;
+    placeholders.reserve(blocks.size());
+    size_t stackHeight = 0;
+    size_t maxWidth = 0;
+    for (const PackerPtr &block : blocks) {
+        placeholders.push_back(Image("block", block->size()));
+        stackHeight += block->size().height;
+        maxWidth = std::max(maxWidth, block->size().width);
+    }
+
+    const size_t step = align(std::max<size_t>(1, size.height / 64));
+    for (;;) {
+        if (tryPack(size, placeholders)) {
+            PackerPtr result = std::make_shared<TextureAtlasPacker>(size, m_policy);
+            result->setPlacementAlignment(m_alignment);
+
+            bool inserted = true;
+            for (size_t i = 0; inserted && i < blocks.size(); i++)
+                inserted = result->insertAtlas(*blocks[i]);
+            if (inserted)
+                return result;
+
+            //the blocks always fit on top of each other, a failure there can not be fixed by growing
+            if (size.height >= stackHeight && size.width >= maxWidth)
+                return PackerPtr();
+        }
+
+        size.height += step;
+        if (square)
+            size.width += step;
+    }
+}
+
+/**
+ * @class HierarchicalPacker::HierarchicalPacker
+ * Packs very large numbers of images in two levels. The images are sorted by their height and
+ * split into clusters of about \a clusterSize similar images with the same share of the total area.
+ * Every cluster is packed into a block of the same width, all clusters at the same time. The blocks
+ * are then stacked into columns of about the same height, which are placed next to each other in a
+ * square atlas, \sa TextureAtlasPacker::insertAtlas. Every packing trial only walks the layout of one
+ * cluster, so the packing time grows about linearly with the number of images, while a
+ * \sa AtlasPack::SizeSearch walks the layout of all images for every insert.
+ *
+ * \a threads specifies the number of worker threads, 0 uses one thread per core.
+ */
+HierarchicalPacker::HierarchicalPacker(size_t threads)
+    : p(new HierarchicalPackerPrivate(threads))
+{
+
+}
+
+/*!
+ * \brief HierarchicalPacker::HierarchicalPacker
+ * Creates a packer that runs its trials on the shared \a jobs queue, which
+ * has to outlive the packer.
+ */
+HierarchicalPacker::HierarchicalPacker(JobQueue<bool> *jobs)
+    : p(new HierarchicalPackerPrivate(jobs))
+{
+
+}
+
+HierarchicalPacker::~HierarchicalPacker()
+{
+    if (p) delete p;
+}
+
+/*!
+ * \brief HierarchicalPacker::setClusterSize
+ * Sets how many images are packed into one block, defaults to 1024. Bigger clusters
+ * waste less space at the borders of the blocks, smaller ones are packed faster.
+ */
+void HierarchicalPacker::setClusterSize(size_t images)
+{
+    p->m_clusterSize = images > 0 ? images : 1;
+}
+
+size_t HierarchicalPacker::clusterSize() const
+{
+    return p->m_clusterSize;
+}
+
+/*!
+ * \brief HierarchicalPacker::setPlacementAlignment
+ * Sets the placement alignment of the blocks and the atlas, \sa TextureAtlasPacker::setPlacementAlignment
+ */
+void HierarchicalPacker::setPlacementAlignment(size_t alignment)
+{
+    p->m_alignment = alignment > 0 ? alignment : 1;
+}
+
+size_t HierarchicalPacker::placementAlignment() const
+{
+    return p->m_alignment;
+}
+
+/*!
+ * \brief HierarchicalPacker::setPackPolicy
+ * Sets the split rule and fit heuristic the blocks and the atlas are packed with
+ */
+void HierarchicalPacker::setPackPolicy(const PackPolicy &policy)
+{
+    p->m_policy = policy;
+}
+
+PackPolicy HierarchicalPacker::packPolicy() const
+{
+    return p->m_policy;
+}
+
+/*!
+ * \brief HierarchicalPacker::threadCount
+ * Returns the number of clusters that are packed in parallel
+ */
+unsigned int HierarchicalPacker::threadCount() const
+{
+    return p->m_jobs->maxJobs();
+}
+
+/*!
+ * \brief HierarchicalPacker::run
+ * Packs all \a images and returns the atlas, the returned packer already contains all
+ * images. If \a report is set, the clusters and the time spent in both levels are recorded there.
+ * Returns a empty pointer if \a images is empty.
+ */
+std::shared_ptr<TextureAtlasPacker> HierarchicalPacker::run(const std::vector<Image> &images, HierarchicalReport *report)
+{
+    if (images.empty())
+        return PackerPtr();
+
+    auto runStart = Clock::now();
+    HierarchicalReport localReport;
+    if (!report)
+        report = &localReport;
+    *report = HierarchicalReport();
+
+    //images of similar height end up in the same cluster, which keeps the blocks dense
+    std::vector<Image> sorted(images);
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Image &a, const Image &b) {
+        if (a.height() != b.height())
+            return a.height() > b.height();
+        return a.width() > b.width();
+    });
+
+    //the clusters form a grid of columns and rows in a square atlas, every cluster gets the
+    //same share of the cell area and all blocks the width of a column
+    std::vector<size_t> cellAreas;
+    cellAreas.reserve(sorted.size());
+    for (const Image &img : sorted) {
+        cellAreas.push_back(p->align(img.width()) * p->align(img.height()));
+        report->cellArea += cellAreas.back();
+    }
+
+    const size_t wanted  = (sorted.size() + p->m_clusterSize - 1) / p->m_clusterSize;
+    const size_t columns = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(wanted)))));
+    const size_t rows    = (wanted + columns - 1) / columns;
+    const size_t blockWidth = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(report->cellArea)) / columns));
+    const double clusterArea = static_cast<double>(report->cellArea) / (columns * rows);
+
+    std::vector<size_t> bounds{0};
+    size_t area = 0;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        area += cellAreas[i];
+        if (area >= clusterArea * bounds.size() && i + 1 < sorted.size())
+            bounds.push_back(i + 1);
+    }
+    bounds.push_back(sorted.size());
+
+    const size_t clusterCount = bounds.size() - 1;
+    std::vector<PackerPtr> blocks(clusterCount);
+    std::vector<std::future<bool> > tasks;
+    tasks.reserve(clusterCount);
+
+    auto phaseStart = Clock::now();
+    for (size_t idx = 0; idx < clusterCount; idx++) {
+        tasks.push_back(p->m_jobs->addTask([this, &sorted, &blocks, &bounds, idx, blockWidth]() {
+            blocks[idx] = p->packCluster(std::vector<Image>(sorted.begin() + bounds[idx], sorted.begin() + bounds[idx + 1]),
+                                         blockWidth);
+            return true;
+        }, Trace::isEnabled() ? "pack cluster " + std::to_string(idx) : std::string(), TaskPriority::High));
+    }
+    for (std::future<bool> &task : tasks)
+        task.get();
+    report->clusterMs = elapsedMs(phaseStart);
+
+    //every block goes into the column that is the lowest so far, tallest first
+    std::vector<size_t> tallest(clusterCount);
+    for (size_t idx = 0; idx < clusterCount; idx++) {
+        tallest[idx] = idx;
+        report->blockArea += blocks[idx]->size().width * blocks[idx]->size().height;
+    }
+    std::stable_sort(tallest.begin(), tallest.end(), [&blocks](size_t a, size_t b) {
+        return blocks[a]->size().height > blocks[b]->size().height;
+    });
+
+    std::vector<std::vector<PackerPtr> > stacks(columns);
+    std::vector<size_t> stackHeights(columns, 0);
+    for (size_t idx : tallest) {
+        const size_t column = std::min_element(stackHeights.begin(), stackHeights.end()) - stackHeights.begin();
+        stacks[column].push_back(blocks[idx]);
+        stackHeights[column] += blocks[idx]->size().height;
+    }
+
+    //the columns are stacked in parallel, a column as wide as its blocks places them below each other
+    phaseStart = Clock::now();
+    std::vector<PackerPtr> stacked(columns);
+    tasks.clear();
+    for (size_t column = 0; column < columns; column++) {
+        if (stacks[column].empty())
+            continue;
+
+        tasks.push_back(p->m_jobs->addTask([this, &stacks, &stacked, column]() {
+            Size size;
+            for (const PackerPtr &block : stacks[column]) {
+                size.width = std::max(size.width, block->size().width);
+                size.height += block->size().height;
+            }
+            stacked[column] = p->combine(stacks[column], size, false);
+            return stacked[column] != nullptr;
+        }, Trace::isEnabled() ? "stack column " + std::to_string(column) : std::string(), TaskPriority::High));
+    }
+
+    bool success = true;
+    for (std::future<bool> &task : tasks) {
+        if (!task.get())
+            success = false;
+    }
+    if (!success)
+        return PackerPtr();
+
+    //the columns are placed next to each other, highest first
+    stacked.erase(std::remove(stacked.begin(), stacked.end(), nullptr), stacked.end());
+    std::stable_sort(stacked.begin(), stacked.end(), [](const PackerPtr &a, const PackerPtr &b) {
+        return a->size().height > b->size().height;
+    });
+
+    size_t side = 0;
+    for (const PackerPtr &column : stacked) {
+        side += column->size().width;
+        report->columns++;
+    }
+    side = std::max(side, stacked.front()->size().height);
+
+    PackerPtr result = p->combine(stacked, Size(side, side), true);
+    if (!result)
+        return PackerPtr();
+    report->combineMs = elapsedMs(phaseStart);
+
+    report->clusters = clusterCount;
+    for (size_t idx = 0; idx < clusterCount; idx++)
+        report->clusterSize = std::max(report->clusterSize, bounds[idx + 1] - bounds[idx]);
+    report->milliseconds = elapsedMs(runStart);
+    return result;
+}
+
+}
@@ -24,6 +24,8 @@
 
 #include <AtlasPack/Image>
 
+#include <iostream>
+
 /**
  * \class AtlasPack::Image
  * \brief Represents informations about a texture to be painted into the Atlas
@@ -33,13 +35,24 @@ namespace AtlasPack {
 
     class ImagePrivate {
         public:
-            ImagePrivate (const std::string &p, const Size s)
+            ImagePrivate (const std::string &p, const Size s, const Rect &c)
                 : path(p)
-                , size(s){}
+                , size(s)
+                , content(c){}
+
+            //the content has to be part of the source image
+            bool contentInside () const {
+                return PixelView(nullptr, size).contains(content);
+            }
 
             std::string path;
             AtlasPack::Size size;
+            AtlasPack::Rect content;
             bool valid = true;
+
+            //set for images that are not read from a file
+            std::shared_ptr<const PixelBuffer> pixels;
+            PixelProvider provider;
     };
 
     /*!
@@ -51,15 +64,75 @@ namespace AtlasPack {
 
 
     Image::Image()
-        : p(new ImagePrivate("", AtlasPack::Size()))
+        : p(new ImagePrivate("", AtlasPack::Size(), AtlasPack::Rect()))
     {
         p->valid = false;
     }
 
     Image::Image(const std::string &path, const AtlasPack::Size size)
-        : p(new ImagePrivate(path, size))
+        : p(new ImagePrivate(path, size, AtlasPack::Rect(AtlasPack::Pos(0, 0), size)))
+    {
+
+    }
+
+    /*!
+     * \brief Image::Image
+     * Creates a trimmed image, only the area \a contentRect of the source image
+     * with the geometry \a size will be packed into the atlas. The image is invalid
+     * if \a contentRect is not inside of \a size.
+     */
+    Image::Image(const std::string &path, const AtlasPack::Size size, const AtlasPack::Rect &contentRect)
+        : p(new ImagePrivate(path, size, contentRect))
+    {
+        p->valid = p->contentInside();
+    }
+
+    /*!
+     * \brief Image::Image
+     * Creates a in-memory image from \a pixels, which are painted into the atlas directly
+     * instead of reading a file. The \a name is used to identify the image in the atlas description.
+     */
+    Image::Image(const std::string &name, std::shared_ptr<const PixelBuffer> pixels)
+        : Image(name, pixels, AtlasPack::Rect(AtlasPack::Pos(0, 0), pixels ? pixels->size() : AtlasPack::Size()))
+    {
+
+    }
+
+    /*!
+     * \brief Image::Image
+     * Creates a trimmed in-memory image, only the area \a contentRect of \a pixels is packed.
+     * The image is invalid if \a contentRect is not inside of \a pixels.
+     */
+    Image::Image(const std::string &name, std::shared_ptr<const PixelBuffer> pixels, const AtlasPack::Rect &contentRect)
+        : p(new ImagePrivate(name, pixels ? pixels->size() : AtlasPack::Size(), contentRect))
     {
+        p->pixels = pixels;
+        p->valid  = pixels && !pixels->isNull() && p->contentInside();
+    }
 
+    /*!
+     * \brief Image::Image
+     * Creates a in-memory image with the geometry \a size, its pixels are requested from
+     * \a provider only when the image is painted. This keeps the memory usage low if
+     * the pixels can be generated or decoded on demand.
+     * \note the \a provider is called from the worker threads of the packer
+     */
+    Image::Image(const std::string &name, const AtlasPack::Size size, PixelProvider provider)
+        : Image(name, size, AtlasPack::Rect(AtlasPack::Pos(0, 0), size), provider)
+    {
+
+    }
+
+    /*!
+     * \brief Image::Image
+     * Creates a trimmed in-memory image with pixels from \a provider, only the area \a contentRect
+     * is packed. The image is invalid if \a contentRect is not inside of \a size.
+     */
+    Image::Image(const std::string &name, const AtlasPack::Size size, const AtlasPack::Rect &contentRect, PixelProvider provider)
+        : p(new ImagePrivate(name, size, contentRect))
+    {
+        p->provider = provider;
+        p->valid    = static_cast<bool>(provider) && p->contentInside();
     }
 
     Image::Image(const Image &other)
@@ -78,14 +151,24 @@ namespace AtlasPack {
         return *this;
     }
 
+    /*!
+     * \brief Image::width
+     * Returns the width of the area that is packed into the atlas, this
+     * equals the width of the source image unless the image is trimmed.
+     */
     size_t Image::width() const
     {
-        return p->size.width;
+        return p->content.size.width;
     }
 
+    /*!
+     * \brief Image::height
+     * Returns the height of the area that is packed into the atlas, this
+     * equals the height of the source image unless the image is trimmed.
+     */
     size_t Image::height() const
     {
-        return p->size.height;
+        return p->content.size.height;
     }
 
     std::string Image::path() const
@@ -98,5 +181,66 @@ namespace AtlasPack {
         return p->valid;
     }
 
+    /*!
+     * \brief Image::sourceSize
+     * Returns the geometry of the source image, including transparent borders
+     * that might have been trimmed away.
+     */
+    Size Image::sourceSize() const
+    {
+        return p->size;
+    }
+
+    /*!
+     * \brief Image::contentRect
+     * Returns the area of the source image that is packed into the atlas.
+     */
+    Rect Image::contentRect() const
+    {
+        return p->content;
+    }
+
+    /*!
+     * \brief Image::isTrimmed
+     * Returns true if only a part of the source image is packed into the atlas.
+     */
+    bool Image::isTrimmed() const
+    {
+        return p->content.topLeft.x != 0 || p->content.topLeft.y != 0
+                || p->content.size.width != p->size.width
+                || p->content.size.height != p->size.height;
+    }
+
+    /*!
+     * \brief Image::isInMemory
+     * Returns true if the image pixels are held in memory or generated by a
+     * \sa AtlasPack::PixelProvider instead of being read from \sa Image::path
+     */
+    bool Image::isInMemory() const
+    {
+        return p->pixels || p->provider;
+    }
+
+    /*!
+     * \brief Image::pixels
+     * Returns the pixels of a in-memory image, calling the provider if required.
+     * Returns a empty pointer for file based images or if the provider failed.
+     */
+    std::shared_ptr<const PixelBuffer> Image::pixels() const
+    {
+        if (p->pixels || !p->provider)
+            return p->pixels;
+
+        std::shared_ptr<PixelBuffer> buffer = std::make_shared<PixelBuffer>();
+        if (!p->provider(buffer.get()))
+            return nullptr;
+
+        if (buffer->size().width != p->size.width || buffer->size().height != p->size.height) {
+            std::cerr << "The pixel provider of "<<p->path<<" returned a image of the wrong size"<<std::endl;
+            return nullptr;
+        }
+        return buffer;
+    }
+
 }
 
@@ -0,0 +1,245 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <AtlasPack/ImageCache>
+#include <AtlasPack/filestamp_p.h>
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace AtlasPack {
+
+/**
+ * @internal
+ * One part of the cache with its own lock, the least recently used entry is at the back
+ */
+class CacheShard {
+    public:
+        struct Entry {
+            std::string path;
+            FileStamp stamp;
+            std::shared_ptr<const PixelBuffer> pixels;
+        };
+        using EntryList = std::list<Entry>;
+
+        std::mutex mutex;
+        EntryList entries;
+        std::unordered_map<std::string, EntryList::iterator> index;
+};
+
+class ImageCachePrivate {
+    public:
+        ImageCachePrivate (size_t budget, size_t shards)
+            : m_budget(budget), m_shards(shards > 0 ? shards : 1) {}
+
+        CacheShard &shardOf (const std::string &path) { return m_shards[std::hash<std::string>()(path) % m_shards.size()]; }
+        void erase (CacheShard &shard, CacheShard::EntryList::iterator entry);
+        void evict (size_t firstShard);
+
+        std::atomic<size_t> m_budget;
+        std::atomic<size_t> m_used{0};
+        std::atomic<size_t> m_count{0};
+        mutable std::atomic<size_t> m_hits{0};
+        mutable std::atomic<size_t> m_misses{0};
+        std::atomic<size_t> m_evictions{0};
+        std::vector<CacheShard> m_shards;
+};
+
+/**
+ * @internal
+ * Removes \a entry from \a shard, the shard has to be locked
+ */
+void ImageCachePrivate::erase(CacheShard &shard, CacheShard::EntryList::iterator entry)
+{
+    m_used -= entry->pixels->byteCount();
+    m_count--;
+    shard.index.erase(entry->path);
+    shard.entries.erase(entry);
+}
+
+/**
+ * @internal
+ * Drops the least recently used entries until the cache fits into its budget again. The shard
+ * \a firstShard is emptied first, then the following ones. Only one shard is locked at a time,
+ * so the order is only least recently used within a shard.
+ */
+void ImageCachePrivate::evict(size_t firstShard)
+{
+    for (size_t i = 0; i < m_shards.size() && m_used > m_budget; i++) {
+        CacheShard &shard = m_shards[(firstShard + i) % m_shards.size()];
+        std::lock_guard<std::mutex> lk(shard.mutex);
+        while (m_used > m_budget && !shard.entries.empty()) {
+            erase(shard, std::prev(shard.entries.end()));
+            m_evictions++;
+        }
+    }
+}
+
+/**
+ * \class AtlasPack::ImageCache
+ * Keeps decoded images in memory, so images that are painted more than once, into several atlases,
+ * by incremental rebuilds or retries, are only decoded once. Entries are keyed by the path and are
+ * only used as long as the modification time and size of the file did not change. When the decoded
+ * pixels exceed the byte budget the least recently used images are dropped.
+ *
+ * The cache is split into \a shards parts with their own lock, selected by the hash of the path,
+ * so many paint tasks can use it at the same time. Pixels handed out stay valid after they were
+ * dropped from the cache. Two threads that miss the same image at the same time both decode it.
+ */
+ImageCache::ImageCache(size_t budgetBytes, size_t shards)
+    : p(new ImageCachePrivate(budgetBytes, shards))
+{
+
+}
+
+ImageCache::~ImageCache()
+{
+    if (p) delete p;
+}
+
+/*!
+ * \brief ImageCache::setBudget
+ * Sets the number of bytes the decoded pixels may use, entries are dropped
+ * immediately if the cache is bigger than the new budget
+ */
+void ImageCache::setBudget(size_t bytes)
+{
+    p->m_budget = bytes;
+    p->evict(0);
+}
+
+size_t ImageCache::budget() const
+{
+    return p->m_budget;
+}
+
+/*!
+ * \brief ImageCache::find
+ * Returns the cached pixels of the file \a path, or a empty pointer if the
+ * file is not cached or was modified since it was decoded.
+ */
+std::shared_ptr<const PixelBuffer> ImageCache::find(const std::string &path) const
+{
+    FileStamp stamp;
+    if (!readFileStamp(path, &stamp))
+        return std::shared_ptr<const PixelBuffer>();
+
+    CacheShard &shard = p->shardOf(path);
+    std::lock_guard<std::mutex> lk(shard.mutex);
+
+    auto entry = shard.index.find(path);
+    if (entry == shard.index.end() || !(entry->second->stamp == stamp))
+        return std::shared_ptr<const PixelBuffer>();
+
+    //move to the front, it is the most recently used one now
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry->second);
+    return entry->second->pixels;
+}
+
+/*!
+ * \brief ImageCache::load
+ * Returns the pixels of the file \a path, from the cache if possible, otherwise they
+ * are decoded with \a decode and added to the cache. Images bigger than the budget
+ * are returned without being cached. Returns a empty pointer if decoding failed.
+ */
+std::shared_ptr<const PixelBuffer> ImageCache::load(const std::string &path, const PixelProvider &decode)
+{
+    std::shared_ptr<const PixelBuffer> cached = find(path);
+    if (cached) {
+        p->m_hits++;
+        return cached;
+    }
+    p->m_misses++;
+
+    //take the stamp before decoding, if the file changes meanwhile the next lookup decodes again
+    FileStamp stamp;
+    bool cacheable = readFileStamp(path, &stamp);
+
+    std::shared_ptr<PixelBuffer> pixels = std::make_shared<PixelBuffer>();
+    if (!decode(pixels.get()) || pixels->isNull())
+        return std::shared_ptr<const PixelBuffer>();
+
+    if (!cacheable || pixels->byteCount() > p->m_budget)
+        return pixels;
+
+    CacheShard &shard = p->shardOf(path);
+    {
+        std::lock_guard<std::mutex> lk(shard.mutex);
+        auto old = shard.index.find(path);
+        if (old != shard.index.end())
+            p->erase(shard, old->second);
+
+        shard.entries.push_front(CacheShard::Entry{path, stamp, pixels});
+        shard.index[path] = shard.entries.begin();
+        p->m_used += pixels->byteCount();
+        p->m_count++;
+    }
+
+    p->evict(&shard - p->m_shards.data());
+    return pixels;
+}
+
+/*!
+ * \brief ImageCache::remove
+ * Drops the pixels of the file \a path from the cache
+ */
+void ImageCache::remove(const std::string &path)
+{
+    CacheShard &shard = p->shardOf(path);
+    std::lock_guard<std::mutex> lk(shard.mutex);
+
+    auto entry = shard.index.find(path);
+    if (entry != shard.index.end())
+        p->erase(shard, entry->second);
+}
+
+void ImageCache::clear()
+{
+    for (CacheShard &shard : p->m_shards) {
+        std::lock_guard<std::mutex> lk(shard.mutex);
+        while (!shard.entries.empty())
+            p->erase(shard, shard.entries.begin());
+    }
+}
+
+/*!
+ * \brief ImageCache::stats
+ * Returns the current size and the counters of the cache
+ */
+ImageCacheStats ImageCache::stats() const
+{
+    ImageCacheStats stats;
+    stats.entries = p->m_count;
+    stats.usedBytes = p->m_used;
+    stats.budgetBytes = p->m_budget;
+    stats.hits = p->m_hits;
+    stats.misses = p->m_misses;
+    stats.evictions = p->m_evictions;
+    return stats;
+}
+
+}
@@ -0,0 +1,662 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <AtlasPack/LiveAtlas>
+#include <AtlasPack/SizeSearch>
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/JobQueue>
+#include <AtlasPack/filestamp_p.h>
+#include <AtlasPack/pixelops_p.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+namespace fs = boost::filesystem;
+
+namespace AtlasPack {
+
+using PixelPtr = std::shared_ptr<PixelBuffer>;
+
+class LiveAtlasPrivate {
+    public:
+        LiveAtlasPrivate (Backend *backend, const std::string &basePath)
+            : m_backend(backend), m_basePath(basePath), m_writer(1) {}
+
+        void decode (const std::vector<std::string> &paths);
+        void forget (const std::string &path);
+        void rescan (const std::string &dir, std::vector<std::string> *modified, std::vector<std::string> *removed) const;
+        bool repack (std::string *error);
+        bool paint (const std::string &path, const Rect &cell);
+        bool clear (const Rect &cell);
+        bool writeTiles (const std::vector<Rect> &dirty, bool full, std::string *error);
+        void scheduleWrite ();
+        bool writeAtlas (std::string *error);
+
+        Backend *m_backend = nullptr;
+        std::string m_basePath;
+        bool m_trim = false;
+        size_t m_tileSize = 0;
+        Size m_tiledSize;       //atlas size the tiles were last written for
+
+        SizeSearch m_search;
+        JobQueue<PixelPtr> m_jobs;
+
+        //guards the layout and the canvas against the background writer
+        std::mutex m_mutex;
+        std::shared_ptr<TextureAtlasPacker> m_packer;
+        std::shared_ptr<PaintDevice> m_canvas;
+        std::map<std::string, Image> m_images;      //in-memory images holding the decoded pixels
+        std::map<std::string, FileStamp> m_stamps;  //file stamps of the decoded images
+
+        //writes the atlas image and description in the background, a write that is queued
+        //but did not start yet also takes all changes made until then
+        std::atomic_bool m_writeQueued{false};
+        std::mutex m_errorMutex;
+        std::string m_writeError;
+        JobQueue<bool> m_writer;
+};
+
+/**
+ * @internal
+ * @brief LiveAtlasPrivate::decode
+ * Decodes all images in \a paths in parallel and replaces the cached images
+ * with them. Images that can not be decoded are forgotten.
+ */
+void LiveAtlasPrivate::decode(const std::vector<std::string> &paths)
+{
+    std::vector<FileStamp> stamps(paths.size());
+    std::vector<std::future<PixelPtr> > results;
+    results.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        const std::string &path = paths[i];
+        FileStamp *stamp = &stamps[i];
+        results.push_back(m_jobs.addTask([this, path, stamp]() {
+            //the stamp is read first, so a change while decoding is noticed by the next rescan
+            readFileStamp(path, stamp);
+            PixelPtr pixels = std::make_shared<PixelBuffer>();
+            if (!m_backend->readImagePixels(path, pixels.get()) || pixels->isNull())
+                return PixelPtr();
+            return pixels;
+        }, path));
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        const std::string &path = paths[i];
+        PixelPtr pixels = results[i].get();
+        if (!pixels) {
+            std::cerr << "Error when trying to load "<<path<<" skipping file."<<std::endl;
+            forget(path);
+            continue;
+        }
+
+        Rect content(Pos(0, 0), pixels->size());
+        if (m_trim) {
+            content = PixelOps::opaqueRect(pixels->view());
+
+            //a fully transparent image still needs a place in the atlas
+            if (content.size.width == 0 || content.size.height == 0)
+                content = Rect(Pos(0, 0), Size(1, 1));
+        }
+
+        m_images[path] = Image(path, pixels, content);
+        m_stamps[path] = stamps[i];
+    }
+}
+
+void LiveAtlasPrivate::forget(const std::string &path)
+{
+    m_images.erase(path);
+    m_stamps.erase(path);
+}
+
+/**
+ * @internal
+ * @brief LiveAtlasPrivate::rescan
+ * Compares the files directly inside of \a dir with the known images. Files that are new or
+ * have a different stamp are added to \a modified, known images that are gone to \a removed.
+ */
+void LiveAtlasPrivate::rescan(const std::string &dir, std::vector<std::string> *modified,
+                              std::vector<std::string> *removed) const
+{
+    boost::system::error_code err;
+    for (fs::directory_iterator it(dir, err), end; !err && it != end; it.increment(err)) {
+        boost::system::error_code statErr;
+        if (!fs::is_regular_file(it->path(), statErr) || !m_backend->supportsImageType(fs::extension(it->path())))
+            continue;
+
+        const std::string path = it->path().string();
+        FileStamp stamp;
+        auto known = m_stamps.find(path);
+        if (known == m_stamps.end() || !readFileStamp(path, &stamp) || stamp != known->second)
+            modified->push_back(path);
+    }
+
+    const fs::path dirPath(dir);
+    for (const auto &entry : m_images) {
+        boost::system::error_code statErr;
+        if (fs::path(entry.first).parent_path() == dirPath && !fs::is_regular_file(entry.first, statErr))
+            removed->push_back(entry.first);
+    }
+}
+
+/**
+ * @internal
+ * @brief LiveAtlasPrivate::repack
+ * Searches a new layout for all known images and repaints the full atlas from the cached pixels
+ */
+bool LiveAtlasPrivate::repack(std::string *error)
+{
+    std::vector<Image> images;
+    images.reserve(m_images.size());
+    for (const auto &entry : m_images)
+        images.push_back(entry.second);
+
+    //without images a empty atlas of the smallest size is kept, the first new image
+    //does not fit into it and packs again
+    if (images.empty()) {
+        const size_t side = m_search.placementAlignment();
+        m_packer = std::make_shared<TextureAtlasPacker>(Size(side, side), m_search.packPolicy());
+        m_packer->setPlacementAlignment(side);
+        m_canvas = m_backend->createPaintDevice(m_packer->size());
+        return true;
+    }
+
+    std::shared_ptr<TextureAtlasPacker> packer = m_search.run(images);
+    if (!packer) {
+        if (error) *error = "Could not find a atlas size that fits all images";
+        return false;
+    }
+
+    m_packer = packer;
+    m_canvas = m_backend->createPaintDevice(m_packer->size());
+    for (const Placement &placement : m_packer->placements()) {
+        if (!paint(placement.image.path(), placement.cell)) {
+            if (error) *error = "Failed to paint image " + placement.image.path();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @internal
+ * @brief LiveAtlasPrivate::paint
+ * Paints the cached pixels of the image \a path into its \a cell
+ */
+bool LiveAtlasPrivate::paint(const std::string &path, const Rect &cell)
+{
+    auto image = m_images.find(path);
+    if (image == m_images.end())
+        return false;
+
+    std::shared_ptr<const PixelBuffer> pixels = image->second.pixels();
+    return pixels && m_canvas->paintImage(cell.topLeft, pixels->view().region(image->second.contentRect()));
+}
+
+/**
+ * @internal
+ * @brief LiveAtlasPrivate::clear
+ * Makes the area \a cell fully transparent
+ */
+bool LiveAtlasPrivate::clear(const Rect &cell)
+{
+    PixelBuffer transparent(cell.size);
+    return m_canvas->paintImage(cell.topLeft, transparent.view());
+}
+
+/**
+ * @internal
+ * @brief LiveAtlasPrivate::writeTiles
+ * Writes the tiles of the atlas that overlap the \a dirty areas, or all tiles if \a full is set,
+ * into the directory <basePath>_tiles and lists them in <basePath>.delta, in the same layout
+ * \sa TextureAtlasPacker::compile uses for --tiles. Does nothing if no tile size is set.
+ */
+bool LiveAtlasPrivate::writeTiles(const std::vector<Rect> &dirty, bool full, std::string *error)
+{
+    if (!m_tileSize)
+        return true;
+
+    const size_t tile = m_tileSize;
+    const Size size = m_packer->size();
+    const size_t cols = (size.width + tile - 1) / tile;
+    const size_t rows = (size.height + tile - 1) / tile;
+    full = full || size.width != m_tiledSize.width || size.height != m_tiledSize.height;
+
+    std::set<std::pair<size_t, size_t> > changed;
+    if (full) {
+        for (size_t row = 0; row < rows; row++) {
+            for (size_t col = 0; col < cols; col++)
+                changed.insert(std::make_pair(col, row));
+        }
+    } else {
+        for (const Rect &rect : dirty) {
+            if (!rect.size.width || !rect.size.height)
+                continue;
+            const size_t lastCol = std::min(cols - 1, (rect.topLeft.x + rect.size.width - 1) / tile);
+            const size_t lastRow = std::min(rows - 1, (rect.topLeft.y + rect.size.height - 1) / tile);
+            for (size_t row = rect.topLeft.y / tile; row <= lastRow; row++) {
+                for (size_t col = rect.topLeft.x / tile; col <= lastCol; col++)
+                    changed.insert(std::make_pair(col, row));
+            }
+        }
+    }
+
+    const fs::path tileDir(m_basePath + "_tiles");
+    const std::string dirName = tileDir.filename().string();
+    auto tileName = [&dirName](size_t col, size_t row) {
+        return dirName + "/" + std::to_string(col) + "_" + std::to_string(row) + ".png";
+    };
+    const fs::path baseDir = tileDir.parent_path();
+
+    boost::system::error_code fsErr;
+    fs::create_directories(tileDir, fsErr);
+    if (fsErr) {
+        if (error) *error = "Could not create the tile directory " + tileDir.string();
+        return false;
+    }
+
+    std::ostringstream delta;
+    delta << tile << "," << size.width << "," << size.height << "," << (full ? "full" : "partial") << "\n";
+    for (const auto &pos : changed) {
+        const Pos topLeft(pos.first * tile, pos.second * tile);
+        const Rect rect(topLeft, Size(std::min(tile, size.width - topLeft.x), std::min(tile, size.height - topLeft.y)));
+        const std::string fileName = (baseDir / tileName(pos.first, pos.second)).string();
+
+        PixelBuffer pixels;
+        std::shared_ptr<PaintDevice> tilePainter = m_backend->createPaintDevice(rect.size);
+        if (!m_canvas->readPixels(rect, &pixels) || !tilePainter->paintImage(Pos(0, 0), pixels.view())
+                || !tilePainter->exportToFile(fileName)) {
+            if (error) *error = "Failed to write tile " + fileName;
+            return false;
+        }
+        delta << "changed," << pos.first << "," << pos.second << "," << rect.topLeft.x << "," << rect.topLeft.y << ","
+              << rect.size.width << "," << rect.size.height << "," << tileName(pos.first, pos.second) << "\n";
+    }
+
+    //tiles of a bigger earlier layout are not part of the atlas anymore
+    const size_t oldCols = (m_tiledSize.width + tile - 1) / tile;
+    const size_t oldRows = (m_tiledSize.height + tile - 1) / tile;
+    for (size_t row = 0; row < oldRows; row++) {
+        for (size_t col = 0; col < oldCols; col++) {
+            if (col < cols && row < rows)
+                continue;
+            fs::remove(baseDir / tileName(col, row), fsErr);
+            delta << "removed," << col << "," << row << ",0,0,0,0," << tileName(col, row) << "\n";
+        }
+    }
+    m_tiledSize = size;
+
+    //the tile hashes of a earlier compile do not describe these tiles anymore
+    fs::remove(m_basePath + ".tiles", fsErr);
+
+    std::ofstream deltaFile(m_basePath + ".delta", std::ios::trunc | std::ios::out);
+    deltaFile << delta.str();
+    deltaFile.close();
+    if (deltaFile.fail()) {
+        if (error) *error = "Failed to write the tile delta " + m_basePath + ".delta";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @internal
+ * @brief LiveAtlasPrivate::scheduleWrite
+ * Queues a write of the atlas image and description on the background writer, unless
+ * a queued write did not start yet and picks up the latest state anyway
+ */
+void LiveAtlasPrivate::scheduleWrite()
+{
+    if (m_writeQueued.exchange(true))
+        return;
+
+    m_writer.addTask([this]() {
+        m_writeQueued.store(false);
+        std::string err;
+        if (writeAtlas(&err))
+            return true;
+
+        std::cerr << err << std::endl;
+        std::lock_guard<std::mutex> lk(m_errorMutex);
+        m_writeError = err;
+        return false;
+    }, "write live atlas");
+}
+
+/**
+ * @internal
+ * @brief LiveAtlasPrivate::writeAtlas
+ * Writes the atlas image and the description. Only copying the canvas and the description
+ * holds the lock, so updates are not blocked while the image is encoded.
+ */
+bool LiveAtlasPrivate::writeAtlas(std::string *error)
+{
+    PixelBuffer pixels;
+    std::ostringstream description;
+    Size size;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (!m_packer)
+            return true;
+
+        size = m_packer->size();
+        if (!m_canvas->readPixels(Rect(Pos(0, 0), size), &pixels)) {
+            if (error) *error = "Failed to read the atlas image";
+            return false;
+        }
+        m_packer->writeDescription(description);
+    }
+
+    const std::string textureFile = m_basePath + ".png";
+    std::shared_ptr<PaintDevice> painter = m_backend->createPaintDevice(size);
+    if (!painter->paintImage(Pos(0, 0), pixels.view()) || !painter->exportToFile(textureFile)) {
+        if (error) *error = "Failed to export atlas image " + textureFile;
+        return false;
+    }
+
+    const std::string descFileName = m_basePath + ".atlas";
+    std::ofstream descFile(descFileName, std::ios::trunc | std::ios::out);
+    descFile << description.str();
+    descFile.close();
+    if (descFile.fail()) {
+        if (error) *error = "Failed to write atlas index file " + descFileName;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \class AtlasPack::LiveAtlas
+ * Keeps the packed layout, the atlas image and the decoded pixels of all images in memory, so
+ * the atlas can be updated quickly when some of the images change. Unchanged images are neither
+ * decoded nor painted again and keep their position, a full repack only happens if a changed
+ * or new image does not fit into the free space anymore.
+ *
+ * The atlas is written as <basePath>.png and <basePath>.atlas, in the same format
+ * \sa AtlasPack::TextureAtlasPacker::compile uses. Updates only change the in-memory atlas,
+ * the files are written in the background, several updates in a row are written once.
+ * \sa LiveAtlas::flush waits until they are written. With a tile size set, the tiles that
+ * an update touched are written right away, see \sa LiveAtlas::setTileSize.
+ * The \a backend has to support \sa AtlasPack::Backend::readImagePixels and its paint devices
+ * \sa AtlasPack::PaintDevice::readPixels.
+ */
+LiveAtlas::LiveAtlas(Backend *backend, const std::string &basePath)
+    : p(new LiveAtlasPrivate(backend, basePath))
+{
+
+}
+
+LiveAtlas::~LiveAtlas()
+{
+    if (p) {
+        flush();
+        delete p;
+    }
+}
+
+/*!
+ * \brief LiveAtlas::setTrimImages
+ * If \a enabled is true, fully transparent borders are cut off all images, \sa AtlasPack::Backend::readTrimmedImageInformation
+ */
+void LiveAtlas::setTrimImages(bool enabled)
+{
+    p->m_trim = enabled;
+}
+
+bool LiveAtlas::trimImages() const
+{
+    return p->m_trim;
+}
+
+/*!
+ * \brief LiveAtlas::setPlacementAlignment
+ * \sa AtlasPack::TextureAtlasPacker::setPlacementAlignment
+ */
+void LiveAtlas::setPlacementAlignment(size_t alignment)
+{
+    p->m_search.setPlacementAlignment(alignment);
+}
+
+size_t LiveAtlas::placementAlignment() const
+{
+    return p->m_search.placementAlignment();
+}
+
+/*!
+ * \brief LiveAtlas::setPackPolicy
+ * \sa AtlasPack::SizeSearch::setPackPolicy, takes effect with the next full repack
+ */
+void LiveAtlas::setPackPolicy(const PackPolicy &policy)
+{
+    p->m_search.setPackPolicy(policy);
+}
+
+PackPolicy LiveAtlas::packPolicy() const
+{
+    return p->m_search.packPolicy();
+}
+
+/*!
+ * \brief LiveAtlas::setTileSize
+ * If \a tileSize is not 0, the atlas is also written as tiles of \a tileSize pixels into the
+ * directory <basePath>_tiles. Every update writes only the tiles it touched and lists them in
+ * <basePath>.delta, like \sa AtlasPack::TextureAtlasPacker::setTileSize does for a compile.
+ */
+void LiveAtlas::setTileSize(size_t tileSize)
+{
+    p->m_tileSize = tileSize;
+    p->m_tiledSize = Size();
+}
+
+size_t LiveAtlas::tileSize() const
+{
+    return p->m_tileSize;
+}
+
+Size LiveAtlas::size() const
+{
+    return p->m_packer ? p->m_packer->size() : Size();
+}
+
+/*!
+ * \brief LiveAtlas::count
+ * Returns the number of images in the atlas
+ */
+size_t LiveAtlas::count() const
+{
+    return p->m_images.size();
+}
+
+/*!
+ * \brief LiveAtlas::rebuild
+ * Drops all cached data, packs the images in \a files and writes the atlas. If \a files
+ * is empty a empty atlas is written. Returns once the atlas is written.
+ */
+bool LiveAtlas::rebuild(const std::vector<std::string> &files, std::string *error)
+{
+    {
+        std::lock_guard<std::mutex> lk(p->m_mutex);
+        p->m_images.clear();
+        p->m_stamps.clear();
+        p->decode(files);
+        if (!p->repack(error) || !p->writeTiles(std::vector<Rect>(), true, error))
+            return false;
+    }
+    p->scheduleWrite();
+    return flush(error);
+}
+
+/*!
+ * \brief LiveAtlas::update
+ * Updates the atlas after the files in \a changedPaths were modified, created or deleted.
+ * A path can also name a removed directory, in which case all images below it are removed,
+ * or a existing directory, whose files are compared with the known images. Paths of files the
+ * backend does not support are ignored.
+ *
+ * The areas of the atlas that were repainted are stored in \a dirtyRects, if the images had to be
+ * packed again \a repacked is set to true and \a dirtyRects contains the full atlas. The touched
+ * tiles are written before this returns, the full atlas image and description in the background.
+ */
+bool LiveAtlas::update(const std::vector<std::string> &changedPaths, std::vector<Rect> *dirtyRects,
+                       bool *repacked, std::string *error)
+{
+    if (repacked) *repacked = false;
+    if (dirtyRects) dirtyRects->clear();
+
+    std::lock_guard<std::mutex> lk(p->m_mutex);
+
+    std::vector<std::string> removed;
+    std::vector<std::string> modified;
+    for (const std::string &path : changedPaths) {
+        boost::system::error_code err;
+        if (fs::is_directory(path, err)) {
+            p->rescan(path, &modified, &removed);
+            continue;
+        }
+        if (fs::is_regular_file(path, err)) {
+            if (p->m_backend->supportsImageType(fs::extension(path)))
+                modified.push_back(path);
+            continue;
+        }
+
+        //the path is gone, it might have been a single image or a full directory
+        const std::string prefix = path + "/";
+        for (const auto &entry : p->m_images) {
+            if (entry.first == path || entry.first.compare(0, prefix.size(), prefix) == 0)
+                removed.push_back(entry.first);
+        }
+    }
+
+    //a file can be reported by itself and by the rescan of its directory
+    for (std::vector<std::string> *list : { &removed, &modified }) {
+        std::sort(list->begin(), list->end());
+        list->erase(std::unique(list->begin(), list->end()), list->end());
+    }
+
+    if (removed.empty() && modified.empty())
+        return true;
+
+    std::vector<Rect> cleared;
+    std::vector<std::pair<std::string, Rect> > painted;
+    bool needRepack = !p->m_packer;
+
+    for (const std::string &path : removed) {
+        Rect cell;
+        if (p->m_packer && p->m_packer->removeImage(path, &cell))
+            cleared.push_back(cell);
+        p->forget(path);
+    }
+
+    p->decode(modified);
+    for (const std::string &path : modified) {
+        auto image = p->m_images.find(path);
+        if (image == p->m_images.end()) {
+            //the file could not be decoded anymore, drop it from the atlas
+            Rect cell;
+            if (p->m_packer && p->m_packer->removeImage(path, &cell))
+                cleared.push_back(cell);
+            continue;
+        }
+        if (needRepack)
+            continue;
+
+        Rect cell;
+        if (p->m_packer->replaceImage(image->second, &cell)) {
+            cleared.push_back(cell);
+            painted.emplace_back(path, cell);
+            continue;
+        }
+
+        //the image is new or grew too big for its old cell, try to find a new place for it
+        if (p->m_packer->removeImage(path, &cell))
+            cleared.push_back(cell);
+
+        if (p->m_packer->insertImage(image->second, &cell)) {
+            cleared.push_back(cell);
+            painted.emplace_back(path, cell);
+        } else {
+            needRepack = true;
+        }
+    }
+
+    if (needRepack) {
+        if (!p->repack(error) || !p->writeTiles(std::vector<Rect>(), true, error))
+            return false;
+        p->scheduleWrite();
+        if (repacked) *repacked = true;
+        if (dirtyRects) dirtyRects->push_back(Rect(Pos(0, 0), p->m_packer->size()));
+        return true;
+    }
+
+    //clear all touched cells first, a removed image might have left its cell to a new one
+    for (const Rect &cell : cleared) {
+        if (!p->clear(cell)) {
+            if (error) *error = "Failed to clear the atlas area of a changed image";
+            return false;
+        }
+    }
+    for (const auto &entry : painted) {
+        if (!p->paint(entry.first, entry.second)) {
+            if (error) *error = "Failed to paint image " + entry.first;
+            return false;
+        }
+    }
+
+    if (!p->writeTiles(cleared, false, error))
+        return false;
+    p->scheduleWrite();
+
+    if (dirtyRects)
+        *dirtyRects = cleared;
+    return true;
+}
+
+/*!
+ * \brief LiveAtlas::flush
+ * Waits until the atlas image and description of all updates so far are written. Returns
+ * \a false and stores the reason in \a error if a background write failed since the last flush.
+ */
+bool LiveAtlas::flush(std::string *error)
+{
+    p->m_writer.waitForAllRunningTasks();
+
+    std::lock_guard<std::mutex> lk(p->m_errorMutex);
+    if (p->m_writeError.empty())
+        return true;
+    if (error) *error = p->m_writeError;
+    p->m_writeError.clear();
+    return false;
+}
+
+}
@@ -0,0 +1,340 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/packengine_p.h>
+
+namespace AtlasPack {
+
+const size_t PackLayout::NoNode;
+
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+const uint32_t PackEngine<SplitRule, FitHeuristic, Coord>::NoLeaf;
+
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+PackEngine<SplitRule, FitHeuristic, Coord>::PackEngine(const Size &size)
+{
+    m_nodes.push_back(Node{0, 0, static_cast<Coord>(size.width), static_cast<Coord>(size.height), 0, false});
+    if (UsesFreeList::value)
+        m_free.add(m_nodes.front().width, m_nodes.front().height, 0);
+}
+
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+Size PackEngine<SplitRule, FitHeuristic, Coord>::size() const
+{
+    return Size(m_nodes.front().width, m_nodes.front().height);
+}
+
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+Rect PackEngine<SplitRule, FitHeuristic, Coord>::rect(size_t node) const
+{
+    const Node &n = m_nodes[node];
+    return Rect(Pos(n.x, n.y), Size(n.width, n.height));
+}
+
+/**
+ * @internal
+ * Returns the first free leaf a cell of \a width x \a height fits into, or NoLeaf if
+ * the cell does not fit anywhere. The tree is walked depth first, left child before
+ * right, subtrees that are too small are skipped.
+ */
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+uint32_t PackEngine<SplitRule, FitHeuristic, Coord>::findNode(Coord width, Coord height, size_t *slot, std::false_type)
+{
+    UNUSED(slot);
+
+    m_stack.clear();
+    m_stack.push_back(0);
+    while (!m_stack.empty()) {
+        const uint32_t idx = m_stack.back();
+        m_stack.pop_back();
+
+        const Node &node = m_nodes[idx];
+        if (node.width < width || node.height < height)
+            continue;
+
+        if (node.left) {
+            m_stack.push_back(node.left + 1);
+            m_stack.push_back(node.left);
+            continue;
+        }
+
+        if (!node.used)
+            return idx;
+    }
+    return NoLeaf;
+}
+
+/**
+ * @internal
+ * Returns the smallest free leaf a cell of \a width x \a height fits into, or NoLeaf if
+ * the cell does not fit anywhere. The position of the leaf in the free list is stored in \a slot.
+ */
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+uint32_t PackEngine<SplitRule, FitHeuristic, Coord>::findNode(Coord width, Coord height, size_t *slot, std::true_type)
+{
+    *slot = m_free.findSmallestFit(width, height);
+    return *slot == FreeRectList<Coord>::NoSlot ? NoLeaf : m_free.node(*slot);
+}
+
+/**
+ * @internal
+ * Places a cell into the free leaf picked by the heuristic, splitting it until
+ * one leaf has exactly the size of the cell. Returns the index of that leaf.
+ */
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+size_t PackEngine<SplitRule, FitHeuristic, Coord>::place(const Size &cell)
+{
+    const Node &root = m_nodes.front();
+    if (cell.width > root.width || cell.height > root.height)
+        return NoNode;
+
+    const Coord width  = static_cast<Coord>(cell.width);
+    const Coord height = static_cast<Coord>(cell.height);
+
+    size_t slot = FreeRectList<Coord>::NoSlot;
+    uint32_t idx = findNode(width, height, &slot, UsesFreeList());
+    if (idx == NoLeaf)
+        return NoNode;
+
+    Step step{static_cast<uint32_t>(m_nodes.size()), idx, 0, NoLeaf, 0, 0};
+    if (UsesFreeList::value) {
+        step.slot = static_cast<uint32_t>(slot);
+        step.slotWidth = m_free.width(slot);
+        step.slotHeight = m_free.height(slot);
+        m_free.remove(slot);
+        step.freeCount = static_cast<uint32_t>(m_free.size());
+    }
+    m_journal.push_back(step);
+
+    while (m_nodes[idx].width != width || m_nodes[idx].height != height) {
+        const Node node = m_nodes[idx];
+        const Coord remainWidth  = node.width - width;
+        const Coord remainHeight = node.height - height;
+        const bool vertical = SplitRule::splitVertically(remainWidth, remainHeight);
+
+        const uint32_t left = static_cast<uint32_t>(m_nodes.size());
+        m_nodes[idx].left = left;
+
+        if (vertical) {
+            m_nodes.push_back(Node{node.x, node.y, width, node.height, 0, false});
+            m_nodes.push_back(Node{static_cast<Coord>(node.x + width), node.y, remainWidth, node.height, 0, false});
+        } else {
+            m_nodes.push_back(Node{node.x, node.y, node.width, height, 0, false});
+            m_nodes.push_back(Node{node.x, static_cast<Coord>(node.y + height), node.width, remainHeight, 0, false});
+        }
+
+        //the right child stays empty
+        if (UsesFreeList::value)
+            m_free.add(m_nodes.back().width, m_nodes.back().height, left + 1);
+
+        //continue with the left child, it always contains the cell
+        idx = left;
+    }
+
+    m_nodes[idx].used = true;
+    return idx;
+}
+
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+size_t PackEngine<SplitRule, FitHeuristic, Coord>::insert(const Size &cell)
+{
+    return place(cell);
+}
+
+/**
+ * @internal
+ * Places all \a cells in order, the node of every cell is appended to \a nodes.
+ * Stops and returns false at the first cell that does not fit.
+ */
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+bool PackEngine<SplitRule, FitHeuristic, Coord>::insertAll(const std::vector<Size> &cells, std::vector<size_t> *nodes)
+{
+    reserve(cells.size());
+    nodes->reserve(nodes->size() + cells.size());
+
+    for (const Size &cell : cells) {
+        const size_t node = place(cell);
+        if (node == NoNode)
+            return false;
+        nodes->push_back(node);
+    }
+    return true;
+}
+
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+void PackEngine<SplitRule, FitHeuristic, Coord>::release(size_t node)
+{
+    m_journal.clear();
+    m_nodes[node].used = false;
+    if (UsesFreeList::value)
+        m_free.add(m_nodes[node].width, m_nodes[node].height, static_cast<uint32_t>(node));
+}
+
+/**
+ * @internal
+ * Appends all used leafs to \a nodes, in depth first order
+ */
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+void PackEngine<SplitRule, FitHeuristic, Coord>::usedNodes(std::vector<size_t> *nodes) const
+{
+    std::vector<uint32_t> stack{0};
+    while (!stack.empty()) {
+        const uint32_t idx = stack.back();
+        stack.pop_back();
+
+        const Node &node = m_nodes[idx];
+        if (node.left) {
+            stack.push_back(node.left + 1);
+            stack.push_back(node.left);
+        } else if (node.used) {
+            nodes->push_back(idx);
+        }
+    }
+}
+
+/**
+ * @internal
+ * Replaces the used leaf \a node with a copy of the tree of \a layout, moved to the position of
+ * the leaf. The leaf has to have exactly the size of \a layout. The node every node of \a layout was
+ * copied to is stored at its index in \a nodeMap, used leafs stay used and free leafs can take in
+ * cells afterwards. Like releasing a node this clears the journal.
+ */
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+bool PackEngine<SplitRule, FitHeuristic, Coord>::graft(size_t node, const PackLayout &layout, std::vector<size_t> *nodeMap)
+{
+    const Rect target = rect(node);
+    if (m_nodes[node].left || !m_nodes[node].used
+            || target.size.width != layout.size().width || target.size.height != layout.size().height)
+        return false;
+
+    m_journal.clear();
+    m_nodes[node].used = false;
+    m_nodes.reserve(m_nodes.size() + layout.nodeCount());
+
+    //children are always stored after their parent, so every node was mapped before it is visited
+    nodeMap->assign(layout.nodeCount(), NoNode);
+    (*nodeMap)[0] = node;
+    for (size_t idx = 0; idx < layout.nodeCount(); idx++) {
+        const size_t mapped = (*nodeMap)[idx];
+        const size_t child = layout.firstChild(idx);
+
+        if (!child) {
+            m_nodes[mapped].used = layout.isUsed(idx);
+            if (UsesFreeList::value && !m_nodes[mapped].used)
+                m_free.add(m_nodes[mapped].width, m_nodes[mapped].height, static_cast<uint32_t>(mapped));
+            continue;
+        }
+
+        const uint32_t left = static_cast<uint32_t>(m_nodes.size());
+        m_nodes[mapped].left = left;
+        for (size_t i = 0; i < 2; i++) {
+            const Rect r = layout.rect(child + i);
+            m_nodes.push_back(Node{static_cast<Coord>(target.topLeft.x + r.topLeft.x),
+                                   static_cast<Coord>(target.topLeft.y + r.topLeft.y),
+                                   static_cast<Coord>(r.size.width), static_cast<Coord>(r.size.height), 0, false});
+            (*nodeMap)[child + i] = left + i;
+        }
+    }
+    return true;
+}
+
+/**
+ * @internal
+ * Makes room for \a cells more inserts, so inserting and rolling back
+ * afterwards does not allocate memory
+ */
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+void PackEngine<SplitRule, FitHeuristic, Coord>::reserve(size_t cells)
+{
+    //every cell adds at most 4 nodes and 2 free leafs
+    m_nodes.reserve(m_nodes.size() + cells * 4);
+    m_stack.reserve(m_nodes.capacity());
+    m_journal.reserve(m_journal.size() + cells);
+    if (UsesFreeList::value)
+        m_free.reserve(m_free.size() + cells * 2);
+}
+
+/**
+ * @internal
+ * Takes back the latest inserts until only \a journalSize of them are left,
+ * the layout is exactly in the state it had after that many inserts.
+ */
+template <typename SplitRule, typename FitHeuristic, typename Coord>
+void PackEngine<SplitRule, FitHeuristic, Coord>::rollback(size_t journalSize)
+{
+    while (m_journal.size() > journalSize) {
+        const Step &step = m_journal.back();
+
+        if (UsesFreeList::value) {
+            while (m_free.size() > step.freeCount)
+                m_free.pop();
+            m_free.restore(step.slot, step.slotWidth, step.slotHeight, step.leaf);
+        }
+
+        m_nodes.resize(step.nodeCount);
+        m_nodes[step.leaf].left = 0;
+        m_nodes[step.leaf].used = false;
+        m_journal.pop_back();
+    }
+}
+
+template class PackEngine<SplitLongerRemainder,  FitFirst,    uint16_t>;
+template class PackEngine<SplitLongerRemainder,  FitFirst,    uint32_t>;
+template class PackEngine<SplitLongerRemainder,  FitBestArea, uint16_t>;
+template class PackEngine<SplitLongerRemainder,  FitBestArea, uint32_t>;
+template class PackEngine<SplitShorterRemainder, FitFirst,    uint16_t>;
+template class PackEngine<SplitShorterRemainder, FitFirst,    uint32_t>;
+template class PackEngine<SplitShorterRemainder, FitBestArea, uint16_t>;
+template class PackEngine<SplitShorterRemainder, FitBestArea, uint32_t>;
+
+template <typename SplitRule, typename FitHeuristic>
+static std::unique_ptr<PackLayout> createLayout (const Size &size)
+{
+    //16 bit coordinates keep the nodes small, which matters for the many size search trials
+    if (size.width <= std::numeric_limits<uint16_t>::max() && size.height <= std::numeric_limits<uint16_t>::max())
+        return std::unique_ptr<PackLayout>(new PackEngine<SplitRule, FitHeuristic, uint16_t>(size));
+    return std::unique_ptr<PackLayout>(new PackEngine<SplitRule, FitHeuristic, uint32_t>(size));
+}
+
+/**
+ * @internal
+ * @brief PackLayout::create
+ * Creates the engine specialised on \a policy and the coordinate range \a size needs.
+ * This is the only place the policy is looked at, all packing afterwards runs the
+ * specialised code.
+ */
+std::unique_ptr<PackLayout> PackLayout::create(const Size &size, const PackPolicy &policy)
+{
+    if (policy.split == SplitRule::LongerRemainder) {
+        if (policy.fit == FitHeuristic::BestAreaFit)
+            return createLayout<SplitLongerRemainder, FitBestArea>(size);
+        return createLayout<SplitLongerRemainder, FitFirst>(size);
+    }
+
+    if (policy.fit == FitHeuristic::BestAreaFit)
+        return createLayout<SplitShorterRemainder, FitBestArea>(size);
+    return createLayout<SplitShorterRemainder, FitFirst>(size);
+}
+
+}
@@ -0,0 +1,495 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <AtlasPack/PackOptimizer>
+#include <AtlasPack/packengine_p.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <random>
+
+namespace AtlasPack {
+
+using PackerPtr = std::shared_ptr<TextureAtlasPacker>;
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs (Clock::time_point start, Clock::time_point end = Clock::now())
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static const PackPolicy AllPolicies[] = {
+    PackPolicy{SplitRule::LongerRemainder,  FitHeuristic::FirstFit},
+    PackPolicy{SplitRule::LongerRemainder,  FitHeuristic::BestAreaFit},
+    PackPolicy{SplitRule::ShorterRemainder, FitHeuristic::FirstFit},
+    PackPolicy{SplitRule::ShorterRemainder, FitHeuristic::BestAreaFit}
+};
+static const size_t PolicyCount = sizeof(AllPolicies) / sizeof(AllPolicies[0]);
+
+//the temperature is relative to the total area of all images
+static const double StartTemperature = 0.02;
+static const double EndTemperature   = 0.0005;
+
+/**
+ * @internal
+ * A insertion order together with the policy it is packed with
+ */
+struct Candidate {
+    std::vector<uint32_t> order;
+    size_t policy = 0;
+    size_t side = 0;
+};
+
+/**
+ * @internal
+ * A packing trial that can be continued from any position of the insertion order.
+ * Cells that do not fit are skipped, the score is the area of all placed cells.
+ * The state after every position is kept as a journal position of the layout,
+ * so after the first evaluation no memory is allocated anymore.
+ */
+class Trial {
+    public:
+        Trial (const Size &size, const PackPolicy &policy, const std::vector<Size> &cells, const std::vector<uint64_t> &areas);
+
+        uint64_t evaluateFrom (const std::vector<uint32_t> &order, size_t first);
+
+    private:
+        const std::vector<Size> &m_cells;
+        const std::vector<uint64_t> &m_areas;
+        std::unique_ptr<PackLayout> m_layout;
+        std::vector<size_t> m_journalAt;
+        std::vector<uint64_t> m_areaAt;
+};
+
+Trial::Trial(const Size &size, const PackPolicy &policy, const std::vector<Size> &cells, const std::vector<uint64_t> &areas)
+    : m_cells(cells), m_areas(areas), m_layout(PackLayout::create(size, policy)),
+      m_journalAt(cells.size() + 1, 0), m_areaAt(cells.size() + 1, 0)
+{
+    m_layout->reserve(cells.size());
+}
+
+/**
+ * @internal
+ * Packs \a order starting at index \a first, everything before was already placed by the
+ * previous evaluation and is not touched. Returns the area of all placed cells.
+ */
+uint64_t Trial::evaluateFrom(const std::vector<uint32_t> &order, size_t first)
+{
+    m_layout->rollback(m_journalAt[first]);
+
+    uint64_t area = m_areaAt[first];
+    for (size_t i = first; i < order.size(); i++) {
+        m_journalAt[i] = m_layout->journalSize();
+        m_areaAt[i] = area;
+        if (m_layout->insert(m_cells[order[i]]) != PackLayout::NoNode)
+            area += m_areas[order[i]];
+    }
+
+    m_journalAt[order.size()] = m_layout->journalSize();
+    m_areaAt[order.size()] = area;
+    return area;
+}
+
+class PackOptimizerPrivate {
+    public:
+        PackOptimizerPrivate (size_t threads)
+            : m_ownJobs(new JobQueue<bool>(threads)), m_jobs(m_ownJobs.get()) {}
+        PackOptimizerPrivate (JobQueue<bool> *jobs)
+            : m_jobs(jobs) {}
+
+        bool fitsAll (const std::vector<uint32_t> &order, size_t policy, size_t side) const;
+        size_t smallestSide (const std::vector<uint32_t> &order, size_t policy) const;
+        bool anneal (Candidate *candidate, size_t side, Clock::time_point deadline, uint64_t seed,
+                     std::atomic<bool> *found, std::atomic<size_t> *evaluations) const;
+
+        std::unique_ptr<JobQueue<bool> > m_ownJobs;
+        JobQueue<bool> *m_jobs = nullptr;
+        double m_budgetMs = 1000;
+        size_t m_alignment = 1;
+        uint64_t m_seed = 1;
+
+        //the images of the current run
+        std::vector<Size> m_cells;
+        std::vector<uint64_t> m_areas;
+        uint64_t m_totalArea = 0;
+        size_t m_lowerBound = 1;
+};
+
+/**
+ * @internal
+ * @brief PackOptimizerPrivate::fitsAll
+ * Returns true if all cells packed in \a order fit into a atlas of \a side x \a side
+ */
+bool PackOptimizerPrivate::fitsAll(const std::vector<uint32_t> &order, size_t policy, size_t side) const
+{
+    std::unique_ptr<PackLayout> layout = PackLayout::create(Size(side, side), AllPolicies[policy]);
+    layout->reserve(order.size());
+    for (uint32_t cell : order) {
+        if (layout->insert(m_cells[cell]) == PackLayout::NoNode)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @internal
+ * @brief PackOptimizerPrivate::smallestSide
+ * Returns the edge length of the smallest atlas \a order fits into. The size is doubled
+ * until everything fits and then bisected, starting at the lower bound of the images.
+ */
+size_t PackOptimizerPrivate::smallestSide(const std::vector<uint32_t> &order, size_t policy) const
+{
+    size_t tooSmall = m_lowerBound - 1;
+    size_t fits = m_lowerBound;
+    while (!fitsAll(order, policy, fits)) {
+        tooSmall = fits;
+        fits *= 2;
+    }
+
+    while (fits - tooSmall > 1) {
+        size_t side = tooSmall + (fits - tooSmall) / 2;
+        if (fitsAll(order, policy, side))
+            fits = side;
+        else
+            tooSmall = side;
+    }
+    return fits;
+}
+
+/**
+ * @internal
+ * @brief PackOptimizerPrivate::anneal
+ * Runs simulated annealing on the insertion order of \a candidate, trying to fit all cells
+ * into a atlas of \a side x \a side. A move either swaps two cells or moves one cell in front
+ * of another, only the order behind the first changed position is packed again. Moves that
+ * lose placed area are accepted with a probability that shrinks as the temperature cools down
+ * towards \a deadline.
+ *
+ * Stops when everything fits, when \a found is set by another chain or at \a deadline.
+ * Returns true if all cells fit, \a candidate then contains the order.
+ */
+bool PackOptimizerPrivate::anneal(Candidate *candidate, size_t side, Clock::time_point deadline, uint64_t seed,
+                                  std::atomic<bool> *found, std::atomic<size_t> *evaluations) const
+{
+    std::vector<uint32_t> &order = candidate->order;
+    Trial trial(Size(side, side), AllPolicies[candidate->policy], m_cells, m_areas);
+
+    uint64_t placed = trial.evaluateFrom(order, 0);
+    size_t trials = 1;
+
+    const size_t count = order.size();
+    std::mt19937_64 random(seed);
+    std::uniform_int_distribution<size_t> pickFirst(0, count > 1 ? count - 1 : 0);
+    std::uniform_int_distribution<size_t> pickSecond(0, count > 1 ? count - 2 : 0);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    const Clock::time_point start = Clock::now();
+    const double span = std::max(elapsedMs(start, deadline), 1.0);
+    double temperature = StartTemperature;
+
+    while (count > 1 && placed < m_totalArea && !found->load(std::memory_order_relaxed)) {
+
+        //cool down geometrically, looking at the clock is cheap compared to a trial
+        if (trials % 16 == 0) {
+            const Clock::time_point now = Clock::now();
+            if (now >= deadline)
+                break;
+            temperature = StartTemperature * std::pow(EndTemperature / StartTemperature, elapsedMs(start, now) / span);
+        }
+
+        size_t first = pickFirst(random);
+        size_t second = pickSecond(random);
+        if (second >= first)
+            second++;
+        if (first > second)
+            std::swap(first, second);
+
+        //either swap two cells or move the second one in front of the first
+        const bool move = chance(random) < 0.5;
+        if (move)
+            std::rotate(order.begin() + first, order.begin() + second, order.begin() + second + 1);
+        else
+            std::swap(order[first], order[second]);
+
+        const uint64_t next = trial.evaluateFrom(order, first);
+        trials++;
+
+        if (next >= placed
+                || chance(random) < std::exp(-static_cast<double>(placed - next) / m_totalArea / temperature)) {
+            placed = next;
+            continue;
+        }
+
+        //take the move back
+        if (move)
+            std::rotate(order.begin() + first, order.begin() + first + 1, order.begin() + second + 1);
+        else
+            std::swap(order[first], order[second]);
+
+        trial.evaluateFrom(order, first);
+        trials++;
+    }
+
+    evaluations->fetch_add(trials, std::memory_order_relaxed);
+    if (placed < m_totalArea)
+        return false;
+
+    found->store(true);
+    candidate->side = side;
+    return true;
+}
+
+/**
+ * @class PackOptimizer::PackOptimizer
+ * Searches a insertion order and \a AtlasPack::PackPolicy that packs a list of images into
+ * a smaller quadratic atlas than \a AtlasPack::SizeSearch finds with the given order.
+ *
+ * The search starts with the images sorted by area, longer side, height and width and every
+ * policy, the smallest atlas of those is improved by simulated annealing. Every round tries
+ * to fit the images into a atlas one pixel smaller than the best one so far, running one chain
+ * per worker thread with different policies and random seeds. The first chain that fits all images
+ * ends the round. The search stops when the time budget is used up or the area of the images
+ * does not allow a smaller atlas.
+ *
+ * \a threads specifies the number of worker threads, 0 uses one thread per core.
+ */
+PackOptimizer::PackOptimizer(size_t threads)
+    : p(new PackOptimizerPrivate(threads))
+{
+
+}
+
+/*!
+ * \brief PackOptimizer::PackOptimizer
+ * Creates a optimizer that runs its chains on the shared \a jobs queue, which
+ * has to outlive the optimizer.
+ */
+PackOptimizer::PackOptimizer(JobQueue<bool> *jobs)
+    : p(new PackOptimizerPrivate(jobs))
+{
+
+}
+
+PackOptimizer::~PackOptimizer()
+{
+    if (p) delete p;
+}
+
+/*!
+ * \brief PackOptimizer::setTimeBudget
+ * Sets the wall clock time a run may take, defaults to 1000 milliseconds. The sorted
+ * starting orders are always tried, even if that takes longer.
+ */
+void PackOptimizer::setTimeBudget(double milliseconds)
+{
+    p->m_budgetMs = milliseconds > 0 ? milliseconds : 0;
+}
+
+double PackOptimizer::timeBudget() const
+{
+    return p->m_budgetMs;
+}
+
+/*!
+ * \brief PackOptimizer::setPlacementAlignment
+ * Sets the placement alignment of the resulting atlas, \sa TextureAtlasPacker::setPlacementAlignment
+ */
+void PackOptimizer::setPlacementAlignment(size_t alignment)
+{
+    p->m_alignment = alignment > 0 ? alignment : 1;
+}
+
+size_t PackOptimizer::placementAlignment() const
+{
+    return p->m_alignment;
+}
+
+/*!
+ * \brief PackOptimizer::setSeed
+ * Sets the seed of the random moves. Because the rounds end at the first chain
+ * that succeeds, runs with the same seed can still give different results.
+ */
+void PackOptimizer::setSeed(uint64_t seed)
+{
+    p->m_seed = seed;
+}
+
+uint64_t PackOptimizer::seed() const
+{
+    return p->m_seed;
+}
+
+/*!
+ * \brief PackOptimizer::threadCount
+ * Returns the number of annealing chains that run in parallel
+ */
+unsigned int PackOptimizer::threadCount() const
+{
+    return p->m_jobs->maxJobs();
+}
+
+/*!
+ * \brief PackOptimizer::run
+ * Searches the smallest atlas for \a images within the time budget and returns it,
+ * the returned packer already contains all images and uses the policy that was found.
+ * If \a report is set, the result of the search is recorded there.
+ * Returns a empty pointer if \a images is empty.
+ */
+std::shared_ptr<TextureAtlasPacker> PackOptimizer::run(const std::vector<Image> &images, OptimizeReport *report)
+{
+    if (images.empty())
+        return PackerPtr();
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::milli>(p->m_budgetMs));
+
+    //same cell sizes as the packer uses
+    p->m_cells.clear();
+    p->m_areas.clear();
+    p->m_totalArea = 0;
+    size_t longestSide = 0;
+    for (const Image &img : images) {
+        Size cell((img.width()  + p->m_alignment - 1) / p->m_alignment * p->m_alignment,
+                  (img.height() + p->m_alignment - 1) / p->m_alignment * p->m_alignment);
+        p->m_cells.push_back(cell);
+        p->m_areas.push_back(static_cast<uint64_t>(cell.width) * cell.height);
+        p->m_totalArea += p->m_areas.back();
+        longestSide = std::max(longestSide, std::max(cell.width, cell.height));
+    }
+
+    size_t areaSide = static_cast<size_t>(std::sqrt(static_cast<double>(p->m_totalArea)));
+    while (static_cast<uint64_t>(areaSide) * areaSide < p->m_totalArea)
+        areaSide++;
+    p->m_lowerBound = std::max<size_t>(std::max(areaSide, longestSide), 1);
+
+    //the starting orders, the input order first so it wins ties
+    const std::vector<Size> &cells = p->m_cells;
+    std::vector<std::vector<uint32_t> > orders(5, std::vector<uint32_t>(cells.size()));
+    for (size_t i = 0; i < cells.size(); i++)
+        orders[0][i] = static_cast<uint32_t>(i);
+    for (size_t i = 1; i < orders.size(); i++)
+        orders[i] = orders[0];
+
+    std::stable_sort(orders[1].begin(), orders[1].end(), [&](uint32_t a, uint32_t b) {
+        return p->m_areas[a] > p->m_areas[b];
+    });
+    std::stable_sort(orders[2].begin(), orders[2].end(), [&](uint32_t a, uint32_t b) {
+        return std::max(cells[a].width, cells[a].height) > std::max(cells[b].width, cells[b].height);
+    });
+    std::stable_sort(orders[3].begin(), orders[3].end(), [&](uint32_t a, uint32_t b) {
+        return cells[a].height > cells[b].height;
+    });
+    std::stable_sort(orders[4].begin(), orders[4].end(), [&](uint32_t a, uint32_t b) {
+        return cells[a].width > cells[b].width;
+    });
+
+    std::vector<size_t> sides(orders.size() * PolicyCount);
+    std::vector<std::future<bool> > tasks;
+    for (size_t i = 0; i < sides.size(); i++) {
+        size_t *slot = &sides[i];
+        const std::vector<uint32_t> *order = &orders[i / PolicyCount];
+        const size_t policy = i % PolicyCount;
+        tasks.push_back(p->m_jobs->addTask([this, slot, order, policy]() {
+            *slot = p->smallestSide(*order, policy);
+            return true;
+        }, Trace::isEnabled() ? "optimize start " + std::to_string(i) : std::string(), TaskPriority::High));
+    }
+    for (std::future<bool> &task : tasks)
+        task.get();
+
+    Candidate best;
+    const size_t firstBest = std::min_element(sides.begin(), sides.end()) - sides.begin();
+    best.order = orders[firstBest / PolicyCount];
+    best.policy = firstBest % PolicyCount;
+    best.side = sides[firstBest];
+
+    OptimizeReport result;
+    result.lowerBound = p->m_lowerBound;
+    result.initialSize = best.side;
+
+    //rounds of annealing chains, each round aims one pixel below the best atlas so far
+    const size_t chains = threadCount();
+    const double roundMs = std::max(p->m_budgetMs / 10.0, 10.0);
+    std::atomic<size_t> evaluations(0);
+
+    while (best.side > p->m_lowerBound && Clock::now() < deadline) {
+        const Clock::time_point roundDeadline = std::min(deadline, Clock::now() +
+                std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(roundMs)));
+        const size_t side = best.side - 1;
+
+        std::atomic<bool> found(false);
+        std::vector<Candidate> candidates(chains, best);
+        std::vector<std::future<bool> > chainTasks;
+        for (size_t i = 0; i < chains; i++) {
+            //the first chain keeps the best policy, the others try the remaining ones as well
+            Candidate *candidate = &candidates[i];
+            candidate->policy = (best.policy + i) % PolicyCount;
+            const uint64_t seed = p->m_seed + result.epochs * chains + i;
+            chainTasks.push_back(p->m_jobs->addTask([this, candidate, side, roundDeadline, seed, &found, &evaluations]() {
+                return p->anneal(candidate, side, roundDeadline, seed, &found, &evaluations);
+            }, Trace::isEnabled() ? "optimize " + std::to_string(side) + " chain " + std::to_string(i) : std::string(),
+            TaskPriority::High));
+        }
+
+        bool improved = false;
+        for (size_t i = 0; i < chains; i++) {
+            if (chainTasks[i].get() && !improved) {
+                best = candidates[i];
+                improved = true;
+            }
+        }
+        result.epochs++;
+
+        if (improved) {
+            //the new order often fits into even smaller atlases
+            while (best.side > p->m_lowerBound && p->fitsAll(best.order, best.policy, best.side - 1))
+                best.side--;
+            result.improvements++;
+        }
+    }
+
+    std::vector<Image> ordered;
+    ordered.reserve(images.size());
+    for (uint32_t i : best.order)
+        ordered.push_back(images[i]);
+
+    PackerPtr packer = std::make_shared<TextureAtlasPacker>(Size(best.side, best.side), AllPolicies[best.policy]);
+    packer->setPlacementAlignment(p->m_alignment);
+    if (!packer->insertImages(ordered))
+        return PackerPtr();
+
+    if (report) {
+        result.finalSize = best.side;
+        result.evaluations = evaluations.load();
+        result.milliseconds = elapsedMs(start);
+        result.queue = p->m_jobs->stats();
+        *report = result;
+    }
+    return packer;
+}
+
+}
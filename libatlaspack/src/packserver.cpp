@@ -0,0 +1,945 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <AtlasPack/PackServer>
+#include <AtlasPack/PackOptimizer>
+#include <AtlasPack/SizeSearch>
+#include <AtlasPack/JobQueue>
+#include <AtlasPack/filestamp_p.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ATLASPACK_HAVE_UNIX_SOCKETS
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace AtlasPack {
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs (Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//longest request or response line that is accepted
+static const size_t MaxLineLength = 64 * 1024;
+
+static const char *PhaseNames[] = { "painting", "mipmaps", "compressing", "exporting", "description", "finished" };
+
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+
+#ifdef MSG_NOSIGNAL
+static const int SendFlags = MSG_NOSIGNAL;
+#else
+static const int SendFlags = 0;
+#endif
+
+/**
+ * @internal
+ * Writing to a socket that was closed by the other side must fail with EPIPE instead of
+ * killing the process, on Linux that is done with \a SendFlags for every send call
+ */
+static void disableSigPipe (int fd)
+{
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    UNUSED(fd);
+#endif
+}
+
+static void setCloseOnExec (int fd)
+{
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+/**
+ * @internal
+ * Sends \a line followed by a newline, returns false if the other side is gone
+ */
+static bool sendLine (int fd, const std::string &line)
+{
+    std::string data = line + "\n";
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t res = send(fd, data.data() + written, data.size() - written, SendFlags);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return false;
+        written += static_cast<size_t>(res);
+    }
+    return true;
+}
+
+static bool sendError (int fd, const std::string &message)
+{
+    std::ostringstream line;
+    line << "error " << std::quoted(message);
+    return sendLine(fd, line.str());
+}
+
+/**
+ * @internal
+ * Splits the data received from a socket into lines
+ */
+class LineReader {
+    public:
+        explicit LineReader (int fd) : m_fd(fd) {}
+
+        //returns false at the end of the stream, on errors and on lines longer than MaxLineLength
+        bool readLine (std::string *line) {
+            while (true) {
+                size_t end = m_buffer.find('\n');
+                if (end != std::string::npos) {
+                    line->assign(m_buffer, 0, end);
+                    m_buffer.erase(0, end + 1);
+                    return true;
+                }
+                if (m_buffer.size() > MaxLineLength)
+                    return false;
+
+                char chunk[4096];
+                ssize_t res = recv(m_fd, chunk, sizeof(chunk), 0);
+                if (res < 0 && errno == EINTR)
+                    continue;
+                if (res <= 0)
+                    return false;
+                m_buffer.append(chunk, static_cast<size_t>(res));
+            }
+        }
+
+    private:
+        int m_fd;
+        std::string m_buffer;
+};
+
+static bool socketAddress (const std::string &path, sockaddr_un *addr, std::string *err)
+{
+    std::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+        if (err) *err = "The socket path " + path + " is empty or too long";
+        return false;
+    }
+    std::memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+#endif
+
+class PackServerPrivate {
+    public:
+        PackServerPrivate (Backend *backend, size_t threads, WorkerAffinity affinity)
+            : m_backend(backend), m_jobs(threads, affinity) {}
+
+        //image information of a file, valid as long as the file is not modified
+        struct ImageInfo {
+            FileStamp stamp;
+            std::string inputDirectory;
+            Image image;
+            Image trimmed;
+        };
+
+        struct Connection {
+            int fd = -1;
+            std::thread thread;
+            std::atomic_bool finished{false};
+        };
+
+        void serve (Connection *connection);
+        bool handlePack (int fd, const PackRequest &request);
+        bool collectImages (int fd, const PackRequest &request, std::vector<Image> *images, PackReport *report, std::string *err);
+        void evictStale (const std::string &inputDirectory, const std::vector<std::string> &paths);
+        void closeSocket ();
+
+        Backend *m_backend = nullptr;
+        JobQueue<bool> m_jobs;
+        std::string m_socketPath;
+        int m_listenFd = -1;
+        int m_wakeFds[2] = {-1, -1};
+        std::atomic_bool m_stop{false};
+        std::atomic<size_t> m_served{0};
+
+        mutable std::mutex m_cacheMutex;
+        std::unordered_map<std::string, ImageInfo> m_cache;
+};
+
+/**
+ * @internal
+ * @brief PackServerPrivate::evictStale
+ * Drops the cached information of all files that were last seen in \a inputDirectory but
+ * are not part of the sorted list \a paths anymore, so removed files do not stay in memory.
+ */
+void PackServerPrivate::evictStale(const std::string &inputDirectory, const std::vector<std::string> &paths)
+{
+    std::lock_guard<std::mutex> lk(m_cacheMutex);
+    for (auto it = m_cache.begin(); it != m_cache.end(); ) {
+        if (it->second.inputDirectory == inputDirectory && !std::binary_search(paths.begin(), paths.end(), it->first))
+            it = m_cache.erase(it);
+        else
+            ++it;
+    }
+}
+
+/**
+ * @internal
+ * @brief PackServerPrivate::collectImages
+ * Collects the images of the input directory of \a request, sorted by path. The image information
+ * is taken from the cache if the file did not change since it was read, all other files are read in
+ * parallel. Files that can not be read are reported to the client and skipped.
+ */
+bool PackServerPrivate::collectImages(int fd, const PackRequest &request, std::vector<Image> *images,
+                                      PackReport *report, std::string *err)
+{
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+    auto scanStart = Clock::now();
+    const fs::path dir(request.inputDirectory);
+
+    boost::system::error_code ec;
+    if (!fs::is_directory(dir, ec)) {
+        evictStale(request.inputDirectory, std::vector<std::string>());
+        *err = "The input directory " + request.inputDirectory + " does not exist";
+        return false;
+    }
+
+    std::vector<std::string> paths;
+    try {
+        auto addFile = [this, &paths](const fs::directory_entry &entry) {
+            boost::system::error_code statErr;
+            if (fs::is_regular_file(entry.status(statErr)) && m_backend->supportsImageType(fs::extension(entry.path())))
+                paths.push_back(entry.path().string());
+        };
+
+        if (request.recursive) {
+            for (fs::recursive_directory_iterator it(dir), end; it != end; ++it)
+                addFile(*it);
+        } else {
+            for (fs::directory_iterator it(dir), end; it != end; ++it)
+                addFile(*it);
+        }
+    } catch (const fs::filesystem_error &ex) {
+        *err = std::string("Error while reading the input directory: ") + ex.what();
+        return false;
+    }
+    std::sort(paths.begin(), paths.end());
+    evictStale(request.inputDirectory, paths);
+
+    std::vector<FileStamp> stamps(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        readFileStamp(paths[i], &stamps[i]);
+
+    std::vector<Image> found(paths.size());
+    std::vector<size_t> missing;
+    {
+        std::lock_guard<std::mutex> lk(m_cacheMutex);
+        for (size_t i = 0; i < paths.size(); i++) {
+            auto info = m_cache.find(paths[i]);
+            if (info != m_cache.end() && info->second.stamp == stamps[i]) {
+                info->second.inputDirectory = request.inputDirectory;
+                found[i] = request.trim ? info->second.trimmed : info->second.image;
+            }
+            if (!found[i].isValid())
+                missing.push_back(i);
+        }
+    }
+
+    //read the missing information on the warm pool, every task takes a share of the files
+    auto probeStart = Clock::now();
+    const size_t tasks = std::min<size_t>(missing.size(), m_jobs.maxJobs());
+    std::vector<std::future<bool> > probed;
+    for (size_t task = 0; task < tasks; task++) {
+        probed.push_back(m_jobs.addTask([this, task, tasks, &missing, &paths, &found, &request]() {
+            for (size_t i = task; i < missing.size(); i += tasks) {
+                const std::string &path = paths[missing[i]];
+                found[missing[i]] = request.trim ? m_backend->readTrimmedImageInformation(path)
+                                                 : m_backend->readImageInformation(path);
+            }
+            return true;
+        }, Trace::isEnabled() ? "probe " + std::to_string(task) : std::string()));
+    }
+    for (std::future<bool> &res : probed)
+        res.get();
+    report->probeMs = elapsedMs(probeStart);
+
+    {
+        std::lock_guard<std::mutex> lk(m_cacheMutex);
+        for (size_t i : missing) {
+            if (!found[i].isValid())
+                continue;
+
+            ImageInfo &info = m_cache[paths[i]];
+            if (info.stamp != stamps[i]) {
+                info = ImageInfo();
+                info.stamp = stamps[i];
+            }
+            info.inputDirectory = request.inputDirectory;
+            (request.trim ? info.trimmed : info.image) = found[i];
+        }
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (found[i].isValid()) {
+            images->push_back(found[i]);
+            continue;
+        }
+
+        std::ostringstream line;
+        line << "skipped " << std::quoted(paths[i]);
+        if (!sendLine(fd, line.str())) {
+            *err = "The client closed the connection";
+            return false;
+        }
+    }
+
+    report->scanMs = elapsedMs(scanStart) - report->probeMs;
+    report->imageCount = images->size();
+    return true;
+#else
+    UNUSED(fd);
+    UNUSED(request);
+    UNUSED(images);
+    UNUSED(report);
+    *err = "The pack server is not supported on this platform";
+    return false;
+#endif
+}
+
+/**
+ * @internal
+ * @brief PackServerPrivate::handlePack
+ * Packs and compiles the atlas of \a request, streaming the progress to the client.
+ * Returns false if the client went away, the compile run is cancelled in that case.
+ */
+bool PackServerPrivate::handlePack(int fd, const PackRequest &request)
+{
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+    auto start = Clock::now();
+    PackReport report;
+    BatchEntry entry = request.atlas;
+    std::string err;
+
+    if (!sendLine(fd, "progress scanning"))
+        return false;
+    if (!collectImages(fd, request, &entry.images, &report, &err))
+        return sendError(fd, err);
+    if (entry.images.empty())
+        return sendError(fd, "No images to pack");
+
+    if (!sendLine(fd, "progress packing " + std::to_string(entry.images.size())))
+        return false;
+
+    std::shared_ptr<TextureAtlasPacker> packer;
+    if (request.optimizeMs > 0) {
+        PackOptimizer optimizer(&m_jobs);
+        optimizer.setPlacementAlignment(entry.alignment);
+        optimizer.setTimeBudget(request.optimizeMs);
+        packer = optimizer.run(entry.images, &report.optimize);
+    } else {
+        SizeSearch search(&m_jobs);
+        search.setPlacementAlignment(entry.alignment);
+        search.setPackPolicy(entry.policy);
+        packer = search.run(entry.images, &report.search);
+    }
+    if (!packer)
+        return sendError(fd, "Could not find a atlas size that fits all images");
+
+    packer->setGenerateMipmaps(entry.mipmaps);
+    packer->setBlockCompression(entry.compression);
+    packer->setExportPng(entry.exportPng);
+    packer->setDecodeBudget(entry.decodeBudget);
+    packer->setPrefetchWindow(entry.prefetchWindow);
+    packer->setTileSize(entry.tileSize);
+    packer->setJobQueue(&m_jobs);
+
+    //the calls are serialized by the compile run, send every 10% of painted images and every phase change.
+    //The callback runs on the paint workers, it only queues the lines and this thread sends them,
+    //so a client that stops reading can not stall the workers
+    bool clientGone = false;
+    int lastStep = -1;
+    CompilePhase lastPhase = CompilePhase::Painting;
+    std::mutex progressMutex;
+    std::vector<std::string> progressLines;
+    auto progress = [&progressMutex, &progressLines, &lastStep, &lastPhase](const CompileProgress &progress) {
+        std::string line;
+        if (progress.phase == CompilePhase::Painting && progress.totalImages) {
+            int step = static_cast<int>(progress.paintedImages * 10 / progress.totalImages);
+            if (step != lastStep)
+                line = "progress painting " + std::to_string(progress.paintedImages) + " " + std::to_string(progress.totalImages);
+            lastStep = step;
+        } else if (progress.phase != lastPhase) {
+            line = std::string("progress ") + PhaseNames[static_cast<int>(progress.phase)];
+        }
+        lastPhase = progress.phase;
+
+        if (!line.empty()) {
+            std::lock_guard<std::mutex> lk(progressMutex);
+            progressLines.push_back(std::move(line));
+        }
+    };
+    auto sendProgress = [fd, &clientGone, &progressMutex, &progressLines]() {
+        std::vector<std::string> lines;
+        {
+            std::lock_guard<std::mutex> lk(progressMutex);
+            lines.swap(progressLines);
+        }
+        for (const std::string &line : lines) {
+            if (!clientGone && !sendLine(fd, line))
+                clientGone = true;
+        }
+    };
+
+    TextureAtlas atlas;
+    {
+        CompileHandle handle = packer->compileAsync(entry.basePath, m_backend, progress, &report.compile);
+        while (!handle.waitFor(100)) {
+            sendProgress();
+            if (clientGone || m_stop)
+                handle.cancel();
+        }
+        atlas = handle.result(&err);
+    }
+    sendProgress();
+
+    if (clientGone)
+        return false;
+    if (!atlas.isValid())
+        return sendError(fd, err.empty() ? "Failed to compile the atlas" : err);
+
+    report.peakMemory = peakMemoryUsage();
+    if (request.sendReport) {
+        std::ostringstream json;
+        report.writeJson(json);
+        std::string line = "report " + json.str();
+        std::replace(line.begin(), line.end(), '\n', ' ');
+        if (!sendLine(fd, line))
+            return false;
+    }
+
+    std::ostringstream result;
+    result << "ok " << packer->size().width << " " << packer->size().height << " "
+           << entry.images.size() << " " << elapsedMs(start);
+    return sendLine(fd, result.str());
+#else
+    UNUSED(fd);
+    UNUSED(request);
+    return false;
+#endif
+}
+
+/**
+ * @internal
+ * @brief PackServerPrivate::serve
+ * Answers the requests of one client until it closes the connection or the server stops
+ */
+void PackServerPrivate::serve(Connection *connection)
+{
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+    const int fd = connection->fd;
+    LineReader reader(fd);
+    std::string line;
+
+    while (!m_stop && reader.readLine(&line)) {
+        std::istringstream in(line);
+        std::string command;
+        if (!(in >> command))
+            continue;
+
+        bool alive = true;
+        if (command == "pack") {
+            PackRequest request;
+            std::string err;
+            if (PackServer::parseRequest(line, &request, &err))
+                alive = handlePack(fd, request);
+            else
+                alive = sendError(fd, err);
+            m_served++;
+        } else if (command == "stats") {
+            size_t cached = 0;
+            {
+                std::lock_guard<std::mutex> lk(m_cacheMutex);
+                cached = m_cache.size();
+            }
+            alive = sendLine(fd, "ok " + std::to_string(cached) + " " + std::to_string(m_served.load())
+                             + " " + std::to_string(m_jobs.maxJobs()));
+        } else {
+            alive = sendError(fd, "Unknown request " + command);
+        }
+
+        if (!alive)
+            break;
+    }
+#else
+    UNUSED(connection);
+#endif
+    connection->finished = true;
+}
+
+void PackServerPrivate::closeSocket()
+{
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+    if (m_listenFd >= 0) {
+        close(m_listenFd);
+        unlink(m_socketPath.c_str());
+        m_listenFd = -1;
+    }
+    for (int &wakeFd : m_wakeFds) {
+        if (wakeFd >= 0)
+            close(wakeFd);
+        wakeFd = -1;
+    }
+#endif
+}
+
+/**
+ * \class AtlasPack::PackServer
+ * Packs and compiles atlases on request of other processes, sent over a Unix domain socket.
+ * A build system that creates many atlases pays the startup of the process and the image decoder
+ * only once, the worker threads stay warm and the image information of all files is cached until
+ * the file is modified.
+ *
+ * The protocol is line based, every value that can contain spaces is quoted like in the batch manifest.
+ * A client sends "pack <input directory> <output basename> [options]" with the options written by
+ * \sa PackServer::formatRequest, or "stats". The server answers a pack request with any number of
+ * "progress <phase> ..." and "skipped <path>" lines, optionally "report <json>", and ends with either
+ * "ok <width> <height> <images> <milliseconds>" or "error <message>". "stats" is answered with
+ * "ok <cached images> <served requests> <worker threads of the pool>". A client can send many requests over one connection,
+ * they are answered in order, several clients are served at the same time.
+ *
+ * \a threads specifies the number of worker threads shared by all requests, 0 uses one thread per core,
+ * \a affinity where they are pinned to, see \sa AtlasPack::JobQueue.
+ */
+PackServer::PackServer(Backend *backend, size_t threads, WorkerAffinity affinity)
+    : p(new PackServerPrivate(backend, threads, affinity))
+{
+
+}
+
+/*!
+ * \brief PackServer::~PackServer
+ * Closes and removes the socket, \sa PackServer::run must have returned before.
+ */
+PackServer::~PackServer()
+{
+    if (p) {
+        p->closeSocket();
+        delete p;
+    }
+}
+
+/*!
+ * \brief PackServer::listen
+ * Creates the socket \a socketPath and starts accepting connections, they are served
+ * as soon as \sa PackServer::run is called. Only the user running the server may connect to
+ * the socket. A socket file left behind by a server that did not exit cleanly is replaced,
+ * a socket a running server listens on is not. Returns false and sets \a error on failure.
+ */
+bool PackServer::listen(const std::string &socketPath, std::string *error)
+{
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+    if (p->m_listenFd >= 0) {
+        if (error) *error = "The server is already listening on " + p->m_socketPath;
+        return false;
+    }
+
+    sockaddr_un addr;
+    if (!socketAddress(socketPath, &addr, error))
+        return false;
+
+    struct stat info;
+    if (lstat(socketPath.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            if (error) *error = socketPath + " exists and is not a socket";
+            return false;
+        }
+
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool inUse = probe >= 0 && connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0)
+            close(probe);
+        if (inUse) {
+            if (error) *error = "Another server is listening on " + socketPath;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        if (error) *error = std::string("Could not create the socket: ") + strerror(errno);
+        return false;
+    }
+    setCloseOnExec(fd);
+
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        if (error) *error = "Could not listen on " + socketPath + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    //only the user running the server may send requests, they read and write files with its permissions
+    if (chmod(socketPath.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        if (error) *error = "Could not listen on " + socketPath + ": " + strerror(errno);
+        close(fd);
+        unlink(socketPath.c_str());
+        return false;
+    }
+
+    if (pipe(p->m_wakeFds) != 0) {
+        if (error) *error = std::string("Could not create the wake up pipe: ") + strerror(errno);
+        close(fd);
+        unlink(socketPath.c_str());
+        return false;
+    }
+    setCloseOnExec(p->m_wakeFds[0]);
+    setCloseOnExec(p->m_wakeFds[1]);
+    fcntl(p->m_wakeFds[1], F_SETFL, fcntl(p->m_wakeFds[1], F_GETFL) | O_NONBLOCK);
+
+    p->m_listenFd = fd;
+    p->m_socketPath = socketPath;
+    p->m_stop = false;
+    return true;
+#else
+    UNUSED(socketPath);
+    if (error) *error = "The pack server is not supported on this platform";
+    return false;
+#endif
+}
+
+bool PackServer::isListening() const
+{
+    return p->m_listenFd >= 0;
+}
+
+std::string PackServer::socketPath() const
+{
+    return p->m_socketPath;
+}
+
+/*!
+ * \brief PackServer::run
+ * Serves clients until \sa PackServer::stop is called, every connection is served by
+ * its own thread. Before returning all connections are closed, running compiles are
+ * cancelled. Returns immediately if the server is not listening.
+ */
+void PackServer::run()
+{
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+    using Connection = PackServerPrivate::Connection;
+    std::list<std::unique_ptr<Connection> > connections;
+
+    auto reap = [&connections](bool all) {
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (!all && !(*it)->finished) {
+                ++it;
+                continue;
+            }
+            (*it)->thread.join();
+            close((*it)->fd);
+            it = connections.erase(it);
+        }
+    };
+
+    while (p->m_listenFd >= 0 && !p->m_stop) {
+        pollfd fds[2] = { { p->m_listenFd, POLLIN, 0 }, { p->m_wakeFds[0], POLLIN, 0 } };
+
+        //wake up once a second to clean up the finished connections
+        int res = poll(fds, 2, 1000);
+        reap(false);
+        if (res < 0 && errno != EINTR)
+            break;
+        if (res <= 0 || (fds[1].revents & POLLIN))
+            continue;
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(p->m_listenFd, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+            setCloseOnExec(fd);
+            disableSigPipe(fd);
+
+            connections.emplace_back(new Connection());
+            Connection *connection = connections.back().get();
+            connection->fd = fd;
+            connection->thread = std::thread(&PackServerPrivate::serve, p, connection);
+        }
+    }
+
+    //wake up the clients that wait for the next request
+    for (auto &connection : connections)
+        shutdown(connection->fd, SHUT_RDWR);
+    reap(true);
+#endif
+}
+
+/*!
+ * \brief PackServer::stop
+ * Makes \sa PackServer::run return, can be called from any thread and from signal handlers
+ */
+void PackServer::stop()
+{
+    p->m_stop = true;
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+    if (p->m_wakeFds[1] >= 0) {
+        char wake = 1;
+        ssize_t res = write(p->m_wakeFds[1], &wake, 1);
+        UNUSED(res);
+    }
+#endif
+}
+
+/*!
+ * \brief PackServer::threadCount
+ * Returns the number of worker threads shared by all requests
+ */
+unsigned int PackServer::threadCount() const
+{
+    return p->m_jobs.maxJobs();
+}
+
+/*!
+ * \brief PackServer::cachedImages
+ * Returns the number of files the image information is cached for
+ */
+size_t PackServer::cachedImages() const
+{
+    std::lock_guard<std::mutex> lk(p->m_cacheMutex);
+    return p->m_cache.size();
+}
+
+size_t PackServer::servedRequests() const
+{
+    return p->m_served;
+}
+
+/*!
+ * \brief PackServer::formatRequest
+ * Returns the protocol line of \a request, without the trailing newline.
+ * Relative paths are sent as they are, the server resolves them against its own working directory.
+ */
+std::string PackServer::formatRequest(const PackRequest &request)
+{
+    const BatchEntry &atlas = request.atlas;
+
+    std::ostringstream out;
+    out << "pack " << std::quoted(request.inputDirectory) << " " << std::quoted(atlas.basePath);
+    if (request.recursive)
+        out << " recursive";
+    if (request.trim)
+        out << " trim";
+    if (atlas.mipmaps)
+        out << " mipmaps";
+    if (atlas.compression != BlockCompression::None)
+        out << " compress " << (atlas.compression == BlockCompression::BC1 ? "bc1" : "bc3");
+    if (!atlas.exportPng)
+        out << " no-png";
+    out << " align " << atlas.alignment
+        << " split " << (atlas.policy.split == SplitRule::ShorterRemainder ? "shorter" : "longer")
+        << " fit " << (atlas.policy.fit == FitHeuristic::BestAreaFit ? "best-area" : "first");
+    if (request.optimizeMs > 0)
+        out << " optimize " << request.optimizeMs;
+    if (atlas.decodeBudget)
+        out << " decode-budget " << atlas.decodeBudget;
+    if (atlas.prefetchWindow)
+        out << " prefetch " << atlas.prefetchWindow;
+    if (atlas.tileSize)
+        out << " tiles " << atlas.tileSize;
+    if (request.sendReport)
+        out << " report";
+    return out.str();
+}
+
+/*!
+ * \brief PackServer::parseRequest
+ * Reads a pack request line into \a request. Without a align option the alignment is 4 if
+ * mipmaps or compressed textures are generated and 1 otherwise, like on the command line.
+ * Returns false and sets \a error if the line is not a valid pack request.
+ */
+bool PackServer::parseRequest(const std::string &line, PackRequest *request, std::string *error)
+{
+    auto fail = [error](const std::string &message) {
+        if (error) *error = message;
+        return false;
+    };
+
+    std::istringstream in(line);
+    std::string command;
+    if (!(in >> command) || command != "pack")
+        return fail("Not a pack request");
+
+    *request = PackRequest();
+    BatchEntry &atlas = request->atlas;
+    if (!(in >> std::quoted(request->inputDirectory) >> std::quoted(atlas.basePath)))
+        return fail("Expected a input directory and a output basename");
+
+    bool hasAlignment = false;
+    std::string option;
+    while (in >> option) {
+        std::string value;
+        if (option == "recursive") {
+            request->recursive = true;
+        } else if (option == "trim") {
+            request->trim = true;
+        } else if (option == "mipmaps") {
+            atlas.mipmaps = true;
+        } else if (option == "no-png") {
+            atlas.exportPng = false;
+        } else if (option == "report") {
+            request->sendReport = true;
+        } else if (option == "compress") {
+            in >> value;
+            if (value == "bc1")
+                atlas.compression = BlockCompression::BC1;
+            else if (value == "bc3")
+                atlas.compression = BlockCompression::BC3;
+            else
+                return fail("Unknown block compression format " + value);
+        } else if (option == "align") {
+            if (!(in >> atlas.alignment) || atlas.alignment == 0)
+                return fail("align expects a positive number");
+            hasAlignment = true;
+        } else if (option == "split") {
+            in >> value;
+            if (value == "longer")
+                atlas.policy.split = SplitRule::LongerRemainder;
+            else if (value == "shorter")
+                atlas.policy.split = SplitRule::ShorterRemainder;
+            else
+                return fail("Unknown split rule " + value);
+        } else if (option == "fit") {
+            in >> value;
+            if (value == "first")
+                atlas.policy.fit = FitHeuristic::FirstFit;
+            else if (value == "best-area")
+                atlas.policy.fit = FitHeuristic::BestAreaFit;
+            else
+                return fail("Unknown fit heuristic " + value);
+        } else if (option == "optimize") {
+            if (!(in >> request->optimizeMs) || request->optimizeMs < 0)
+                return fail("optimize expects a time budget in milliseconds");
+        } else if (option == "decode-budget") {
+            if (!(in >> atlas.decodeBudget))
+                return fail("decode-budget expects a number of bytes");
+        } else if (option == "prefetch") {
+            if (!(in >> atlas.prefetchWindow))
+                return fail("prefetch expects a number of bytes");
+        } else if (option == "tiles") {
+            if (!(in >> atlas.tileSize) || atlas.tileSize == 0)
+                return fail("tiles expects a positive tile size");
+        } else {
+            return fail("Unknown option " + option);
+        }
+    }
+
+    if (!hasAlignment)
+        atlas.alignment = (atlas.mipmaps || atlas.compression != BlockCompression::None) ? 4 : 1;
+    if (!atlas.exportPng && atlas.compression == BlockCompression::None && !atlas.tileSize)
+        return fail("no-png requires a block compression format or tiles");
+    return true;
+}
+
+/*!
+ * \brief PackServer::sendRequest
+ * Sends \a request to the server listening on \a socketPath and waits for the answer.
+ * Every line of the answer is passed to \a response as it arrives, including the final one.
+ * Returns true if the atlas was created, otherwise false and \a error is set.
+ */
+bool PackServer::sendRequest(const std::string &socketPath, const PackRequest &request,
+                             LineCallback response, std::string *error)
+{
+#ifdef ATLASPACK_HAVE_UNIX_SOCKETS
+    sockaddr_un addr;
+    if (!socketAddress(socketPath, &addr, error))
+        return false;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        if (error) *error = std::string("Could not create the socket: ") + strerror(errno);
+        return false;
+    }
+    setCloseOnExec(fd);
+    disableSigPipe(fd);
+
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        if (error) *error = "Could not connect to " + socketPath + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    bool success = false;
+    bool answered = false;
+    if (sendLine(fd, formatRequest(request))) {
+        LineReader reader(fd);
+        std::string line;
+        while (!answered && reader.readLine(&line)) {
+            if (response)
+                response(line);
+
+            if (line == "ok" || line.compare(0, 3, "ok ") == 0) {
+                success = answered = true;
+            } else if (line.compare(0, 6, "error ") == 0) {
+                std::istringstream in(line.substr(6));
+                std::string message;
+                in >> std::quoted(message);
+                if (error) *error = message;
+                answered = true;
+            }
+        }
+    }
+    close(fd);
+
+    if (!answered && error)
+        *error = "The server closed the connection";
+    return success;
+#else
+    UNUSED(socketPath);
+    UNUSED(request);
+    UNUSED(response);
+    if (error) *error = "The pack server is not supported on this platform";
+    return false;
+#endif
+}
+
+}
@@ -24,6 +24,8 @@
 
 #include <AtlasPack/PaintDevice>
 
+#include <iostream>
+
 namespace AtlasPack {
 
 PaintDevice::~PaintDevice()
@@ -31,6 +33,79 @@ PaintDevice::~PaintDevice()
 
 }
 
+/**
+ * \fn AtlasPack::PaintDevice::paintImageFromFile(Pos topleft, std::string filename, Rect sourceRect)
+ * Paints only the area \a sourceRect of the image given by \a filename at position \a topleft,
+ * this is used to paint trimmed images. The default implementation does not support
+ * painting parts of a image and always returns false.
+ */
+bool PaintDevice::paintImageFromFile(Pos topleft, std::string filename, Rect sourceRect)
+{
+    UNUSED(topleft);
+    UNUSED(sourceRect);
+    std::cerr << "The paint device does not support painting parts of " << filename << std::endl;
+    return false;
+}
+
+/**
+ * \fn AtlasPack::PaintDevice::paintImageFromData(Pos topleft, std::string filename, const std::vector<unsigned char> &data)
+ * Paints the image \a filename at position \a topleft, decoding it from \a data, the content of the file that
+ * was already read into memory, see \sa AtlasPack::FilePrefetcher. The default implementation ignores \a data
+ * and calls \sa PaintDevice::paintImageFromFile.
+ */
+bool PaintDevice::paintImageFromData(Pos topleft, std::string filename, const std::vector<unsigned char> &data)
+{
+    UNUSED(data);
+    return paintImageFromFile(topleft, filename);
 }
 
+/**
+ * \fn AtlasPack::PaintDevice::paintImageFromData(Pos topleft, std::string filename, const std::vector<unsigned char> &data, Rect sourceRect)
+ * Paints only the area \a sourceRect of the image \a filename, decoded from \a data. The default
+ * implementation ignores \a data and calls \sa PaintDevice::paintImageFromFile.
+ */
+bool PaintDevice::paintImageFromData(Pos topleft, std::string filename, const std::vector<unsigned char> &data,
+                                     Rect sourceRect)
+{
+    UNUSED(data);
+    return paintImageFromFile(topleft, filename, sourceRect);
+}
 
+/**
+ * \fn AtlasPack::PaintDevice::decodesImageData
+ * Returns true if the paint device decodes the file content given to \sa PaintDevice::paintImageFromData,
+ * only then it is worth to read the files ahead. The default implementation returns false.
+ */
+bool PaintDevice::decodesImageData() const
+{
+    return false;
+}
+
+/**
+ * \fn AtlasPack::PaintDevice::paintImage
+ * Copies the RGBA pixels given by \a pixels into the paint device at position \a topleft,
+ * replacing the current content of that area. The default implementation does not support
+ * painting pixel buffers and always returns false.
+ */
+bool PaintDevice::paintImage(Pos topleft, const PixelView &pixels)
+{
+    UNUSED(topleft);
+    UNUSED(pixels);
+    std::cerr << "The paint device does not support painting pixel buffers" << std::endl;
+    return false;
+}
+
+/**
+ * \fn AtlasPack::PaintDevice::readPixels
+ * Reads the area \a rect of the paint device as RGBA pixels into \a target.
+ * The default implementation does not support reading back pixels and always returns false.
+ */
+bool PaintDevice::readPixels(const Rect &rect, PixelBuffer *target) const
+{
+    UNUSED(rect);
+    UNUSED(target);
+    std::cerr << "The paint device does not support reading pixels" << std::endl;
+    return false;
+}
+
+}
@@ -0,0 +1,339 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/pixelops_p.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ATLASPACK_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace AtlasPack {
+namespace PixelOps {
+
+/**
+ * @internal
+ * Returns the index of the first pixel in \a row with a alpha value
+ * different from 0, searching \a count pixels. Returns \a count if all pixels
+ * are fully transparent.
+ */
+static size_t firstOpaquePixel (const unsigned char *row, size_t count)
+{
+    size_t x = 0;
+#ifdef ATLASPACK_HAVE_SSE2
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m128i zero      = _mm_setzero_si128();
+
+    //test 4 pixels at once, the mask bit of a pixel is cleared if its alpha is set
+    for (; x + 4 <= count; x += 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x * 4));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(px, alphaMask), zero)));
+        if (mask != 0xF) {
+            while (mask & 1) {
+                mask >>= 1;
+                x++;
+            }
+            return x;
+        }
+    }
+#endif
+    for (; x < count; x++) {
+        if (row[x * 4 + 3] != 0)
+            return x;
+    }
+    return count;
+}
+
+/**
+ * @internal
+ * Returns the index of the last pixel in \a row with a alpha value
+ * different from 0, searching \a count pixels. Returns \a count if all pixels
+ * are fully transparent.
+ */
+static size_t lastOpaquePixel (const unsigned char *row, size_t count)
+{
+    size_t x = count;
+#ifdef ATLASPACK_HAVE_SSE2
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m128i zero      = _mm_setzero_si128();
+
+    for (; x >= 4; x -= 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + (x - 4) * 4));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(px, alphaMask), zero)));
+        if (mask != 0xF) {
+            while (mask & 0x8) {
+                mask <<= 1;
+                x--;
+            }
+            return x - 1;
+        }
+    }
+#endif
+    for (; x > 0; x--) {
+        if (row[(x - 1) * 4 + 3] != 0)
+            return x - 1;
+    }
+    return count;
+}
+
+/**
+ * @internal
+ * Calculates the smallest rectangle in \a pixels that contains all pixels with
+ * a alpha value different from 0. A fully transparent image results in a
+ * invalid rectangle with a size of 0x0.
+ */
+Rect opaqueRect (const PixelView &pixels)
+{
+    const size_t width  = pixels.size.width;
+    const size_t height = pixels.size.height;
+
+    size_t left   = width;
+    size_t right  = 0;
+    size_t top    = height;
+    size_t bottom = 0;
+
+    for (size_t y = 0; y < height; y++) {
+        const unsigned char *row = pixels.scanLine(y);
+
+        size_t first = firstOpaquePixel(row, width);
+        if (first == width)
+            continue;
+
+        if (top == height)
+            top = y;
+        bottom = y;
+
+        if (first < left)
+            left = first;
+
+        //only the part right of the current bounding box is of interest
+        if (right + 1 < width) {
+            size_t last = lastOpaquePixel(row + (right + 1) * 4, width - right - 1);
+            if (last != width - right - 1)
+                right = right + 1 + last;
+        }
+        if (first > right)
+            right = first;
+    }
+
+    if (top == height)
+        return Rect();
+
+    return Rect(Pos(left, top), Size(right - left + 1, bottom - top + 1));
+}
+
+
+/**
+ * @internal
+ * Returns the geometry of the next smaller mipmap level of a image with \a size
+ */
+Size mipmapSize (const Size &size)
+{
+    return Size(std::max<size_t>(1, size.width / 2), std::max<size_t>(1, size.height / 2));
+}
+
+/**
+ * @internal
+ * Calculates the rows \a firstRow up to but not including \a lastRow of \a target, which
+ * is the next mipmap level of \a source, using a 2x2 box filter. Odd pixels at the right
+ * and bottom border of \a source are dropped. Rows are independent of each other, so the
+ * work can be split up between multiple threads.
+ */
+void downsample (const PixelView &source, PixelBuffer *target, size_t firstRow, size_t lastRow)
+{
+    const size_t width = target->size().width;
+
+    for (size_t y = firstRow; y < lastRow; y++) {
+        const size_t sy0 = std::min(y * 2,     source.size.height - 1);
+        const size_t sy1 = std::min(y * 2 + 1, source.size.height - 1);
+        const unsigned char *row0 = source.scanLine(sy0);
+        const unsigned char *row1 = source.scanLine(sy1);
+        unsigned char *out = target->scanLine(y);
+
+        size_t x = 0;
+
+        //a source that is only 1 pixel wide can not be reduced horizontally
+        if (source.size.width < 2) {
+            for (size_t c = 0; c < 4; c++)
+                out[c] = static_cast<unsigned char>((row0[c] + row1[c] + 1) / 2);
+            continue;
+        }
+
+#ifdef ATLASPACK_HAVE_SSE2
+        const __m128i zero  = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi16(2);
+
+        //8 source pixels of both rows result in 4 target pixels
+        for (; x + 4 <= width; x += 4) {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8 + 16));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8 + 16));
+
+            //vertical sums, every register holds 2 neighbouring source pixels as 16 bit channels
+            __m128i v0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            __m128i v1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            __m128i v2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+            __m128i v3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+            //horizontal sums, the low 4 channels hold the sum of the pixel pair
+            v0 = _mm_add_epi16(v0, _mm_srli_si128(v0, 8));
+            v1 = _mm_add_epi16(v1, _mm_srli_si128(v1, 8));
+            v2 = _mm_add_epi16(v2, _mm_srli_si128(v2, 8));
+            v3 = _mm_add_epi16(v3, _mm_srli_si128(v3, 8));
+
+            __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(v0, v1), round), 2);
+            __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(v2, v3), round), 2);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x * 4), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; x < width; x++) {
+            const size_t sx0 = x * 8;
+            const size_t sx1 = sx0 + 4;
+            for (size_t c = 0; c < 4; c++) {
+                out[x * 4 + c] = static_cast<unsigned char>((row0[sx0 + c] + row0[sx1 + c]
+                                                             + row1[sx0 + c] + row1[sx1 + c] + 2) / 4);
+            }
+        }
+    }
+}
+
+/**
+ * @internal
+ * A source pixel that contributes to a pixel of a resampled image, \sa resample
+ */
+struct ResampleTap {
+    size_t source;
+    size_t weight;
+};
+
+/**
+ * @internal
+ * Returns the source pixels that cover the target pixel \a index, if a image with
+ * \a sourceLength pixels is scaled by \a scale / \a layoutScale. Positions are measured
+ * in a grid where a target pixel is \a layoutScale units long and a source pixel \a scale
+ * units, so the weight of a tap is the length of the overlap of both pixels.
+ */
+static std::vector<ResampleTap> resampleTaps (size_t index, size_t sourceLength, size_t scale, size_t layoutScale)
+{
+    std::vector<ResampleTap> taps;
+    const size_t begin = index * layoutScale;
+    const size_t end   = begin + layoutScale;
+
+    for (size_t i = begin / scale; i < sourceLength && i * scale < end; i++) {
+        const size_t overlap = std::min(end, (i + 1) * scale) - std::max(begin, i * scale);
+        if (overlap)
+            taps.push_back(ResampleTap{i, overlap});
+    }
+    return taps;
+}
+
+/**
+ * @internal
+ * Calculates the rows \a firstRow up to but not including \a lastRow of \a target, which is
+ * \a source scaled down by \a scale / \a layoutScale, using a area filter. The size of \a target
+ * is expected to be the size of \a source scaled and rounded up, the pixels at the right and
+ * bottom border are averaged over the part of the source that is available. Like \sa downsample
+ * rows are independent of each other.
+ */
+void resample (const PixelView &source, PixelBuffer *target, size_t scale, size_t layoutScale,
+               size_t firstRow, size_t lastRow)
+{
+    const size_t width = target->size().width;
+
+    std::vector<std::vector<ResampleTap>> columns(width);
+    for (size_t x = 0; x < width; x++)
+        columns[x] = resampleTaps(x, source.size.width, scale, layoutScale);
+
+    std::vector<uint32_t> sums(width * 4);
+    std::vector<uint32_t> weights(width);
+
+    for (size_t y = firstRow; y < lastRow; y++) {
+        std::fill(sums.begin(), sums.end(), 0);
+        std::fill(weights.begin(), weights.end(), 0);
+
+        for (const ResampleTap &row : resampleTaps(y, source.size.height, scale, layoutScale)) {
+            const unsigned char *in = source.scanLine(row.source);
+            for (size_t x = 0; x < width; x++) {
+                uint32_t *sum = sums.data() + x * 4;
+                for (const ResampleTap &col : columns[x]) {
+                    const uint32_t w = static_cast<uint32_t>(row.weight * col.weight);
+                    const unsigned char *px = in + col.source * 4;
+                    sum[0] += px[0] * w;
+                    sum[1] += px[1] * w;
+                    sum[2] += px[2] * w;
+                    sum[3] += px[3] * w;
+                    weights[x] += w;
+                }
+            }
+        }
+
+        unsigned char *out = target->scanLine(y);
+        for (size_t x = 0; x < width; x++) {
+            const uint32_t w = weights[x];
+            for (size_t c = 0; c < 4; c++)
+                out[x * 4 + c] = w ? static_cast<unsigned char>((sums[x * 4 + c] + w / 2) / w) : 0;
+        }
+    }
+}
+
+/**
+ * @internal
+ * Fills the area of \a cell that is not covered by \a content with the border pixels
+ * of \a content. Images are always placed at the top left corner of their cell, so only the
+ * right and bottom padding need to be filled. This keeps the filtering of mipmap levels from
+ * blending the background into the border of a image.
+ */
+void extendEdges (PixelBuffer *pixels, const Rect &content, const Rect &cell)
+{
+    const size_t x0 = content.topLeft.x;
+    const size_t y0 = content.topLeft.y;
+    const size_t contentRight  = x0 + content.size.width;
+    const size_t contentBottom = y0 + content.size.height;
+    const size_t cellRight  = std::min(cell.topLeft.x + cell.size.width,  pixels->size().width);
+    const size_t cellBottom = std::min(cell.topLeft.y + cell.size.height, pixels->size().height);
+
+    if (content.size.width == 0 || content.size.height == 0
+            || contentRight > cellRight || contentBottom > cellBottom)
+        return;
+
+    for (size_t y = y0; y < contentBottom; y++) {
+        unsigned char *row = pixels->scanLine(y);
+        const unsigned char *edge = row + (contentRight - 1) * 4;
+        for (size_t x = contentRight; x < cellRight; x++)
+            std::memcpy(row + x * 4, edge, 4);
+    }
+
+    const unsigned char *lastRow = pixels->scanLine(contentBottom - 1) + x0 * 4;
+    for (size_t y = contentBottom; y < cellBottom; y++)
+        std::memcpy(pixels->scanLine(y) + x0 * 4, lastRow, (cellRight - x0) * 4);
+}
+
+}
+}
@@ -0,0 +1,214 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/pngstream_p.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace AtlasPack {
+
+static const size_t ChunkSize = 1 << 20;
+
+//png filter type of every scanline, Up subtracts the pixels of the scanline above
+static const unsigned char FilterUp = 2;
+
+static void appendBigEndian (std::vector<unsigned char> *out, uint32_t value)
+{
+    out->push_back(static_cast<unsigned char>(value >> 24));
+    out->push_back(static_cast<unsigned char>(value >> 16));
+    out->push_back(static_cast<unsigned char>(value >> 8));
+    out->push_back(static_cast<unsigned char>(value));
+}
+
+PngStreamWriter::~PngStreamWriter()
+{
+    if (m_streamOpen)
+        deflateEnd(&m_stream);
+}
+
+/**
+ * @internal
+ * @brief PngStreamWriter::open
+ * Creates \a fileName and writes the png header for a image of \a size
+ */
+bool PngStreamWriter::open(const std::string &fileName, const Size &size, std::string *error)
+{
+    if (size.width == 0 || size.height == 0 || size.width > 0x7FFFFFFF || size.height > 0x7FFFFFFF) {
+        if (error) *error = "Invalid png image size";
+        return false;
+    }
+
+    if (m_streamOpen) {
+        deflateEnd(&m_stream);
+        m_streamOpen = false;
+    }
+
+    m_file.open(fileName, std::ios::binary | std::ios::trunc | std::ios::out);
+    if (!m_file.is_open()) {
+        if (error) *error = "Could not create image file " + fileName;
+        return false;
+    }
+
+    m_stream = z_stream();
+    if (deflateInit(&m_stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        if (error) *error = "Could not initialize the compression of " + fileName;
+        m_file.close();
+        return false;
+    }
+    m_streamOpen = true;
+
+    m_fileName = fileName;
+    m_size = size;
+    m_rowsWritten = 0;
+    m_previous.assign(size.width * 4, 0);
+    m_row.resize(size.width * 4 + 1);
+    m_chunk.clear();
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    m_file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+    //8 bit RGBA, no interlacing
+    std::vector<unsigned char> header;
+    appendBigEndian(&header, static_cast<uint32_t>(size.width));
+    appendBigEndian(&header, static_cast<uint32_t>(size.height));
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+    writeChunk("IHDR", header.data(), header.size());
+    return m_file.good();
+}
+
+/**
+ * @internal
+ * @brief PngStreamWriter::writeScanLine
+ * Appends the next scanline, \a pixels has to contain width RGBA pixels
+ */
+bool PngStreamWriter::writeScanLine(const unsigned char *pixels)
+{
+    if (!m_streamOpen || m_rowsWritten >= m_size.height)
+        return false;
+
+    //the first scanline is compared to a row of zeros, which leaves it unchanged
+    const size_t length = m_size.width * 4;
+    m_row[0] = FilterUp;
+    for (size_t i = 0; i < length; i++)
+        m_row[i + 1] = static_cast<unsigned char>(pixels[i] - m_previous[i]);
+    std::copy(pixels, pixels + length, m_previous.begin());
+
+    if (!compress(m_row.data(), m_row.size(), Z_NO_FLUSH))
+        return false;
+    m_rowsWritten++;
+    return m_file.good();
+}
+
+/**
+ * @internal
+ * @brief PngStreamWriter::finish
+ * Writes the remaining image data and the end of the file, fails if not
+ * all scanlines were written
+ */
+bool PngStreamWriter::finish(std::string *error)
+{
+    if (!m_streamOpen || m_rowsWritten != m_size.height) {
+        if (error) *error = "Not all scanlines of " + m_fileName + " were written";
+        return false;
+    }
+
+    const bool compressed = compress(nullptr, 0, Z_FINISH);
+    deflateEnd(&m_stream);
+    m_streamOpen = false;
+    if (!compressed) {
+        if (error) *error = "Failed to compress image file " + m_fileName;
+        return false;
+    }
+
+    flushChunk();
+    writeChunk("IEND", nullptr, 0);
+
+    m_file.close();
+    if (m_file.fail()) {
+        if (error) *error = "Failed to write image file " + m_fileName;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @internal
+ * Hands \a length bytes of \a data to zlib and collects the compressed output in the
+ * next IDAT chunk, which is written once it is big enough
+ */
+bool PngStreamWriter::compress(const unsigned char *data, size_t length, int flush)
+{
+    unsigned char out[64 * 1024];
+    do {
+        //zlib counts the input with 32 bit, very wide scanlines are passed in pieces
+        const size_t piece = std::min<size_t>(length, std::numeric_limits<uInt>::max());
+        m_stream.next_in  = const_cast<Bytef *>(data);
+        m_stream.avail_in = static_cast<uInt>(piece);
+        data += piece;
+        length -= piece;
+
+        const int pieceFlush = length ? Z_NO_FLUSH : flush;
+        do {
+            m_stream.next_out  = out;
+            m_stream.avail_out = sizeof(out);
+            if (deflate(&m_stream, pieceFlush) == Z_STREAM_ERROR)
+                return false;
+            m_chunk.insert(m_chunk.end(), out, out + (sizeof(out) - m_stream.avail_out));
+        } while (m_stream.avail_out == 0);
+    } while (length);
+
+    if (m_chunk.size() >= ChunkSize)
+        flushChunk();
+    return true;
+}
+
+void PngStreamWriter::flushChunk()
+{
+    if (m_chunk.empty())
+        return;
+    writeChunk("IDAT", m_chunk.data(), m_chunk.size());
+    m_chunk.clear();
+}
+
+void PngStreamWriter::writeChunk(const char *type, const unsigned char *data, size_t length)
+{
+    std::vector<unsigned char> head;
+    appendBigEndian(&head, static_cast<uint32_t>(length));
+    head.insert(head.end(), type, type + 4);
+
+    uLong crc = crc32(0, head.data() + 4, 4);
+    if (length)
+        crc = crc32(crc, data, static_cast<uInt>(length));
+
+    std::vector<unsigned char> tail;
+    appendBigEndian(&tail, static_cast<uint32_t>(crc));
+
+    m_file.write(reinterpret_cast<const char *>(head.data()), head.size());
+    if (length)
+        m_file.write(reinterpret_cast<const char *>(data), length);
+    m_file.write(reinterpret_cast<const char *>(tail.data()), tail.size());
+}
+
+}
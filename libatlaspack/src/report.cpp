@@ -0,0 +1,243 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/Report>
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace AtlasPack {
+
+/*!
+ * \brief DurationHistogram::add
+ * Records a duration of \a milliseconds
+ */
+void DurationHistogram::add(double milliseconds)
+{
+    minMs = count == 0 ? milliseconds : std::min(minMs, milliseconds);
+    maxMs = count == 0 ? milliseconds : std::max(maxMs, milliseconds);
+    totalMs += milliseconds;
+    count++;
+
+    size_t bucket = 0;
+    double limit = 0.001;
+    while (milliseconds >= limit && bucket < 63) {
+        limit *= 2;
+        bucket++;
+    }
+
+    if (buckets.size() <= bucket)
+        buckets.resize(bucket + 1, 0);
+    buckets[bucket]++;
+}
+
+/*!
+ * \brief peakMemoryUsage
+ * Returns the peak resident memory of the current process in bytes, or 0
+ * if it is not available on the platform.
+ */
+size_t peakMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static void writeHistogram (std::ostream &out, const DurationHistogram &hist)
+{
+    out << "{ \"count\": " << hist.count
+        << ", \"total_ms\": " << hist.totalMs
+        << ", \"min_ms\": " << hist.minMs
+        << ", \"max_ms\": " << hist.maxMs
+        << ", \"mean_ms\": " << (hist.count ? hist.totalMs / hist.count : 0.0)
+        << ", \"buckets\": [";
+
+    //every bucket is written with its upper limit in microseconds
+    double limit = 1;
+    for (size_t i = 0; i < hist.buckets.size(); i++, limit *= 2) {
+        if (i) out << ", ";
+        out << "{ \"below_us\": " << limit << ", \"count\": " << hist.buckets[i] << " }";
+    }
+    out << "] }";
+}
+
+static void writeQueueStats (std::ostream &out, const JobQueueStats &stats, const char *indent)
+{
+    out << "{\n"
+        << indent << "  \"uptime_ms\": " << stats.uptimeMs << ",\n"
+        << indent << "  \"queue_depth\": " << stats.queueDepth << ",\n"
+        << indent << "  \"peak_queue_depth\": " << stats.peakQueueDepth << ",\n"
+        << indent << "  \"average_queue_depth\": " << stats.averageQueueDepth << ",\n"
+        << indent << "  \"depth_samples\": [";
+    //every sample is written as [ms, depth]
+    for (size_t i = 0; i < stats.depthSamples.size(); i++)
+        out << (i ? ", " : "") << "[" << stats.depthSamples[i].timeMs << ", " << stats.depthSamples[i].depth << "]";
+    out << "],\n"
+        << indent << "  \"running_tasks\": " << stats.runningTasks << ",\n"
+        << indent << "  \"enqueued_tasks\": " << stats.enqueuedTasks << ",\n"
+        << indent << "  \"finished_tasks\": " << stats.finishedTasks << ",\n"
+        << indent << "  \"wait_calls\": " << stats.waitCalls << ",\n"
+        << indent << "  \"wait_times\": ";
+    writeHistogram(out, stats.waitTimes);
+    out << ",\n"
+        << indent << "  \"lane_wait_times\": {";
+    static const char *laneNames[] = { "high", "normal", "low" };
+    for (size_t i = 0; i < stats.laneWaitTimes.size() && i < 3; i++) {
+        out << (i ? ", " : " ") << "\"" << laneNames[i] << "\": ";
+        writeHistogram(out, stats.laneWaitTimes[i]);
+    }
+    out << " },\n"
+        << indent << "  \"pinned_workers\": " << stats.pinnedWorkers << ",\n"
+        << indent << "  \"run_times\": ";
+    writeHistogram(out, stats.runTimes);
+    out << ",\n"
+        << indent << "  \"workers\": [";
+    for (size_t i = 0; i < stats.workerBusyMs.size(); i++) {
+        out << (i ? ", " : "")
+            << "{ \"busy_ms\": " << stats.workerBusyMs[i]
+            << ", \"utilization\": " << stats.workerUtilization[i] << " }";
+    }
+    out << "]\n"
+        << indent << "}";
+}
+
+/*!
+ * \brief PackReport::writeJson
+ * Writes the report as JSON object into \a out
+ */
+void PackReport::writeJson(std::ostream &out) const
+{
+    out << "{\n"
+        << "  \"images\": " << imageCount << ",\n"
+        << "  \"scan_ms\": " << scanMs << ",\n"
+        << "  \"probe_ms\": " << probeMs << ",\n"
+        << "  \"search\": {\n"
+        << "    \"total_ms\": " << search.milliseconds << ",\n"
+        << "    \"rounds\": [";
+
+    for (size_t i = 0; i < search.rounds.size(); i++) {
+        const SearchRound &round = search.rounds[i];
+        out << (i ? ",\n" : "\n")
+            << "      { \"phase\": \"" << (round.growing ? "grow" : "shrink") << "\""
+            << ", \"first_size\": " << round.firstSize.width
+            << ", \"last_size\": " << round.lastSize.width
+            << ", \"trials\": " << round.trials
+            << ", \"found_fit\": " << (round.foundFit ? "true" : "false")
+            << ", \"ms\": " << round.milliseconds << " }";
+    }
+
+    out << "\n    ],\n"
+        << "    \"queue\": ";
+    writeQueueStats(out, search.queue, "    ");
+    out << "\n"
+        << "  },\n"
+        << "  \"optimize\": {\n"
+        << "    \"total_ms\": " << optimize.milliseconds << ",\n"
+        << "    \"lower_bound\": " << optimize.lowerBound << ",\n"
+        << "    \"initial_size\": " << optimize.initialSize << ",\n"
+        << "    \"final_size\": " << optimize.finalSize << ",\n"
+        << "    \"epochs\": " << optimize.epochs << ",\n"
+        << "    \"improvements\": " << optimize.improvements << ",\n"
+        << "    \"evaluations\": " << optimize.evaluations << ",\n"
+        << "    \"queue\": ";
+    writeQueueStats(out, optimize.queue, "    ");
+    out << "\n"
+        << "  },\n"
+        << "  \"hierarchical\": {\n"
+        << "    \"total_ms\": " << hierarchical.milliseconds << ",\n"
+        << "    \"clusters\": " << hierarchical.clusters << ",\n"
+        << "    \"cluster_size\": " << hierarchical.clusterSize << ",\n"
+        << "    \"columns\": " << hierarchical.columns << ",\n"
+        << "    \"cluster_ms\": " << hierarchical.clusterMs << ",\n"
+        << "    \"combine_ms\": " << hierarchical.combineMs << ",\n"
+        << "    \"cell_area\": " << hierarchical.cellArea << ",\n"
+        << "    \"block_area\": " << hierarchical.blockArea << "\n"
+        << "  },\n"
+        << "  \"compile\": {\n"
+        << "    \"collect_ms\": " << compile.collectMs << ",\n"
+        << "    \"paint_ms\": " << compile.paintMs << ",\n"
+        << "    \"mipmap_ms\": " << compile.mipmapMs << ",\n"
+        << "    \"compress_ms\": " << compile.compressMs << ",\n"
+        << "    \"export_ms\": " << compile.exportMs << ",\n"
+        << "    \"manifest_ms\": " << compile.manifestMs << ",\n"
+        << "    \"total_ms\": " << compile.totalMs << ",\n"
+        << "    \"paint_tasks\": ";
+    writeHistogram(out, compile.paintTasks);
+    out << ",\n"
+        << "    \"decode_budget_bytes\": " << compile.decodeBudget << ",\n"
+        << "    \"peak_decode_bytes\": " << compile.peakDecodeBytes << ",\n"
+        << "    \"admission_wait_ms\": " << compile.admissionWaitMs << ",\n"
+        << "    \"prefetch\": { \"io_uring\": " << (compile.prefetch.ioUring ? "true" : "false")
+        << ", \"window_bytes\": " << compile.prefetch.windowBytes
+        << ", \"files\": " << compile.prefetch.files
+        << ", \"bytes\": " << compile.prefetch.bytes
+        << ", \"ready\": " << compile.prefetch.ready
+        << ", \"waited\": " << compile.prefetch.waited
+        << ", \"direct\": " << compile.prefetch.direct
+        << ", \"failed\": " << compile.prefetch.failed
+        << ", \"wait_ms\": " << compile.prefetch.waitMs << " },\n"
+        << "    \"tiles\": { \"tile_size\": " << compile.tiles.tileSize
+        << ", \"tiles\": " << compile.tiles.tiles
+        << ", \"changed\": " << compile.tiles.changedTiles
+        << ", \"removed\": " << compile.tiles.removedTiles
+        << ", \"full\": " << (compile.tiles.full ? "true" : "false")
+        << ", \"bytes_written\": " << compile.tiles.bytesWritten
+        << ", \"hash_ms\": " << compile.tiles.hashMs
+        << ", \"write_ms\": " << compile.tiles.writeMs << " },\n"
+        << "    \"variants\": " << compile.variants << ",\n"
+        << "    \"variant_ms\": " << compile.variantMs << ",\n"
+        << "    \"images\": " << compile.imageCount << ",\n"
+        << "    \"atlas_width\": " << compile.atlasSize.width << ",\n"
+        << "    \"atlas_height\": " << compile.atlasSize.height << ",\n"
+        << "    \"used_area\": " << compile.usedArea << ",\n"
+        << "    \"wasted_area\": " << compile.wastedArea << ",\n"
+        << "    \"occupancy\": " << compile.occupancy << ",\n"
+        << "    \"queue\": ";
+    writeQueueStats(out, compile.queue, "    ");
+    out << "\n"
+        << "  },\n"
+        << "  \"peak_memory_bytes\": " << peakMemory << "\n"
+        << "}\n";
+}
+
+}
@@ -0,0 +1,455 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/ShardedCompiler>
+#include <AtlasPack/TiledPaintDevice>
+#include <AtlasPack/textureatlas_p.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ATLASPACK_HAVE_SPAWN
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace AtlasPack {
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs (Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static const char *PlanMagic = "atlaspack-shards";
+static const int PlanVersion = 1;
+
+/**
+ * @internal
+ * A image file of the layout and the position it is painted at
+ */
+struct ShardEntry {
+    Image image;
+    Pos   pos;
+};
+
+/**
+ * @internal
+ * The layout the coordinator hands to the worker processes
+ */
+struct ShardPlan {
+    std::string canvasFile;
+    Size size;
+    unsigned int shards = 1;
+    std::vector<ShardEntry> entries;
+
+    //the canvas is split into horizontal bands, every image belongs
+    //to the band its top left corner is located in
+    unsigned int shardOf (const Pos &pos) const {
+        const size_t bandHeight = (size.height + shards - 1) / shards;
+        return static_cast<unsigned int>(std::min<size_t>(shards - 1, pos.y / bandHeight));
+    }
+
+    bool write (const std::string &fileName, std::string *err) const;
+    bool read (const std::string &fileName, std::string *err);
+};
+
+bool ShardPlan::write(const std::string &fileName, std::string *err) const
+{
+    std::ofstream out(fileName, std::ios::trunc | std::ios::out);
+    out << PlanMagic << " " << PlanVersion << "\n"
+        << std::quoted(canvasFile) << "\n"
+        << size.width << " " << size.height << " " << shards << "\n"
+        << entries.size() << "\n";
+
+    for (const ShardEntry &entry : entries) {
+        const Rect content = entry.image.contentRect();
+        out << std::quoted(entry.image.path()) << " "
+            << entry.pos.x << " " << entry.pos.y << " "
+            << entry.image.sourceSize().width << " " << entry.image.sourceSize().height << " "
+            << content.topLeft.x << " " << content.topLeft.y << " "
+            << content.size.width << " " << content.size.height << "\n";
+    }
+
+    out.close();
+    if (out.fail()) {
+        if (err) *err = "Failed to write the shard plan " + fileName;
+        return false;
+    }
+    return true;
+}
+
+bool ShardPlan::read(const std::string &fileName, std::string *err)
+{
+    std::ifstream in(fileName);
+    std::string magic;
+    int version = 0;
+    size_t count = 0;
+
+    in >> magic >> version >> std::quoted(canvasFile) >> size.width >> size.height >> shards >> count;
+    if (!in || magic != PlanMagic || version != PlanVersion || shards == 0) {
+        if (err) *err = "Invalid shard plan " + fileName;
+        return false;
+    }
+
+    entries.clear();
+    entries.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        std::string path;
+        Pos pos;
+        Size source;
+        Rect content;
+        in >> std::quoted(path) >> pos.x >> pos.y >> source.width >> source.height
+           >> content.topLeft.x >> content.topLeft.y >> content.size.width >> content.size.height;
+        if (!in) {
+            if (err) *err = "Truncated shard plan " + fileName;
+            return false;
+        }
+        entries.push_back(ShardEntry{Image(path, source, content), pos});
+    }
+    return true;
+}
+
+static std::string shardResultFile (const std::string &planFile, unsigned int shard)
+{
+    return planFile + "." + std::to_string(shard) + ".done";
+}
+
+class ShardedCompilerPrivate {
+    public:
+        bool runShards (const std::string &planFile, unsigned int shards, std::string *err) const;
+
+        std::string m_executable;
+        Backend *m_backend = nullptr;
+        unsigned int m_shards = std::max(1u, std::thread::hardware_concurrency());
+};
+
+/**
+ * @internal
+ * @brief ShardedCompilerPrivate::runShards
+ * Starts one worker process per shard and waits until all of them exited
+ */
+bool ShardedCompilerPrivate::runShards(const std::string &planFile, unsigned int shards, std::string *err) const
+{
+#ifdef ATLASPACK_HAVE_SPAWN
+    std::vector<pid_t> workers;
+    bool success = true;
+
+    for (unsigned int shard = 0; shard < shards; shard++) {
+        std::vector<std::string> args { m_executable, "--shard-worker", planFile, "--shard-index", std::to_string(shard) };
+        std::vector<char *> argv;
+        for (std::string &arg : args)
+            argv.push_back(&arg[0]);
+        argv.push_back(nullptr);
+
+        pid_t pid = 0;
+        int res = posix_spawnp(&pid, m_executable.c_str(), nullptr, nullptr, argv.data(), environ);
+        if (res != 0) {
+            if (err) *err = "Could not start the worker process " + m_executable + ": " + strerror(res);
+            success = false;
+            break;
+        }
+        workers.push_back(pid);
+    }
+
+    //always wait for the workers that were started, even if starting another one failed
+    for (size_t shard = 0; shard < workers.size(); shard++) {
+        int status = 0;
+        while (waitpid(workers[shard], &status, 0) < 0 && errno == EINTR) {}
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (success && err) *err = "The worker process of shard " + std::to_string(shard) + " failed";
+            success = false;
+        }
+    }
+    return success;
+#else
+    UNUSED(planFile);
+    UNUSED(shards);
+    if (err) *err = "Sharded compiles are not supported on this platform";
+    return false;
+#endif
+}
+
+/**
+ * \class AtlasPack::ShardedCompiler
+ * Compiles a packed atlas with several worker processes instead of threads. The calling
+ * process writes the layout into a plan file, then starts one process per shard, each one paints
+ * the images of one horizontal band of the atlas into a shared tile file, \sa AtlasPack::TiledPaintDevice::openFile.
+ * Once all workers are done the results are merged and the atlas image and description are written.
+ *
+ * Every worker has its own address space and image decoder, a crashing decoder only fails one shard
+ * and the workers do not share the locks of the decoding library.
+ *
+ * The workers are started as "\a workerExecutable --shard-worker <plan> --shard-index <n>", the
+ * executable has to call \sa ShardedCompiler::runWorker with these arguments. In-memory images are
+ * painted by the calling process. Mipmaps and block compression are not supported.
+ *
+ * The plan, the tile file and the shard results are written next to the atlas as <basePath>.plan,
+ * <basePath>.canvas and <basePath>.plan.<n>.done, and removed when the compile ends. A compile
+ * fails instead of overwriting any of them if they already exist.
+ */
+ShardedCompiler::ShardedCompiler(const std::string &workerExecutable, Backend *backend)
+    : p(new ShardedCompilerPrivate())
+{
+    p->m_executable = workerExecutable;
+    p->m_backend = backend;
+}
+
+ShardedCompiler::~ShardedCompiler()
+{
+    if (p) delete p;
+}
+
+/*!
+ * \brief ShardedCompiler::setShardCount
+ * Sets the number of worker processes, defaults to the number of cores
+ */
+void ShardedCompiler::setShardCount(unsigned int shards)
+{
+    p->m_shards = std::max(1u, shards);
+}
+
+unsigned int ShardedCompiler::shardCount() const
+{
+    return p->m_shards;
+}
+
+/*!
+ * \brief ShardedCompiler::compile
+ * Paints the layout of \a packer with the worker processes and writes the atlas image and
+ * description to \a basePath, like \sa TextureAtlasPacker::compile.
+ */
+TextureAtlas ShardedCompiler::compile(const TextureAtlasPacker &packer, const std::string &basePath,
+                                      std::string *error, CompileReport *report) const
+{
+    auto compileStart = Clock::now();
+    CompileReport localReport;
+    if (!report)
+        report = &localReport;
+    *report = CompileReport();
+
+    const fs::path outputDir = fs::path(basePath + ".atlas").parent_path();
+    if (!fs::exists(outputDir) || !fs::is_directory(outputDir)) {
+        if (error) *error = "Basepath is not a directory or does not exist";
+        return TextureAtlas();
+    }
+
+    const std::vector<Placement> placements = packer.placements();
+
+    ShardPlan plan;
+    plan.canvasFile = basePath + ".canvas";
+    plan.size = packer.size();
+    plan.shards = static_cast<unsigned int>(std::min<size_t>(p->m_shards, std::max<size_t>(1, plan.size.height)));
+
+    std::vector<const Placement *> inMemory;
+    for (const Placement &placement : placements) {
+        if (placement.image.isInMemory())
+            inMemory.push_back(&placement);
+        else
+            plan.entries.push_back(ShardEntry{placement.image, placement.cell.topLeft});
+    }
+
+    //the intermediate files of this run, they must not exist yet, so cleaning up never
+    //removes a file that belongs to somebody else
+    const std::string planFile = basePath + ".plan";
+    std::vector<std::string> scratchFiles = { planFile, plan.canvasFile };
+    for (unsigned int shard = 0; shard < plan.shards; shard++) {
+        scratchFiles.push_back(shardResultFile(planFile, shard));
+        scratchFiles.push_back(shardResultFile(planFile, shard) + ".tmp");
+    }
+    for (const std::string &file : scratchFiles) {
+        boost::system::error_code ec;
+        if (fs::exists(file, ec)) {
+            if (error) *error = "The file " + file + " already exists, remove it if no other compile is running";
+            return TextureAtlas();
+        }
+    }
+
+    auto cleanup = [&]() {
+        boost::system::error_code ec;
+        for (const std::string &file : scratchFiles)
+            fs::remove(file, ec);
+    };
+
+    //start with a empty canvas, the tile file is created by the first device that opens it
+    if (!plan.write(planFile, error) || !TiledPaintDevice::openFile(plan.canvasFile, plan.size, p->m_backend)->isValid()) {
+        if (error && error->empty()) *error = "Could not create the shared canvas " + plan.canvasFile;
+        cleanup();
+        return TextureAtlas();
+    }
+
+    auto phaseStart = Clock::now();
+    if (!p->runShards(planFile, plan.shards, error)) {
+        cleanup();
+        return TextureAtlas();
+    }
+
+    //merge the results, every image has to be painted by its shard
+    std::vector<bool> painted(plan.entries.size(), false);
+    for (unsigned int shard = 0; shard < plan.shards; shard++) {
+        std::ifstream result(shardResultFile(planFile, shard));
+        size_t idx = 0;
+        while (result >> idx) {
+            if (idx < painted.size() && plan.shardOf(plan.entries[idx].pos) == shard)
+                painted[idx] = true;
+        }
+    }
+    for (size_t idx = 0; idx < painted.size(); idx++) {
+        if (!painted[idx]) {
+            if (error) *error = "Image " + plan.entries[idx].image.path() + " was not painted by its shard";
+            cleanup();
+            return TextureAtlas();
+        }
+    }
+
+    std::shared_ptr<TiledPaintDevice> canvas = TiledPaintDevice::openFile(plan.canvasFile, plan.size, p->m_backend);
+    for (const Placement *placement : inMemory) {
+        std::shared_ptr<const PixelBuffer> pixels = placement->image.pixels();
+        if (!pixels || !canvas->paintImage(placement->cell.topLeft, pixels->view().region(placement->image.contentRect()))) {
+            if (error) *error = "Failed to paint image " + placement->image.path();
+            cleanup();
+            return TextureAtlas();
+        }
+    }
+    report->paintMs = elapsedMs(phaseStart);
+
+    //hand the canvas to the encoder of the backend band by band
+    phaseStart = Clock::now();
+    std::shared_ptr<PaintDevice> painter = p->m_backend->createPaintDevice(plan.size);
+    for (size_t y = 0; y < plan.size.height; y += TiledPaintDevice::TileSize) {
+        const Rect band(Pos(0, y), Size(plan.size.width, std::min(TiledPaintDevice::TileSize, plan.size.height - y)));
+        PixelBuffer pixels;
+        if (!canvas->readPixels(band, &pixels) || !painter->paintImage(band.topLeft, pixels.view())) {
+            if (error) *error = "Failed to copy the shared canvas";
+            cleanup();
+            return TextureAtlas();
+        }
+    }
+    canvas.reset();
+
+    if (!painter->exportToFile(basePath + ".png")) {
+        if (error) *error = "Failed to export Texture to file";
+        cleanup();
+        return TextureAtlas();
+    }
+    report->exportMs = elapsedMs(phaseStart);
+    cleanup();
+
+    phaseStart = Clock::now();
+    if (!packer.writeDescription(basePath + ".atlas", error))
+        return TextureAtlas();
+    report->manifestMs = elapsedMs(phaseStart);
+
+    std::unique_ptr<TextureAtlasPrivate> priv = std::make_unique<TextureAtlasPrivate>();
+    for (const Placement &placement : placements)
+        priv->m_textures[placement.image.path()] = Texture(placement.cell.topLeft, placement.image);
+    priv->buildIndex();
+
+    report->imageCount = priv->m_textures.size();
+    report->atlasSize  = plan.size;
+    for (const Placement &placement : placements)
+        report->usedArea += placement.image.width() * placement.image.height();
+    const size_t atlasArea = plan.size.width * plan.size.height;
+    report->wastedArea = atlasArea - std::min(atlasArea, report->usedArea);
+    report->occupancy  = atlasArea ? static_cast<double>(report->usedArea) / atlasArea : 0.0;
+    report->totalMs    = elapsedMs(compileStart);
+
+    return TextureAtlas(priv.release());
+}
+
+/*!
+ * \brief ShardedCompiler::runWorker
+ * Paints all images of \a shard listed in \a planFile into the shared canvas, decoding them
+ * with \a backend. This is called by the worker processes started from \sa ShardedCompiler::compile.
+ */
+bool ShardedCompiler::runWorker(const std::string &planFile, unsigned int shard, const Backend *backend, std::string *error)
+{
+    ShardPlan plan;
+    if (!plan.read(planFile, error))
+        return false;
+
+    if (shard >= plan.shards) {
+        if (error) *error = "Invalid shard index " + std::to_string(shard);
+        return false;
+    }
+
+    std::vector<size_t> painted;
+    {
+        std::shared_ptr<TiledPaintDevice> canvas = TiledPaintDevice::openFile(plan.canvasFile, plan.size, backend);
+        if (!canvas->isValid()) {
+            if (error) *error = "Could not open the shared canvas " + plan.canvasFile;
+            return false;
+        }
+
+        for (size_t idx = 0; idx < plan.entries.size(); idx++) {
+            const ShardEntry &entry = plan.entries[idx];
+            if (plan.shardOf(entry.pos) != shard)
+                continue;
+
+            bool ok = entry.image.isTrimmed()
+                    ? canvas->paintImageFromFile(entry.pos, entry.image.path(), entry.image.contentRect())
+                    : canvas->paintImageFromFile(entry.pos, entry.image.path());
+            if (!ok) {
+                if (error) *error = "Failed to paint image " + entry.image.path();
+                return false;
+            }
+            painted.push_back(idx);
+        }
+    }
+
+    //the result is renamed into place, so a partially written file is never merged
+    const std::string resultFile = shardResultFile(planFile, shard);
+    std::ofstream out(resultFile + ".tmp", std::ios::trunc | std::ios::out);
+    for (size_t idx : painted)
+        out << idx << "\n";
+    out.close();
+
+    boost::system::error_code ec;
+    if (!out.fail())
+        fs::rename(resultFile + ".tmp", resultFile, ec);
+    if (out.fail() || ec) {
+        fs::remove(resultFile + ".tmp", ec);
+        if (error) *error = "Failed to write the shard result " + resultFile;
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,305 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/SizeSearch>
+#include <AtlasPack/JobQueue>
+
+#include <chrono>
+
+namespace AtlasPack {
+
+using PackerPtr = std::shared_ptr<TextureAtlasPacker>;
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs (Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+class SizeSearchPrivate {
+    public:
+        SizeSearchPrivate (size_t threads)
+            : m_ownJobs(new JobQueue<bool>(threads)), m_jobs(m_ownJobs.get()) {}
+        SizeSearchPrivate (JobQueue<bool> *jobs)
+            : m_jobs(jobs) {}
+
+        PackerPtr tryPack (const Size &size, const std::vector<Image> &images) const;
+        std::vector<PackerPtr> tryPackAll (const std::vector<Size> &sizes, const std::vector<Image> &images) const;
+
+        std::unique_ptr<JobQueue<bool> > m_ownJobs;
+        JobQueue<bool> *m_jobs = nullptr;
+        size_t m_startSize = 1000;
+        size_t m_increment = 100;
+        size_t m_alignment = 1;
+        PackPolicy m_policy;
+};
+
+/**
+ * @internal
+ * @brief SizeSearchPrivate::tryPack
+ * Packs all \a images into a new atlas of \a size, returns a empty pointer if they do not fit.
+ */
+PackerPtr SizeSearchPrivate::tryPack(const Size &size, const std::vector<Image> &images) const
+{
+    PackerPtr result = std::make_shared<TextureAtlasPacker>(size, m_policy);
+    result->setPlacementAlignment(m_alignment);
+    if (!result->insertImages(images))
+        return PackerPtr();
+    return result;
+}
+
+/**
+ * @internal
+ * @brief SizeSearchPrivate::tryPackAll
+ * Tries all \a sizes in parallel, the result at index i is the packer for sizes[i] or a empty
+ * pointer if the images did not fit. Only waits for its own tasks, so the queue can be shared.
+ */
+std::vector<PackerPtr> SizeSearchPrivate::tryPackAll(const std::vector<Size> &sizes, const std::vector<Image> &images) const
+{
+    std::vector<PackerPtr> results(sizes.size());
+    std::vector<std::future<bool> > tasks;
+    tasks.reserve(sizes.size());
+
+    for (size_t i = 0; i < sizes.size(); i++) {
+        const Size mySize = sizes[i];
+        PackerPtr *slot = &results[i];
+        tasks.push_back(m_jobs->addTask([this, mySize, slot, &images]() {
+            *slot = tryPack(mySize, images);
+            return true;
+        }, Trace::isEnabled() ? "pack " + std::to_string(mySize.width) + "x" + std::to_string(mySize.height) : std::string(),
+        TaskPriority::High));
+    }
+
+    for (std::future<bool> &task : tasks)
+        task.get();
+    return results;
+}
+
+/**
+ * @class SizeSearch::SizeSearch
+ * Searches the smallest quadratic \a AtlasPack::TextureAtlasPacker that can take in a list of images.
+ * Starting at \a startSize the atlas is grown by \a increment until all images fit, then it is
+ * shrunk pixel by pixel until the images do not fit anymore. Each round of the search tries as many
+ * sizes in parallel as there are worker threads.
+ *
+ * \a threads specifies the number of worker threads, 0 uses one thread per core.
+ */
+SizeSearch::SizeSearch(size_t threads)
+    : p(new SizeSearchPrivate(threads))
+{
+
+}
+
+/*!
+ * \brief SizeSearch::SizeSearch
+ * Creates a search that runs its trials on the shared \a jobs queue, which
+ * has to outlive the search. \sa AtlasPack::BatchCompiler
+ */
+SizeSearch::SizeSearch(JobQueue<bool> *jobs)
+    : p(new SizeSearchPrivate(jobs))
+{
+
+}
+
+SizeSearch::~SizeSearch()
+{
+    if (p) delete p;
+}
+
+/*!
+ * \brief SizeSearch::setStartSize
+ * Sets the edge length of the first atlas that is tried, defaults to 1000
+ */
+void SizeSearch::setStartSize(size_t size)
+{
+    p->m_startSize = size;
+}
+
+size_t SizeSearch::startSize() const
+{
+    return p->m_startSize;
+}
+
+/*!
+ * \brief SizeSearch::setIncrement
+ * Sets the step the atlas edge length is grown by until all images fit, defaults to 100
+ */
+void SizeSearch::setIncrement(size_t increment)
+{
+    p->m_increment = increment > 0 ? increment : 1;
+}
+
+size_t SizeSearch::increment() const
+{
+    return p->m_increment;
+}
+
+/*!
+ * \brief SizeSearch::setPlacementAlignment
+ * Sets the placement alignment of all tried atlases, \sa TextureAtlasPacker::setPlacementAlignment
+ */
+void SizeSearch::setPlacementAlignment(size_t alignment)
+{
+    p->m_alignment = alignment > 0 ? alignment : 1;
+}
+
+size_t SizeSearch::placementAlignment() const
+{
+    return p->m_alignment;
+}
+
+/*!
+ * \brief SizeSearch::setPackPolicy
+ * Sets the split rule and fit heuristic every trial atlas is packed with
+ */
+void SizeSearch::setPackPolicy(const PackPolicy &policy)
+{
+    p->m_policy = policy;
+}
+
+PackPolicy SizeSearch::packPolicy() const
+{
+    return p->m_policy;
+}
+
+/*!
+ * \brief SizeSearch::threadCount
+ * Returns the number of atlas sizes that are tried in parallel
+ */
+unsigned int SizeSearch::threadCount() const
+{
+    return p->m_jobs->maxJobs();
+}
+
+/*!
+ * \brief SizeSearch::run
+ * Searches the smallest atlas that can contain all \a images and returns it,
+ * the returned packer already contains all images. If \a report is set, the
+ * timing of every search round is recorded there.
+ * Returns a empty pointer if \a images is empty.
+ */
+std::shared_ptr<TextureAtlasPacker> SizeSearch::run(const std::vector<Image> &images, SearchReport *report)
+{
+    if (images.empty())
+        return PackerPtr();
+
+    auto searchStart = Clock::now();
+    if (report)
+        *report = SearchReport();
+
+    unsigned int cores = threadCount();
+    size_t lastSize = p->m_startSize;
+
+    PackerPtr lastPossibleAtlas;
+
+    //first find a atlas that fits all
+    while (!lastPossibleAtlas) {
+
+        auto roundStart = Clock::now();
+        SearchRound round;
+        round.growing = true;
+        round.firstSize = Size(lastSize, lastSize);
+
+        std::vector<Size> sizes;
+        for (unsigned int i = 0; i < cores; i++) {
+            sizes.push_back(Size(lastSize, lastSize));
+            lastSize += p->m_increment;
+        }
+
+        //run all trials and wait until they are finished
+        std::vector<PackerPtr> taskResults = p->tryPackAll(sizes, images);
+
+        //now find a Atlas that fits all images
+        for (auto &result : taskResults ) {
+            //if we get a Atlas we found one that fits
+            lastPossibleAtlas = result;
+            if (lastPossibleAtlas)
+                break;
+        }
+
+        if (report) {
+            round.lastSize = Size(lastSize - p->m_increment, lastSize - p->m_increment);
+            round.trials = taskResults.size();
+            round.foundFit = lastPossibleAtlas != nullptr;
+            round.milliseconds = elapsedMs(roundStart);
+            report->rounds.push_back(round);
+        }
+    }
+
+    //now shrink the atlas until the images do not fit anymore
+    bool canGoOn = true;
+    size_t decrement = 1;
+    lastSize = lastPossibleAtlas->size().height;
+    while (canGoOn) {
+
+        auto roundStart = Clock::now();
+        SearchRound round;
+        round.growing = false;
+        round.firstSize = Size(lastSize - decrement, lastSize - decrement);
+
+        std::vector<Size> sizes;
+        for (unsigned int i = 0; i < cores; i++) {
+
+            //make sure we do not overflow
+            if(decrement > lastSize)
+                break;
+
+            sizes.push_back(Size(lastSize - decrement, lastSize - decrement));
+            lastSize -= decrement;
+        }
+
+        if (sizes.empty())
+            break;
+
+        //run all trials and wait until they are finished
+        std::vector<PackerPtr> taskResults = p->tryPackAll(sizes, images);
+
+        for (auto &result : taskResults ) {
+            if (result) {
+                lastPossibleAtlas = result;
+                round.foundFit = true;
+            } else {
+                //the previous atlas was the smallest one
+                canGoOn = false;
+                break;
+            }
+        }
+
+        if (report) {
+            round.lastSize = Size(lastSize, lastSize);
+            round.trials = taskResults.size();
+            round.milliseconds = elapsedMs(roundStart);
+            report->rounds.push_back(round);
+        }
+    }
+
+    if (report) {
+        report->milliseconds = elapsedMs(searchStart);
+        report->queue = p->m_jobs->stats();
+    }
+
+    return lastPossibleAtlas;
+}
+
+}
@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/spatialindex_p.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace AtlasPack {
+
+const size_t SpatialIndex::NoItem;
+const size_t SpatialIndex::NodeSize;
+
+/**
+ * @internal
+ * @brief SpatialIndex::build
+ * Builds the index over \a rects, replacing the previous content
+ */
+void SpatialIndex::build(const std::vector<Rect> &rects)
+{
+    clear();
+    if (rects.empty())
+        return;
+
+    const size_t count = rects.size();
+    std::vector<Box> items(count);
+    for (size_t i = 0; i < count; i++) {
+        const Rect &r = rects[i];
+        items[i] = Box{r.topLeft.x, r.topLeft.y, r.topLeft.x + r.size.width, r.topLeft.y + r.size.height};
+    }
+
+    //Sort-Tile-Recursive: sort by x into vertical slices, then every slice by y
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    auto centerX = [&items](size_t i) { return items[i].x0 + items[i].x1; };
+    auto centerY = [&items](size_t i) { return items[i].y0 + items[i].y1; };
+
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return centerX(a) < centerX(b); });
+
+    const size_t leafNodes  = (count + NodeSize - 1) / NodeSize;
+    const size_t slices     = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(leafNodes))));
+    const size_t sliceItems = ((leafNodes + slices - 1) / slices) * NodeSize;
+    for (size_t start = 0; start < count; start += sliceItems) {
+        auto first = order.begin() + start;
+        auto last  = order.begin() + std::min(count, start + sliceItems);
+        std::sort(first, last, [&](size_t a, size_t b) { return centerY(a) < centerY(b); });
+    }
+
+    m_boxes.reserve(count + count / (NodeSize - 1) + 1);
+    m_indices.reserve(m_boxes.capacity());
+    for (size_t idx : order) {
+        m_boxes.push_back(items[idx]);
+        m_indices.push_back(idx);
+    }
+    m_levelEnds.push_back(count);
+
+    //every following level groups NodeSize consecutive nodes of the level below
+    size_t levelStart = 0;
+    while (m_levelEnds.back() - levelStart > 1) {
+        const size_t levelEnd = m_levelEnds.back();
+        for (size_t first = levelStart; first < levelEnd; first += NodeSize) {
+            const size_t last = std::min(levelEnd, first + NodeSize);
+            Box bounds = m_boxes[first];
+            for (size_t i = first + 1; i < last; i++) {
+                bounds.x0 = std::min(bounds.x0, m_boxes[i].x0);
+                bounds.y0 = std::min(bounds.y0, m_boxes[i].y0);
+                bounds.x1 = std::max(bounds.x1, m_boxes[i].x1);
+                bounds.y1 = std::max(bounds.y1, m_boxes[i].y1);
+            }
+            m_boxes.push_back(bounds);
+            m_indices.push_back(first);
+        }
+        levelStart = levelEnd;
+        m_levelEnds.push_back(m_boxes.size());
+    }
+}
+
+void SpatialIndex::clear()
+{
+    m_boxes.clear();
+    m_indices.clear();
+    m_levelEnds.clear();
+}
+
+/**
+ * @internal
+ * Calls \a visitor with the item index of every rectangle intersecting \a area,
+ * stops as soon as the visitor returns false.
+ */
+template <typename Visitor>
+void SpatialIndex::visit(const Box &area, Visitor visitor) const
+{
+    if (m_boxes.empty())
+        return;
+
+    //pairs of node position and level, starting at the root
+    std::vector<std::pair<size_t, size_t> > stack;
+    stack.reserve(m_levelEnds.size() * NodeSize);
+    stack.emplace_back(m_boxes.size() - 1, m_levelEnds.size() - 1);
+
+    while (!stack.empty()) {
+        const size_t node  = stack.back().first;
+        const size_t level = stack.back().second;
+        stack.pop_back();
+
+        if (!m_boxes[node].intersects(area))
+            continue;
+
+        if (level == 0) {
+            if (!visitor(m_indices[node]))
+                return;
+            continue;
+        }
+
+        const size_t first = m_indices[node];
+        const size_t last  = std::min(first + NodeSize, m_levelEnds[level - 1]);
+        for (size_t child = first; child < last; child++)
+            stack.emplace_back(child, level - 1);
+    }
+}
+
+/**
+ * @internal
+ * @brief SpatialIndex::itemAt
+ * Returns the index of a rectangle containing \a pos, or NoItem
+ */
+size_t SpatialIndex::itemAt(const Pos &pos) const
+{
+    size_t found = NoItem;
+    visit(Box{pos.x, pos.y, pos.x + 1, pos.y + 1}, [&found](size_t item) {
+        found = item;
+        return false;
+    });
+    return found;
+}
+
+/**
+ * @internal
+ * @brief SpatialIndex::query
+ * Appends the indices of all rectangles intersecting \a rect to \a result
+ */
+void SpatialIndex::query(const Rect &rect, std::vector<size_t> *result) const
+{
+    const Box area{rect.topLeft.x, rect.topLeft.y, rect.topLeft.x + rect.size.width, rect.topLeft.y + rect.size.height};
+    visit(area, [result](size_t item) {
+        result->push_back(item);
+        return true;
+    });
+}
+
+}
@@ -117,6 +117,55 @@ bool TextureAtlas::loadImage(const std::string &imgName, PaintDevice *painter, P
     return false;
 }
 
+/**
+ * @internal
+ * @brief TextureAtlasPrivate::buildIndex
+ * Builds the position lookup over the areas of all textures, has to be called
+ * whenever m_textures was changed.
+ */
+void TextureAtlasPrivate::buildIndex()
+{
+    std::vector<Rect> rects;
+    rects.reserve(m_textures.size());
+    m_indexNames.clear();
+    m_indexNames.reserve(m_textures.size());
+
+    for (const auto &entry : m_textures) {
+        rects.push_back(Rect(entry.second.pos, Size(entry.second.image.width(), entry.second.image.height())));
+        m_indexNames.push_back(entry.first);
+    }
+    m_index.build(rects);
+}
+
+/**
+ * @brief TextureAtlas::textureAt
+ * Returns the name of the texture that covers the atlas pixel \a pos, or a empty
+ * string if the pixel is not part of any texture. Runs in logarithmic time.
+ */
+std::string TextureAtlas::textureAt(const Pos &pos) const
+{
+    size_t item = p->m_index.itemAt(pos);
+    if (item == SpatialIndex::NoItem)
+        return std::string();
+    return p->m_indexNames[item];
+}
+
+/**
+ * @brief TextureAtlas::texturesIn
+ * Returns the names of all textures that overlap the atlas area \a rect
+ */
+std::vector<std::string> TextureAtlas::texturesIn(const Rect &rect) const
+{
+    std::vector<size_t> items;
+    p->m_index.query(rect, &items);
+
+    std::vector<std::string> result;
+    result.reserve(items.size());
+    for (size_t item : items)
+        result.push_back(p->m_indexNames[item]);
+    return result;
+}
+
 /**
  * @brief TextureAtlas::count
  * Returns the number of elements in the texture atlas
@@ -24,171 +24,865 @@
 #include <AtlasPack/TextureAtlasPacker>
 #include <AtlasPack/textureatlas_p.h>
 #include <AtlasPack/JobQueue>
+#include <AtlasPack/FilePrefetcher>
+#include <AtlasPack/pixelops_p.h>
+#include <AtlasPack/blockcompression_p.h>
+#include <AtlasPack/packengine_p.h>
 #include <boost/filesystem.hpp>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <map>
 
 namespace fs =  boost::filesystem;
 
 namespace AtlasPack {
 
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs (Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
 /**
  * \internal
- * Represents a Node in the packing tree algorithm,
- * can contain either child nodes or a image. The rect
- * variable is always set.
+ * Collects the duration of the paint tasks, which run on multiple threads
  */
-struct Node {
+struct PaintStatistics {
+    void add (Clock::time_point start, Clock::time_point end) {
+        std::lock_guard<std::mutex> lk(mutex);
+        histogram.add(std::chrono::duration<double, std::milli>(end - start).count());
+        if (!painted || start < firstStart)
+            firstStart = start;
+        if (!painted || end > lastEnd)
+            lastEnd = end;
+        painted = true;
+    }
+
+    //! time from the first paint task starting until the last one finished
+    double spanMs () const {
+        return painted ? std::chrono::duration<double, std::milli>(lastEnd - firstStart).count() : 0;
+    }
+
+    std::mutex mutex;
+    DurationHistogram histogram;
+    bool painted = false;
+    Clock::time_point firstStart;
+    Clock::time_point lastEnd;
+};
 
-    Node (Rect _rect = Rect())
-        : rect(_rect){}
+//decoders hold the source image in their own format and as RGBA pixels at the same time
+static const size_t DecodeBytesPerPixel = 8;
 
-    std::shared_ptr<Node> left;
-    std::shared_ptr<Node> right;
+/**
+ * \internal
+ * Estimated memory painting \a img needs, the full source image is decoded even if only
+ * the trimmed content is painted. In-memory images may be decoded by their provider.
+ */
+static size_t paintFootprint (const Image &img)
+{
+    const Size source = img.sourceSize();
+    return source.width * source.height * (img.isInMemory() ? 4 : DecodeBytesPerPixel);
+}
 
-    Rect rect;
-    Image img;
+/**
+ * \internal
+ * Admits paint tasks while the estimated memory of all running tasks stays within a budget.
+ * Tasks are admitted from the compile thread, so the workers never block. Of the waiting tasks
+ * the biggest one that fits is admitted first and small tasks fill up the remaining budget, so
+ * big images are spread out instead of running together. A task bigger than the whole budget
+ * runs once nothing else is running.
+ */
+class AdmissionControl {
+    public:
+        explicit AdmissionControl (size_t budget) : m_budget(budget) {}
+
+        void add (size_t bytes, size_t task) { m_waiting.emplace(bytes, task); }
+        bool hasWaiting () const { return !m_waiting.empty(); }
+        size_t admitNext ();
+        void release (size_t bytes);
+
+        size_t budget () const { return m_budget; }
+        size_t peakBytes () const { return m_peak; }
+        double waitMs () const { return m_waitMs; }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_released;
+        std::multimap<size_t, size_t> m_waiting;    //footprint and task, only used by the compile thread
+        size_t m_budget = 0;
+        size_t m_running = 0;
+        size_t m_peak = 0;
+        double m_waitMs = 0;
 };
 
+/*
+ * Waits until one of the waiting tasks fits into the budget, reserves its
+ * memory and returns the task. Must only be called while tasks are waiting.
+ */
+size_t AdmissionControl::admitNext()
+{
+    std::unique_lock<std::mutex> lk(m_mutex);
+
+    auto candidate = m_waiting.end();
+    auto findFit = [this, &candidate]() {
+        if (m_running == 0) {
+            candidate = std::prev(m_waiting.end());
+            return true;
+        }
+        if (m_running >= m_budget)
+            return false;
+
+        //the biggest task that does not exceed the remaining budget
+        auto next = m_waiting.upper_bound(m_budget - m_running);
+        if (next == m_waiting.begin())
+            return false;
+        candidate = std::prev(next);
+        return true;
+    };
+
+    if (!findFit()) {
+        auto waitStart = Clock::now();
+        m_released.wait(lk, findFit);
+        m_waitMs += elapsedMs(waitStart);
+    }
+
+    const size_t task = candidate->second;
+    m_running += candidate->first;
+    m_peak = std::max(m_peak, m_running);
+    m_waiting.erase(candidate);
+    return task;
+}
+
+void AdmissionControl::release(size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_running -= bytes;
+    }
+    m_released.notify_one();
+}
+
+/**
+ * \internal
+ * Shared state of a compile run started with \sa TextureAtlasPacker::compileAsync,
+ * the progress counters are updated from the worker threads.
+ */
+class CompileHandlePrivate {
+    public:
+        void setPhase (CompilePhase phase);
+        void imagePainted ();
+        void notify ();
+
+        std::atomic_bool cancelled{false};
+        std::atomic<size_t> painted{0};
+        std::atomic<int> phase{static_cast<int>(CompilePhase::Painting)};
+        std::atomic<size_t> total{0};
+
+        std::mutex callbackMutex;
+        CompileProgressCallback callback;
+        std::string error;
+
+        //has to stay the last member, destroying it waits for the compile run to finish
+        std::shared_future<TextureAtlas> result;
+};
+
+void CompileHandlePrivate::setPhase(CompilePhase newPhase)
+{
+    phase.store(static_cast<int>(newPhase));
+    notify();
+}
+
+void CompileHandlePrivate::imagePainted()
+{
+    painted.fetch_add(1);
+    notify();
+}
+
+/*
+ * Calls the progress callback, the calls are serialized so the callback
+ * does not need to be thread safe.
+ */
+void CompileHandlePrivate::notify()
+{
+    if (!callback)
+        return;
+
+    //read the counters while locked, so the callback never sees them going backwards
+    std::lock_guard<std::mutex> lk(callbackMutex);
+    CompileProgress progress;
+    progress.phase = static_cast<CompilePhase>(phase.load());
+    progress.paintedImages = painted.load();
+    progress.totalImages = total.load();
+    callback(progress);
+}
+
 class TextureAtlasPackerPrivate {
     public:
 
-    Node *insertImage (const Image &img, Node *node);
+    Size cellSize (const Image &img) const;
+    size_t findImage (const std::string &path) const;
+    void writeDescriptionLine (std::ostream *descStr, const Texture &t) const;
+    std::vector<Placement> collectPlacements () const;
+    bool writeMipmaps (const std::string &basePath, Backend *backend, PaintDevice *painter,
+                       JobQueue<bool> *jobs, std::vector<std::shared_ptr<PixelBuffer> > &levels,
+                       bool exportLevels, std::string *err = nullptr) const;
+    bool writeCompressed (const std::string &fileName, JobQueue<bool> *jobs,
+                          const std::vector<std::shared_ptr<PixelBuffer> > &levels, std::string *err = nullptr) const;
+    bool writeTiles (const std::string &basePath, Backend *backend, JobQueue<bool> *jobs,
+                     std::shared_ptr<const PixelBuffer> pixels, TileOutputStats *stats, std::string *err = nullptr) const;
+    bool writeVariants (Backend *backend, JobQueue<bool> *jobs, std::shared_ptr<const PixelBuffer> pixels,
+                        std::string *err = nullptr) const;
     bool collectNodes(TextureAtlasPrivate *atlas, std::shared_ptr<PaintDevice> painter, std::basic_ostream<char> *descStr,
-                      Node *node, JobQueue<bool> *painterQueue, std::vector<std::future<bool> > &painterResults, std::string *err = nullptr);
+                      JobQueue<bool> *painterQueue, std::vector<std::future<bool> > &painterResults,
+                      PaintStatistics *stats = nullptr, CompileHandlePrivate *control = nullptr,
+                      AdmissionControl *admission = nullptr, FilePrefetcher *prefetcher = nullptr,
+                      std::string *err = nullptr);
 
-    Node m_root;
+    PackPolicy m_policy;
+    std::unique_ptr<PackLayout> m_layout;
+    std::vector<Image> m_images;    //the image placed into every node of the layout, invalid for free nodes
+    size_t m_alignment = 1;
+    bool m_mipmaps = false;
+    bool m_exportPng = true;
+    BlockCompression m_compression = BlockCompression::None;
+    JobQueue<bool> *m_jobs = nullptr;
+    size_t m_decodeBudget = 0;
+    size_t m_prefetchWindow = 0;
+    size_t m_tileSize = 0;
+    std::vector<AtlasVariant> m_variants;
+    size_t m_layoutScale = 1;
 };
 
 /**
- * @brief TextureAtlasPrivate::insertImage
- * \returns the Node the Image was inserted into, nullptr if not enough space is available
- */
-Node *TextureAtlasPackerPrivate::insertImage(const Image &img, Node *node)
-{
-    //if we have children, we are not a leaf
-    if (node->left || node->right) {
-        //first inside left:
-        Node *newNode = insertImage(img, node->left.get());
-        if (newNode)
-            return newNode;
-
-        //no space in left, insert right
-        return insertImage(img, node->right.get());
-    } else {
-        //this path is entered if we found a leaf node
-
-        //first check if the space is already filled
-        if (node->img.isValid())
-            return nullptr;
-
-        Pos  nodePos  = node->rect.topLeft;
-        Size nodeSize = node->rect.size;
-
-        //check if there is enough room
-        if (nodeSize.height < img.height()
-                || nodeSize.width < img.width()) {
-            //node too small
-            return nullptr;
-        }
+ * @internal
+ * @brief TextureAtlasPackerPrivate::cellSize
+ * Returns the area that is reserved for \a img in the atlas, which is the image geometry
+ * rounded up to the placement alignment.
+ */
+Size TextureAtlasPackerPrivate::cellSize(const Image &img) const
+{
+    return Size((img.width()  + m_alignment - 1) / m_alignment * m_alignment,
+                (img.height() + m_alignment - 1) / m_alignment * m_alignment);
+}
 
-        //check if we found a perfect fit
-        if (nodeSize.height == img.height()
-                && nodeSize.width == img.width()) {
-            //perfect fit, store the image
-            node->img = img;
+/**
+ * @internal
+ * @brief TextureAtlasPackerPrivate::findImage
+ * Returns the layout node that contains the image loaded from \a path, or PackLayout::NoNode
+ */
+size_t TextureAtlasPackerPrivate::findImage(const std::string &path) const
+{
+    for (size_t node = 0; node < m_images.size(); node++) {
+        if (m_images[node].isValid() && m_images[node].path() == path)
             return node;
-        }
-
-        //At this poing the node is splitted up
-        //we will split in a way that we always end up with the biggest possible
-        //empty rectangle
-        size_t remainWidth  = nodeSize.width - img.width();
-        size_t remainHeight = nodeSize.height - img.height();
-
-        if (remainWidth > remainHeight) {
-            node->left  = std::make_shared<Node>(Rect(nodePos,
-                                                      Size(img.width(), nodeSize.height)));
-
-            node->right = std::make_shared<Node>(Rect(Pos(nodePos.x+img.width(), nodePos.y),
-                                                      Size(nodeSize.width - img.width(), nodeSize.height)));
-        } else {
-            node->left  = std::make_shared<Node>(Rect(nodePos,
-                                                      Size(nodeSize.width, img.height())));
+    }
+    return PackLayout::NoNode;
+}
 
-            node->right = std::make_shared<Node>(Rect(Pos(nodePos.x, nodePos.y + img.height()),
-                                                      Size(nodeSize.width, nodeSize.height - img.height())));
-        }
+/**
+ * @internal
+ * @brief TextureAtlasPackerPrivate::writeDescriptionLine
+ * Writes the description of the texture \a t as one line into \a descStr
+ */
+void TextureAtlasPackerPrivate::writeDescriptionLine(std::ostream *descStr, const Texture &t) const
+{
+    // the description file is written as a CSV file
+    // @NOTE possible room for improvement, make the description file structure modular,
+    // to make it easy to use another format
+    (*descStr) << t.image.path() <<","
+               << t.pos.x<<","
+               << t.pos.y<<","
+               << t.image.width()<<","
+               << t.image.height();
 
-        //now insert into leftmost Node
-        return insertImage(img, node->left.get());
+    // trimmed images additionally store where the packed area was located in the source image
+    if (t.image.isTrimmed()) {
+        (*descStr) << ","
+                   << t.offset.x<<","
+                   << t.offset.y<<","
+                   << t.originalSize.width<<","
+                   << t.originalSize.height;
     }
+    (*descStr) << "\n";
 }
 
 /**
  * @internal
  * @brief TextureAtlasPackerPrivate::collectNodes
- * Iterates over the full tree, filling the \a atlas and painting the images using the \a painter as well as writing
+ * Iterates over all placed images, filling the \a atlas and painting the images using the \a painter as well as writing
  * the image rectangle and filenmame into the output stream given by \a descStr.
+ * If \a admission is set, paint tasks are only queued while their estimated memory fits into its budget,
+ * the call then blocks until the last task was queued.
+ * If \a prefetcher is set, the files of the images are read ahead in the order the paint tasks are queued.
  * If a error occurs and \a err is set, a error message is put there.
  */
 bool TextureAtlasPackerPrivate::collectNodes(TextureAtlasPrivate *atlas, std::shared_ptr<PaintDevice> painter,
-                                             std::basic_ostream<char> *descStr, Node *node,
+                                             std::basic_ostream<char> *descStr,
                                              JobQueue<bool> *painterQueue, std::vector<std::future<bool>> &painterResults,
-                                             std::string *err)
+                                             PaintStatistics *stats, CompileHandlePrivate *control,
+                                             AdmissionControl *admission, FilePrefetcher *prefetcher, std::string *err)
 {
-    bool collected = false;
-    if(node->img.isValid()) {
-        collected = true;
+    UNUSED(err);
+
+    // Renders the image into the atlas image, called from a async thread
+    auto fun = [prefetcher](std::shared_ptr<PaintDevice> painter, Placement placement, PaintStatistics *stats, CompileHandlePrivate *control){
+        //skip the remaining work once the compile run was cancelled
+        if (control && control->cancelled.load())
+            return false;
+
+        auto start = Clock::now();
+
+        // paint the texture into the cache image, trimmed images only paint their content area
+        const Image &img = placement.image;
+        const Pos &pos = placement.cell.topLeft;
+        bool painted = false;
+        if (img.isInMemory()) {
+            std::shared_ptr<const PixelBuffer> pixels = img.pixels();
+            painted = pixels && painter->paintImage(pos, pixels->view().region(img.contentRect()));
+        } else if (std::shared_ptr<const FileData> data = prefetcher ? prefetcher->take(img.path()) : nullptr) {
+            painted = img.isTrimmed()
+                    ? painter->paintImageFromData(pos, img.path(), *data, img.contentRect())
+                    : painter->paintImageFromData(pos, img.path(), *data);
+        } else {
+            //without prefetching, or if reading ahead failed, the paint device reads the file itself
+            painted = img.isTrimmed()
+                    ? painter->paintImageFromFile(pos, img.path(), img.contentRect())
+                    : painter->paintImageFromFile(pos, img.path());
+        }
+
+        if (stats)
+            stats->add(start, Clock::now());
+
+        if(!painted) {
+            std::cout<<"Failed to paint image "<<img.path();
+            return false;
+        }
+
+        if (control)
+            control->imagePainted();
+        return true;
+    };
+
+    const std::vector<Placement> placements = collectPlacements();
+    painterResults.reserve(painterResults.size() + placements.size());
+
+    for (size_t i = 0; i < placements.size(); i++) {
+        const Placement &placement = placements[i];
 
         // we found a Image node, lets fill the information into the given structures
-        Texture t(node->rect.topLeft, node->img);
-        atlas->m_textures[node->img.path()] = t;
-
-        // Renders the node into the atlas image, called from a async thread
-        auto fun = [](std::shared_ptr<PaintDevice> painter, Node *node){
-            // paint the texture into the cache image
-            if(!painter->paintImageFromFile(node->rect.topLeft, node->img.path())) {
-                std::cout<<"Failed to paint image "<<node->img.path();
+        Texture t(placement.cell.topLeft, placement.image);
+        atlas->m_textures[placement.image.path()] = t;
+        writeDescriptionLine(descStr, t);
+
+        // push the future results into a vector, so we can check if we had errors after all tasks are done
+        if (!admission) {
+            if (prefetcher && !placement.image.isInMemory())
+                prefetcher->prefetch(placement.image.path());
+            painterResults.push_back(painterQueue->addTask(std::bind(fun, painter, placement, stats, control),
+                                                           Trace::isEnabled() ? placement.image.path() : std::string()));
+        } else {
+            admission->add(paintFootprint(placement.image), i);
+        }
+    }
+
+    //with a budget the tasks are queued in the order they are admitted, each one gives its memory back when done
+    while (admission && admission->hasWaiting()) {
+        const Placement &placement = placements[admission->admitNext()];
+        const size_t bytes = paintFootprint(placement.image);
+        if (prefetcher && !placement.image.isInMemory())
+            prefetcher->prefetch(placement.image.path());
+        painterResults.push_back(painterQueue->addTask([=]() {
+            //give the memory back even if painting throws, otherwise the compile thread waits forever
+            struct Release {
+                AdmissionControl *admission; size_t bytes;
+                ~Release () { admission->release(bytes); }
+            } release{admission, bytes};
+            return fun(painter, placement, stats, control);
+        }, Trace::isEnabled() ? placement.image.path() : std::string()));
+    }
+
+    return true;
+}
+
+/**
+ * @internal
+ * @brief TextureAtlasPackerPrivate::collectPlacements
+ * Returns all placed images with their cells, in the order of the packing tree.
+ */
+std::vector<Placement> TextureAtlasPackerPrivate::collectPlacements() const
+{
+    std::vector<size_t> nodes;
+    m_layout->usedNodes(&nodes);
+
+    std::vector<Placement> placements;
+    placements.reserve(nodes.size());
+    for (size_t node : nodes)
+        placements.push_back(Placement{m_images[node], m_layout->rect(node)});
+    return placements;
+}
+
+/**
+ * @internal
+ * @brief TextureAtlasPackerPrivate::writeMipmaps
+ * Generates the full mipmap chain of the base level stored as first element in \a levels
+ * and appends every level to \a levels. If \a exportLevels is true, each level is written
+ * to a file named after \a basePath with a _mip<level>.png suffix. The padding of every placed
+ * image is filled with its border pixels before each level is calculated, so images
+ * do not bleed into each other, the padded base level is painted back into \a painter.
+ * The rows of each level are calculated in parallel on \a jobs.
+ */
+bool TextureAtlasPackerPrivate::writeMipmaps(const std::string &basePath, Backend *backend, PaintDevice *painter,
+                                             JobQueue<bool> *jobs, std::vector<std::shared_ptr<PixelBuffer> > &levels,
+                                             bool exportLevels, std::string *err) const
+{
+    std::shared_ptr<PixelBuffer> level = levels.front();
+
+    const std::vector<Placement> placements = collectPlacements();
+
+    //fill the padding of the base level and write it back so all levels match
+    auto padLevel = [&placements](PixelBuffer *pixels, size_t levelIdx) {
+        for (const Placement &placement : placements) {
+            Rect content(Pos(placement.cell.topLeft.x >> levelIdx, placement.cell.topLeft.y >> levelIdx),
+                         Size(std::max<size_t>(1, placement.image.width()  >> levelIdx),
+                              std::max<size_t>(1, placement.image.height() >> levelIdx)));
+            Rect cell(content.topLeft,
+                      Size(std::max<size_t>(1, placement.cell.size.width  >> levelIdx),
+                           std::max<size_t>(1, placement.cell.size.height >> levelIdx)));
+            PixelOps::extendEdges(pixels, content, cell);
+        }
+    };
+
+    if (m_alignment > 1) {
+        padLevel(level.get(), 0);
+        if (!painter->paintImage(Pos(0, 0), level->view())) {
+            if (err) *err = "Failed to write the padded atlas image";
+            return false;
+        }
+    }
+
+    std::vector<std::future<bool> > exportResults;
+    size_t levelIdx = 0;
+    while (level->size().width > 1 || level->size().height > 1) {
+        levelIdx++;
+
+        std::shared_ptr<PixelBuffer> next = std::make_shared<PixelBuffer>(PixelOps::mipmapSize(level->size()));
+
+        //split the rows into one chunk per worker thread
+        size_t rows  = next->size().height;
+        size_t chunk = std::max<size_t>(1, (rows + jobs->maxJobs() - 1) / jobs->maxJobs());
+        std::vector<std::future<bool> > rowResults;
+        for (size_t row = 0; row < rows; row += chunk) {
+            size_t last = std::min(rows, row + chunk);
+            rowResults.push_back(jobs->addTask([level, next, row, last]() {
+                PixelOps::downsample(level->view(), next.get(), row, last);
+                return true;
+            }, Trace::isEnabled() ? "downsample level " + std::to_string(levelIdx) : std::string()));
+        }
+        for (std::future<bool> &res : rowResults)
+            res.get();
+
+        padLevel(next.get(), levelIdx);
+        levels.push_back(next);
+
+        //export the level while the next one is calculated
+        if (exportLevels) {
+            std::stringstream fileName;
+            fileName << basePath << "_mip" << levelIdx << ".png";
+            exportResults.push_back(jobs->addTask([backend, next, name = fileName.str()]() {
+                auto levelPainter = backend->createPaintDevice(next->size());
+                if (!levelPainter->paintImage(Pos(0, 0), next->view()) || !levelPainter->exportToFile(name)) {
+                    std::cerr << "Failed to write mipmap level " << name << std::endl;
+                    return false;
+                }
+                return true;
+            }, Trace::isEnabled() ? fileName.str() : std::string(), TaskPriority::Low));
+        }
+
+        level = next;
+    }
+
+    bool success = true;
+    for (std::future<bool> &res : exportResults) {
+        if (!res.get())
+            success = false;
+    }
+
+    if (!success && err)
+        *err = "Failed to export mipmap levels";
+    return success;
+}
+
+/**
+ * @internal
+ * @brief TextureAtlasPackerPrivate::writeCompressed
+ * Compresses all \a levels into the configured block compression format and writes them
+ * into the DDS file \a fileName. The block rows of every level are compressed in parallel on \a jobs.
+ */
+bool TextureAtlasPackerPrivate::writeCompressed(const std::string &fileName, JobQueue<bool> *jobs,
+                                                const std::vector<std::shared_ptr<PixelBuffer> > &levels,
+                                                std::string *err) const
+{
+    std::vector<std::vector<unsigned char> > compressed(levels.size());
+    std::vector<std::future<bool> > results;
+
+    const BlockCompression format = m_compression;
+    for (size_t i = 0; i < levels.size(); i++) {
+        std::shared_ptr<PixelBuffer> level = levels[i];
+        compressed[i].resize(BlockCompressor::compressedSize(level->size(), format));
+        unsigned char *target = compressed[i].data();
+
+        size_t blockRows = (level->size().height + 3) / 4;
+        size_t chunk = std::max<size_t>(1, (blockRows + jobs->maxJobs() - 1) / jobs->maxJobs());
+        for (size_t row = 0; row < blockRows; row += chunk) {
+            size_t last = std::min(blockRows, row + chunk);
+            results.push_back(jobs->addTask([level, format, target, row, last]() {
+                BlockCompressor::compressBlockRows(level->view(), format, target, row, last);
+                return true;
+            }, Trace::isEnabled() ? "compress level " + std::to_string(i) : std::string(), TaskPriority::Low));
+        }
+    }
+
+    for (std::future<bool> &res : results)
+        res.get();
+
+    if (!BlockCompressor::writeDDS(fileName, format, m_layout->size(), compressed)) {
+        if (err) *err = "Failed to write the compressed texture file " + fileName;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @internal
+ * Hash of one tile of the atlas image, FNV-1a over the pixels of the tile
+ */
+static uint64_t tileHash (const PixelView &tile)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t y = 0; y < tile.size.height; y++) {
+        const unsigned char *line = tile.scanLine(y);
+        for (size_t i = 0; i < tile.size.width * 4; i++) {
+            hash ^= line[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+/**
+ * @internal
+ * Reads the tile hashes of a earlier build from the tile manifest \a fileName.
+ * Returns false if there is no readable manifest.
+ */
+static bool readTileManifest (const std::string &fileName, size_t *tileSize, Size *atlasSize,
+                              std::map<std::pair<size_t, size_t>, uint64_t> *hashes)
+{
+    std::ifstream in(fileName);
+    char sep = 0;
+    if (!(in >> *tileSize >> sep >> atlasSize->width >> sep >> atlasSize->height))
+        return false;
+
+    size_t col = 0, row = 0;
+    uint64_t hash = 0;
+    while (in >> col >> sep >> row >> sep >> std::hex >> hash >> std::dec)
+        (*hashes)[std::make_pair(col, row)] = hash;
+    return true;
+}
+
+/**
+ * @internal
+ * @brief TextureAtlasPackerPrivate::writeTiles
+ * Splits the atlas image \a pixels into square tiles of the configured tile size and writes every
+ * tile that differs from the earlier build as png file into the directory \a basePath with a _tiles
+ * suffix. The tiles are compared by the hashes stored in the tile manifest \a basePath.tiles by the
+ * earlier build, which is then replaced. Every manifest line holds the column, row and hash of a tile,
+ * after a first line with the tile size and the atlas width and height.
+ *
+ * The delta descriptor \a basePath.delta lists what was written: a first line with the tile size,
+ * atlas width and height and "full" or "partial", then one line per changed or removed tile holding
+ * "changed" or "removed", column, row, the tile rectangle in the atlas and the tile file name.
+ * All values are separated by commas like in the atlas description. Tiles are hashed and written in parallel on \a jobs.
+ */
+bool TextureAtlasPackerPrivate::writeTiles(const std::string &basePath, Backend *backend, JobQueue<bool> *jobs,
+                                           std::shared_ptr<const PixelBuffer> pixels, TileOutputStats *stats,
+                                           std::string *err) const
+{
+    const size_t tile = m_tileSize;
+    const Size size = pixels->size();
+    const size_t cols = (size.width + tile - 1) / tile;
+    const size_t rows = (size.height + tile - 1) / tile;
+
+    auto tileRect = [tile, size](size_t col, size_t row) {
+        const Pos topLeft(col * tile, row * tile);
+        return Rect(topLeft, Size(std::min(tile, size.width - topLeft.x), std::min(tile, size.height - topLeft.y)));
+    };
+
+    const fs::path tileDir(basePath + "_tiles");
+    const std::string dirName = tileDir.filename().string();
+    auto tileName = [&dirName](size_t col, size_t row) {
+        return dirName + "/" + std::to_string(col) + "_" + std::to_string(row) + ".png";
+    };
+    const fs::path baseDir = tileDir.parent_path();
+
+    boost::system::error_code fsErr;
+    fs::create_directories(tileDir, fsErr);
+    if (fsErr) {
+        if (err) *err = "Could not create the tile directory " + tileDir.string();
+        return false;
+    }
+
+    const std::string manifestName = basePath + ".tiles";
+    size_t previousTile = 0;
+    Size previousSize;
+    std::map<std::pair<size_t, size_t>, uint64_t> previous;
+    const bool full = !readTileManifest(manifestName, &previousTile, &previousSize, &previous)
+            || previousTile != tile || previousSize.width != size.width || previousSize.height != size.height;
+
+    //hash one row of tiles per task
+    auto phaseStart = Clock::now();
+    std::vector<uint64_t> hashes(cols * rows);
+    std::vector<std::future<bool> > results;
+    for (size_t row = 0; row < rows; row++) {
+        results.push_back(jobs->addTask([pixels, &hashes, &tileRect, cols, row]() {
+            for (size_t col = 0; col < cols; col++)
+                hashes[row * cols + col] = tileHash(pixels->view().region(tileRect(col, row)));
+            return true;
+        }, Trace::isEnabled() ? "hash tile row " + std::to_string(row) : std::string()));
+    }
+    for (std::future<bool> &res : results)
+        res.get();
+    results.clear();
+    stats->hashMs = elapsedMs(phaseStart);
+
+    std::vector<std::pair<size_t, size_t> > changed;
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t col = 0; col < cols; col++) {
+            auto prev = previous.find(std::make_pair(col, row));
+            if (full || prev == previous.end() || prev->second != hashes[row * cols + col]
+                    || !fs::exists(baseDir / tileName(col, row), fsErr))
+                changed.emplace_back(col, row);
+        }
+    }
+
+    phaseStart = Clock::now();
+    for (const auto &pos : changed) {
+        const Rect rect = tileRect(pos.first, pos.second);
+        const std::string fileName = (baseDir / tileName(pos.first, pos.second)).string();
+        results.push_back(jobs->addTask([backend, pixels, rect, fileName]() {
+            auto tilePainter = backend->createPaintDevice(rect.size);
+            if (!tilePainter->paintImage(Pos(0, 0), pixels->view().region(rect)) || !tilePainter->exportToFile(fileName)) {
+                std::cerr << "Failed to write tile " << fileName << std::endl;
                 return false;
             }
             return true;
-        };
-
-        // push the future results into a vector, so we can check if we had errors after all tasks are done
-        painterResults.push_back(painterQueue->addTask(std::bind(fun, painter, node)));
+        }, fileName, TaskPriority::Low));
+    }
 
-        // the description file is written as a CSV file
-        // @NOTE possible room for improvement, make the description file structure modular,
-        // to make it easy to use another format
-        (*descStr) << node->img.path() <<","
-                   << t.pos.x<<","
-                   << t.pos.y<<","
-                   << t.image.width()<<","
-                   << t.image.height()<<"\n";
+    bool success = true;
+    for (std::future<bool> &res : results) {
+        if (!res.get())
+            success = false;
+    }
+    if (!success) {
+        if (err) *err = "Failed to write the atlas tiles";
+        return false;
+    }
 
+    //tiles of a bigger earlier build are not part of the atlas anymore
+    std::vector<std::pair<size_t, size_t> > removed;
+    for (const auto &prev : previous) {
+        if (prev.first.first >= cols || prev.first.second >= rows) {
+            fs::remove(baseDir / tileName(prev.first.first, prev.first.second), fsErr);
+            removed.push_back(prev.first);
+        }
     }
+    stats->writeMs = elapsedMs(phaseStart);
 
-    if (collected && (node->left || node->right )) {
-        //this should never happen, if it does at least print a warning about it
-        if(collected) std::cerr<<"Node has leafs AND image?"<<std::endl;
+    std::ofstream manifest(manifestName, std::ios::trunc | std::ios::out);
+    manifest << tile << "," << size.width << "," << size.height << "\n";
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t col = 0; col < cols; col++)
+            manifest << col << "," << row << "," << std::hex << hashes[row * cols + col] << std::dec << "\n";
     }
 
-    //recursively iterate through the child nodes, start with the left node again
-    if(node->left) {
-        if (!collectNodes(atlas, painter, descStr, node->left.get(), painterQueue, painterResults, err))
-            return false;
+    std::ofstream delta(basePath + ".delta", std::ios::trunc | std::ios::out);
+    delta << tile << "," << size.width << "," << size.height << "," << (full ? "full" : "partial") << "\n";
+    for (const auto &pos : changed) {
+        const Rect rect = tileRect(pos.first, pos.second);
+        delta << "changed," << pos.first << "," << pos.second << "," << rect.topLeft.x << "," << rect.topLeft.y << ","
+              << rect.size.width << "," << rect.size.height << "," << tileName(pos.first, pos.second) << "\n";
+
+        const uintmax_t bytes = fs::file_size(baseDir / tileName(pos.first, pos.second), fsErr);
+        if (!fsErr)
+            stats->bytesWritten += bytes;
     }
+    for (const auto &pos : removed)
+        delta << "removed," << pos.first << "," << pos.second << ",0,0,0,0," << tileName(pos.first, pos.second) << "\n";
 
-    if(node->right){
-        if (!collectNodes(atlas, painter, descStr, node->right.get(), painterQueue, painterResults, err))
-            return false;
+    manifest.close();
+    delta.close();
+    if (manifest.fail() || delta.fail()) {
+        if (err) *err = "Failed to write the tile manifest " + manifestName;
+        return false;
     }
 
+    stats->tileSize = tile;
+    stats->tiles = cols * rows;
+    stats->changedTiles = changed.size();
+    stats->removedTiles = removed.size();
+    stats->full = full;
     return true;
 }
 
+/**
+ * @internal
+ * @brief TextureAtlasPackerPrivate::writeVariants
+ * Writes every configured variant from the atlas image \a pixels. The variant image is \a pixels
+ * scaled down with a area filter, the images that have a own file for the variant are then painted
+ * over their scaled area. Because the placement alignment makes every cell start at a position that
+ * scales to a whole pixel, no image bleeds into the cell of another one. Each variant gets a png image
+ * and a description with the scaled geometry of every image, named after its base path.
+ * The rows of all variants are scaled in parallel on \a jobs, then the images are painted and exported.
+ */
+bool TextureAtlasPackerPrivate::writeVariants(Backend *backend, JobQueue<bool> *jobs,
+                                              std::shared_ptr<const PixelBuffer> pixels, std::string *err) const
+{
+    const size_t layoutScale = m_layoutScale;
+    auto scaleDown = [layoutScale](size_t value, size_t scale) {
+        return value * scale / layoutScale;
+    };
+    auto scaleUp = [layoutScale](size_t value, size_t scale) {
+        return (value * scale + layoutScale - 1) / layoutScale;
+    };
+
+    const std::vector<Placement> placements = collectPlacements();
+    std::vector<std::shared_ptr<PixelBuffer> > targets;
+    std::vector<std::future<bool> > results;
+
+    for (const AtlasVariant &variant : m_variants) {
+        const size_t scale = variant.scale;
+        std::shared_ptr<PixelBuffer> target = std::make_shared<PixelBuffer>(Size(scaleUp(pixels->size().width, scale),
+                                                                                 scaleUp(pixels->size().height, scale)));
+        targets.push_back(target);
+
+        //split the rows into one chunk per worker thread
+        size_t rows  = target->size().height;
+        size_t chunk = std::max<size_t>(1, (rows + jobs->maxJobs() - 1) / jobs->maxJobs());
+        for (size_t row = 0; row < rows; row += chunk) {
+            size_t last = std::min(rows, row + chunk);
+            results.push_back(jobs->addTask([pixels, target, scale, layoutScale, row, last]() {
+                PixelOps::resample(pixels->view(), target.get(), scale, layoutScale, row, last);
+                return true;
+            }, Trace::isEnabled() ? variant.basePath + " resample" : std::string()));
+        }
+    }
+    for (std::future<bool> &res : results)
+        res.get();
+    results.clear();
+
+    //images with their own file for a variant replace the downsampled pixels in their scaled area
+    for (size_t idx = 0; idx < m_variants.size(); idx++) {
+        const AtlasVariant &variant = m_variants[idx];
+        std::shared_ptr<PixelBuffer> target = targets[idx];
+
+        for (const Placement &placement : placements) {
+            auto source = variant.sources.find(placement.image.path());
+            if (source == variant.sources.end())
+                continue;
+
+            const Rect content = placement.image.contentRect();
+            const Size size(scaleUp(content.size.width, variant.scale), scaleUp(content.size.height, variant.scale));
+            const Pos from(scaleDown(content.topLeft.x, variant.scale), scaleDown(content.topLeft.y, variant.scale));
+            const Pos to(scaleDown(placement.cell.topLeft.x, variant.scale), scaleDown(placement.cell.topLeft.y, variant.scale));
+
+            results.push_back(jobs->addTask([backend, target, fileName = source->second, size, from, to]() {
+                PixelBuffer image;
+                if (!backend->readImagePixels(fileName, &image)) {
+                    std::cerr << "Failed to read variant image " << fileName << std::endl;
+                    return false;
+                }
+
+                //the file might not be scaled exactly like the packed image, only its overlap is copied
+                const Size imageSize = image.size();
+                if (from.x >= imageSize.width || from.y >= imageSize.height)
+                    return true;
+                const size_t width  = std::min(size.width,  imageSize.width  - from.x);
+                const size_t height = std::min(size.height, imageSize.height - from.y);
+                for (size_t y = 0; y < height; y++)
+                    std::memcpy(target->scanLine(to.y + y) + to.x * 4, image.scanLine(from.y + y) + from.x * 4, width * 4);
+                return true;
+            }, source->second));
+        }
+    }
+
+    bool success = true;
+    for (std::future<bool> &res : results) {
+        if (!res.get())
+            success = false;
+    }
+    results.clear();
+    if (!success) {
+        if (err) *err = "Failed to paint the variant images";
+        return false;
+    }
+
+    for (size_t idx = 0; idx < m_variants.size(); idx++) {
+        const AtlasVariant &variant = m_variants[idx];
+        std::shared_ptr<PixelBuffer> target = targets[idx];
+        const std::string imageName = variant.basePath + ".png";
+
+        results.push_back(jobs->addTask([backend, target, imageName]() {
+            auto variantPainter = backend->createPaintDevice(target->size());
+            if (!variantPainter->paintImage(Pos(0, 0), target->view()) || !variantPainter->exportToFile(imageName)) {
+                std::cerr << "Failed to write variant image " << imageName << std::endl;
+                return false;
+            }
+            return true;
+        }, imageName, TaskPriority::Low));
+
+        //same format as the atlas description, with every value scaled
+        const std::string descName = variant.basePath + ".atlas";
+        std::ofstream desc(descName, std::ios::trunc | std::ios::out);
+        for (const Placement &placement : placements) {
+            const Image &img = placement.image;
+            desc << img.path() << ","
+                 << scaleDown(placement.cell.topLeft.x, variant.scale) << ","
+                 << scaleDown(placement.cell.topLeft.y, variant.scale) << ","
+                 << scaleUp(img.width(), variant.scale) << ","
+                 << scaleUp(img.height(), variant.scale);
+            if (img.isTrimmed()) {
+                desc << ","
+                     << scaleDown(img.contentRect().topLeft.x, variant.scale) << ","
+                     << scaleDown(img.contentRect().topLeft.y, variant.scale) << ","
+                     << scaleUp(img.sourceSize().width, variant.scale) << ","
+                     << scaleUp(img.sourceSize().height, variant.scale);
+            }
+            desc << "\n";
+        }
+        desc.close();
+        if (desc.fail()) {
+            if (err) *err = "Failed to write variant index file " + descName;
+            success = false;
+        }
+    }
+
+    for (std::future<bool> &res : results) {
+        if (!res.get() && success) {
+            if (err) *err = "Failed to export the variant images";
+            success = false;
+        }
+    }
+    return success;
+}
+
 /**
  * @class TextureAtlasPacker::TextureAtlasPacker
  * Implements a packing algorithm to pack images into a bigger texture, called
@@ -199,10 +893,17 @@ bool TextureAtlasPackerPrivate::collectNodes(TextureAtlasPrivate *atlas, std::sh
  */
 
 
-TextureAtlasPacker::TextureAtlasPacker(Size atlasSize)
+/*!
+ * \brief TextureAtlasPacker::TextureAtlasPacker
+ * Creates a empty atlas of \a atlasSize, images are placed using the split rule and fit
+ * heuristic given by \a policy. Every policy is backed by its own specialised packing code,
+ * the policy is only looked at once here.
+ */
+TextureAtlasPacker::TextureAtlasPacker(Size atlasSize, const PackPolicy &policy)
     : p(new TextureAtlasPackerPrivate())
 {
-    p->m_root.rect = Rect(Pos(0,0), atlasSize);
+    p->m_policy = policy;
+    p->m_layout = PackLayout::create(atlasSize, policy);
 }
 
 TextureAtlasPacker::~TextureAtlasPacker()
@@ -216,7 +917,16 @@ TextureAtlasPacker::~TextureAtlasPacker()
  */
 Size TextureAtlasPacker::size() const
 {
-    return p->m_root.rect.size;
+    return p->m_layout->size();
+}
+
+/*!
+ * \brief TextureAtlasPacker::packPolicy
+ * Returns the policy the atlas was created with
+ */
+PackPolicy TextureAtlasPacker::packPolicy() const
+{
+    return p->m_policy;
 }
 
 /*!
@@ -224,13 +934,384 @@ Size TextureAtlasPacker::size() const
  * Tried to insert the \sa AtlasPack::Image given by \a img into the atlas.
  * The internal algorithm will split the atlas rectangle into smaller portions
  * until the image fits.
- * Returns \a true on success, or \a false in case the atlas does not have enough remaining space.
+ * Returns \a true on success, or \a false in case the atlas does not have enough remaining space
+ * or \a img is invalid.
+ */
+bool TextureAtlasPacker::insertImage(const Image &img, Rect *cell)
+{
+    if (!img.isValid())
+        return false;
+
+    size_t node = p->m_layout->insert(p->cellSize(img));
+    if (node == PackLayout::NoNode)
+        return false;
+
+    p->m_images.resize(p->m_layout->nodeCount());
+    p->m_images[node] = img;
+    if (cell)
+        *cell = p->m_layout->rect(node);
+    return true;
+}
+
+/*!
+ * \brief TextureAtlasPacker::insertImages
+ * Inserts all \a images in order, this is faster than inserting them one by one.
+ * Returns \a false as soon as one image does not fit, the images before it stay
+ * in the atlas. Nothing is inserted if one of the \a images is invalid.
  */
-bool TextureAtlasPacker::insertImage(const Image &img)
+bool TextureAtlasPacker::insertImages(const std::vector<Image> &images)
 {
-    return p->insertImage(img, &p->m_root) != nullptr;
+    std::vector<Size> cells;
+    cells.reserve(images.size());
+    for (const Image &img : images) {
+        if (!img.isValid())
+            return false;
+        cells.push_back(p->cellSize(img));
+    }
+
+    std::vector<size_t> nodes;
+    bool inserted = p->m_layout->insertAll(cells, &nodes);
+
+    p->m_images.resize(p->m_layout->nodeCount());
+    for (size_t i = 0; i < nodes.size(); i++)
+        p->m_images[nodes[i]] = images[i];
+    return inserted;
+}
+
+/*!
+ * \brief TextureAtlasPacker::insertAtlas
+ * Inserts all images of \a block at once, keeping their positions relative to each other.
+ * A cell of the size of \a block is reserved and stored in \a cell, the layout of \a block is
+ * copied into it, so its free areas can take in images afterwards. This combines atlases that
+ * were packed independently, \sa AtlasPack::HierarchicalPacker. The size of \a block has to be a
+ * multiple of the placement alignment, with its images aligned to the same value.
+ * Returns \a false if \a block does not fit or is not aligned.
+ */
+bool TextureAtlasPacker::insertAtlas(const TextureAtlasPacker &block, Rect *cell)
+{
+    const Size blockSize = block.size();
+    if (blockSize.width % p->m_alignment || blockSize.height % p->m_alignment)
+        return false;
+
+    size_t node = p->m_layout->insert(blockSize);
+    if (node == PackLayout::NoNode)
+        return false;
+
+    std::vector<size_t> nodeMap;
+    if (!p->m_layout->graft(node, *block.p->m_layout, &nodeMap)) {
+        p->m_layout->release(node);
+        return false;
+    }
+
+    p->m_images.resize(p->m_layout->nodeCount());
+    for (size_t i = 0; i < block.p->m_images.size(); i++) {
+        if (block.p->m_images[i].isValid())
+            p->m_images[nodeMap[i]] = block.p->m_images[i];
+    }
+    if (cell)
+        *cell = p->m_layout->rect(node);
+    return true;
+}
+
+/*!
+ * \brief TextureAtlasPacker::replaceImage
+ * Replaces the already packed image with the same path as \a img, for example after
+ * the file was modified. This only succeeds if \a img fits into the cell that was reserved
+ * for the old image, which is stored in \a cell. The other images keep their position.
+ * Returns \a false if there is no image with that path or \a img is too big or invalid.
+ */
+bool TextureAtlasPacker::replaceImage(const Image &img, Rect *cell)
+{
+    if (!img.isValid())
+        return false;
+
+    size_t node = p->findImage(img.path());
+    if (node == PackLayout::NoNode)
+        return false;
+
+    Size newCell = p->cellSize(img);
+    Rect nodeRect = p->m_layout->rect(node);
+    if (newCell.width > nodeRect.size.width || newCell.height > nodeRect.size.height)
+        return false;
+
+    p->m_images[node] = img;
+    if (cell)
+        *cell = nodeRect;
+    return true;
+}
+
+/*!
+ * \brief TextureAtlasPacker::removeImage
+ * Removes the image loaded from \a path, its cell, which is stored in \a cell, can
+ * be used by images inserted afterwards. Returns \a false if there is no such image.
+ */
+bool TextureAtlasPacker::removeImage(const std::string &path, Rect *cell)
+{
+    size_t node = p->findImage(path);
+    if (node == PackLayout::NoNode)
+        return false;
+
+    p->m_layout->release(node);
+    p->m_images[node] = Image();
+    if (cell)
+        *cell = p->m_layout->rect(node);
+    return true;
+}
+
+/*!
+ * \brief TextureAtlasPacker::placements
+ * Returns all packed images together with their cells
+ */
+std::vector<Placement> TextureAtlasPacker::placements() const
+{
+    return p->collectPlacements();
+}
+
+/*!
+ * \brief TextureAtlasPacker::writeDescription
+ * Writes only the atlas description of the current layout into \a fileName, in
+ * the same format \sa TextureAtlasPacker::compile uses.
+ */
+bool TextureAtlasPacker::writeDescription(const std::string &fileName, std::string *error) const
+{
+    std::ofstream descFile(fileName, std::ios::trunc | std::ios::out);
+    if (!descFile.is_open()) {
+        if (error) {
+            std::stringstream s;
+            s << "Could not create atlas index file "<<fileName<<" "<<strerror(errno);
+            *error = s.str();
+        }
+        return false;
+    }
+
+    writeDescription(descFile);
+
+    descFile.close();
+    if (descFile.fail()) {
+        if (error) *error = "Failed to write atlas index file " + fileName;
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief TextureAtlasPacker::writeDescription
+ * Writes the atlas description of the current layout into the stream \a out
+ */
+void TextureAtlasPacker::writeDescription(std::ostream &out) const
+{
+    for (const Placement &placement : p->collectPlacements())
+        p->writeDescriptionLine(&out, Texture(placement.cell.topLeft, placement.image));
+}
+
+/*!
+ * \brief TextureAtlasPacker::setPlacementAlignment
+ * Aligns the position of all images inserted afterwards to multiples of \a alignment pixels,
+ * the area between the images is used as padding. This is required for mipmaps or block compressed
+ * textures, so the images do not share pixels or blocks in the smaller levels.
+ */
+void TextureAtlasPacker::setPlacementAlignment(size_t alignment)
+{
+    p->m_alignment = alignment > 0 ? alignment : 1;
+}
+
+/*!
+ * \brief TextureAtlasPacker::placementAlignment
+ * Returns the current placement alignment, \sa TextureAtlasPacker::setPlacementAlignment
+ */
+size_t TextureAtlasPacker::placementAlignment() const
+{
+    return p->m_alignment;
+}
+
+/*!
+ * \brief TextureAtlasPacker::setGenerateMipmaps
+ * If \a enabled is true, \sa TextureAtlasPacker::compile additionally writes the full chain of
+ * mipmap levels of the atlas image, named <basePath>_mip<level>.png
+ */
+void TextureAtlasPacker::setGenerateMipmaps(bool enabled)
+{
+    p->m_mipmaps = enabled;
+}
+
+/*!
+ * \brief TextureAtlasPacker::generateMipmaps
+ * Returns true if mipmap levels are generated on compile
+ */
+bool TextureAtlasPacker::generateMipmaps() const
+{
+    return p->m_mipmaps;
+}
+
+/*!
+ * \brief TextureAtlasPacker::setBlockCompression
+ * If \a format is not \a BlockCompression::None, \sa TextureAtlasPacker::compile additionally
+ * writes the atlas image compressed into \a format to a DDS file named <basePath>.dds. If mipmaps
+ * are generated they are stored in the same file. Use a placement alignment of 4 to make sure
+ * images do not share compressed blocks.
+ */
+void TextureAtlasPacker::setBlockCompression(BlockCompression format)
+{
+    p->m_compression = format;
+}
+
+/*!
+ * \brief TextureAtlasPacker::blockCompression
+ * Returns the block compression format that is used on compile
+ */
+BlockCompression TextureAtlasPacker::blockCompression() const
+{
+    return p->m_compression;
+}
+
+/*!
+ * \brief TextureAtlasPacker::setExportPng
+ * If \a enabled is false, \sa TextureAtlasPacker::compile does not write the png files of the atlas
+ * image and its mipmaps, this is useful if only the block compressed texture is required.
+ */
+void TextureAtlasPacker::setExportPng(bool enabled)
+{
+    p->m_exportPng = enabled;
+}
+
+/*!
+ * \brief TextureAtlasPacker::exportPng
+ * Returns true if the atlas image is written as png file on compile
+ */
+bool TextureAtlasPacker::exportPng() const
+{
+    return p->m_exportPng;
+}
+
+/*!
+ * \brief TextureAtlasPacker::setDecodeBudget
+ * Limits the memory the paint tasks of \sa TextureAtlasPacker::compile may use at the same time
+ * to \a bytes. The memory of every task is estimated from the size of its source image, tasks
+ * are held back until enough of the budget is free. A single image bigger than the budget is
+ * painted while no other task runs. 0 (the default) starts all paint tasks at once.
+ */
+void TextureAtlasPacker::setDecodeBudget(size_t bytes)
+{
+    p->m_decodeBudget = bytes;
+}
+
+size_t TextureAtlasPacker::decodeBudget() const
+{
+    return p->m_decodeBudget;
+}
+
+/*!
+ * \brief TextureAtlasPacker::setPrefetchWindow
+ * Reads the image files ahead of the paint tasks of \sa TextureAtlasPacker::compile, holding up to
+ * \a bytes of file content that was not painted yet, see \sa AtlasPack::FilePrefetcher. The paint
+ * device decodes the images from memory, so the workers do not wait for storage. Nothing is read ahead
+ * if the paint device does not decode from memory, \sa PaintDevice::decodesImageData.
+ * 0 (the default) lets the paint device read every file itself.
+ */
+void TextureAtlasPacker::setPrefetchWindow(size_t bytes)
+{
+    p->m_prefetchWindow = bytes;
+}
+
+size_t TextureAtlasPacker::prefetchWindow() const
+{
+    return p->m_prefetchWindow;
+}
+
+/*!
+ * \brief TextureAtlasPacker::setTileSize
+ * Makes \sa TextureAtlasPacker::compile additionally write the atlas image as square tiles of
+ * \a tileSize pixels. Only tiles that differ from the tiles written by the previous compile run
+ * into the same location are written again, a small delta file lists them, so tools syncing or
+ * uploading the atlas only have to move the changed tiles. 0 (the default) writes no tiles.
+ */
+void TextureAtlasPacker::setTileSize(size_t tileSize)
+{
+    p->m_tileSize = tileSize;
+}
+
+size_t TextureAtlasPacker::tileSize() const
+{
+    return p->m_tileSize;
+}
+
+/*!
+ * \brief TextureAtlasPacker::setVariants
+ * Makes \sa TextureAtlasPacker::compile additionally write a scaled copy of the atlas for every entry
+ * of \a variants, for example the @1x and @2x atlases of images that were packed at @3x. All variants
+ * share the layout of the packed images, which have the size of \a layoutScale. A variant of scale
+ * s has s / \a layoutScale times the size of the atlas and is painted from the atlas image, or from the
+ * files listed in its sources. The placement alignment has to be a multiple of
+ * \sa TextureAtlasPacker::variantAlignment, so every image starts at a whole pixel in all variants.
+ * Mipmaps, block compression and tiles are only written for the atlas itself.
+ */
+void TextureAtlasPacker::setVariants(const std::vector<AtlasVariant> &variants, size_t layoutScale)
+{
+    p->m_variants = variants;
+    p->m_layoutScale = std::max<size_t>(1, layoutScale);
 }
 
+std::vector<AtlasVariant> TextureAtlasPacker::variants() const
+{
+    return p->m_variants;
+}
+
+size_t TextureAtlasPacker::layoutScale() const
+{
+    return p->m_layoutScale;
+}
+
+/*!
+ * \brief TextureAtlasPacker::variantAlignment
+ * Returns the smallest placement alignment that lets every image of a layout at \a layoutScale start
+ * at a whole pixel in all of the \a variants, this is the least common multiple of the
+ * denominators of all scale factors.
+ */
+size_t TextureAtlasPacker::variantAlignment(const std::vector<AtlasVariant> &variants, size_t layoutScale)
+{
+    auto gcd = [](size_t a, size_t b) {
+        while (b) {
+            size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    };
+
+    size_t alignment = 1;
+    for (const AtlasVariant &variant : variants) {
+        size_t step = layoutScale / std::max<size_t>(1, gcd(layoutScale, variant.scale));
+        alignment = alignment / gcd(alignment, step) * step;
+    }
+    return alignment;
+}
+
+/*!
+ * \brief TextureAtlasPacker::setJobQueue
+ * Runs the paint, mipmap and compression tasks of \sa TextureAtlasPacker::compile on \a jobs
+ * instead of creating a new queue for every compile run. The queue can be shared by many atlases
+ * and has to outlive the compile call. Passing nullptr restores the default.
+ */
+void TextureAtlasPacker::setJobQueue(JobQueue<bool> *jobs)
+{
+    p->m_jobs = jobs;
+}
+
+JobQueue<bool> *TextureAtlasPacker::jobQueue() const
+{
+    return p->m_jobs;
+}
+
+/*
+ * Returns true and sets \a error if the compile run controlled by \a control was cancelled
+ */
+static bool wasCancelled (CompileHandlePrivate *control, std::string *error)
+{
+    if (!control || !control->cancelled.load())
+        return false;
+    if (error) *error = "Compiling the atlas was cancelled";
+    return true;
+}
 
 /**
  * \brief TextureAtlasPacker::compile
@@ -238,19 +1319,64 @@ bool TextureAtlasPacker::insertImage(const Image &img)
  * image file and stores them on disk. Expects \a basePath to point at a user writeable directory,
  * the last part of \a basePath will be used to form the texture atlas description file and image file names.
  *
+ * If \a report is set, the duration of every compile phase and the occupancy of the atlas are recorded there.
+ *
  * \note This can take a lot of time for a big list of images, however the implementation does run with multiple
  *       threads to speed the process up.
  */
-TextureAtlas TextureAtlasPacker::compile(const std::string &basePath, Backend *backend, std::string *error) const
+TextureAtlas TextureAtlasPacker::compile(const std::string &basePath, Backend *backend, std::string *error, CompileReport *report) const
+{
+    return compile(basePath, backend, error, report, nullptr);
+}
+
+/**
+ * \brief TextureAtlasPacker::compileAsync
+ * Like \sa TextureAtlasPacker::compile, but returns immediately. The compile run continues in the
+ * background and can be observed and cancelled with the returned \sa AtlasPack::CompileHandle.
+ * If \a progress is set, it is called every time a image was painted and when the compile phase changes.
+ * The calls come from the worker threads, but never at the same time.
+ *
+ * \note The packer, the \a backend and \a report have to stay alive until the compile run is finished.
+ *       Destroying the last copy of the handle waits for that.
+ */
+CompileHandle TextureAtlasPacker::compileAsync(const std::string &basePath, Backend *backend,
+                                               CompileProgressCallback progress, CompileReport *report) const
+{
+    CompileHandle handle;
+    handle.p = std::make_shared<CompileHandlePrivate>();
+    handle.p->callback = progress;
+
+    CompileHandlePrivate *control = handle.p.get();
+    handle.p->result = std::async(std::launch::async, [this, basePath, backend, report, control]() {
+        return compile(basePath, backend, &control->error, report, control);
+    }).share();
+    return handle;
+}
+
+/**
+ * @internal
+ * Runs the compile, reporting progress to \a control if it is set
+ */
+TextureAtlas TextureAtlasPacker::compile(const std::string &basePath, Backend *backend, std::string *error,
+                                         CompileReport *report, CompileHandlePrivate *control) const
 {
 
     try {
+        auto compileStart = Clock::now();
+        CompileReport localReport;
+        if (!report)
+            report = &localReport;
+        *report = CompileReport();
 
         //the basepath is used to create the filenames for the 2 output files
         fs::path descFileName(basePath + ".atlas");
         fs::path textureFile(basePath + ".png");
 
-        JobQueue<bool> jobs;
+        //use the shared queue if one was set, otherwise a queue only for this compile run
+        std::unique_ptr<JobQueue<bool> > ownJobs;
+        if (!p->m_jobs)
+            ownJobs.reset(new JobQueue<bool>());
+        JobQueue<bool> &jobs = p->m_jobs ? *p->m_jobs : *ownJobs;
 
         //check if the output directory exists
         if (!fs::exists(descFileName.parent_path())
@@ -260,6 +1386,20 @@ TextureAtlas TextureAtlasPacker::compile(const std::string &basePath, Backend *b
             return TextureAtlas();
         }
 
+        //a variant has to be smaller than the layout and every image has to start at a whole pixel in it
+        for (const AtlasVariant &variant : p->m_variants) {
+            if (variant.scale == 0 || variant.scale >= p->m_layoutScale) {
+                if (error)
+                    *error = "Variant scales have to be smaller than the layout scale";
+                return TextureAtlas();
+            }
+        }
+        if (p->m_alignment % variantAlignment(p->m_variants, p->m_layoutScale)) {
+            if (error)
+                *error = "The placement alignment does not fit the variant scales";
+            return TextureAtlas();
+        }
+
         //create atlas description text file
         std::ofstream descFile(descFileName.string(), std::ios::trunc | std::ios::out);
         if(!descFile.is_open()) {
@@ -272,18 +1412,56 @@ TextureAtlas TextureAtlasPacker::compile(const std::string &basePath, Backend *b
         }
 
         //get new painter instance from the backend
-        auto painter = backend->createPaintDevice(p->m_root.rect.size);
+        const Rect atlasRect(Pos(0, 0), size());
+        auto painter = backend->createPaintDevice(atlasRect.size);
 
         std::unique_ptr<TextureAtlasPrivate> priv = std::make_unique<TextureAtlasPrivate>();
         std::vector<std::future<bool> > paintResults;
+        PaintStatistics paintStats;
 
-        //recursively collect all nodes, write them to the desc file and give paint tasks to the
+        //the description is buffered and written after the image, so both can be measured on their own
+        std::stringstream descStr;
+
+        //recursively collect all nodes, write them to the description and give paint tasks to the
         //JobQueue to run asynchronously
-        if(!p->collectNodes(priv.get(), painter, &descFile, &p->m_root, &jobs, paintResults, error))
+        if (control) {
+            control->total.store(p->collectPlacements().size());
+            control->setPhase(CompilePhase::Painting);
+        }
+
+        //has to outlive the paint tasks, they give their memory back when they are done
+        std::unique_ptr<AdmissionControl> admission;
+        if (p->m_decodeBudget)
+            admission.reset(new AdmissionControl(p->m_decodeBudget));
+        //reading ahead only helps if the paint device decodes from memory, others read the file again
+        std::unique_ptr<FilePrefetcher> prefetcher;
+        if (p->m_prefetchWindow && painter->decodesImageData())
+            prefetcher.reset(new FilePrefetcher(p->m_prefetchWindow));
+
+        auto phaseStart = Clock::now();
+        bool collected = p->collectNodes(priv.get(), painter, &descStr, &jobs, paintResults, &paintStats, control,
+                                         admission.get(), prefetcher.get(), error);
+        report->collectMs = elapsedMs(phaseStart);
+
+        //wait until all painters are done, only our own tasks are waited for
+        //since the queue might be shared with other atlases
+        for (std::future<bool> &res : paintResults)
+            res.wait();
+        if (!collected)
             return TextureAtlas();
+        //painting starts while the tree is still walked, only count the time the paint tasks ran
+        report->paintMs = paintStats.spanMs();
+        report->paintTasks = paintStats.histogram;
+        if (admission) {
+            report->decodeBudget = admission->budget();
+            report->peakDecodeBytes = admission->peakBytes();
+            report->admissionWaitMs = admission->waitMs();
+        }
+        if (prefetcher)
+            report->prefetch = prefetcher->stats();
 
-        //wait until all painters are done
-        jobs.waitForAllRunningTasks();
+        if (wasCancelled(control, error))
+            return TextureAtlas();
 
         //check if we have errors in some of the painters, no need
         //to print which one here, because the painters will print a error message on their
@@ -295,13 +1473,96 @@ TextureAtlas TextureAtlasPacker::compile(const std::string &basePath, Backend *b
             }
         }
 
+        //mipmaps and block compression work on the painted pixels, the padding of the images
+        //is filled while generating the mipmaps, so this has to happen before the base level is exported
+        std::shared_ptr<PixelBuffer> basePixels;
+        if (p->m_mipmaps || p->m_compression != BlockCompression::None) {
+            std::vector<std::shared_ptr<PixelBuffer> > levels{ std::make_shared<PixelBuffer>() };
+            if (!painter->readPixels(atlasRect, levels.front().get())) {
+                if (error) *error = "Failed to read back the atlas image";
+                return TextureAtlas();
+            }
+            if (p->m_tileSize || !p->m_variants.empty())
+                basePixels = levels.front();
+
+            if (control && p->m_mipmaps)
+                control->setPhase(CompilePhase::Mipmaps);
+
+            phaseStart = Clock::now();
+            if (p->m_mipmaps && !p->writeMipmaps(basePath, backend, painter.get(), &jobs, levels, p->m_exportPng, error))
+                return TextureAtlas();
+            report->mipmapMs = elapsedMs(phaseStart);
+
+            if (wasCancelled(control, error))
+                return TextureAtlas();
+            if (control && p->m_compression != BlockCompression::None)
+                control->setPhase(CompilePhase::Compressing);
+
+            phaseStart = Clock::now();
+            if (p->m_compression != BlockCompression::None
+                    && !p->writeCompressed(basePath + ".dds", &jobs, levels, error))
+                return TextureAtlas();
+            report->compressMs = elapsedMs(phaseStart);
+        }
+
+        if (wasCancelled(control, error))
+            return TextureAtlas();
+        if (control)
+            control->setPhase(CompilePhase::Exporting);
+
         //finally save the result to a file
-        if(!painter->exportToFile(textureFile.string())) {
+        phaseStart = Clock::now();
+        if(p->m_exportPng && !painter->exportToFile(textureFile.string())) {
             if (error) *error = "Failed to export Texture to file";
             return TextureAtlas();
         }
 
+        if ((p->m_tileSize || !p->m_variants.empty()) && !basePixels) {
+            basePixels = std::make_shared<PixelBuffer>();
+            if (!painter->readPixels(atlasRect, basePixels.get())) {
+                if (error) *error = "Failed to read back the atlas image";
+                return TextureAtlas();
+            }
+        }
+        if (p->m_tileSize && !p->writeTiles(basePath, backend, &jobs, basePixels, &report->tiles, error))
+            return TextureAtlas();
+        report->exportMs = elapsedMs(phaseStart);
+
+        if (!p->m_variants.empty()) {
+            phaseStart = Clock::now();
+            if (!p->writeVariants(backend, &jobs, basePixels, error))
+                return TextureAtlas();
+            report->variants  = p->m_variants.size();
+            report->variantMs = elapsedMs(phaseStart);
+        }
+
+        if (control)
+            control->setPhase(CompilePhase::WritingDescription);
+
+        phaseStart = Clock::now();
+        descFile << descStr.str();
         descFile.close();
+        if (descFile.fail()) {
+            if (error) *error = "Failed to write atlas index file " + descFileName.string();
+            return TextureAtlas();
+        }
+        report->manifestMs = elapsedMs(phaseStart);
+
+        //occupancy of the atlas, padding created by the placement alignment counts as wasted
+        report->imageCount = priv->m_textures.size();
+        report->atlasSize  = atlasRect.size;
+        for (const auto &entry : priv->m_textures)
+            report->usedArea += entry.second.image.width() * entry.second.image.height();
+        const size_t atlasArea = report->atlasSize.width * report->atlasSize.height;
+        report->wastedArea = atlasArea - std::min(atlasArea, report->usedArea);
+        report->occupancy  = atlasArea ? static_cast<double>(report->usedArea) / atlasArea : 0.0;
+        report->totalMs    = elapsedMs(compileStart);
+        report->queue      = jobs.stats();
+
+        priv->buildIndex();
+
+        if (control)
+            control->setPhase(CompilePhase::Finished);
         return TextureAtlas(priv.release());
 
     } catch (const fs::filesystem_error& ex) {
@@ -317,6 +1578,88 @@ TextureAtlas TextureAtlasPacker::compile(const std::string &basePath, Backend *b
     return TextureAtlas();
 }
 
+/**
+ * \class AtlasPack::CompileHandle
+ * Handle to a compile run started with \sa TextureAtlasPacker::compileAsync. Copies of
+ * the handle refer to the same compile run.
+ */
+CompileHandle::CompileHandle()
+{
+
+}
+
+/*!
+ * \brief CompileHandle::isValid
+ * Returns \a true if the handle refers to a compile run
+ */
+bool CompileHandle::isValid() const
+{
+    return p != nullptr;
+}
+
+/*!
+ * \brief CompileHandle::cancel
+ * Requests to stop the compile run, images that are not painted yet are skipped and
+ * the following phases are not started. The result will be a invalid atlas.
+ */
+void CompileHandle::cancel()
+{
+    if (p)
+        p->cancelled.store(true);
+}
+
+bool CompileHandle::isCancelled() const
+{
+    return p && p->cancelled.load();
+}
+
+/*!
+ * \brief CompileHandle::progress
+ * Returns the current phase and the number of painted images
+ */
+CompileProgress CompileHandle::progress() const
+{
+    CompileProgress progress;
+    if (p) {
+        progress.phase = static_cast<CompilePhase>(p->phase.load());
+        progress.paintedImages = p->painted.load();
+        progress.totalImages = p->total.load();
+    }
+    return progress;
+}
+
+/*!
+ * \brief CompileHandle::isFinished
+ * Returns \a true if the compile run is done, successful or not
+ */
+bool CompileHandle::isFinished() const
+{
+    return !p || p->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
 
+/*!
+ * \brief CompileHandle::waitFor
+ * Waits up to \a milliseconds for the compile run, returns \a true if it is finished
+ */
+bool CompileHandle::waitFor(unsigned int milliseconds) const
+{
+    return !p || p->result.wait_for(std::chrono::milliseconds(milliseconds)) == std::future_status::ready;
+}
+
+/*!
+ * \brief CompileHandle::result
+ * Waits for the compile run and returns the compiled atlas, in case of a error the
+ * atlas is invalid and the message is stored in \a error.
+ */
+TextureAtlas CompileHandle::result(std::string *error) const
+{
+    if (!p)
+        return TextureAtlas();
+
+    TextureAtlas atlas = p->result.get();
+    if (error)
+        *error = p->error;
+    return atlas;
+}
 
 }
@@ -0,0 +1,540 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/TiledPaintDevice>
+#include <AtlasPack/pngstream_p.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ATLASPACK_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace AtlasPack {
+
+const size_t TiledPaintDevice::TileSize;
+static const size_t TileBytes = TiledPaintDevice::TileSize * TiledPaintDevice::TileSize * 4;
+
+class TiledPaintDevicePrivate {
+    public:
+        struct Tile {
+            unsigned char *data = nullptr;
+            size_t pins = 0;
+            bool inLru = false;
+            std::list<size_t>::iterator lruPos;
+        };
+
+        ~TiledPaintDevicePrivate();
+
+        void init (const Size &size, size_t residentBytes);
+        bool createSwapFile (const std::string &swapDirectory, std::string *err);
+        bool openFile (const std::string &fileName, std::string *err);
+        bool resizeFile (std::string *err);
+        unsigned char *pin (size_t tile);
+        void unpin (size_t tile);
+        void unmapOldest ();
+
+        template <typename Function> bool forEachTile (const Rect &area, Function fun);
+
+        const Backend *m_decoder = nullptr;
+        Size m_size;
+        size_t m_tilesX = 0;
+        size_t m_tilesY = 0;
+        bool m_valid = false;
+
+        std::mutex m_mutex;
+        std::vector<Tile> m_tiles;
+        std::list<size_t> m_lru;    //mapped tiles that are not in use, the least recently used first
+        size_t m_mapped = 0;
+        size_t m_maxMapped = 1;
+        int m_fd = -1;
+};
+
+TiledPaintDevicePrivate::~TiledPaintDevicePrivate()
+{
+#ifdef ATLASPACK_HAVE_MMAP
+    for (Tile &tile : m_tiles) {
+        if (tile.data)
+            munmap(tile.data, TileBytes);
+    }
+    if (m_fd >= 0)
+        close(m_fd);
+#endif
+}
+
+void TiledPaintDevicePrivate::init(const Size &size, size_t residentBytes)
+{
+    m_size = size;
+    m_tilesX = (size.width  + TiledPaintDevice::TileSize - 1) / TiledPaintDevice::TileSize;
+    m_tilesY = (size.height + TiledPaintDevice::TileSize - 1) / TiledPaintDevice::TileSize;
+    m_maxMapped = std::max<size_t>(1, residentBytes / TileBytes);
+    m_tiles.resize(m_tilesX * m_tilesY);
+}
+
+/**
+ * @internal
+ * @brief TiledPaintDevicePrivate::createSwapFile
+ * Creates the swap file in \a swapDirectory, it is removed from the directory right away
+ * so it disappears when the device is destroyed or the process ends. The file is sparse,
+ * tiles that are never painted do not use any disk space and read as transparent pixels.
+ */
+bool TiledPaintDevicePrivate::createSwapFile(const std::string &swapDirectory, std::string *err)
+{
+#ifdef ATLASPACK_HAVE_MMAP
+    boost::system::error_code ec;
+    fs::path dir = swapDirectory.empty() ? fs::temp_directory_path(ec) : fs::path(swapDirectory);
+    if (ec) {
+        *err = "Could not find a directory for the swap file: " + ec.message();
+        return false;
+    }
+
+    std::string fileName = (dir / "atlaspack-tiles-XXXXXX").string();
+    m_fd = mkstemp(&fileName[0]);
+    if (m_fd < 0) {
+        *err = "Could not create the swap file in " + dir.string() + ": " + strerror(errno);
+        return false;
+    }
+    unlink(fileName.c_str());
+    return resizeFile(err);
+#else
+    UNUSED(swapDirectory);
+    *err = "Tiled paint devices need memory mapped files, which are not supported on this platform";
+    return false;
+#endif
+}
+
+/**
+ * @internal
+ * @brief TiledPaintDevicePrivate::openFile
+ * Opens or creates the tile file \a fileName, which is kept after the device is destroyed.
+ */
+bool TiledPaintDevicePrivate::openFile(const std::string &fileName, std::string *err)
+{
+#ifdef ATLASPACK_HAVE_MMAP
+    m_fd = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) {
+        *err = "Could not open the tile file " + fileName + ": " + strerror(errno);
+        return false;
+    }
+    return resizeFile(err);
+#else
+    UNUSED(fileName);
+    *err = "Tiled paint devices need memory mapped files, which are not supported on this platform";
+    return false;
+#endif
+}
+
+/**
+ * @internal
+ * Makes sure the tile file is big enough for all tiles
+ */
+bool TiledPaintDevicePrivate::resizeFile(std::string *err)
+{
+#ifdef ATLASPACK_HAVE_MMAP
+    const off_t fileSize = static_cast<off_t>(m_tiles.size() * TileBytes);
+    struct stat info;
+    if (fstat(m_fd, &info) == 0 && info.st_size == fileSize)
+        return true;
+
+    if (ftruncate(m_fd, fileSize) != 0) {
+        *err = std::string("Could not resize the tile file: ") + strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    UNUSED(err);
+    return false;
+#endif
+}
+
+/**
+ * @internal
+ * @brief TiledPaintDevicePrivate::pin
+ * Returns the pixels of \a tile, mapping it if required. The tile stays mapped until
+ * \sa TiledPaintDevicePrivate::unpin is called. The least recently used tiles are unmapped
+ * to stay in the resident budget, if all mapped tiles are in use the budget is exceeded.
+ */
+unsigned char *TiledPaintDevicePrivate::pin(size_t tile)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Tile &t = m_tiles[tile];
+
+    if (t.inLru) {
+        m_lru.erase(t.lruPos);
+        t.inLru = false;
+    }
+
+#ifdef ATLASPACK_HAVE_MMAP
+    if (!t.data) {
+        while (m_mapped >= m_maxMapped && !m_lru.empty())
+            unmapOldest();
+
+        void *data = mmap(nullptr, TileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, static_cast<off_t>(tile * TileBytes));
+        if (data == MAP_FAILED) {
+            std::cerr << "Failed to map tile " << tile << " of the swap file: " << strerror(errno) << std::endl;
+            return nullptr;
+        }
+        t.data = static_cast<unsigned char *>(data);
+        m_mapped++;
+    }
+#endif
+
+    t.pins++;
+    return t.data;
+}
+
+void TiledPaintDevicePrivate::unpin(size_t tile)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Tile &t = m_tiles[tile];
+    if (--t.pins == 0) {
+        t.lruPos = m_lru.insert(m_lru.end(), tile);
+        t.inLru = true;
+    }
+}
+
+/**
+ * @internal
+ * Unmaps the least recently used tile, its pixels are written back to the swap file
+ * by the kernel. Has to be called with m_mutex locked.
+ */
+void TiledPaintDevicePrivate::unmapOldest()
+{
+    const size_t tile = m_lru.front();
+    m_lru.pop_front();
+
+    Tile &t = m_tiles[tile];
+    t.inLru = false;
+#ifdef ATLASPACK_HAVE_MMAP
+    munmap(t.data, TileBytes);
+#endif
+    t.data = nullptr;
+    m_mapped--;
+}
+
+/**
+ * @internal
+ * Calls \a fun with the pixels of every tile that intersects \a area, its position in the
+ * atlas and the part of \a area it covers. \a area has to be inside of the device.
+ */
+template <typename Function>
+bool TiledPaintDevicePrivate::forEachTile(const Rect &area, Function fun)
+{
+    const size_t tileSize = TiledPaintDevice::TileSize;
+    if (area.size.width == 0 || area.size.height == 0)
+        return true;
+
+    const size_t lastX = (area.topLeft.x + area.size.width  - 1) / tileSize;
+    const size_t lastY = (area.topLeft.y + area.size.height - 1) / tileSize;
+
+    for (size_t ty = area.topLeft.y / tileSize; ty <= lastY; ty++) {
+        for (size_t tx = area.topLeft.x / tileSize; tx <= lastX; tx++) {
+            const Pos tilePos(tx * tileSize, ty * tileSize);
+            const size_t x0 = std::max(area.topLeft.x, tilePos.x);
+            const size_t y0 = std::max(area.topLeft.y, tilePos.y);
+            const size_t x1 = std::min(area.topLeft.x + area.size.width,  tilePos.x + tileSize);
+            const size_t y1 = std::min(area.topLeft.y + area.size.height, tilePos.y + tileSize);
+
+            const size_t tile = ty * m_tilesX + tx;
+            unsigned char *pixels = pin(tile);
+            if (!pixels)
+                return false;
+            fun(pixels, tilePos, Rect(Pos(x0, y0), Size(x1 - x0, y1 - y0)));
+            unpin(tile);
+        }
+    }
+    return true;
+}
+
+/**
+ * \class AtlasPack::TiledPaintDevice
+ * Paint device for atlases that do not fit into memory. The canvas is stored as tiles
+ * of TileSize x TileSize pixels in a sparse swap file, the tiles are memory mapped while
+ * they are painted and only the most recently used ones stay mapped, so the memory usage
+ * is bound by \a residentBytes instead of the atlas size.
+ *
+ * Images are decoded with \a decoder. The atlas is streamed tile row by tile row into a
+ * png file by \sa TiledPaintDevice::exportToFile, the only supported format.
+ * Mipmaps and block compression read back the full atlas, so they still need enough memory
+ * for the complete image.
+ */
+TiledPaintDevice::TiledPaintDevice(const Size &size, const Backend *decoder, const std::string &swapDirectory,
+                                   size_t residentBytes)
+    : p(new TiledPaintDevicePrivate())
+{
+    p->m_decoder = decoder;
+    p->init(size, residentBytes);
+
+    std::string err;
+    p->m_valid = p->createSwapFile(swapDirectory, &err);
+    if (!p->m_valid)
+        std::cerr << err << std::endl;
+}
+
+TiledPaintDevice::TiledPaintDevice(TiledPaintDevicePrivate *priv)
+    : p(priv)
+{
+}
+
+/*!
+ * \brief TiledPaintDevice::openFile
+ * Creates a device that keeps its tiles in \a fileName instead of a temporary file. The
+ * file is created if required and kept when the device is destroyed, its existing content
+ * is used as canvas. Several processes can open the same file and paint into it, changes
+ * are shared through the memory mapping. Returns a invalid device if the file can not be opened.
+ */
+std::shared_ptr<TiledPaintDevice> TiledPaintDevice::openFile(const std::string &fileName, const Size &size,
+                                                             const Backend *decoder, size_t residentBytes)
+{
+    TiledPaintDevicePrivate *priv = new TiledPaintDevicePrivate();
+    priv->m_decoder = decoder;
+    priv->init(size, residentBytes);
+
+    std::string err;
+    priv->m_valid = priv->openFile(fileName, &err);
+    if (!priv->m_valid)
+        std::cerr << err << std::endl;
+    return std::shared_ptr<TiledPaintDevice>(new TiledPaintDevice(priv));
+}
+
+TiledPaintDevice::~TiledPaintDevice()
+{
+    if (p) delete p;
+}
+
+/*!
+ * \brief TiledPaintDevice::isValid
+ * Returns false if the swap file could not be created
+ */
+bool TiledPaintDevice::isValid() const
+{
+    return p->m_valid;
+}
+
+Size TiledPaintDevice::size() const
+{
+    return p->m_size;
+}
+
+/*!
+ * \brief TiledPaintDevice::residentBytes
+ * Returns the size of all currently mapped tiles
+ */
+size_t TiledPaintDevice::residentBytes() const
+{
+    std::lock_guard<std::mutex> lock(p->m_mutex);
+    return p->m_mapped * TileBytes;
+}
+
+/*!
+ * \brief TiledPaintDevice::paintImageFromFile
+ * Reimplements the paintImageFromFile function from \sa AtlasPack::PaintDevice
+ */
+bool TiledPaintDevice::paintImageFromFile(Pos topleft, std::string filename)
+{
+    PixelBuffer pixels;
+    if (!p->m_decoder || !p->m_decoder->readImagePixels(filename, &pixels))
+        return false;
+    return paintImage(topleft, pixels.view());
+}
+
+/*!
+ * \brief TiledPaintDevice::paintImageFromFile
+ * Reimplements the paintImageFromFile function from \sa AtlasPack::PaintDevice
+ */
+bool TiledPaintDevice::paintImageFromFile(Pos topleft, std::string filename, Rect sourceRect)
+{
+    PixelBuffer pixels;
+    if (!p->m_decoder || !p->m_decoder->readImagePixels(filename, &pixels))
+        return false;
+
+    if (!pixels.view().contains(sourceRect)) {
+        std::cerr << "The source area is outside of the image " << filename << std::endl;
+        return false;
+    }
+    return paintImage(topleft, pixels.view().region(sourceRect));
+}
+
+/*!
+ * \brief TiledPaintDevice::paintImage
+ * Reimplements the paintImage function from \sa AtlasPack::PaintDevice, parts of \a pixels
+ * outside of the device are ignored. Images that do not share pixels can be painted from
+ * multiple threads at the same time.
+ */
+bool TiledPaintDevice::paintImage(Pos topleft, const PixelView &pixels)
+{
+    if (!p->m_valid || !pixels.isValid())
+        return false;
+    if (topleft.x >= p->m_size.width || topleft.y >= p->m_size.height)
+        return true;
+
+    const Rect area(topleft, Size(std::min(pixels.size.width,  p->m_size.width  - topleft.x),
+                                  std::min(pixels.size.height, p->m_size.height - topleft.y)));
+
+    return p->forEachTile(area, [&](unsigned char *tile, const Pos &tilePos, const Rect &part) {
+        for (size_t y = part.topLeft.y; y < part.topLeft.y + part.size.height; y++) {
+            const unsigned char *src = pixels.scanLine(y - topleft.y) + (part.topLeft.x - topleft.x) * 4;
+            unsigned char *dst = tile + ((y - tilePos.y) * TileSize + (part.topLeft.x - tilePos.x)) * 4;
+            std::memcpy(dst, src, part.size.width * 4);
+        }
+    });
+}
+
+/*!
+ * \brief TiledPaintDevice::readPixels
+ * Reimplements the readPixels function from \sa AtlasPack::PaintDevice
+ */
+bool TiledPaintDevice::readPixels(const Rect &rect, PixelBuffer *target) const
+{
+    if (!p->m_valid
+            || rect.topLeft.x + rect.size.width > p->m_size.width
+            || rect.topLeft.y + rect.size.height > p->m_size.height)
+        return false;
+
+    PixelBuffer pixels(rect.size);
+    bool success = p->forEachTile(rect, [&](unsigned char *tile, const Pos &tilePos, const Rect &part) {
+        for (size_t y = part.topLeft.y; y < part.topLeft.y + part.size.height; y++) {
+            const unsigned char *src = tile + ((y - tilePos.y) * TileSize + (part.topLeft.x - tilePos.x)) * 4;
+            unsigned char *dst = pixels.scanLine(y - rect.topLeft.y) + (part.topLeft.x - rect.topLeft.x) * 4;
+            std::memcpy(dst, src, part.size.width * 4);
+        }
+    });
+
+    if (success)
+        *target = std::move(pixels);
+    return success;
+}
+
+/*!
+ * \brief TiledPaintDevice::exportToFile
+ * Streams the atlas into the png file \a filename one scanline at a time, other
+ * image formats are not supported.
+ */
+bool TiledPaintDevice::exportToFile(std::string filename)
+{
+    if (!p->m_valid)
+        return false;
+
+    if (boost::algorithm::to_lower_copy(fs::path(filename).extension().string()) != ".png") {
+        std::cerr << "Tiled paint devices can only export png images, not " << filename << std::endl;
+        return false;
+    }
+
+    std::string err;
+    PngStreamWriter writer;
+    if (!writer.open(filename, p->m_size, &err)) {
+        std::cerr << err << std::endl;
+        return false;
+    }
+
+    //a row of tiles is pinned once for all of its scanlines
+    std::vector<unsigned char> scanLine(p->m_size.width * 4);
+    std::vector<unsigned char *> band(p->m_tilesX, nullptr);
+    for (size_t ty = 0; ty < p->m_tilesY; ty++) {
+        bool written = true;
+        for (size_t tx = 0; tx < p->m_tilesX && written; tx++) {
+            band[tx] = p->pin(ty * p->m_tilesX + tx);
+            written = band[tx] != nullptr;
+        }
+
+        const size_t lastY = std::min(p->m_size.height, (ty + 1) * TileSize);
+        for (size_t y = ty * TileSize; y < lastY && written; y++) {
+            for (size_t tx = 0; tx < p->m_tilesX; tx++) {
+                const size_t x = tx * TileSize;
+                std::memcpy(scanLine.data() + x * 4, band[tx] + (y - ty * TileSize) * TileSize * 4,
+                            std::min(TileSize, p->m_size.width - x) * 4);
+            }
+            written = writer.writeScanLine(scanLine.data());
+        }
+
+        for (size_t tx = 0; tx < p->m_tilesX; tx++) {
+            if (band[tx])
+                p->unpin(ty * p->m_tilesX + tx);
+            band[tx] = nullptr;
+        }
+
+        if (!written) {
+            std::cerr << "Failed to write image file " << filename << std::endl;
+            return false;
+        }
+    }
+
+    if (!writer.finish(&err)) {
+        std::cerr << err << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \class AtlasPack::TiledBackend
+ * Backend that paints into \sa AtlasPack::TiledPaintDevice instances, so atlases can be
+ * bigger than the available memory. All images are read and decoded by \a decoder.
+ */
+TiledBackend::TiledBackend(const Backend *decoder, const std::string &swapDirectory, size_t residentBytes)
+    : m_decoder(decoder), m_swapDirectory(swapDirectory), m_residentBytes(residentBytes)
+{
+}
+
+bool TiledBackend::supportsImageType(const std::string &extension) const
+{
+    return m_decoder->supportsImageType(extension);
+}
+
+std::shared_ptr<PaintDevice> TiledBackend::createPaintDevice(const Size &reserveSize) const
+{
+    return std::make_shared<TiledPaintDevice>(reserveSize, m_decoder, m_swapDirectory, m_residentBytes);
+}
+
+Image TiledBackend::readImageInformation(const std::string &path) const
+{
+    return m_decoder->readImageInformation(path);
+}
+
+Image TiledBackend::readTrimmedImageInformation(const std::string &path) const
+{
+    return m_decoder->readTrimmedImageInformation(path);
+}
+
+bool TiledBackend::readImagePixels(const std::string &path, PixelBuffer *target) const
+{
+    return m_decoder->readImagePixels(path, target);
+}
+
+}
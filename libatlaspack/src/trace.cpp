@@ -0,0 +1,316 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <AtlasPack/Trace>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace AtlasPack {
+
+/**
+ * \class AtlasPack::Trace
+ * Records timed events, like the tasks executed by \sa AtlasPack::JobQueue, and writes
+ * them in the Chrome trace event format, which can be opened with chrome://tracing or Perfetto.
+ *
+ * Every thread records into its own ring buffer, so threads do not contend with each other.
+ * If a buffer is full the oldest events are overwritten. When tracing is disabled the
+ * only cost is a relaxed atomic load per event.
+ */
+
+std::atomic_bool Trace::s_enabled{false};
+
+namespace {
+
+struct TraceEvent {
+    std::string name;
+    const char *category = "";
+    uint64_t start    = 0;
+    uint64_t duration = 0;
+    uint64_t enqueued = 0;
+};
+
+struct ThreadBuffer {
+    std::mutex mutex;           //only contended while the trace is written
+    std::vector<TraceEvent> events;
+    size_t next = 0;
+    bool wrapped = false;
+    size_t threadId = 0;
+    std::string threadName;
+    bool finished = false;      //the thread exited, the buffer only holds its events
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer> > buffers;
+    size_t nextThreadId = 1;
+    size_t bufferSize = 1 << 16;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+TraceRegistry &registry ()
+{
+    static TraceRegistry reg;
+    return reg;
+}
+
+/*
+ * Trace state of a thread. The buffer is only registered once the thread records
+ * a event, when the thread exits a buffer without events is unregistered again.
+ * Buffers with events stay in the registry until \sa Trace::clear, so their events
+ * can still be written.
+ */
+struct ThreadState {
+    std::string name;
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadState () {
+        if (!buffer)
+            return;
+
+        bool empty;
+        {
+            std::lock_guard<std::mutex> lk(buffer->mutex);
+            buffer->finished = true;
+            empty = buffer->next == 0 && !buffer->wrapped;
+        }
+        if (empty) {
+            TraceRegistry &reg = registry();
+            std::lock_guard<std::mutex> lk(reg.mutex);
+            reg.buffers.erase(std::remove(reg.buffers.begin(), reg.buffers.end(), buffer), reg.buffers.end());
+        }
+    }
+};
+
+ThreadState &threadState ()
+{
+    thread_local ThreadState state;
+    return state;
+}
+
+/*
+ * Returns the buffer of the calling thread, registering it on first use
+ */
+ThreadBuffer &threadBuffer ()
+{
+    ThreadState &state = threadState();
+    if (!state.buffer) {
+        state.buffer = std::make_shared<ThreadBuffer>();
+        state.buffer->threadName = state.name;
+
+        TraceRegistry &reg = registry();
+        std::lock_guard<std::mutex> lk(reg.mutex);
+        state.buffer->threadId = reg.nextThreadId++;
+        reg.buffers.push_back(state.buffer);
+    }
+    return *state.buffer;
+}
+
+void writeEscaped (std::ostream &out, const std::string &str)
+{
+    out << '"';
+    for (char c : str) {
+        switch (c) {
+            case '"':  out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n";  break;
+            case '\t': out << "\\t";  break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                    out << ' ';
+                else
+                    out << c;
+        }
+    }
+    out << '"';
+}
+
+}
+
+/*!
+ * \brief Trace::setEnabled
+ * Enables or disables recording of trace events
+ */
+void Trace::setEnabled(bool enabled)
+{
+    //make sure the time base exists before the first event is recorded
+    registry();
+    s_enabled.store(enabled);
+}
+
+/*!
+ * \brief Trace::setBufferSize
+ * Sets the number of events every thread keeps, only affects threads that did not
+ * record any events yet. Defaults to 65536.
+ */
+void Trace::setBufferSize(size_t eventsPerThread)
+{
+    TraceRegistry &reg = registry();
+    std::lock_guard<std::mutex> lk(reg.mutex);
+    reg.bufferSize = eventsPerThread > 0 ? eventsPerThread : 1;
+}
+
+size_t Trace::bufferSize()
+{
+    TraceRegistry &reg = registry();
+    std::lock_guard<std::mutex> lk(reg.mutex);
+    return reg.bufferSize;
+}
+
+/*!
+ * \brief Trace::now
+ * Returns the current timestamp of the trace clock in microseconds
+ */
+uint64_t Trace::now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - registry().epoch).count());
+}
+
+/*!
+ * \brief Trace::setThreadName
+ * Sets the name the calling thread is shown with in the trace. This does not allocate
+ * a event buffer, so it is cheap to call even if tracing is disabled.
+ */
+void Trace::setThreadName(const std::string &name)
+{
+    ThreadState &state = threadState();
+    state.name = name;
+    if (state.buffer) {
+        std::lock_guard<std::mutex> lk(state.buffer->mutex);
+        state.buffer->threadName = name;
+    }
+}
+
+/*!
+ * \brief Trace::complete
+ * Records a event called \a name that started at \a start and took \a duration microseconds
+ * on the calling thread. If \a enqueued is set, it marks the time the work was queued.
+ * Does nothing if tracing is disabled.
+ */
+void Trace::complete(const std::string &name, const char *category, uint64_t start, uint64_t duration, uint64_t enqueued)
+{
+    if (!isEnabled())
+        return;
+
+    ThreadBuffer &buf = threadBuffer();
+    std::lock_guard<std::mutex> lk(buf.mutex);
+
+    //the ring is only allocated once the thread records its first event
+    if (buf.events.empty())
+        buf.events.resize(bufferSize());
+
+    TraceEvent &ev = buf.events[buf.next];
+    ev.name     = name;
+    ev.category = category;
+    ev.start    = start;
+    ev.duration = duration;
+    ev.enqueued = enqueued;
+
+    if (++buf.next == buf.events.size()) {
+        buf.next = 0;
+        buf.wrapped = true;
+    }
+}
+
+/*!
+ * \brief Trace::writeChromeTrace
+ * Writes all recorded events of all threads as Chrome trace JSON into \a out
+ */
+bool Trace::writeChromeTrace(std::ostream &out)
+{
+    std::vector<std::shared_ptr<ThreadBuffer> > buffers;
+    {
+        TraceRegistry &reg = registry();
+        std::lock_guard<std::mutex> lk(reg.mutex);
+        buffers = reg.buffers;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    for (const auto &buf : buffers) {
+        std::lock_guard<std::mutex> lk(buf->mutex);
+
+        if (!buf->threadName.empty()) {
+            out << (first ? "\n" : ",\n")
+                << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buf->threadId
+                << ",\"args\":{\"name\":";
+            writeEscaped(out, buf->threadName);
+            out << "}}";
+            first = false;
+        }
+
+        //oldest events first
+        if (buf->events.empty())
+            continue;
+
+        size_t count = buf->wrapped ? buf->events.size() : buf->next;
+        size_t idx   = buf->wrapped ? buf->next : 0;
+        for (size_t i = 0; i < count; i++, idx = (idx + 1) % buf->events.size()) {
+            const TraceEvent &ev = buf->events[idx];
+            out << (first ? "\n" : ",\n")
+                << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buf->threadId
+                << ",\"cat\":\"" << ev.category << "\""
+                << ",\"ts\":" << ev.start
+                << ",\"dur\":" << ev.duration
+                << ",\"name\":";
+            writeEscaped(out, ev.name);
+            if (ev.enqueued)
+                out << ",\"args\":{\"enqueued\":" << ev.enqueued
+                    << ",\"wait_us\":" << (ev.start >= ev.enqueued ? ev.start - ev.enqueued : 0) << "}";
+            out << "}";
+            first = false;
+        }
+    }
+
+    out << "\n]}\n";
+    return out.good();
+}
+
+/*!
+ * \brief Trace::clear
+ * Drops all recorded events, and the buffers of threads that exited
+ */
+void Trace::clear()
+{
+    TraceRegistry &reg = registry();
+    std::lock_guard<std::mutex> lk(reg.mutex);
+
+    std::vector<std::shared_ptr<ThreadBuffer> > running;
+    for (const auto &buf : reg.buffers) {
+        std::lock_guard<std::mutex> bufLk(buf->mutex);
+        if (buf->finished)
+            continue;
+        buf->next = 0;
+        buf->wrapped = false;
+        running.push_back(buf);
+    }
+    reg.buffers.swap(running);
+}
+
+}
@@ -24,16 +24,34 @@
 
 #include <AtlasPack/TextureAtlasPacker>
 #include <AtlasPack/TextureAtlas>
+#include <AtlasPack/SizeSearch>
+#include <AtlasPack/PackOptimizer>
+#include <AtlasPack/HierarchicalPacker>
+#include <AtlasPack/Report>
+#include <AtlasPack/Trace>
+#include <AtlasPack/LiveAtlas>
+#include <AtlasPack/DirectoryWatcher>
+#include <AtlasPack/BatchCompiler>
 #include <AtlasPack/JobQueue>
+#include <AtlasPack/TiledPaintDevice>
+#include <AtlasPack/ShardedCompiler>
+#include <AtlasPack/PackServer>
+#include <AtlasPack/ImageCache>
 
 #include <AtlasPack/Backends/MagickBackend>
 
+#include <csignal>
 #include <iostream>
 #include <thread>
 #include <future>
 #include <functional>
 #include <utility>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <set>
+#include <algorithm>
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 
@@ -60,12 +78,12 @@ static void showHelp () {
 }
 
 /*
- * Collects all files that the backend supports in \a readDir.
- * If \a recursive is true all subdirectories will be searched as well
+ * Collects the paths of all files that the backend supports in \a readDir.
+ * If \a recursive is true all subdirectories will be searched as well.
  */
-static std::vector<AtlasPack::Image> collectImageFiles (AtlasPack::Backend *backend, const fs::path &readDir, bool recursive = false)
+static std::vector<std::string> collectImagePaths (AtlasPack::Backend *backend, const fs::path &readDir, bool recursive = false)
 {
-    std::vector<AtlasPack::Image> result;
+    std::vector<std::string> result;
 
     try {
         if (!fs::exists(readDir)) {
@@ -88,7 +106,7 @@ static std::vector<AtlasPack::Image> collectImageFiles (AtlasPack::Backend *back
                 }
 
                 if (recursive) {
-                    std::vector<AtlasPack::Image> subDirItems = collectImageFiles(backend, entry, true);
+                    std::vector<std::string> subDirItems = collectImagePaths(backend, entry, true);
                     result.reserve(result.size() + subDirItems.size());
                     result.insert(result.end(), subDirItems.begin(), subDirItems.end());
                 }
@@ -105,14 +123,7 @@ static std::vector<AtlasPack::Image> collectImageFiles (AtlasPack::Backend *back
             if (!backend->supportsImageType(fs::extension(entry)))
                 continue;
 
-            AtlasPack::Image img = backend->readImageInformation(entry.path().string());
-            if (!img.isValid()) {
-                std::cerr << "Error when trying to load "<<entry.path().string()<<" skipping file."<<std::endl;
-                continue;
-            }
-
-            //std::cout<<"Found Image: "<<img.path()<<std::endl;
-            result.push_back(img);
+            result.push_back(entry.path().string());
         }
 
     } catch (const fs::filesystem_error& ex) {
@@ -122,6 +133,460 @@ static std::vector<AtlasPack::Image> collectImageFiles (AtlasPack::Backend *back
     return result;
 }
 
+/*
+ * Collects all files that the backend supports in \a readDir.
+ * If \a recursive is true all subdirectories will be searched as well,
+ * if \a trim is true fully transparent borders are cut off the images.
+ * The time spent reading the image information is added to \a probeMs if set
+ */
+static std::vector<AtlasPack::Image> collectImageFiles (AtlasPack::Backend *backend, const fs::path &readDir, bool recursive = false,
+                                                        bool trim = false, double *probeMs = nullptr)
+{
+    std::vector<AtlasPack::Image> result;
+
+    for (const std::string &path : collectImagePaths(backend, readDir, recursive)) {
+        auto probeStart = std::chrono::steady_clock::now();
+        AtlasPack::Image img = trim ? backend->readTrimmedImageInformation(path)
+                                    : backend->readImageInformation(path);
+        if (probeMs)
+            *probeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - probeStart).count();
+        if (!img.isValid()) {
+            std::cerr << "Error when trying to load "<<path<<" skipping file."<<std::endl;
+            continue;
+        }
+
+        //std::cout<<"Found Image: "<<img.path()<<std::endl;
+        result.push_back(img);
+    }
+
+    return result;
+}
+
+/*
+ * The real stdout, with "--report -" std::cout is redirected to stderr
+ * so progress and status lines do not end up in the JSON report.
+ */
+static std::ostream reportStdout(std::cout.rdbuf());
+
+/*
+ * Writes \a report as JSON into the file \a fileName, or to stdout if \a fileName is "-".
+ * Returns \a true on success.
+ */
+static bool writeReport (const AtlasPack::PackReport &report, const std::string &fileName)
+{
+    if (fileName == "-") {
+        report.writeJson(reportStdout);
+        reportStdout.flush();
+        return true;
+    }
+
+    std::ofstream out(fileName, std::ios::trunc | std::ios::out);
+    if (!out.is_open()) {
+        std::cerr << "Could not create report file "<<fileName<<std::endl;
+        return false;
+    }
+    report.writeJson(out);
+    return true;
+}
+
+/*
+ * Writes the recorded trace events as Chrome trace JSON into the file \a fileName.
+ * Returns \a true on success.
+ */
+static bool writeTrace (const std::string &fileName)
+{
+    std::ofstream out(fileName, std::ios::trunc | std::ios::out);
+    if (!out.is_open()) {
+        std::cerr << "Could not create trace file "<<fileName<<std::endl;
+        return false;
+    }
+    return AtlasPack::Trace::writeChromeTrace(out);
+}
+
+/*
+ * Reads where the worker threads are pinned to from \a vm into \a affinity.
+ * Returns \a false and prints a error if the option is invalid.
+ */
+static bool readWorkerAffinity (const po::variables_map &vm, AtlasPack::WorkerAffinity *affinity)
+{
+    *affinity = AtlasPack::WorkerAffinity::None;
+    if (!vm.count("pin"))
+        return true;
+
+    std::string pin = vm["pin"].as<std::string>();
+    if (pin == "cores")
+        *affinity = AtlasPack::WorkerAffinity::Cores;
+    else if (pin == "numa")
+        *affinity = AtlasPack::WorkerAffinity::NumaNodes;
+    else if (pin != "none") {
+        std::cerr << "Unknown worker pinning "<<pin<<std::endl;
+        showHelp();
+        return false;
+    }
+
+    if (*affinity != AtlasPack::WorkerAffinity::None && !AtlasPack::CpuAffinity::isSupported())
+        std::cerr << "Pinning worker threads is not supported on this system, --pin is ignored."<<std::endl;
+    return true;
+}
+
+/*
+ * Reads the split rule and fit heuristic from \a vm into \a policy.
+ * Returns \a false and prints a error if the options are invalid.
+ */
+static bool readPackPolicy (const po::variables_map &vm, AtlasPack::PackPolicy *policy)
+{
+    if (vm.count("split")) {
+        std::string rule = vm["split"].as<std::string>();
+        if (rule == "longer")
+            policy->split = AtlasPack::SplitRule::LongerRemainder;
+        else if (rule == "shorter")
+            policy->split = AtlasPack::SplitRule::ShorterRemainder;
+        else {
+            std::cerr << "Unknown split rule "<<rule<<std::endl;
+            showHelp();
+            return false;
+        }
+    }
+
+    if (vm.count("fit")) {
+        std::string heuristic = vm["fit"].as<std::string>();
+        if (heuristic == "first")
+            policy->fit = AtlasPack::FitHeuristic::FirstFit;
+        else if (heuristic == "best-area")
+            policy->fit = AtlasPack::FitHeuristic::BestAreaFit;
+        else {
+            std::cerr << "Unknown fit heuristic "<<heuristic<<std::endl;
+            showHelp();
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Reads the options that control how a atlas is written from \a vm into \a options.
+ * Returns \a false and prints a error if the options are invalid.
+ */
+static bool readAtlasOptions (const po::variables_map &vm, AtlasPack::BatchEntry *options)
+{
+    options->mipmaps = vm.count("mipmaps") > 0;
+
+    options->compression = AtlasPack::BlockCompression::None;
+    if (vm.count("compress")) {
+        std::string format = vm["compress"].as<std::string>();
+        if (format == "bc1")
+            options->compression = AtlasPack::BlockCompression::BC1;
+        else if (format == "bc3")
+            options->compression = AtlasPack::BlockCompression::BC3;
+        else {
+            std::cerr << "Unknown block compression format "<<format<<std::endl;
+            showHelp();
+            return false;
+        }
+    }
+
+    options->tileSize = vm.count("tiles") ? vm["tiles"].as<size_t>() : 0;
+    if (vm.count("tiles") && options->tileSize == 0) {
+        std::cerr << "--tiles requires a positive tile size."<<std::endl;
+        return false;
+    }
+
+    options->exportPng = vm.count("no-png") == 0;
+    if (!options->exportPng && options->compression == AtlasPack::BlockCompression::None && !options->tileSize) {
+        std::cerr << "--no-png requires a block compression format or --tiles."<<std::endl;
+        return false;
+    }
+
+    //block compression works on 4x4 blocks, images should not share them
+    options->alignment = (options->mipmaps || options->compression != AtlasPack::BlockCompression::None) ? 4 : 1;
+    if (vm.count("align"))
+        options->alignment = vm["align"].as<size_t>();
+
+    options->decodeBudget = vm["decode-mb"].as<size_t>() << 20;
+    options->prefetchWindow = vm["prefetch-mb"].as<size_t>() << 20;
+
+    return readPackPolicy(vm, &options->policy);
+}
+
+/*
+ * Reads the scales of the atlas variants from \a vm into \a variants. The packed \a images have the
+ * biggest listed scale, which is stored in \a layoutScale, every other scale is written next to
+ * \a outputFileName with a @<scale>x suffix. Images with the same path relative to \a readDir in the
+ * --variant-dir of a scale are painted from there instead of being scaled down.
+ * Returns \a false and prints a error if the options are invalid.
+ */
+static bool readVariants (const po::variables_map &vm, const fs::path &readDir, const fs::path &outputFileName,
+                          const std::vector<AtlasPack::Image> &images, std::vector<AtlasPack::AtlasVariant> *variants,
+                          size_t *layoutScale)
+{
+    auto readScale = [](const std::string &text) {
+        size_t scale = 0;
+        try {
+            scale = std::stoul(text);
+        } catch (const std::exception &) {
+        }
+        return scale;
+    };
+
+    variants->clear();
+    *layoutScale = 1;
+    if (!vm.count("variants")) {
+        if (vm.count("variant-dir")) {
+            std::cerr << "--variant-dir requires --variants."<<std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::set<size_t> scales;
+    std::stringstream list(vm["variants"].as<std::string>());
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        size_t scale = readScale(item);
+        if (scale == 0) {
+            std::cerr << "Invalid variant scale "<<item<<std::endl;
+            return false;
+        }
+        scales.insert(scale);
+    }
+    if (scales.size() < 2) {
+        std::cerr << "--variants requires at least two scales, the biggest one is the scale of the input images."<<std::endl;
+        return false;
+    }
+
+    *layoutScale = *scales.rbegin();
+    for (size_t scale : scales) {
+        if (scale == *layoutScale)
+            continue;
+        AtlasPack::AtlasVariant variant;
+        variant.scale = scale;
+        variant.basePath = outputFileName.string() + "@" + std::to_string(scale) + "x";
+        variants->push_back(variant);
+    }
+
+    if (!vm.count("variant-dir"))
+        return true;
+
+    for (const std::string &spec : vm["variant-dir"].as<std::vector<std::string> >()) {
+        size_t sep = spec.find(':');
+        size_t scale = sep == std::string::npos ? 0 : readScale(spec.substr(0, sep));
+        auto variant = std::find_if(variants->begin(), variants->end(), [scale](const AtlasPack::AtlasVariant &v) {
+            return v.scale == scale;
+        });
+        if (variant == variants->end()) {
+            std::cerr << "--variant-dir "<<spec<<" does not name a scale of --variants."<<std::endl;
+            return false;
+        }
+
+        fs::path dir(spec.substr(sep + 1));
+        for (const AtlasPack::Image &img : images) {
+            fs::path file = dir / fs::relative(img.path(), readDir);
+            if (fs::exists(file))
+                variant->sources[img.path()] = file.string();
+        }
+    }
+    return true;
+}
+
+/*
+ * Builds all atlases listed in the manifest \a manifestFile on one shared worker pool.
+ * Every line of the manifest names a input directory and the output basename of its atlas,
+ * separated by whitespace. Paths containing spaces have to be quoted, relative paths are relative
+ * to the directory of the manifest. Empty lines and lines starting with # are ignored.
+ * Returns the exit code of the tool.
+ */
+static int runBatchMode (AtlasPack::Backend *backend, const fs::path &manifestFile, const po::variables_map &vm,
+                         AtlasPack::WorkerAffinity affinity)
+{
+    AtlasPack::BatchEntry options;
+    if (!readAtlasOptions(vm, &options))
+        return 1;
+
+    std::ifstream manifest(manifestFile.string());
+    if (!manifest.is_open()) {
+        std::cerr << "Could not open the batch manifest "<<manifestFile.string()<<std::endl;
+        return 1;
+    }
+
+    std::vector<std::pair<fs::path, fs::path> > groups;
+    const fs::path baseDir = manifestFile.parent_path();
+    std::string line;
+    for (size_t lineNr = 1; std::getline(manifest, line); lineNr++) {
+        std::istringstream lineStr(line);
+        std::string input, output;
+        if (!(lineStr >> std::quoted(input)) || input[0] == '#')
+            continue;
+
+        if (!(lineStr >> std::quoted(output))) {
+            std::cerr << manifestFile.string()<<":"<<lineNr<<": expected a input directory and a output basename"<<std::endl;
+            return 1;
+        }
+
+        fs::path inputPath(input), outputPath(output);
+        if (inputPath.is_relative())
+            inputPath = baseDir / inputPath;
+        if (outputPath.is_relative())
+            outputPath = baseDir / outputPath;
+        groups.emplace_back(inputPath, outputPath);
+    }
+
+    //read the image information of all groups in parallel
+    const bool recursive = vm.count("recursive") > 0;
+    const bool trim = vm.count("trim") > 0;
+    std::vector<AtlasPack::BatchEntry> entries(groups.size(), options);
+    {
+        AtlasPack::JobQueue<bool> probeJobs;
+        std::vector<std::future<bool> > probed;
+        for (size_t i = 0; i < groups.size(); i++) {
+            AtlasPack::BatchEntry *entry = &entries[i];
+            const fs::path dir = groups[i].first;
+            entry->basePath = groups[i].second.string();
+            probed.push_back(probeJobs.addTask([backend, entry, dir, recursive, trim]() {
+                entry->images = collectImageFiles(backend, dir, recursive, trim);
+                return true;
+            }, dir.string()));
+        }
+        for (std::future<bool> &res : probed)
+            res.get();
+    }
+
+    AtlasPack::BatchCompiler batch(backend, 0, affinity);
+    std::cout << "Building "<<entries.size()<<" atlases, "<<batch.concurrentAtlases()<<" at a time using "
+              << batch.threadCount()<<" worker threads"<<std::endl;
+
+    std::vector<AtlasPack::BatchResult> results = batch.run(entries, [](const AtlasPack::BatchResult &result) {
+        if (result.success) {
+            std::cout << "Created "<<result.basePath<<" with "<<result.report.compile.imageCount<<" Images, size "
+                      << result.report.compile.atlasSize.width<<std::endl;
+        } else {
+            std::cerr << "Failed to create "<<result.basePath<<", error was: "<<result.error<<std::endl;
+        }
+    });
+
+    int failed = 0;
+    for (const AtlasPack::BatchResult &result : results) {
+        if (!result.success)
+            failed++;
+    }
+    std::cout << "Built "<<(results.size() - failed)<<" of "<<results.size()<<" atlases."<<std::endl;
+
+    if (vm.count("report")) {
+        std::ofstream reportFile;
+        const std::string reportName = vm["report"].as<std::string>();
+        if (reportName != "-") {
+            reportFile.open(reportName, std::ios::trunc | std::ios::out);
+            if (!reportFile.is_open()) {
+                std::cerr << "Could not create report file "<<reportName<<std::endl;
+                return 1;
+            }
+        }
+
+        std::ostream &out = reportName == "-" ? reportStdout : reportFile;
+        out << "[\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            if (i) out << ",\n";
+            results[i].report.writeJson(out);
+        }
+        out << "]\n";
+        out.flush();
+    }
+
+    if (vm.count("trace") && !writeTrace(vm["trace"].as<std::string>()))
+        return 1;
+
+    return failed ? 1 : 0;
+}
+
+/*
+ * Packs all images in \a readDir into the atlas \a outputFileName and keeps it up to date
+ * until the process is terminated. Changed images are decoded and painted again, all other
+ * images stay in memory. Returns the exit code of the tool.
+ */
+static int runWatchMode (AtlasPack::Backend *backend, const fs::path &readDir, const fs::path &outputFileName,
+                         const po::variables_map &vm)
+{
+    if (vm.count("mipmaps") || vm.count("compress") || vm.count("no-png")) {
+        std::cerr << "--watch only writes the png atlas image, it can not be combined with --mipmaps, --compress or --no-png."<<std::endl;
+        return 1;
+    }
+
+    const bool recursive = vm.count("recursive") > 0;
+    const unsigned int debounce = vm["debounce"].as<unsigned int>();
+
+    AtlasPack::LiveAtlas atlas(backend, outputFileName.string());
+    atlas.setTrimImages(vm.count("trim") > 0);
+    if (vm.count("align"))
+        atlas.setPlacementAlignment(vm["align"].as<size_t>());
+    if (vm.count("tiles")) {
+        if (vm["tiles"].as<size_t>() == 0) {
+            std::cerr << "--tiles requires a positive tile size."<<std::endl;
+            return 1;
+        }
+        atlas.setTileSize(vm["tiles"].as<size_t>());
+    }
+
+    AtlasPack::PackPolicy policy;
+    if (!readPackPolicy(vm, &policy))
+        return 1;
+    atlas.setPackPolicy(policy);
+
+    //start watching before the first build, so no change gets lost
+    AtlasPack::DirectoryWatcher watcher(readDir.string(), recursive);
+    if (!watcher.isValid()) {
+        std::cerr << "Could not watch the input directory."<<std::endl;
+        return 1;
+    }
+
+    auto rebuild = [&]() {
+        auto start = std::chrono::steady_clock::now();
+        std::string err;
+        if (!atlas.rebuild(collectImagePaths(backend, readDir, recursive), &err)) {
+            std::cerr << "Failed to create Atlas, error was: "<<err<<std::endl;
+            return false;
+        }
+        std::cout << "Created a Atlas with "<<atlas.count()<<" Images of size "<<atlas.size().width
+                  << " in "<<std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms."<<std::endl;
+        return true;
+    };
+
+    rebuild();
+    std::cout << "Watching "<<readDir.string()<<" for changes, press Ctrl+C to stop."<<std::endl;
+
+    while (true) {
+        std::string err;
+        std::vector<std::string> changes = watcher.waitForChanges(debounce, &err);
+        if (changes.empty()) {
+            if (!err.empty()) {
+                std::cerr << err << std::endl;
+                return 1;
+            }
+            continue;
+        }
+
+        //directories that are reported, for example when events were lost, are compared
+        //with the atlas by the update, only their changed files are decoded again
+        auto start = std::chrono::steady_clock::now();
+        std::vector<AtlasPack::Rect> dirty;
+        bool repacked = false;
+        if (!atlas.update(changes, &dirty, &repacked, &err)) {
+            std::cerr << "Failed to update the Atlas, error was: "<<err<<std::endl;
+            continue;
+        }
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (repacked) {
+            std::cout << "Packed "<<atlas.count()<<" Images again into a Atlas of size "<<atlas.size().width
+                      << " in "<<ms<<" ms."<<std::endl;
+        } else if (!dirty.empty()) {
+            std::cout << "Updated "<<dirty.size()<<" areas of the Atlas in "<<ms<<" ms:";
+            for (const AtlasPack::Rect &rect : dirty)
+                std::cout << " "<<rect.size.width<<"x"<<rect.size.height<<"+"<<rect.topLeft.x<<"+"<<rect.topLeft.y;
+            std::cout << std::endl;
+        }
+    }
+}
+
 /*
  * Builds the commandline parameters and parses the arguments. Returns \a true on success.
  */
@@ -134,13 +599,42 @@ static bool parseCommandline (int argc, char *argv[], po::variables_map &vm) {
     //split the arguments in pack and extract groups so the help is easier to read
     po::options_description descPack("pack");
     descPack.add_options()
-            ("recursive,r", "Search also subdirectories for images");
+            ("recursive,r", "Search also subdirectories for images")
+            ("trim,t", "Cut off fully transparent borders of the images before packing")
+            ("mipmaps,m", "Generate the full mipmap chain of the atlas image")
+            ("compress", po::value<std::string>(), "Additionally write a block compressed DDS texture, either bc1 or bc3")
+            ("no-png", "Do not write the png images, requires --compress or --tiles")
+            ("variants", po::value<std::string>(), "Also write scaled copies of the atlas from the same layout, a list like 1,2,3 where the biggest scale is the scale of the input images, the others are written to <basename>@<scale>x")
+            ("variant-dir", po::value<std::vector<std::string> >(), "SCALE:DIR, paint the images found in DIR into the variant of this scale instead of scaling them down, can be given multiple times")
+            ("tiles", po::value<size_t>(), "Also write the atlas as tiles of N pixels, only tiles that changed since the last run are written again and listed in a .delta file")
+            ("report", po::value<std::string>(), "Write the duration of every phase and the atlas occupancy as JSON to a file, - writes to stdout")
+            ("trace", po::value<std::string>(), "Record the execution of all worker tasks and write them as Chrome trace JSON to a file")
+            ("batch", po::value<std::string>(), "Build all atlases listed in a manifest file on one shared thread pool, every line names a input directory and a output basename")
+            ("watch,w", "Keep running and update the atlas whenever images in the input directory change")
+            ("debounce", po::value<unsigned int>()->default_value(100), "Milliseconds without further changes before --watch updates the atlas")
+            ("swap-dir", po::value<std::string>(), "Paint the atlas into tiles in a temporary file in this directory, for atlases bigger than the memory, only png output")
+            ("resident-mb", po::value<size_t>()->default_value(256), "Megabytes of tiles --swap-dir keeps in memory")
+            ("server", po::value<std::string>(), "Keep running and pack the atlases requested over the Unix socket at this path, with a warm thread pool and image cache")
+            ("connect", po::value<std::string>(), "Send the pack request to the server listening on this socket instead of packing in this process")
+            ("cache-mb", po::value<size_t>(), "Keep up to N megabytes of decoded images for images painted more than once, defaults to 512 with --server and 0 otherwise")
+            ("decode-mb", po::value<size_t>()->default_value(1024), "Only paint as many images at the same time as their decoded pixels fit into N megabytes, 0 paints all at once")
+            ("prefetch-mb", po::value<size_t>()->default_value(64), "Read up to N megabytes of image files ahead of the paint tasks, 0 lets every paint task read its file itself")
+            ("pin", po::value<std::string>(), "Pin the worker threads, none (default), cores pins every worker to one core, numa keeps them on their NUMA node")
+            ("shards", po::value<unsigned int>(), "Paint the atlas with N worker processes, each painting one band of the atlas, only png output")
+            ("split", po::value<std::string>(), "How the free space next to a image is divided, longer (default) keeps the biggest free area, shorter keeps them square")
+            ("fit", po::value<std::string>(), "Which free area a image is placed into, first (default) or best-area")
+            ("optimize", po::value<double>(), "Spend N milliseconds searching the image order, split rule and fit heuristic that give the smallest atlas, replaces --split and --fit")
+            ("hierarchical", "Pack the images in clusters of similar images first and then the clusters into the atlas, much faster for very many images")
+            ("cluster-size", po::value<size_t>()->default_value(1024), "Images per cluster of --hierarchical")
+            ("align", po::value<size_t>(), "Align image positions to multiples of N pixels, defaults to 4 if mipmaps or compressed textures are generated, 1 otherwise");
 
     //the following options will not be shown in help, this is required for positional arguments
     po::options_description hiddenOptions("Hidden");
     hiddenOptions.add_options()
             ("input-or-output-file", po::value<std::string>(), "")
-            ("atlasBaseName",  po::value<std::string>(), "Path and basename where the texture atlas should be placed");
+            ("atlasBaseName",  po::value<std::string>(), "Path and basename where the texture atlas should be placed")
+            ("shard-worker", po::value<std::string>(), "")
+            ("shard-index", po::value<unsigned int>()->default_value(0), "");
 
     // Declare an options description instance which will include
     // all the options
@@ -191,6 +685,106 @@ static bool parseCommandline (int argc, char *argv[], po::variables_map &vm) {
     return true;
 }
 
+static AtlasPack::PackServer *runningServer = nullptr;
+
+static void stopServer (int)
+{
+    if (runningServer)
+        runningServer->stop();
+}
+
+/*
+ * Serves pack requests on the Unix socket \a socketPath until the process
+ * receives SIGINT or SIGTERM. Returns the exit code of the tool.
+ */
+static int runServerMode (AtlasPack::Backend *backend, const std::string &socketPath, AtlasPack::WorkerAffinity affinity)
+{
+    AtlasPack::PackServer server(backend, 0, affinity);
+    std::string err;
+    if (!server.listen(socketPath, &err)) {
+        std::cerr << err << std::endl;
+        return 1;
+    }
+
+    runningServer = &server;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+
+    std::cout << "Serving pack requests on "<<socketPath<<" with "<<server.threadCount()<<" worker threads, press Ctrl+C to stop."<<std::endl;
+    server.run();
+
+    runningServer = nullptr;
+    std::cout << "Served "<<server.servedRequests()<<" requests."<<std::endl;
+    return 0;
+}
+
+/*
+ * Sends the pack request described by the command line to the server listening on \a socketPath
+ * and prints its answer. Returns the exit code of the tool.
+ */
+static int runClientMode (const std::string &socketPath, const fs::path &readDir, const fs::path &outputFileName,
+                          const po::variables_map &vm)
+{
+    AtlasPack::PackRequest request;
+    if (!readAtlasOptions(vm, &request.atlas))
+        return 1;
+
+    //the server has its own working directory
+    request.inputDirectory = fs::absolute(readDir).string();
+    request.atlas.basePath = fs::absolute(outputFileName).string();
+    request.recursive = vm.count("recursive") > 0;
+    request.trim = vm.count("trim") > 0;
+    request.sendReport = vm.count("report") > 0;
+    if (vm.count("optimize"))
+        request.optimizeMs = vm["optimize"].as<double>();
+
+    std::string reportJson;
+    std::string err;
+    bool success = AtlasPack::PackServer::sendRequest(socketPath, request, [&reportJson](const std::string &line) {
+        if (line.compare(0, 7, "report ") == 0)
+            reportJson = line.substr(7);
+        else if (line.compare(0, 9, "progress ") == 0)
+            std::cout << line.substr(9) << std::endl;
+        else if (line.compare(0, 8, "skipped ") == 0)
+            std::cerr << "Error when trying to load "<<line.substr(8)<<" skipping file."<<std::endl;
+    }, &err);
+
+    if (!success) {
+        std::cerr << "Failed to create Atlas, error was: "<<err<<std::endl;
+        return 1;
+    }
+
+    if (request.sendReport) {
+        const std::string reportName = vm["report"].as<std::string>();
+        if (reportName == "-") {
+            reportStdout << reportJson << std::endl;
+        } else {
+            std::ofstream out(reportName, std::ios::trunc | std::ios::out);
+            if (!out.is_open()) {
+                std::cerr << "Could not create report file "<<reportName<<std::endl;
+                return 1;
+            }
+            out << reportJson << std::endl;
+        }
+    }
+
+    std::cout << "Created "<<request.atlas.basePath<<std::endl;
+    return 0;
+}
+
+/*
+ * Returns the path of the running executable, which is started again
+ * for the worker processes of --shards
+ */
+static std::string workerExecutable (const char *argv0)
+{
+    boost::system::error_code ec;
+    fs::path self = fs::read_symlink("/proc/self/exe", ec);
+    if (!ec && fs::exists(self))
+        return self.string();
+    return argv0;
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -201,7 +795,52 @@ int main(int argc, char *argv[])
 
     //initialize the backend, this could be extended to load automatically
     //from plugins
-    AtlasPack::Backends::MagickBackend backend;
+    AtlasPack::Backends::MagickBackend magickBackend;
+    AtlasPack::Backend *backend = &magickBackend;
+
+    //decoded images are kept for images that are painted more than once, the server keeps them by default
+    size_t cacheMb = vm.count("server") ? 512 : 0;
+    if (vm.count("cache-mb"))
+        cacheMb = vm["cache-mb"].as<size_t>();
+    AtlasPack::ImageCache imageCache(cacheMb << 20);
+    if (cacheMb)
+        magickBackend.setImageCache(&imageCache);
+
+    //atlases bigger than the memory are painted into tiles in a swap file
+    std::unique_ptr<AtlasPack::TiledBackend> tiledBackend;
+    if (vm.count("swap-dir")) {
+        tiledBackend.reset(new AtlasPack::TiledBackend(&magickBackend, vm["swap-dir"].as<std::string>(),
+                                                       vm["resident-mb"].as<size_t>() << 20));
+        backend = tiledBackend.get();
+    }
+
+    //started by a sharded compile to paint one band of the atlas
+    if (vm.count("shard-worker")) {
+        std::string err;
+        if (!AtlasPack::ShardedCompiler::runWorker(vm["shard-worker"].as<std::string>(), vm["shard-index"].as<unsigned int>(),
+                                                   &magickBackend, &err)) {
+            std::cerr << "Shard worker failed: " << err << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (vm.count("trace"))
+        AtlasPack::Trace::setEnabled(true);
+
+    //the report owns stdout, everything else is printed to stderr
+    if (vm.count("report") && vm["report"].as<std::string>() == "-")
+        std::cout.rdbuf(std::cerr.rdbuf());
+
+    AtlasPack::WorkerAffinity affinity;
+    if (!readWorkerAffinity(vm, &affinity))
+        return 1;
+
+    if (vm.count("server"))
+        return runServerMode(backend, vm["server"].as<std::string>(), affinity);
+
+    if (vm.count("batch"))
+        return runBatchMode(backend, vm["batch"].as<std::string>(), vm, affinity);
 
     if (vm.count("input-or-output-file") != 1) {
         std::cerr << "Input directory was not specified."<<std::endl;
@@ -217,6 +856,7 @@ int main(int argc, char *argv[])
         outputFileName = vm["atlasBaseName"].as<std::string>();
     }
 
+    AtlasPack::PackReport report;
     std::vector<AtlasPack::Image> images;
     fs::path readDir(vm["input-or-output-file"].as<std::string>());
     try {
@@ -229,8 +869,18 @@ int main(int argc, char *argv[])
             std::cerr << "Input path is not a directory."<<std::endl;
             return 1;
         }
+
+        if (vm.count("watch"))
+            return runWatchMode(backend, readDir, outputFileName, vm);
+
+        if (vm.count("connect"))
+            return runClientMode(vm["connect"].as<std::string>(), readDir, outputFileName, vm);
+
         std::cout << "Starting to collect files"<<std::endl;
-        images = collectImageFiles(&backend, readDir, vm.count("recursive") > 0);
+        auto scanStart = std::chrono::steady_clock::now();
+        images = collectImageFiles(backend, readDir, vm.count("recursive") > 0, vm.count("trim") > 0, &report.probeMs);
+        report.scanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scanStart).count() - report.probeMs;
+        report.imageCount = images.size();
         std::cout << "Collected "<<images.size()<<" files."<<std::endl;
 
     } catch (const fs::filesystem_error& ex) {
@@ -240,97 +890,109 @@ int main(int argc, char *argv[])
 
     if (images.size() > 0) {
 
-        AtlasPack::JobQueue<std::shared_ptr<AtlasPack::TextureAtlasPacker> > jobQueue;
-
-        auto packer = [](const AtlasPack::Size &s, const std::vector<AtlasPack::Image> &images) {
-            std::shared_ptr<AtlasPack::TextureAtlasPacker> result = std::make_shared<AtlasPack::TextureAtlasPacker>(s);
-            for (const auto &img : images) {
-                if (!result->insertImage(img)) {
-                    return std::shared_ptr<AtlasPack::TextureAtlasPacker>();
-                }
-            }
-            return result;
-        };
-
+        AtlasPack::BatchEntry options;
+        if (!readAtlasOptions(vm, &options))
+            return 1;
 
-        unsigned int cores = jobQueue.maxJobs();
+        std::vector<AtlasPack::AtlasVariant> variants;
+        size_t layoutScale = 1;
+        if (!readVariants(vm, readDir, outputFileName, images, &variants, &layoutScale))
+            return 1;
 
-        //first find a atlas that fits all, incremement by 1000
-        size_t lastSize = 1000;
-        size_t increment = 100;
+        //every image has to start at a whole pixel in all variants
+        const size_t variantAlignment = AtlasPack::TextureAtlasPacker::variantAlignment(variants, layoutScale);
+        size_t alignment = options.alignment;
+        while (alignment % variantAlignment)
+            alignment += options.alignment;
+        options.alignment = alignment;
 
-        std::cout<<"Using "<<cores<<" cores to calculate Atlas"<<std::endl;
+        //one pool for packing and painting, the packing trials run before the paint tasks
+        AtlasPack::JobQueue<bool> jobs(0, affinity);
 
         std::shared_ptr<AtlasPack::TextureAtlasPacker> lastPossibleAtlas;
-
-        while (!lastPossibleAtlas) {
-
-            std::vector<std::future<std::shared_ptr<AtlasPack::TextureAtlasPacker> > > taskResults;
-
-            for (unsigned int i = 0; i < cores; i++) {
-                //use std::bind to pass arguments to the job
-                auto fun = std::bind(packer, AtlasPack::Size(lastSize, lastSize), images);
-                taskResults.push_back(jobQueue.addTask(fun));
-                lastSize += increment;
+        if (vm.count("hierarchical")) {
+            if (vm.count("optimize")) {
+                std::cerr << "--hierarchical can not be combined with --optimize."<<std::endl;
+                return 1;
             }
 
-            //wait until all tasks are finished
-            jobQueue.waitForAllRunningTasks();
-
-            //now find a Atlas that fits all images
-            for (auto &currJob : taskResults ) {
-                //if we get a Atlas we found one that fits
-                lastPossibleAtlas = currJob.get();
-                if (lastPossibleAtlas)
-                    break;
-            }
+            AtlasPack::HierarchicalPacker packer(&jobs);
+            packer.setPlacementAlignment(options.alignment);
+            packer.setPackPolicy(options.policy);
+            packer.setClusterSize(vm["cluster-size"].as<size_t>());
+
+            std::cout<<"Using "<<packer.threadCount()<<" worker threads to pack clusters of "<<packer.clusterSize()<<" Images"<<std::endl;
+            lastPossibleAtlas = packer.run(images, &report.hierarchical);
+        } else if (vm.count("optimize")) {
+            AtlasPack::PackOptimizer optimizer(&jobs);
+            optimizer.setPlacementAlignment(options.alignment);
+            optimizer.setTimeBudget(vm["optimize"].as<double>());
+
+            std::cout<<"Using "<<optimizer.threadCount()<<" worker threads to optimize the Atlas"<<std::endl;
+            lastPossibleAtlas = optimizer.run(images, &report.optimize);
+        } else {
+            AtlasPack::SizeSearch search(&jobs);
+            search.setPlacementAlignment(options.alignment);
+            search.setPackPolicy(options.policy);
+
+            std::cout<<"Using "<<search.threadCount()<<" worker threads to calculate Atlas"<<std::endl;
+            lastPossibleAtlas = search.run(images, &report.search);
         }
 
         if (lastPossibleAtlas) {
-            std::cout<<"Found a atlas that can contain all: "<<lastPossibleAtlas->size().height<<std::endl;
-            std::cout<<"Trying to shrink Atlas size"<<std::endl;
-
-            bool canGoOn = true;
-            size_t decrement = 1;
-            lastSize  = lastPossibleAtlas->size().height;
-            while (canGoOn) {
-
-                std::vector<std::future<std::shared_ptr<AtlasPack::TextureAtlasPacker> > > taskResults;
-
-                for (unsigned int i = 0; i < cores; i++) {
-
-                    //make sure we do not overflow
-                    if(decrement > lastSize)
-                        break;
-
-                    AtlasPack::Size mySize = AtlasPack::Size(lastSize - decrement, lastSize - decrement);
-
-                    auto fun = std::bind(packer, mySize, images);
-                    taskResults.push_back(jobQueue.addTask(fun));
+            std::cout<<"Final Atlas size: "<<lastPossibleAtlas->size().height<<std::endl;
+            std::cout<<"Compiling Atlas, this can take a lot of time ....."<<std::endl;
 
-                    lastSize -= decrement;
+            lastPossibleAtlas->setGenerateMipmaps(options.mipmaps);
+            lastPossibleAtlas->setBlockCompression(options.compression);
+            lastPossibleAtlas->setExportPng(options.exportPng);
+            lastPossibleAtlas->setDecodeBudget(options.decodeBudget);
+            lastPossibleAtlas->setPrefetchWindow(options.prefetchWindow);
+            lastPossibleAtlas->setTileSize(options.tileSize);
+            lastPossibleAtlas->setVariants(variants, layoutScale);
+            lastPossibleAtlas->setJobQueue(&jobs);
+
+            //print every 10% of painted images and every phase change
+            int lastStep = -1;
+            AtlasPack::CompilePhase lastPhase = AtlasPack::CompilePhase::Painting;
+            auto printProgress = [&lastStep, &lastPhase](const AtlasPack::CompileProgress &progress) {
+                if (progress.phase == AtlasPack::CompilePhase::Painting && progress.totalImages) {
+                    int step = static_cast<int>(progress.paintedImages * 10 / progress.totalImages);
+                    if (step != lastStep)
+                        std::cout<<"Painted "<<progress.paintedImages<<" of "<<progress.totalImages<<" Images"<<std::endl;
+                    lastStep = step;
+                } else if (progress.phase != lastPhase) {
+                    static const char *phaseNames[] = { "Painting", "Generating mipmaps", "Compressing",
+                                                        "Exporting the Atlas image", "Writing the Atlas description", "Done" };
+                    std::cout<<phaseNames[static_cast<int>(progress.phase)]<<std::endl;
                 }
+                lastPhase = progress.phase;
+            };
 
-                //wait for all tasks to be finished
-                jobQueue.waitForAllRunningTasks();
-
-                for (auto &currJob : taskResults ) {
-                    auto result = currJob.get();
-                    if (result)
-                        lastPossibleAtlas = result;
-                    else {
-                        //tell the loop we found a Atlas
-                        canGoOn = false;
-                        break;
-                    }
+            std::string err;
+            AtlasPack::TextureAtlas atlas;
+            if (vm.count("shards")) {
+                if (options.mipmaps || options.compression != AtlasPack::BlockCompression::None || options.tileSize
+                        || !variants.empty()) {
+                    std::cerr << "--shards only writes the png atlas image, it can not be combined with --mipmaps, --compress, --tiles or --variants."<<std::endl;
+                    return 1;
                 }
-            }
 
-            std::cout<<"Final Atlas size: "<<lastPossibleAtlas->size().height<<std::endl;
-            std::cout<<"Compiling Atlas, this can take a lot of time ....."<<std::endl;
+                AtlasPack::ShardedCompiler sharded(workerExecutable(argv[0]), backend);
+                sharded.setShardCount(vm["shards"].as<unsigned int>());
+                std::cout<<"Painting with "<<sharded.shardCount()<<" worker processes"<<std::endl;
+                atlas = sharded.compile(*lastPossibleAtlas, outputFileName.string(), &err, &report.compile);
+            } else {
+                AtlasPack::CompileHandle compileRun = lastPossibleAtlas->compileAsync(outputFileName.string(), backend,
+                                                                                     printProgress, &report.compile);
+                atlas = compileRun.result(&err);
+            }
 
-            std::string err;
-            AtlasPack::TextureAtlas atlas = lastPossibleAtlas->compile(outputFileName.string(), &backend, &err);
+            report.peakMemory = AtlasPack::peakMemoryUsage();
+            if (vm.count("report") && !writeReport(report, vm["report"].as<std::string>()))
+                return 1;
+            if (vm.count("trace") && !writeTrace(vm["trace"].as<std::string>()))
+                return 1;
 
             if(atlas.isValid()) {
                 std::cout<<"Created a Atlas with "<<atlas.count()<<" Images from a List of "<<images.size()<<" Images."<<std::endl;
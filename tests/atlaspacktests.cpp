@@ -0,0 +1,469 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Benjamin Zeller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "memorybackend.h"
+
+#include <AtlasPack/TextureAtlasPacker>
+#include <AtlasPack/HierarchicalPacker>
+#include <AtlasPack/TextureAtlas>
+#include <AtlasPack/Image>
+#include <AtlasPack/LiveAtlas>
+#include <AtlasPack/PixelBuffer>
+#include <AtlasPack/freerects_p.h>
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+/*
+ * Minimal regression tests, every test returns true on success and prints
+ * the reason of a failure to stderr.
+ */
+struct TestCase {
+    const char *name;
+    std::function<bool (const fs::path &workDir)> run;
+};
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            return false; \
+        } \
+    } while (0)
+
+static bool overlaps (const AtlasPack::Rect &a, const AtlasPack::Rect &b)
+{
+    return a.topLeft.x < b.topLeft.x + b.size.width && b.topLeft.x < a.topLeft.x + a.size.width
+            && a.topLeft.y < b.topLeft.y + b.size.height && b.topLeft.y < a.topLeft.y + a.size.height;
+}
+
+static bool contains (const AtlasPack::Rect &outer, const AtlasPack::Rect &inner)
+{
+    return inner.topLeft.x >= outer.topLeft.x && inner.topLeft.y >= outer.topLeft.y
+            && inner.topLeft.x + inner.size.width <= outer.topLeft.x + outer.size.width
+            && inner.topLeft.y + inner.size.height <= outer.topLeft.y + outer.size.height;
+}
+
+/*
+ * Every cell has to be inside the atlas and must not overlap any other cell
+ */
+static bool validLayout (const std::vector<AtlasPack::Placement> &placements, const AtlasPack::Size &size)
+{
+    const AtlasPack::Rect bounds(AtlasPack::Pos(0, 0), size);
+    for (size_t i = 0; i < placements.size(); i++) {
+        if (!contains(bounds, placements[i].cell)) {
+            std::cerr << placements[i].image.path() << " is outside of the atlas" << std::endl;
+            return false;
+        }
+        for (size_t j = i + 1; j < placements.size(); j++) {
+            if (overlaps(placements[i].cell, placements[j].cell)) {
+                std::cerr << placements[i].image.path() << " overlaps " << placements[j].image.path() << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static const AtlasPack::Placement *findPlacement (const std::vector<AtlasPack::Placement> &placements, const std::string &path)
+{
+    for (const AtlasPack::Placement &placement : placements) {
+        if (placement.image.path() == path)
+            return &placement;
+    }
+    return nullptr;
+}
+
+/*
+ * An atlas without images still has to compile, with an empty description
+ */
+static bool compileEmptyAtlas (const fs::path &workDir)
+{
+    MemoryBackend backend;
+    AtlasPack::TextureAtlasPacker packer(AtlasPack::Size(64, 64));
+
+    std::string err;
+    const std::string basePath = (workDir / "empty").string();
+    AtlasPack::TextureAtlas atlas = packer.compile(basePath, &backend, &err);
+    if (!atlas.isValid())
+        std::cerr << err << std::endl;
+    CHECK(atlas.isValid());
+    CHECK(atlas.count() == 0);
+    CHECK(fs::exists(basePath + ".atlas"));
+    CHECK(fs::file_size(basePath + ".atlas") == 0);
+    return true;
+}
+
+/*
+ * A content area outside of the pixels makes the image invalid, so it is never
+ * packed or painted, and a region outside of a view is not handed out
+ */
+static bool rejectOutOfBoundsContent (const fs::path &)
+{
+    auto pixels = std::make_shared<AtlasPack::PixelBuffer>(AtlasPack::Size(16, 16));
+    const AtlasPack::Rect inside(AtlasPack::Pos(4, 4), AtlasPack::Size(12, 12));
+    const AtlasPack::Rect outside(AtlasPack::Pos(8, 8), AtlasPack::Size(12, 4));
+    const AtlasPack::Rect overflow(AtlasPack::Pos(static_cast<size_t>(-4), 0), AtlasPack::Size(8, 8));
+
+    CHECK(AtlasPack::Image("inside", pixels, inside).isValid());
+    CHECK(!AtlasPack::Image("outside", pixels, outside).isValid());
+    CHECK(!AtlasPack::Image("overflow", pixels, overflow).isValid());
+
+    auto provider = [](AtlasPack::PixelBuffer *target) {
+        *target = AtlasPack::PixelBuffer(AtlasPack::Size(16, 16));
+        return true;
+    };
+    CHECK(!AtlasPack::Image("provided", AtlasPack::Size(16, 16), outside, provider).isValid());
+    CHECK(!AtlasPack::Image("file.png", AtlasPack::Size(16, 16), outside).isValid());
+
+    AtlasPack::TextureAtlasPacker packer(AtlasPack::Size(64, 64));
+    CHECK(!packer.insertImage(AtlasPack::Image("outside", pixels, outside)));
+    CHECK(packer.placements().empty());
+
+    const AtlasPack::PixelView view = pixels->view();
+    CHECK(view.contains(inside));
+    CHECK(!view.contains(outside));
+    CHECK(!view.contains(overflow));
+    return true;
+}
+
+/*
+ * Removing every image of a live atlas, like in watch mode, keeps a empty atlas
+ */
+static bool liveAtlasWithoutImages (const fs::path &workDir)
+{
+    MemoryBackend backend;
+    backend.addImage("a.png", AtlasPack::Size(20, 10));
+    backend.addImage("b.png", AtlasPack::Size(10, 30));
+
+    const std::string basePath = (workDir / "live").string();
+    AtlasPack::LiveAtlas atlas(&backend, basePath);
+
+    std::string err;
+    CHECK(atlas.rebuild(std::vector<std::string>(), &err));
+    CHECK(atlas.count() == 0);
+    CHECK(fs::file_size(basePath + ".atlas") == 0);
+
+    //the memory images are no files, so the update sees them as removed
+    CHECK(atlas.rebuild({ "a.png", "b.png" }, &err));
+    CHECK(atlas.count() == 2);
+    CHECK(atlas.update({ "a.png", "b.png" }, nullptr, nullptr, &err));
+    CHECK(atlas.count() == 0);
+    CHECK(atlas.flush(&err));
+    CHECK(fs::file_size(basePath + ".atlas") == 0);
+    return true;
+}
+
+/*
+ * A reported directory is compared with the atlas, only its changed files are updated
+ * and only the tiles they touch are listed in the delta
+ */
+static bool liveAtlasRescanDirectory (const fs::path &workDir)
+{
+    const fs::path inputDir = workDir / "watched";
+    fs::create_directories(inputDir);
+
+    MemoryBackend backend;
+    std::vector<std::string> files;
+    for (const char *name : { "a.png", "b.png", "c.png" }) {
+        const std::string path = (inputDir / name).string();
+        std::ofstream(path) << name;
+        backend.addImage(path, AtlasPack::Size(40, 40));
+        files.push_back(path);
+    }
+
+    const std::string basePath = (workDir / "rescan").string();
+    AtlasPack::LiveAtlas atlas(&backend, basePath);
+    atlas.setTileSize(16);
+
+    std::string err;
+    CHECK(atlas.rebuild(files, &err));
+    CHECK(atlas.count() == 3);
+
+    //a grows in size on disk, b is deleted, c stays untouched
+    std::ofstream(files[0]) << "changed content";
+    fs::remove(files[1]);
+
+    std::vector<AtlasPack::Rect> dirty;
+    bool repacked = true;
+    CHECK(atlas.update({ inputDir.string() }, &dirty, &repacked, &err));
+    CHECK(!repacked);
+    CHECK(atlas.count() == 2);
+    CHECK(dirty.size() == 2);    //the cells of a and b
+
+    std::ifstream delta(basePath + ".delta");
+    std::string header;
+    CHECK(std::getline(delta, header));
+    CHECK(header.find("partial") != std::string::npos);
+
+    //nothing changed since, so the next rescan does not touch the atlas
+    CHECK(atlas.update({ inputDir.string() }, &dirty, &repacked, &err));
+    CHECK(dirty.empty());
+    CHECK(atlas.flush(&err));
+    CHECK(fs::exists(basePath + ".atlas"));
+    return true;
+}
+
+/*
+ * Blocks inserted with insertAtlas keep their layout at the offset of their cell, and
+ * their free areas take in images afterwards. The same is done by the hierarchical packer.
+ */
+static bool insertAtlasKeepsBlockLayout (const fs::path &)
+{
+    for (AtlasPack::FitHeuristic fit : { AtlasPack::FitHeuristic::FirstFit, AtlasPack::FitHeuristic::BestAreaFit }) {
+        AtlasPack::PackPolicy policy;
+        policy.fit = fit;
+
+        AtlasPack::TextureAtlasPacker first(AtlasPack::Size(64, 64), policy);
+        CHECK(first.insertImage(AtlasPack::Image("a.png", AtlasPack::Size(32, 32))));
+        CHECK(first.insertImage(AtlasPack::Image("b.png", AtlasPack::Size(48, 16))));
+        CHECK(first.insertImage(AtlasPack::Image("c.png", AtlasPack::Size(20, 10))));
+
+        AtlasPack::TextureAtlasPacker second(AtlasPack::Size(64, 32), policy);
+        CHECK(second.insertImage(AtlasPack::Image("d.png", AtlasPack::Size(32, 32))));
+
+        //the blocks fill the atlas, so the last image has to go into a free area of a block
+        AtlasPack::TextureAtlasPacker atlas(AtlasPack::Size(64, 96), policy);
+        AtlasPack::Rect firstCell, secondCell;
+        CHECK(atlas.insertAtlas(first, &firstCell));
+        CHECK(atlas.insertAtlas(second, &secondCell));
+        CHECK(!overlaps(firstCell, secondCell));
+
+        std::vector<AtlasPack::Placement> placements = atlas.placements();
+        CHECK(placements.size() == 4);
+        CHECK(validLayout(placements, atlas.size()));
+        for (const AtlasPack::TextureAtlasPacker *block : { &first, &second }) {
+            const AtlasPack::Rect &offset = block == &first ? firstCell : secondCell;
+            for (const AtlasPack::Placement &inBlock : block->placements()) {
+                const AtlasPack::Placement *placed = findPlacement(placements, inBlock.image.path());
+                CHECK(placed);
+                CHECK(placed->cell.topLeft.x == offset.topLeft.x + inBlock.cell.topLeft.x);
+                CHECK(placed->cell.topLeft.y == offset.topLeft.y + inBlock.cell.topLeft.y);
+                CHECK(placed->cell.size.width == inBlock.cell.size.width);
+                CHECK(placed->cell.size.height == inBlock.cell.size.height);
+            }
+        }
+
+        AtlasPack::Rect cell;
+        CHECK(atlas.insertImage(AtlasPack::Image("e.png", AtlasPack::Size(16, 16)), &cell));
+        CHECK(contains(firstCell, cell) || contains(secondCell, cell));
+        placements = atlas.placements();
+        CHECK(placements.size() == 5);
+        CHECK(validLayout(placements, atlas.size()));
+
+        std::vector<AtlasPack::Image> images;
+        for (size_t i = 0; i < 40; i++)
+            images.emplace_back("img" + std::to_string(i) + ".png", AtlasPack::Size(8 + i % 7 * 5, 8 + i % 5 * 7));
+        AtlasPack::HierarchicalPacker hierarchical(2);
+        hierarchical.setClusterSize(8);
+        hierarchical.setPackPolicy(policy);
+        std::shared_ptr<AtlasPack::TextureAtlasPacker> combined = hierarchical.run(images);
+        CHECK(combined);
+        placements = combined->placements();
+        CHECK(placements.size() == images.size());
+        CHECK(validLayout(placements, combined->size()));
+    }
+    return true;
+}
+
+/*
+ * The packing tree TextureAtlasPacker used before the pack policies, the default
+ * policy has to produce exactly its layouts
+ */
+struct ReferenceNode {
+    AtlasPack::Rect rect;
+    bool used = false;
+    std::unique_ptr<ReferenceNode> left;
+    std::unique_ptr<ReferenceNode> right;
+};
+
+static bool referenceInsert (ReferenceNode *node, const AtlasPack::Size &cell, AtlasPack::Rect *placed)
+{
+    if (node->left)
+        return referenceInsert(node->left.get(), cell, placed) || referenceInsert(node->right.get(), cell, placed);
+
+    const AtlasPack::Size nodeSize = node->rect.size;
+    if (node->used || nodeSize.width < cell.width || nodeSize.height < cell.height)
+        return false;
+
+    if (nodeSize.width == cell.width && nodeSize.height == cell.height) {
+        node->used = true;
+        *placed = node->rect;
+        return true;
+    }
+
+    const AtlasPack::Pos pos = node->rect.topLeft;
+    node->left.reset(new ReferenceNode);
+    node->right.reset(new ReferenceNode);
+    if (nodeSize.width - cell.width > nodeSize.height - cell.height) {
+        node->left->rect  = AtlasPack::Rect(pos, AtlasPack::Size(cell.width, nodeSize.height));
+        node->right->rect = AtlasPack::Rect(AtlasPack::Pos(pos.x + cell.width, pos.y),
+                                            AtlasPack::Size(nodeSize.width - cell.width, nodeSize.height));
+    } else {
+        node->left->rect  = AtlasPack::Rect(pos, AtlasPack::Size(nodeSize.width, cell.height));
+        node->right->rect = AtlasPack::Rect(AtlasPack::Pos(pos.x, pos.y + cell.height),
+                                            AtlasPack::Size(nodeSize.width, nodeSize.height - cell.height));
+    }
+    return referenceInsert(node->left.get(), cell, placed);
+}
+
+static bool defaultPolicyMatchesNodeTree (const fs::path &)
+{
+    //the same pseudo random sizes on every run, some of them do not fit anymore
+    uint32_t seed = 12345;
+    auto next = [&seed](size_t range) {
+        seed = seed * 1103515245u + 12345u;
+        return static_cast<size_t>((seed >> 16) % range);
+    };
+
+    for (size_t alignment : { 1, 4 }) {
+        const AtlasPack::Size atlasSize(256, 192);
+        ReferenceNode root;
+        root.rect = AtlasPack::Rect(AtlasPack::Pos(0, 0), atlasSize);
+
+        AtlasPack::TextureAtlasPacker packer(atlasSize);
+        packer.setPlacementAlignment(alignment);
+        size_t failed = 0;
+        for (size_t i = 0; i < 300; i++) {
+            const AtlasPack::Size size(1 + next(40), 1 + next(40));
+            const AtlasPack::Size cell((size.width + alignment - 1) / alignment * alignment,
+                                       (size.height + alignment - 1) / alignment * alignment);
+
+            AtlasPack::Rect expected, placed;
+            const bool fits = referenceInsert(&root, cell, &expected);
+            CHECK(packer.insertImage(AtlasPack::Image("img" + std::to_string(i) + ".png", size), &placed) == fits);
+            if (!fits) {
+                failed++;
+                continue;
+            }
+            CHECK(placed.topLeft.x == expected.topLeft.x && placed.topLeft.y == expected.topLeft.y);
+            CHECK(placed.size.width == expected.size.width && placed.size.height == expected.size.height);
+        }
+        //make sure both the placing and the rejecting path were tested
+        CHECK(failed > 0 && failed < 300);
+
+        //a whole trial packed at once has to match as well
+        std::vector<AtlasPack::Image> images;
+        for (const AtlasPack::Placement &placement : packer.placements())
+            images.push_back(placement.image);
+        AtlasPack::TextureAtlasPacker batch(atlasSize);
+        batch.setPlacementAlignment(alignment);
+        CHECK(batch.insertImages(images));
+
+        ReferenceNode batchRoot;
+        batchRoot.rect = AtlasPack::Rect(AtlasPack::Pos(0, 0), atlasSize);
+        const std::vector<AtlasPack::Placement> placements = batch.placements();
+        for (const AtlasPack::Image &img : images) {
+            const AtlasPack::Size cell((img.width() + alignment - 1) / alignment * alignment,
+                                       (img.height() + alignment - 1) / alignment * alignment);
+            AtlasPack::Rect expected;
+            CHECK(referenceInsert(&batchRoot, cell, &expected));
+            const AtlasPack::Placement *placed = findPlacement(placements, img.path());
+            CHECK(placed);
+            CHECK(placed->cell.topLeft.x == expected.topLeft.x && placed->cell.topLeft.y == expected.topLeft.y);
+        }
+    }
+    return true;
+}
+
+/*
+ * The 16 bit fit scan uses SSE2 where available, it has to pick the same rectangle
+ * as the scalar scan of the 32 bit version, including the first one on ties
+ */
+static bool vectorFitScanMatchesScalar (const fs::path &)
+{
+    uint32_t seed = 4711;
+    auto next = [&seed](uint32_t range) {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 8) % range;
+    };
+
+    //small ranges produce many ties, the largest one areas that need all 32 bits
+    for (uint32_t range : { 4u, 64u, 65536u }) {
+        for (size_t count = 0; count < 70; count++) {
+            std::vector<uint16_t> widths, heights;
+            for (size_t i = 0; i < count; i++) {
+                widths.push_back(static_cast<uint16_t>(next(range)));
+                heights.push_back(static_cast<uint16_t>(next(range)));
+            }
+            const std::vector<uint32_t> widths32(widths.begin(), widths.end());
+            const std::vector<uint32_t> heights32(heights.begin(), heights.end());
+
+            for (size_t trial = 0; trial < 20; trial++) {
+                const uint16_t width  = static_cast<uint16_t>(next(range));
+                const uint16_t height = static_cast<uint16_t>(next(range));
+                const size_t vector = AtlasPack::findSmallestFit(widths.data(), heights.data(), count, width, height);
+                const size_t scalar = AtlasPack::findSmallestFit(widths32.data(), heights32.data(), count,
+                                                                 uint32_t(width), uint32_t(height));
+                if (vector != scalar)
+                    std::cerr << "cell " << width << "x" << height << " of " << count << " rectangles" << std::endl;
+                CHECK(vector == scalar);
+            }
+        }
+    }
+
+    //the biggest rectangles, the area does not fit into a signed 32 bit value
+    std::vector<uint16_t> widths(9, 65535), heights(9, 65535);
+    heights[8] = 65534;
+    CHECK(AtlasPack::findSmallestFit(widths.data(), heights.data(), widths.size(), 65535, 1) == 8);
+    CHECK(AtlasPack::findSmallestFit(widths.data(), heights.data(), 8, 65535, 65535) == 0);
+    CHECK(AtlasPack::findSmallestFit(widths.data(), heights.data(), 8, 0, 0) == 0);
+    return true;
+}
+
+int main ()
+{
+    const std::vector<TestCase> tests = {
+        { "compileEmptyAtlas", compileEmptyAtlas },
+        { "rejectOutOfBoundsContent", rejectOutOfBoundsContent },
+        { "liveAtlasWithoutImages", liveAtlasWithoutImages },
+        { "liveAtlasRescanDirectory", liveAtlasRescanDirectory },
+        { "insertAtlasKeepsBlockLayout", insertAtlasKeepsBlockLayout },
+        { "defaultPolicyMatchesNodeTree", defaultPolicyMatchesNodeTree },
+        { "vectorFitScanMatchesScalar", vectorFitScanMatchesScalar },
+    };
+
+    const fs::path workDir = fs::temp_directory_path() / fs::unique_path("atlaspack-tests-%%%%-%%%%");
+    fs::create_directories(workDir);
+
+    int failed = 0;
+    for (const TestCase &test : tests) {
+        const bool ok = test.run(workDir);
+        std::cout << (ok ? "PASS " : "FAIL ") << test.name << std::endl;
+        if (!ok)
+            failed++;
+    }
+
+    boost::system::error_code ec;
+    fs::remove_all(workDir, ec);
+    return failed ? 1 : 0;
+}